@@ -26,6 +26,7 @@ public class OpenMotion : ModuleRules
 			new string[]
 			{
 				"Core",
+				"AnimGraphRuntime",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
@@ -36,6 +37,7 @@ public class OpenMotion : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"RenderCore",
 				"Slate",
 				"SlateCore",
 				// ... add private dependencies that you statically link with here ...	
@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AnimNode_OpenMotionFabrik.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "Misc/ScopeRWLock.h"
+
+#include "OpenMotion.h"
+
+DECLARE_CYCLE_STAT(TEXT("OpenMotion Fabrik AnimNode Eval"), STAT_AnimNodeOpenMotionFabrikEval, STATGROUP_OpenMotion);
+
+FAnimNode_OpenMotionFabrik::FAnimNode_OpenMotionFabrik()
+	: RigAsset(nullptr)
+	, InitializedRigAsset(nullptr)
+	, InitializedRigGeneration(-1)
+{
+}
+
+void FAnimNode_OpenMotionFabrik::GatherDebugData(FNodeDebugData& DebugData)
+{
+	FString DebugLine = DebugData.GetNodeName(this);
+
+	DebugLine += "(";
+	AddDebugNodeData(DebugLine);
+	DebugLine += FString::Printf(TEXT(" Rig: %s)"), RigAsset ? *RigAsset->GetName() : TEXT("None"));
+	DebugData.AddDebugItem(DebugLine);
+
+	ComponentPose.GatherDebugData(DebugData);
+}
+
+void FAnimNode_OpenMotionFabrik::EvaluateSkeletalControl_AnyThread(FComponentSpacePoseContext& Output, TArray<FBoneTransform>& OutBoneTransforms)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimNodeOpenMotionFabrikEval);
+
+	check(OutBoneTransforms.Num() == 0);
+
+	const FBoneContainer& BoneContainer = Output.Pose.GetPose().GetBoneContainer();
+
+	// The definition may be replaced from the game thread between IsValidToEvaluate and now, so check it again under
+	// the lock and leave the pose alone if the bones no longer fit
+	FReadScopeLock ReadLock(RigAsset->GetDefinitionLock());
+	if (!DoChainBonesMatchRig())
+	{
+		return;
+	}
+
+	// The rig is only read, so the pose and scratch space just need building once per definition
+	const bool bReadWholePose = (InitializedRigAsset != RigAsset || InitializedRigGeneration != RigAsset->GetGeneration());
+	if (bReadWholePose)
+	{
+		RigAsset->InitInstance(Instance, FVector::ZeroVector);
+		RigAsset->InitSolveContext(SolveContext);
+		Instance.UseJointBases = true;
+		InitializedRigAsset = RigAsset;
+		InitializedRigGeneration = RigAsset->GetGeneration();
+	}
+
+	// ---------- Read the incoming pose -----------
+
+	// Every joint the first time, then just the bases, leaving the rest where the last solve put them. Connected
+	// chains take their base from the host, so only a chain's own base is read.
+	const int32 NumChainsL = RigAsset->NumChains();
+	JointBoneIndices.Reset(RigAsset->NumJoints);
+	for (int32 ChainLoop = 0; ChainLoop < NumChainsL; ++ChainLoop)
+	{
+		for (const FBoneReference& Joint : ChainBones[ChainLoop].Joints)
+		{
+			const FCompactPoseBoneIndex BoneIndex = Joint.GetCompactPoseIndex(BoneContainer);
+			if (bReadWholePose || JointBoneIndices.Num() == RigAsset->GetChain(ChainLoop).JointStart)
+			{
+				Instance.Joints[JointBoneIndices.Num()] = Output.Pose.GetComponentSpaceTransform(BoneIndex).GetLocation();
+			}
+			JointBoneIndices.Add(BoneIndex);
+		}
+	}
+
+	// Chains without a target reach for where their end effector already is
+	SolveTargets.SetNumUninitialized(NumChainsL, false);
+	for (int32 ChainLoop = 0; ChainLoop < NumChainsL; ++ChainLoop)
+	{
+		const FFabrikRigChain& RigChain = RigAsset->GetChain(ChainLoop);
+		const int32 EffectorIndex = RigChain.JointStart + RigChain.Data.NumBones();
+		SolveTargets[ChainLoop] = ChainTargets.IsValidIndex(ChainLoop) ? ChainTargets[ChainLoop] :
+			Output.Pose.GetComponentSpaceTransform(JointBoneIndices[EffectorIndex]).GetLocation();
+	}
+
+	RigAsset->SolveInstance(Instance, SolveTargets, SolveContext);
+
+	// ---------- Write the solved bones -----------
+
+	WrittenBones.Init(false, BoneContainer.GetCompactPoseNumBones());
+	for (int32 ChainLoop = 0; ChainLoop < NumChainsL; ++ChainLoop)
+	{
+		const FFabrikRigChain& RigChain = RigAsset->GetChain(ChainLoop);
+		const int32 NumBonesL = RigChain.Data.NumBones();
+		for (int32 Loop = 0; Loop <= NumBonesL; ++Loop)
+		{
+			const int32 JointIndex = RigChain.JointStart + Loop;
+			const FCompactPoseBoneIndex BoneIndex = JointBoneIndices[JointIndex];
+
+			// A connected chain's base shares its bone with a joint of the host, which has already placed it
+			if (WrittenBones[BoneIndex.GetInt()])
+			{
+				continue;
+			}
+			WrittenBones[BoneIndex.GetInt()] = true;
+
+			FTransform BoneTransform = Output.Pose.GetComponentSpaceTransform(BoneIndex);
+
+			// Turn each bone by however much the solve turned the line to the next joint. The end effector keeps its rotation.
+			if (Loop < NumBonesL)
+			{
+				const FVector OldDirection = (Output.Pose.GetComponentSpaceTransform(JointBoneIndices[JointIndex + 1]).GetLocation() - BoneTransform.GetLocation()).GetSafeNormal();
+				const FVector NewDirection = (Instance.Joints[JointIndex + 1] - Instance.Joints[JointIndex]).GetSafeNormal();
+				if (!OldDirection.IsZero() && !NewDirection.IsZero())
+				{
+					BoneTransform.SetRotation(FQuat::FindBetweenNormals(OldDirection, NewDirection) * BoneTransform.GetRotation());
+				}
+			}
+			BoneTransform.SetLocation(Instance.Joints[JointIndex]);
+
+			OutBoneTransforms.Add(FBoneTransform(BoneIndex, BoneTransform));
+		}
+	}
+
+	// Bone transforms have to be applied parents first
+	OutBoneTransforms.Sort(FCompareBoneTransformIndex());
+}
+
+bool FAnimNode_OpenMotionFabrik::IsValidToEvaluate(const USkeleton* Skeleton, const FBoneContainer& RequiredBones)
+{
+	if (!RigAsset)
+	{
+		return false;
+	}
+
+	FReadScopeLock ReadLock(RigAsset->GetDefinitionLock());
+	if (!DoChainBonesMatchRig())
+	{
+		return false;
+	}
+
+	for (const FOpenMotionFabrikChainBones& Chain : ChainBones)
+	{
+		for (const FBoneReference& Joint : Chain.Joints)
+		{
+			if (!Joint.IsValidToEvaluate(RequiredBones))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool FAnimNode_OpenMotionFabrik::DoChainBonesMatchRig() const
+{
+	if (RigAsset->NumChains() != ChainBones.Num())
+	{
+		return false;
+	}
+
+	for (int32 ChainLoop = 0; ChainLoop < ChainBones.Num(); ++ChainLoop)
+	{
+		if (ChainBones[ChainLoop].Joints.Num() != RigAsset->GetChain(ChainLoop).Data.Joints.Num())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FAnimNode_OpenMotionFabrik::InitializeBoneReferences(const FBoneContainer& RequiredBones)
+{
+	for (FOpenMotionFabrikChainBones& Chain : ChainBones)
+	{
+		for (FBoneReference& Joint : Chain.Joints)
+		{
+			Joint.Initialize(RequiredBones);
+		}
+	}
+}
@@ -6,13 +6,19 @@
 #include "EJointType.h"
 #include "FabrikUtil.h"
 #include "FabrikMat3f.h"
+#include "FabrikChainSolver.h"
 #include "FabrikStructure.h"
 
 #include "OpenMotion.h"
 
+DECLARE_CYCLE_STAT(TEXT("Fabrik Chain SolveForTarget"), STAT_FabrikChainSolveForTarget, STATGROUP_OpenMotion);
+DECLARE_CYCLE_STAT(TEXT("Fabrik Chain SolveIK"), STAT_FabrikChainSolveIK, STATGROUP_OpenMotion);
+
 UFabrikChain::UFabrikChain(const FObjectInitializer& ObjectInitializer)
 {
 	SolveDistanceThreshold = 0.1f;
+	LODMaxIterationAttempts = 0;
+	LODSolveDistanceThresholdScale = 1.0f;
 	MaxIterationAttempts = 20;
 	MinIterationChange = 0.01f;
 	ChainLength = 0;
@@ -31,6 +37,26 @@ UFabrikChain::UFabrikChain(const FObjectInitializer& ObjectInitializer)
 	ConnectedBoneNumber = -1;
 	EmbeddedTarget = FVector::ZeroVector;
 	UseEmbeddedTarget = false;
+	UseChainData = true;
+	TrackBestSolutionInPlace = true;
+	UseSpecializedSolvers = true;
+	UseTemporalCoherence = false;
+	TemporalSingleIterationDistance = 0.5f;
+	UseClosedFormSolvers = true;
+	SolvePriority = 1.0f;
+	LastSolveIterations = 0;
+	TotalSolveIterations = 0;
+	NumTemporalEarlyOuts = 0;
+	NumTemporalSinglePassSolves = 0;
+	NumClosedFormSolves = 0;
+	LastSolveCutShort = false;
+	NumSolvesCutShort = 0;
+	LastSolveChangedPose = false;
+	LastSolveSkipped = false;
+	NumSolvesSkipped = 0;
+	PoseDirty = true;
+	HasSubBasePulls = false;
+	LastSolveHadSubBasePulls = false;
 }
 
 FVector UFabrikChain::GetBaseLocation() 
@@ -64,6 +90,13 @@ void UFabrikChain::Init(UFabrikChain* InSource)
 	Name = InSource->Name;
 	ConstraintLineWidth = InSource->ConstraintLineWidth;
 	UseEmbeddedTarget = InSource->UseEmbeddedTarget;
+	UseChainData = InSource->UseChainData;
+	TrackBestSolutionInPlace = InSource->TrackBestSolutionInPlace;
+	UseSpecializedSolvers = InSource->UseSpecializedSolvers;
+	UseTemporalCoherence = InSource->UseTemporalCoherence;
+	TemporalSingleIterationDistance = InSource->TemporalSingleIterationDistance;
+	UseClosedFormSolvers = InSource->UseClosedFormSolvers;
+	SolvePriority = InSource->SolvePriority;
 }
 
 UFabrikChain* UFabrikChain::Init(FName InName) 
@@ -90,6 +123,7 @@ void UFabrikChain::AddBone(UFabrikBone* InBone)
 	// Increment the number of bones in the chain and update the chain length
 	++NumBones;
 	UpdateChainLength();
+	MarkDirty();
 }
 
 void UFabrikChain::AddConsecutiveBone(FVector InDirectionUV, float InLength, FColor InColour)
@@ -228,6 +262,7 @@ void UFabrikChain::AddConsecutiveRotorConstrainedBoneC(FVector InBoneDirectionUV
 
 	//## setBallJointConstraintDegs => mRotorConstraintDegs 
 	Bone->Joint->RotorConstraintDegs = InConstraintAngleDegs;
+	Bone->Joint->UpdateConstraintLimits();
 
 	AddBone(Bone);
 }
@@ -260,6 +295,7 @@ void UFabrikChain::RemoveBone(int InBoneNumber)
 		Chain.RemoveAt(InBoneNumber);
 		--NumBones;
 		UpdateChainLength();
+		MarkDirty();
 	}
 	else
 	{
@@ -298,6 +334,7 @@ void UFabrikChain::SetRotorBaseboneConstraint(EBoneConstraintType InRotorType, F
 	BaseboneConstraintUV = InConstraintAxis;// .normalised();
 	BaseboneRelativeConstraintUV = BaseboneConstraintUV; // .set(mBaseboneConstraintUV);
 	GetBone(0)->Joint->SetAsBallJoint(InAngleDegs);
+	MarkDirty();
 }
 
 void UFabrikChain::SetHingeBaseboneConstraint(EBoneConstraintType InHingeType, FVector InHingeRotationAxis, float InCwConstraintDegs, float InAcwConstraintDegs, FVector InHingeReferenceAxis)
@@ -344,6 +381,7 @@ void UFabrikChain::SetHingeBaseboneConstraint(EBoneConstraintType InHingeType, F
 	}
 
 	GetBone(0)->Joint = Hinge;// .setJoint(hinge);
+	MarkDirty();
 }
 
 void UFabrikChain::SetFreelyRotatingGlobalHingedBasebone(FVector InHingeRotationAxis)
@@ -392,10 +430,15 @@ void UFabrikChain::SetColour(FColor InColour)
 }
 
 float UFabrikChain::SolveForEmbeddedTarget()
+{
+	return SolveForEmbeddedTarget(0.0);
+}
+
+float UFabrikChain::SolveForEmbeddedTarget(double InDeadlineSeconds)
 {
 	if (UseEmbeddedTarget)
 	{ 
-		return SolveForTarget(EmbeddedTarget);
+		return SolveForTarget(EmbeddedTarget, InDeadlineSeconds);
 	}
 	else 
 	{ 
@@ -412,22 +455,87 @@ public float solveForTarget(float targetX, float targetY, float targetZ)
 
 float UFabrikChain::SolveForTarget(FVector InNewTarget)
 {
+	return SolveForTarget(InNewTarget, 0.0);
+}
+
+float UFabrikChain::SolveForTarget(FVector InNewTarget, double InDeadlineSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FabrikChainSolveForTarget);
+
+	LastSolveCutShort = false;
+	LastSolveSkipped = false;
+
 	// If we have both the same target and base location as the last run then do not solve
-	if (UFabrikUtil::VectorApproximatelyEquals(LastTargetLocation, InNewTarget, 0.001f) && // LastTargetLocation.approximatelyEquals(newTarget, 0.001f) &&
+	if (!PoseDirty && SubBasePullsMatchLastSolve() &&
+		UFabrikUtil::VectorApproximatelyEquals(LastTargetLocation, InNewTarget, 0.001f) && // LastTargetLocation.approximatelyEquals(newTarget, 0.001f) &&
 		UFabrikUtil::VectorApproximatelyEquals(LastBaseLocation, GetBaseLocation(), 0.001f)) //LastBaseLocation.approximatelyEquals(getBaseLocation(), 0.001f))
 	{
+		LastSolveChangedPose = false;
 		return CurrentSolveDistance;
 	}
 
+	// A dirty chain has had its bones or constraints changed under the last solve, so none of it carries over
+	const bool bWasDirty = PoseDirty;
+	PoseDirty = false;
+	LastSolveChangedPose = true;
+
+	LastSolveHadSubBasePulls = HasSubBasePulls;
+	if (HasSubBasePulls)
+	{
+		LastSolveSubBasePulls = SubBasePulls;
+		LastSolveNumSubBasePulls = NumSubBasePulls;
+	}
+
 	/***
 	* NOTE: We must allow the best solution of THIS run to be used for a new target or base location - we cannot
 	* just use the last solution (even if it's better) - because that solution was for a different target / base
 	* location combination and NOT for the current setup.
 	*/
 
-	// Declare a list of bones to use to store our best solution
+	// Declare a list of bones to use to store our best solution when we are not tracking it in place
 	TArray<UFabrikBone*> BestSolution;// = new ArrayList<FabrikBone3D>();
 
+	// Far away chains settle for fewer iterations and a looser fit
+	int IterationLimit = (LODMaxIterationAttempts > 0) ? FMath::Min(MaxIterationAttempts, LODMaxIterationAttempts) : MaxIterationAttempts;
+	const float SolveThreshold = SolveDistanceThreshold * LODSolveDistanceThresholdScale;
+	bool bWarmStart = false;
+	bool bSinglePass = false;
+	if (UseTemporalCoherence && !bWasDirty && !HasSubBasePulls && LastTargetLocation.X != FLT_MAX)
+	{
+		const float TargetDelta = FVector::Dist(LastTargetLocation, InNewTarget);
+		const bool bBaseInPlace = !FixedBaseMode || UFabrikUtil::VectorApproximatelyEquals(FixedBaseLocation, GetBaseLocation(), 0.001f);
+
+		// Moving the target can only take it TargetDelta further from the effector, so if that still meets our distance
+		// requirement then the current pose stands without any iterations at all
+		if (bBaseInPlace && CurrentSolveDistance + TargetDelta < SolveThreshold)
+		{
+			CurrentSolveDistance = FVector::Dist(GetEffectorLocation(), InNewTarget);
+			LastSolveIterations = 0;
+			LastSolveChangedPose = false;
+			++NumTemporalEarlyOuts;
+
+			LastBaseLocation = GetBaseLocation();
+			LastTargetLocation = InNewTarget;
+			return CurrentSolveDistance;
+		}
+
+		// A small target move usually only needs the pose nudging, so a single pass from the warm start comes first
+		bSinglePass = (TargetDelta <= TemporalSingleIterationDistance && IterationLimit > 1);
+		bWarmStart = true;
+	}
+
+	// When tracking in place we can stay on the chain data for every iteration and only touch the bones at the end
+	bool bSolveOnChainData = UseChainData && TrackBestSolutionInPlace;
+	if (bSolveOnChainData)
+	{
+		FillChainData(ChainData);
+	}
+
+	if (bWarmStart)
+	{
+		WarmStart(InNewTarget, bSolveOnChainData);
+	}
+
 	// We start with a best solve distance that can be easily beaten
 	float BestSolveDistance = FloatMax();// Float.MAX_VALUE;
 
@@ -437,20 +545,45 @@ float UFabrikChain::SolveForTarget(FVector InNewTarget)
 	// Allow up to our iteration limit attempts at solving the chain
 	float SolveDistance;
 
-	for (int Loop = 0; Loop < MaxIterationAttempts; ++Loop)
+	LastSolveIterations = 0;
+
+	// Out of reach targets and two bone chains have an exact answer, which leaves nothing for the iterations to do
+	if (bSolveOnChainData && UseClosedFormSolvers && !HasSubBasePulls && ChainData.SolveClosedForm(InNewTarget, SolveDistance))
+	{
+		BestSolveDistance = SolveDistance;
+		StoreBestSolution(true);
+		IterationLimit = 0;
+		++NumClosedFormSolves;
+	}
+
+	const int FullIterationLimit = IterationLimit;
+	if (bSinglePass)
+	{
+		IterationLimit = FMath::Min(IterationLimit, 1);
+	}
+
+	for (int Loop = 0; Loop < IterationLimit; ++Loop)
 	{
 		// Solve the chain for this target
-		SolveDistance = SolveIK(InNewTarget);
+		SolveDistance = bSolveOnChainData ? ChainData.SolveIK(InNewTarget) : SolveIK(InNewTarget);
+		++LastSolveIterations;
 
 		// Did we solve it for distance? If so, update our best distance and best solution, and also
 		// update our last pass solve distance. Note: We will ALWAYS beat our last solve distance on the first run. 
 		if (SolveDistance < BestSolveDistance)
 		{
 			BestSolveDistance = SolveDistance;
-			BestSolution = this->CloneIkChain();
+			if (TrackBestSolutionInPlace)
+			{
+				StoreBestSolution(bSolveOnChainData);
+			}
+			else
+			{
+				BestSolution = this->CloneIkChain();
+			}
 
 			// If we are happy that this solution meets our distance requirements then we can exit the loop now
-			if (SolveDistance < SolveDistanceThreshold)
+			if (SolveDistance < SolveThreshold)
 			{
 				break;
 			}
@@ -467,11 +600,42 @@ float UFabrikChain::SolveForTarget(FVector InNewTarget)
 
 		// Update the last pass solve distance
 		LastPassSolveDistance = SolveDistance;
+
+		// The single pass left us short of the target, so it was only a first attempt and the usual limit applies
+		if (bSinglePass)
+		{
+			bSinglePass = false;
+			IterationLimit = FullIterationLimit;
+		}
+
+		// Out of time? Settle for the best solution so far
+		if (InDeadlineSeconds > 0.0 && Loop + 1 < IterationLimit && FPlatformTime::Seconds() >= InDeadlineSeconds)
+		{
+			LastSolveCutShort = true;
+			++NumSolvesCutShort;
+			break;
+		}
 	} // End of loop
 
 	  // Update our solve distance and chain configuration to the best solution found
 	CurrentSolveDistance = BestSolveDistance;
-	Chain = BestSolution;
+	if (TrackBestSolutionInPlace)
+	{
+		if (BestSolveDistance < FloatMax())
+		{
+			RestoreBestSolution();
+		}
+	}
+	else
+	{
+		Chain = BestSolution;
+	}
+
+	TotalSolveIterations += LastSolveIterations;
+	if (bSinglePass && LastSolveIterations == 1)
+	{
+		++NumTemporalSinglePassSolves;
+	}
 
 	// Update our base and target locations
 	LastBaseLocation = GetBaseLocation(); // .set(getBaseLocation());
@@ -480,7 +644,69 @@ float UFabrikChain::SolveForTarget(FVector InNewTarget)
 	return CurrentSolveDistance;
 }
 
+void UFabrikChain::WarmStart(FVector InNewTarget, bool bInOnChainData)
+{
+	const FVector BaseLocation = bInOnChainData ? ChainData.GetBaseLocation() : GetBaseLocation();
+	const FVector LastTargetDirection = LastTargetLocation - BaseLocation;
+	const FVector NewTargetDirection = InNewTarget - BaseLocation;
+	if (LastTargetDirection.IsNearlyZero() || NewTargetDirection.IsNearlyZero())
+	{
+		return;
+	}
+
+	// Swing the whole pose about the base by however much the target swung, so the iterations start close to the answer
+	const FQuat Swing = FQuat::FindBetweenVectors(LastTargetDirection, NewTargetDirection);
+	if (bInOnChainData)
+	{
+		for (FVector& Joint : ChainData.Joints)
+		{
+			Joint = BaseLocation + Swing.RotateVector(Joint - BaseLocation);
+		}
+		ChainData.UpdateDirections();
+	}
+	else
+	{
+		for (UFabrikBone* Bone : Chain)
+		{
+			Bone->StartLocation = BaseLocation + Swing.RotateVector(Bone->StartLocation - BaseLocation);
+			Bone->EndLocation = BaseLocation + Swing.RotateVector(Bone->EndLocation - BaseLocation);
+		}
+	}
+}
+
+void UFabrikChain::ResetTelemetry()
+{
+	LastSolveIterations = 0;
+	TotalSolveIterations = 0;
+	NumTemporalEarlyOuts = 0;
+	NumTemporalSinglePassSolves = 0;
+	NumClosedFormSolves = 0;
+	LastSolveCutShort = false;
+	NumSolvesCutShort = 0;
+	NumSolvesSkipped = 0;
+}
+
 float UFabrikChain::SolveIK(FVector InTarget)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FabrikChainSolveIK);
+
+	if (!UseChainData)
+	{
+		return SolveIKBones(InTarget);
+	}
+
+	// Copy the chain into contiguous arrays, solve there and write the new joint locations back to the bones
+	FillChainData(ChainData);
+	float SolveDistance = ChainData.SolveIK(InTarget);
+	ApplyChainData(ChainData);
+
+	// Update our last target location
+	LastTargetLocation = InTarget;
+
+	return SolveDistance;
+}
+
+float UFabrikChain::SolveIKBones(FVector InTarget)
 {
 	// Sanity check that there are bones in the chain
 	if (NumBones == 0) 
@@ -536,13 +762,13 @@ float UFabrikChain::SolveIK(FVector InTarget)
 			else if (ThisBoneJointType == EJointType::JT_LocalHinge)
 			{
 				// Not a basebone? Then construct a rotation matrix based on the previous bones inner-to-to-inner direction...
-				UFabrikMat3f* M; //  UFabrikMat3f::CreateRotationMatrix(FVector InReferenceDirection) Mat3f M;
+				FFabrikMat3f M; //  FFabrikMat3f::CreateRotationMatrix(FVector InReferenceDirection) Mat3f M;
 				FVector RelativeHingeRotationAxis;
 				if (Loop > 0) {
-					M = UFabrikMat3f::CreateRotationMatrix(Chain[Loop - 1]->GetDirectionUV());// Mat3f.createRotationMatrix(Chain[Loop - 1]->GetDirectionUV());
+					M = FFabrikMat3f::CreateRotationMatrix(Chain[Loop - 1]->GetDirectionUV());// Mat3f.createRotationMatrix(Chain[Loop - 1]->GetDirectionUV());
 
 					// getHingeRotationAxis => 
-					RelativeHingeRotationAxis = M->Times(ThisBoneJoint->RotationAxisUV);// .normalise(); // M.times(ThisBoneJoint->getHingeRotationAxis()).normalise();
+					RelativeHingeRotationAxis = M.Times(ThisBoneJoint->RotationAxisUV);// .normalise(); // M.times(ThisBoneJoint->getHingeRotationAxis()).normalise();
 					RelativeHingeRotationAxis.Normalize();
 				}
 				else // ...basebone? Need to construct matrix from the relative constraint UV.
@@ -602,11 +828,11 @@ float UFabrikChain::SolveIK(FVector InTarget)
 
 				// Construct a rotation matrix based on the previous bones inner-to-to-inner direction...
 				// Mat3f m = Mat3f.createRotationMatrix(Chain[Loop - 1]->GetDirectionUV());
-				UFabrikMat3f* M =  UFabrikMat3f::CreateRotationMatrix(Chain[Loop - 1]->GetDirectionUV());
+				FFabrikMat3f M = FFabrikMat3f::CreateRotationMatrix(Chain[Loop - 1]->GetDirectionUV());
 
 				// ...and transform the hinge rotation axis into the previous bones frame of reference.
 				// getHingeRotationAxis => mRotationAxisUV
-				FVector RelativeHingeRotationAxis = M->Times(ThisBoneJoint->RotationAxisUV);// .normalise(); //  m.times(ThisBoneJoint.getHingeRotationAxis()).normalise();
+				FVector RelativeHingeRotationAxis = M.Times(ThisBoneJoint->RotationAxisUV);// .normalise(); //  m.times(ThisBoneJoint.getHingeRotationAxis()).normalise();
 				RelativeHingeRotationAxis.Normalize();
 
 				// Project this bone's outer-to-inner direction onto the plane described by the relative hinge rotation axis
@@ -705,10 +931,10 @@ float UFabrikChain::SolveIK(FVector InTarget)
 
 				// Construct a rotation matrix based on the previous bone's direction
 				//Mat3f m = Mat3f.createRotationMatrix(PrevBoneInnerToOuterUV);
-				UFabrikMat3f* M = UFabrikMat3f::CreateRotationMatrix(PrevBoneInnerToOuterUV);
+				FFabrikMat3f M = FFabrikMat3f::CreateRotationMatrix(PrevBoneInnerToOuterUV);
 
 				// Transform the hinge rotation axis into the previous bone's frame of reference
-				FVector RelativeHingeRotationAxis = M->Times(HingeRotationAxis);// .normalise();
+				FVector RelativeHingeRotationAxis = M.Times(HingeRotationAxis);// .normalise();
 				RelativeHingeRotationAxis.Normalize();
 
 				// Project this bone direction onto the plane described by the hinge rotation axis
@@ -725,7 +951,7 @@ float UFabrikChain::SolveIK(FVector InTarget)
 					// Calc. the reference axis in local space
 					//Vec3f relativeHingeReferenceAxis = mBaseboneRelativeReferenceConstraintUV;//m.times( thisBoneJoint.getHingeReferenceAxis() ).normalise();
 					// getHingeReferenceAxis => mReferenceAxisUV
-					FVector RelativeHingeReferenceAxis = M->Times(ThisBoneJoint->ReferenceAxisUV);// .normalise();
+					FVector RelativeHingeReferenceAxis = M.Times(ThisBoneJoint->ReferenceAxisUV);// .normalise();
 					RelativeHingeReferenceAxis.Normalize();
 
 					// Get the signed angle (about the hinge rotation axis) between the hinge reference axis and the hinge-rotation aligned bone UV
@@ -962,6 +1188,160 @@ float UFabrikChain::SolveIK(FVector InTarget)
 }
 
 
+void UFabrikChain::FillChainData(FFabrikChainData& OutData)
+{
+	OutData.SetNumBones(NumBones);
+
+	for (int Loop = 0; Loop < NumBones; ++Loop)
+	{
+		UFabrikBone* ThisBone = Chain[Loop];
+		UFabrikJoint* ThisJoint = ThisBone->Joint;
+
+		OutData.Joints[Loop] = ThisBone->StartLocation;
+		OutData.Lengths[Loop] = ThisBone->Length;
+		OutData.JointTypes[Loop] = ThisJoint->JointType;
+		OutData.RotorConstraintDegs[Loop] = ThisJoint->RotorConstraintDegs;
+		OutData.HingeClockwiseConstraintDegs[Loop] = ThisJoint->HingeClockwiseConstraintDegs;
+		OutData.HingeAnticlockwiseConstraintDegs[Loop] = ThisJoint->HingeAnticlockwiseConstraintDegs;
+		// Derived from the degrees rather than the joint's cache, which a Blueprint write to the angles leaves behind
+		OutData.RotorLimits[Loop] = FFabrikAngleLimit::FromDegs(ThisJoint->RotorConstraintDegs);
+		OutData.HingeClockwiseLimits[Loop] = FFabrikAngleLimit::FromDegs(ThisJoint->HingeClockwiseConstraintDegs);
+		OutData.HingeAnticlockwiseLimits[Loop] = FFabrikAngleLimit::FromDegs(ThisJoint->HingeAnticlockwiseConstraintDegs);
+		OutData.RotationAxes[Loop] = ThisJoint->RotationAxisUV;
+		OutData.ReferenceAxes[Loop] = ThisJoint->ReferenceAxisUV;
+	}
+
+	if (NumBones > 0)
+	{
+		OutData.Joints[NumBones] = Chain[NumBones - 1]->EndLocation;
+	}
+	OutData.UpdateDirections();
+
+	OutData.BaseboneConstraintType = BaseboneConstraintType;
+	OutData.BaseboneConstraintUV = BaseboneConstraintUV;
+	OutData.BaseboneRelativeConstraintUV = BaseboneRelativeConstraintUV;
+	OutData.BaseboneRelativeReferenceConstraintUV = BaseboneRelativeReferenceConstraintUV;
+	OutData.FixedBaseLocation = FixedBaseLocation;
+	OutData.FixedBaseMode = FixedBaseMode;
+	OutData.SpecializedSolveIK = UseSpecializedSolvers ? FFabrikChainSolverRegistry::Get().Find(OutData) : nullptr;
+
+	OutData.HasSubBasePulls = HasSubBasePulls;
+	if (HasSubBasePulls)
+	{
+		for (int Loop = 0; Loop <= NumBones; ++Loop)
+		{
+			OutData.SubBasePulls[Loop] = SubBasePulls[Loop];
+			OutData.NumSubBasePulls[Loop] = NumSubBasePulls[Loop];
+		}
+	}
+}
+
+void UFabrikChain::ClearSubBasePulls()
+{
+	// The pose may have been solved as a compromise with the chains connected here, which the last solve's pulls
+	// remember, so a solve without pulls will not mistake it for the answer for the target alone
+	HasSubBasePulls = false;
+}
+
+bool UFabrikChain::SubBasePullsMatchLastSolve() const
+{
+	if (HasSubBasePulls != LastSolveHadSubBasePulls)
+	{
+		return false;
+	}
+	if (!HasSubBasePulls)
+	{
+		return true;
+	}
+
+	if (LastSolveNumSubBasePulls.Num() != NumSubBasePulls.Num())
+	{
+		return false;
+	}
+	for (int Loop = 0; Loop < NumSubBasePulls.Num(); ++Loop)
+	{
+		if (NumSubBasePulls[Loop] != LastSolveNumSubBasePulls[Loop] ||
+			!UFabrikUtil::VectorApproximatelyEquals(SubBasePulls[Loop], LastSolveSubBasePulls[Loop], 0.001f))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void UFabrikChain::AddSubBasePull(int InJointNumber, FVector InLocation)
+{
+	if (InJointNumber < 0 || InJointNumber > NumBones)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("Sub-base joint number must be between 0 and the number of bones in the chain."));
+	}
+
+	// Only zero the sums when the first pull of a solve arrives
+	if (!HasSubBasePulls)
+	{
+		SubBasePulls.Init(FVector::ZeroVector, NumBones + 1);
+		NumSubBasePulls.Init(0, NumBones + 1);
+		HasSubBasePulls = true;
+	}
+
+	SubBasePulls[InJointNumber] += InLocation;
+	++NumSubBasePulls[InJointNumber];
+}
+
+FVector UFabrikChain::ReachForward(FVector InTarget)
+{
+	if (NumBones == 0)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("It makes no sense to reach with an IK chain with zero bones."));
+	}
+
+	FillChainData(ChainData);
+	ChainData.SolveForwardPass(InTarget);
+	return ChainData.Joints[0];
+}
+
+void UFabrikChain::ApplyChainData(const FFabrikChainData& InData)
+{
+	check(InData.NumBones() == NumBones);
+
+	for (int Loop = 0; Loop < NumBones; ++Loop)
+	{
+		Chain[Loop]->StartLocation = InData.Joints[Loop];
+		Chain[Loop]->EndLocation = InData.Joints[Loop + 1];
+	}
+}
+
+void UFabrikChain::StoreBestSolution(bool bInFromChainData)
+{
+	// Only grows when bones are added, so repeated solves reuse the same allocation
+	BestSolutionJoints.SetNum(NumBones + 1, false);
+
+	if (bInFromChainData)
+	{
+		for (int Loop = 0; Loop <= NumBones; ++Loop)
+		{
+			BestSolutionJoints[Loop] = ChainData.Joints[Loop];
+		}
+	}
+	else
+	{
+		for (int Loop = 0; Loop < NumBones; ++Loop)
+		{
+			BestSolutionJoints[Loop] = Chain[Loop]->StartLocation;
+		}
+		BestSolutionJoints[NumBones] = Chain[NumBones - 1]->EndLocation;
+	}
+}
+
+void UFabrikChain::RestoreBestSolution()
+{
+	for (int Loop = 0; Loop < NumBones; ++Loop)
+	{
+		Chain[Loop]->StartLocation = BestSolutionJoints[Loop];
+		Chain[Loop]->EndLocation = BestSolutionJoints[Loop + 1];
+	}
+}
+
 void UFabrikChain::UpdateChainLength()
 {
 	// We start adding up the length of the bones from an initial length of zero
@@ -1015,4 +1395,5 @@ void UFabrikChain::ConnectToStructure(UFabrikStructure* InStructure, int InChain
 	// All good? Set the connection details
 	ConnectedChainNumber = InChainNumber;
 	ConnectedBoneNumber = InBoneNumber;
+	MarkDirty();
 }
\ No newline at end of file
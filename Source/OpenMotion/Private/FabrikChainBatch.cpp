@@ -0,0 +1,570 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FabrikChainBatch.h"
+#include "FabrikJoint.h"
+#include "FabrikUtil.h"
+
+#include "OpenMotion.h"
+
+DECLARE_CYCLE_STAT(TEXT("Fabrik Chain Batch SolveForTargets"), STAT_FabrikChainBatchSolveForTargets, STATGROUP_OpenMotion);
+
+// ---------- Three lane-wide vectors at a time ----------
+
+typedef FFabrikChainBatch::FVectorRegister3 FBatchVector;
+
+static FORCEINLINE FBatchVector BatchLoad(const float* InData)
+{
+	return { VectorLoadAligned(InData), VectorLoadAligned(InData + 4), VectorLoadAligned(InData + 8) };
+}
+
+static FORCEINLINE void BatchStore(const FBatchVector& InV, float* OutData)
+{
+	VectorStoreAligned(InV.X, OutData);
+	VectorStoreAligned(InV.Y, OutData + 4);
+	VectorStoreAligned(InV.Z, OutData + 8);
+}
+
+static FORCEINLINE FBatchVector BatchSplat(const FVector& InV)
+{
+	return { VectorSetFloat1(InV.X), VectorSetFloat1(InV.Y), VectorSetFloat1(InV.Z) };
+}
+
+static FORCEINLINE FBatchVector BatchAdd(const FBatchVector& InA, const FBatchVector& InB)
+{
+	return { VectorAdd(InA.X, InB.X), VectorAdd(InA.Y, InB.Y), VectorAdd(InA.Z, InB.Z) };
+}
+
+static FORCEINLINE FBatchVector BatchSubtract(const FBatchVector& InA, const FBatchVector& InB)
+{
+	return { VectorSubtract(InA.X, InB.X), VectorSubtract(InA.Y, InB.Y), VectorSubtract(InA.Z, InB.Z) };
+}
+
+static FORCEINLINE FBatchVector BatchScale(const FBatchVector& InV, const VectorRegister& InScale)
+{
+	return { VectorMultiply(InV.X, InScale), VectorMultiply(InV.Y, InScale), VectorMultiply(InV.Z, InScale) };
+}
+
+// InV * InScale + InAdd
+static FORCEINLINE FBatchVector BatchMultiplyAdd(const FBatchVector& InV, const VectorRegister& InScale, const FBatchVector& InAdd)
+{
+	return { VectorMultiplyAdd(InV.X, InScale, InAdd.X), VectorMultiplyAdd(InV.Y, InScale, InAdd.Y), VectorMultiplyAdd(InV.Z, InScale, InAdd.Z) };
+}
+
+static FORCEINLINE FBatchVector BatchNegate(const FBatchVector& InV)
+{
+	return { VectorNegate(InV.X), VectorNegate(InV.Y), VectorNegate(InV.Z) };
+}
+
+static FORCEINLINE VectorRegister BatchDot(const FBatchVector& InA, const FBatchVector& InB)
+{
+	return VectorMultiplyAdd(InA.X, InB.X, VectorMultiplyAdd(InA.Y, InB.Y, VectorMultiply(InA.Z, InB.Z)));
+}
+
+static FORCEINLINE FBatchVector BatchCross(const FBatchVector& InA, const FBatchVector& InB)
+{
+	return {
+		VectorSubtract(VectorMultiply(InA.Y, InB.Z), VectorMultiply(InA.Z, InB.Y)),
+		VectorSubtract(VectorMultiply(InA.Z, InB.X), VectorMultiply(InA.X, InB.Z)),
+		VectorSubtract(VectorMultiply(InA.X, InB.Y), VectorMultiply(InA.Y, InB.X)) };
+}
+
+static FORCEINLINE FBatchVector BatchSelect(const VectorRegister& InMask, const FBatchVector& InA, const FBatchVector& InB)
+{
+	return { VectorSelect(InMask, InA.X, InB.X), VectorSelect(InMask, InA.Y, InB.Y), VectorSelect(InMask, InA.Z, InB.Z) };
+}
+
+static FORCEINLINE VectorRegister BatchLength(const FBatchVector& InV)
+{
+	const VectorRegister SizeSquared = BatchDot(InV, InV);
+	return VectorMultiply(SizeSquared, VectorReciprocalSqrtAccurate(VectorMax(SizeSquared, VectorSetFloat1(SMALL_NUMBER))));
+}
+
+// Lane-wise FVector::GetSafeNormal
+static FORCEINLINE FBatchVector BatchSafeNormal(const FBatchVector& InV)
+{
+	const VectorRegister Tolerance = VectorSetFloat1(SMALL_NUMBER);
+	const VectorRegister SizeSquared = BatchDot(InV, InV);
+	const VectorRegister NonZero = VectorCompareGT(SizeSquared, Tolerance);
+	const FBatchVector Normal = BatchScale(InV, VectorReciprocalSqrtAccurate(VectorMax(SizeSquared, Tolerance)));
+	return BatchSelect(NonZero, Normal, BatchSplat(FVector::ZeroVector));
+}
+
+// Lane-wise UFabrikUtil::ProjectOntoPlane for a unit plane normal
+static FORCEINLINE FBatchVector BatchProjectOntoPlane(const FBatchVector& InV, const FBatchVector& InPlaneNormal)
+{
+	return BatchSafeNormal(BatchSubtract(InV, BatchScale(InPlaneNormal, BatchDot(InV, InPlaneNormal))));
+}
+
+// Lane-wise UFabrikUtil::VectorGenPerpendicularVectorQuick
+static FORCEINLINE FBatchVector BatchPerpendicularQuick(const FBatchVector& InV)
+{
+	const VectorRegister UseUp = VectorCompareGT(VectorSetFloat1(0.99f), VectorAbs(InV.Y));
+	const FBatchVector CrossUp = { VectorNegate(InV.Z), VectorZero(), InV.X };
+	const FBatchVector CrossRight = { VectorZero(), InV.Z, VectorNegate(InV.Y) };
+	return BatchSafeNormal(BatchSelect(UseUp, CrossUp, CrossRight));
+}
+
+// Lane-wise UFabrikUtil::GetAngleLimitedUnitVectorDegs for unit vectors. The rotor angle is compared as a cosine and the
+// limited vector is built from the baseline and the perpendicular towards InV, so no lane needs any trig.
+static FORCEINLINE FBatchVector BatchLimitToRotor(const FBatchVector& InV, const FBatchVector& InBaseline, const VectorRegister& InCosLimit, const VectorRegister& InSinLimit)
+{
+	const VectorRegister CosAngle = BatchDot(InBaseline, InV);
+	const VectorRegister Outside = VectorCompareGT(InCosLimit, CosAngle);
+
+	// Pointing straight back along the baseline leaves no preferred side, so pick any, as the scalar path does
+	const FBatchVector TowardsV = BatchSafeNormal(BatchSubtract(InV, BatchScale(InBaseline, CosAngle)));
+	const VectorRegister NoSide = VectorCompareEQ(BatchDot(TowardsV, TowardsV), VectorZero());
+	const FBatchVector Perpendicular = BatchSelect(NoSide, BatchPerpendicularQuick(InBaseline), TowardsV);
+	const FBatchVector Limited = BatchSafeNormal(BatchMultiplyAdd(InBaseline, InCosLimit, BatchScale(Perpendicular, InSinLimit)));
+	return BatchSelect(Outside, Limited, InV);
+}
+
+// Lane-wise UFabrikUtil::RotateAboutAxisRads for a unit axis, given the sine and cosine of the angle
+static FORCEINLINE FBatchVector BatchRotateAboutAxis(const FBatchVector& InV, const FBatchVector& InAxis, const VectorRegister& InCos, const VectorRegister& InSin)
+{
+	const VectorRegister OneMinusCos = VectorSubtract(VectorOne(), InCos);
+	const FBatchVector Rotated = BatchMultiplyAdd(InV, InCos, BatchScale(BatchCross(InAxis, InV), InSin));
+	return BatchMultiplyAdd(InAxis, VectorMultiply(BatchDot(InAxis, InV), OneMinusCos), Rotated);
+}
+
+// Keep a hinge-aligned unit vector between the clockwise and anticlockwise limits about the reference axis
+static FORCEINLINE FBatchVector BatchLimitToHinge(const FBatchVector& InV, const FBatchVector& InReferenceAxis, const FBatchVector& InRotationAxis,
+	const VectorRegister& InCosAnticlockwise, const VectorRegister& InSinAnticlockwise, const VectorRegister& InCosClockwise, const VectorRegister& InSinClockwise)
+{
+	// Same sign convention as UFabrikUtil::GetSignedAngleBetweenDegs - anticlockwise is positive and zero counts as positive
+	const VectorRegister CosAngle = BatchDot(InReferenceAxis, InV);
+	const VectorRegister Side = BatchDot(BatchCross(InReferenceAxis, InV), InRotationAxis);
+	const VectorRegister Anticlockwise = VectorCompareGE(Side, VectorZero());
+	const VectorRegister Clockwise = VectorCompareGT(VectorZero(), Side);
+
+	const VectorRegister PastAnticlockwise = VectorBitwiseAnd(Anticlockwise, VectorCompareGT(InCosAnticlockwise, CosAngle));
+	const VectorRegister PastClockwise = VectorBitwiseAnd(Clockwise, VectorCompareGT(InCosClockwise, CosAngle));
+
+	const FBatchVector AnticlockwiseLimit = BatchSafeNormal(BatchRotateAboutAxis(InReferenceAxis, InRotationAxis, InCosAnticlockwise, InSinAnticlockwise));
+	const FBatchVector ClockwiseLimit = BatchSafeNormal(BatchRotateAboutAxis(InReferenceAxis, InRotationAxis, InCosClockwise, InSinClockwise));
+	return BatchSelect(PastAnticlockwise, AnticlockwiseLimit, BatchSelect(PastClockwise, ClockwiseLimit, InV));
+}
+
+// ---------- FFabrikChainBatch ----------
+
+FVector FFabrikChainBatch::LimitToRotor(const FVector& InV, const FVector& InBaseline, const FFabrikAngleLimit& InLimit)
+{
+	MS_ALIGN(16) float Lanes[LaneCount * 3] GCC_ALIGN(16);
+	BatchStore(BatchLimitToRotor(BatchSplat(InV), BatchSplat(InBaseline), VectorSetFloat1(InLimit.Cos), VectorSetFloat1(InLimit.Sin)), Lanes);
+	return FVector(Lanes[0], Lanes[LaneCount], Lanes[LaneCount * 2]);
+}
+
+FFabrikChainBatch::FFabrikChainBatch()
+{
+	SolveDistanceThreshold = 0.1f;
+	MaxIterationAttempts = 20;
+	MinIterationChange = 0.01f;
+	LastNumPasses = 0;
+	bLockstep = false;
+	NumInstancesL = 0;
+	NumGroups = 0;
+	GroupStride = 0;
+	bBaseboneHingeLimited = false;
+}
+
+bool FFabrikChainBatch::CanSolveLockstep(const FFabrikChainData& InRig)
+{
+	for (EJointType JointType : InRig.JointTypes)
+	{
+		if (JointType == EJointType::JT_LocalHinge)
+		{
+			return false;
+		}
+	}
+
+	return InRig.BaseboneConstraintType != EBoneConstraintType::BCT_LocalRotor &&
+		InRig.BaseboneConstraintType != EBoneConstraintType::BCT_LocalHinge;
+}
+
+void FFabrikChainBatch::Init(const FFabrikChainData& InRig, int32 InNumInstances, bool bInAllowLockstep)
+{
+	if (InRig.NumBones() == 0)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("It makes no sense to batch an IK chain with zero bones."));
+	}
+
+	Rig = InRig;
+	Rig.UpdateDirections();
+	bLockstep = bInAllowLockstep && CanSolveLockstep(Rig);
+	NumInstancesL = InNumInstances;
+	NumGroups = (InNumInstances + LaneCount - 1) / LaneCount;
+
+	const int32 NumBonesL = Rig.NumBones();
+	const int32 NumJoints = NumBonesL + 1;
+	GroupStride = NumJoints * 3 * LaneCount;
+
+	BoneLanes.SetNum(NumBonesL);
+	for (int32 Loop = 0; Loop < NumBonesL; ++Loop)
+	{
+		FBoneLanes& Bone = BoneLanes[Loop];
+		Bone.JointType = Rig.JointTypes[Loop];
+		Bone.Length = VectorSetFloat1(Rig.Lengths[Loop]);
+
+		Bone.CosRotor = VectorSetFloat1(Rig.RotorLimits[Loop].Cos);
+		Bone.SinRotor = VectorSetFloat1(Rig.RotorLimits[Loop].Sin);
+
+		Bone.RotationAxis = BatchSplat(Rig.RotationAxes[Loop]);
+		Bone.ReferenceAxis = BatchSplat(Rig.ReferenceAxes[Loop]);
+
+		// Clockwise rotation is negative!
+		Bone.CosAnticlockwise = VectorSetFloat1(Rig.HingeAnticlockwiseLimits[Loop].Cos);
+		Bone.SinAnticlockwise = VectorSetFloat1(Rig.HingeAnticlockwiseLimits[Loop].Sin);
+		Bone.CosClockwise = VectorSetFloat1(Rig.HingeClockwiseLimits[Loop].Cos);
+		Bone.SinClockwise = VectorSetFloat1(-Rig.HingeClockwiseLimits[Loop].Sin);
+
+		// The same free rotation tests FFabrikChainData::SolveIK makes per pass
+		const float CwConstraintDegs = -Rig.HingeClockwiseConstraintDegs[Loop];
+		const float AcwConstraintDegs = Rig.HingeAnticlockwiseConstraintDegs[Loop];
+		Bone.bHingeLimited = !(UFabrikUtil::ApproximatelyEquals(CwConstraintDegs, -UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f)) &&
+			!(UFabrikUtil::ApproximatelyEquals(AcwConstraintDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f));
+		if (Loop == 0)
+		{
+			bBaseboneHingeLimited = !(UFabrikUtil::ApproximatelyEquals(CwConstraintDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.01f) &&
+				UFabrikUtil::ApproximatelyEquals(AcwConstraintDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.01f));
+		}
+	}
+	BaseboneConstraintLanes = BatchSplat(Rig.BaseboneConstraintUV);
+
+	// Padding lanes in the last group copy the rig pose and are never solved
+	Joints.SetNumUninitialized(NumGroups * GroupStride);
+	Targets.SetNumUninitialized(NumGroups * 3 * LaneCount);
+	BaseLocations.SetNumUninitialized(NumGroups * 3 * LaneCount);
+	for (int32 Instance = 0; Instance < NumGroups * LaneCount; ++Instance)
+	{
+		SetPose(Instance, Rig.Joints);
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			*GetLane(Targets, 3 * LaneCount, Instance, 0, Axis) = Rig.GetEffectorLocation()[Axis];
+			*GetLane(BaseLocations, 3 * LaneCount, Instance, 0, Axis) = Rig.FixedBaseLocation[Axis];
+		}
+	}
+
+	Directions.SetNumUninitialized(NumBonesL * 3 * LaneCount);
+	BestJoints.SetNumUninitialized(GroupStride);
+
+	SolveDistances.Init(FLT_MAX, NumInstancesL);
+	LastTargets.Init(FVector(FLT_MAX, FLT_MAX, FLT_MAX), NumInstancesL);
+	LastBaseLocations.Init(FVector(FLT_MAX, FLT_MAX, FLT_MAX), NumInstancesL);
+	LastNumPasses = 0;
+}
+
+float* FFabrikChainBatch::GetLane(FLaneArray& InArray, int32 InGroupStride, int32 InInstance, int32 InIndex, int32 InAxis)
+{
+	return &InArray[(InInstance / LaneCount) * InGroupStride + (InIndex * 3 + InAxis) * LaneCount + (InInstance % LaneCount)];
+}
+
+const float* FFabrikChainBatch::GetLane(const FLaneArray& InArray, int32 InGroupStride, int32 InInstance, int32 InIndex, int32 InAxis) const
+{
+	return &InArray[(InInstance / LaneCount) * InGroupStride + (InIndex * 3 + InAxis) * LaneCount + (InInstance % LaneCount)];
+}
+
+void FFabrikChainBatch::SetBaseLocation(int32 InInstance, const FVector& InBaseLocation)
+{
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		*GetLane(BaseLocations, 3 * LaneCount, InInstance, 0, Axis) = InBaseLocation[Axis];
+	}
+}
+
+void FFabrikChainBatch::SetTarget(int32 InInstance, const FVector& InTarget)
+{
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		*GetLane(Targets, 3 * LaneCount, InInstance, 0, Axis) = InTarget[Axis];
+	}
+}
+
+void FFabrikChainBatch::SetPose(int32 InInstance, const TArray<FVector>& InJoints)
+{
+	for (int32 Joint = 0; Joint < InJoints.Num(); ++Joint)
+	{
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			*GetLane(Joints, GroupStride, InInstance, Joint, Axis) = InJoints[Joint][Axis];
+		}
+	}
+}
+
+FVector FFabrikChainBatch::GetJointLocation(int32 InInstance, int32 InJoint) const
+{
+	return FVector(*GetLane(Joints, GroupStride, InInstance, InJoint, 0),
+		*GetLane(Joints, GroupStride, InInstance, InJoint, 1),
+		*GetLane(Joints, GroupStride, InInstance, InJoint, 2));
+}
+
+bool FFabrikChainBatch::NeedsSolve(int32 InInstance) const
+{
+	// As UFabrikChain::SolveForTarget, do not solve if both the target and base location are the same as the last run
+	const FVector Target(*GetLane(Targets, 3 * LaneCount, InInstance, 0, 0), *GetLane(Targets, 3 * LaneCount, InInstance, 0, 1), *GetLane(Targets, 3 * LaneCount, InInstance, 0, 2));
+	const FVector BaseLocation(*GetLane(BaseLocations, 3 * LaneCount, InInstance, 0, 0), *GetLane(BaseLocations, 3 * LaneCount, InInstance, 0, 1), *GetLane(BaseLocations, 3 * LaneCount, InInstance, 0, 2));
+	return !(UFabrikUtil::VectorApproximatelyEquals(LastTargets[InInstance], Target, 0.001f) &&
+		UFabrikUtil::VectorApproximatelyEquals(LastBaseLocations[InInstance], BaseLocation, 0.001f));
+}
+
+int32 FFabrikChainBatch::SolveForTargets()
+{
+	SCOPE_CYCLE_COUNTER(STAT_FabrikChainBatchSolveForTargets);
+
+	LastNumPasses = 0;
+	int32 NumSolved = 0;
+
+	if (bLockstep)
+	{
+		for (int32 Group = 0; Group < NumGroups; ++Group)
+		{
+			NumSolved += SolveGroup(Group);
+		}
+	}
+	else
+	{
+		for (int32 Instance = 0; Instance < NumInstancesL; ++Instance)
+		{
+			NumSolved += SolveInstance(Instance);
+		}
+	}
+
+	return NumSolved;
+}
+
+VectorRegister FFabrikChainBatch::SolveGroupIK(int32 InGroup)
+{
+	const int32 NumBonesL = Rig.NumBones();
+	float* GroupJoints = &Joints[InGroup * GroupStride];
+	float* GroupDirections = Directions.GetData();
+	const int32 VectorStride = 3 * LaneCount;
+	const FBatchVector Target = BatchLoad(&Targets[InGroup * VectorStride]);
+
+	// ---------- Forward pass from end effector to base -----------
+
+	for (int32 Loop = NumBonesL - 1; Loop >= 0; --Loop)
+	{
+		const FBoneLanes& Bone = BoneLanes[Loop];
+		const bool bEffectorBone = (Loop == NumBonesL - 1);
+
+		// Snap the end effector's end location to the target, otherwise use the outer bone placed on the previous step
+		const FBatchVector OuterJoint = bEffectorBone ? Target : BatchLoad(GroupJoints + (Loop + 1) * VectorStride);
+		if (bEffectorBone)
+		{
+			BatchStore(Target, GroupJoints + (Loop + 1) * VectorStride);
+		}
+
+		FBatchVector ThisBoneOuterToInnerUV = BatchSafeNormal(BatchSubtract(BatchLoad(GroupJoints + Loop * VectorStride), OuterJoint));
+
+		if (Bone.JointType == EJointType::JT_Ball)
+		{
+			// Ball joints do not get constrained against the target on this forward pass
+			if (!bEffectorBone)
+			{
+				const FBatchVector OuterBoneOuterToInnerUV = BatchNegate(BatchLoad(GroupDirections + (Loop + 1) * VectorStride));
+				ThisBoneOuterToInnerUV = BatchLimitToRotor(ThisBoneOuterToInnerUV, OuterBoneOuterToInnerUV, Bone.CosRotor, Bone.SinRotor);
+			}
+		}
+		else if (Bone.JointType == EJointType::JT_GlobalHinge)
+		{
+			// NOTE: Constraining about the hinge reference axis on this forward pass leads to poor solutions... so we won't.
+			ThisBoneOuterToInnerUV = BatchProjectOntoPlane(ThisBoneOuterToInnerUV, Bone.RotationAxis);
+		}
+
+		BatchStore(BatchMultiplyAdd(ThisBoneOuterToInnerUV, Bone.Length, OuterJoint), GroupJoints + Loop * VectorStride);
+		BatchStore(BatchNegate(ThisBoneOuterToInnerUV), GroupDirections + Loop * VectorStride);
+	}
+
+	// ---------- Backward pass from base to end effector -----------
+
+	for (int32 Loop = 0; Loop < NumBonesL; ++Loop)
+	{
+		const FBoneLanes& Bone = BoneLanes[Loop];
+		FBatchVector InnerJoint;
+		FBatchVector ThisBoneInnerToOuterUV;
+
+		if (Loop != 0)
+		{
+			InnerJoint = BatchLoad(GroupJoints + Loop * VectorStride);
+			ThisBoneInnerToOuterUV = BatchSafeNormal(BatchSubtract(BatchLoad(GroupJoints + (Loop + 1) * VectorStride), InnerJoint));
+
+			if (Bone.JointType == EJointType::JT_Ball)
+			{
+				const FBatchVector PrevBoneInnerToOuterUV = BatchLoad(GroupDirections + (Loop - 1) * VectorStride);
+				ThisBoneInnerToOuterUV = BatchLimitToRotor(ThisBoneInnerToOuterUV, PrevBoneInnerToOuterUV, Bone.CosRotor, Bone.SinRotor);
+			}
+			else if (Bone.JointType == EJointType::JT_GlobalHinge)
+			{
+				ThisBoneInnerToOuterUV = BatchProjectOntoPlane(ThisBoneInnerToOuterUV, Bone.RotationAxis);
+				if (Bone.bHingeLimited)
+				{
+					ThisBoneInnerToOuterUV = BatchLimitToHinge(ThisBoneInnerToOuterUV, Bone.ReferenceAxis, Bone.RotationAxis,
+						Bone.CosAnticlockwise, Bone.SinAnticlockwise, Bone.CosClockwise, Bone.SinClockwise);
+				}
+			}
+		}
+		else
+		{
+			// Snap the basebone back to its base, or project it backwards from its end by its length
+			if (Rig.FixedBaseMode)
+			{
+				InnerJoint = BatchLoad(&BaseLocations[InGroup * VectorStride]);
+			}
+			else
+			{
+				InnerJoint = BatchSubtract(BatchLoad(GroupJoints + VectorStride), BatchScale(BatchLoad(GroupDirections), Bone.Length));
+			}
+			BatchStore(InnerJoint, GroupJoints);
+
+			ThisBoneInnerToOuterUV = BatchSafeNormal(BatchSubtract(BatchLoad(GroupJoints + VectorStride), InnerJoint));
+
+			if (Rig.BaseboneConstraintType == EBoneConstraintType::BCT_GlobalRotor)
+			{
+				ThisBoneInnerToOuterUV = BatchLimitToRotor(ThisBoneInnerToOuterUV, BaseboneConstraintLanes, Bone.CosRotor, Bone.SinRotor);
+			}
+			else if (Rig.BaseboneConstraintType == EBoneConstraintType::BCT_GlobalHinge)
+			{
+				ThisBoneInnerToOuterUV = BatchProjectOntoPlane(ThisBoneInnerToOuterUV, Bone.RotationAxis);
+				if (bBaseboneHingeLimited)
+				{
+					ThisBoneInnerToOuterUV = BatchLimitToHinge(ThisBoneInnerToOuterUV, Bone.ReferenceAxis, Bone.RotationAxis,
+						Bone.CosAnticlockwise, Bone.SinAnticlockwise, Bone.CosClockwise, Bone.SinClockwise);
+				}
+			}
+		}
+
+		BatchStore(BatchMultiplyAdd(ThisBoneInnerToOuterUV, Bone.Length, InnerJoint), GroupJoints + (Loop + 1) * VectorStride);
+		BatchStore(ThisBoneInnerToOuterUV, GroupDirections + Loop * VectorStride);
+	}
+
+	// Distance between each lane's end effector and its target
+	return BatchLength(BatchSubtract(BatchLoad(GroupJoints + NumBonesL * VectorStride), Target));
+}
+
+int32 FFabrikChainBatch::SolveGroup(int32 InGroup)
+{
+	// Work out which lanes need solving - padding lanes never do
+	MS_ALIGN(16) float LaneValues[LaneCount] GCC_ALIGN(16);
+	bool bLaneNeedsSolve[LaneCount];
+	int32 NumSolved = 0;
+	for (int32 Lane = 0; Lane < LaneCount; ++Lane)
+	{
+		const int32 Instance = InGroup * LaneCount + Lane;
+		bLaneNeedsSolve[Lane] = Instance < NumInstancesL && NeedsSolve(Instance);
+		LaneValues[Lane] = bLaneNeedsSolve[Lane] ? 1.0f : 0.0f;
+		NumSolved += bLaneNeedsSolve[Lane] ? 1 : 0;
+	}
+
+	if (NumSolved == 0)
+	{
+		return 0;
+	}
+
+	VectorRegister Active = VectorCompareGT(VectorLoadAligned(LaneValues), VectorZero());
+
+	// Lanes that are not being solved, or never improve, end up back on the pose they started with
+	float* GroupJoints = &Joints[InGroup * GroupStride];
+	FMemory::Memcpy(BestJoints.GetData(), GroupJoints, GroupStride * sizeof(float));
+
+	const VectorRegister SolveDistanceThresholdLanes = VectorSetFloat1(SolveDistanceThreshold);
+	const VectorRegister MinIterationChangeLanes = VectorSetFloat1(MinIterationChange);
+	VectorRegister BestSolveDistance = VectorSetFloat1(FLT_MAX);
+	VectorRegister LastPassSolveDistance = VectorSetFloat1(FLT_MAX);
+
+	for (int32 Loop = 0; Loop < MaxIterationAttempts && VectorMaskBits(Active) != 0; ++Loop)
+	{
+		const VectorRegister SolveDistance = SolveGroupIK(InGroup);
+		++LastNumPasses;
+
+		// Active lanes that beat their best distance keep this pose
+		const VectorRegister Improved = VectorBitwiseAnd(Active, VectorCompareGT(BestSolveDistance, SolveDistance));
+		const VectorRegister NotImproved = VectorBitwiseAnd(Active, VectorCompareGE(SolveDistance, BestSolveDistance));
+		BestSolveDistance = VectorSelect(Improved, SolveDistance, BestSolveDistance);
+		for (int32 Offset = 0; Offset < GroupStride; Offset += LaneCount)
+		{
+			VectorStoreAligned(VectorSelect(Improved, VectorLoadAligned(GroupJoints + Offset), VectorLoadAligned(BestJoints.GetData() + Offset)), BestJoints.GetData() + Offset);
+		}
+
+		// Retire lanes which met the distance requirement, or which ground to a halt
+		const VectorRegister Solved = VectorBitwiseAnd(Improved, VectorCompareGT(SolveDistanceThresholdLanes, SolveDistance));
+		const VectorRegister Stalled = VectorBitwiseAnd(NotImproved, VectorCompareGT(MinIterationChangeLanes, VectorAbs(VectorSubtract(SolveDistance, LastPassSolveDistance))));
+		Active = VectorSelect(VectorBitwiseOr(Solved, Stalled), VectorZero(), Active);
+
+		LastPassSolveDistance = SolveDistance;
+	}
+
+	FMemory::Memcpy(GroupJoints, BestJoints.GetData(), GroupStride * sizeof(float));
+
+	VectorStoreAligned(BestSolveDistance, LaneValues);
+	for (int32 Lane = 0; Lane < LaneCount; ++Lane)
+	{
+		const int32 Instance = InGroup * LaneCount + Lane;
+		if (bLaneNeedsSolve[Lane])
+		{
+			SolveDistances[Instance] = LaneValues[Lane];
+			LastTargets[Instance] = FVector(*GetLane(Targets, 3 * LaneCount, Instance, 0, 0), *GetLane(Targets, 3 * LaneCount, Instance, 0, 1), *GetLane(Targets, 3 * LaneCount, Instance, 0, 2));
+			LastBaseLocations[Instance] = FVector(*GetLane(BaseLocations, 3 * LaneCount, Instance, 0, 0), *GetLane(BaseLocations, 3 * LaneCount, Instance, 0, 1), *GetLane(BaseLocations, 3 * LaneCount, Instance, 0, 2));
+		}
+	}
+
+	return NumSolved;
+}
+
+int32 FFabrikChainBatch::SolveInstance(int32 InInstance)
+{
+	if (!NeedsSolve(InInstance))
+	{
+		return 0;
+	}
+
+	const int32 NumJoints = Rig.NumBones() + 1;
+	const FVector Target(*GetLane(Targets, 3 * LaneCount, InInstance, 0, 0), *GetLane(Targets, 3 * LaneCount, InInstance, 0, 1), *GetLane(Targets, 3 * LaneCount, InInstance, 0, 2));
+	const FVector BaseLocation(*GetLane(BaseLocations, 3 * LaneCount, InInstance, 0, 0), *GetLane(BaseLocations, 3 * LaneCount, InInstance, 0, 1), *GetLane(BaseLocations, 3 * LaneCount, InInstance, 0, 2));
+
+	// Borrow the rig as scratch space for this instance's pose
+	for (int32 Joint = 0; Joint < NumJoints; ++Joint)
+	{
+		Rig.Joints[Joint] = GetJointLocation(InInstance, Joint);
+	}
+	Rig.FixedBaseLocation = BaseLocation;
+	Rig.UpdateDirections();
+
+	BestSolutionJoints = Rig.Joints;
+	float BestSolveDistance = FLT_MAX;
+	float LastPassSolveDistance = FLT_MAX;
+
+	for (int32 Loop = 0; Loop < MaxIterationAttempts; ++Loop)
+	{
+		const float SolveDistance = Rig.SolveIK(Target);
+		++LastNumPasses;
+
+		if (SolveDistance < BestSolveDistance)
+		{
+			BestSolveDistance = SolveDistance;
+			BestSolutionJoints = Rig.Joints;
+
+			if (SolveDistance < SolveDistanceThreshold)
+			{
+				break;
+			}
+		}
+		else if (FMath::Abs(SolveDistance - LastPassSolveDistance) < MinIterationChange)
+		{
+			break;
+		}
+
+		LastPassSolveDistance = SolveDistance;
+	}
+
+	for (int32 Joint = 0; Joint < NumJoints; ++Joint)
+	{
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			*GetLane(Joints, GroupStride, InInstance, Joint, Axis) = BestSolutionJoints[Joint][Axis];
+		}
+	}
+
+	SolveDistances[InInstance] = BestSolveDistance;
+	LastTargets[InInstance] = Target;
+	LastBaseLocations[InInstance] = BaseLocation;
+	return 1;
+}
@@ -0,0 +1,316 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FabrikChainData.h"
+
+#include "OpenMotion.h"
+
+FFabrikChainData::FFabrikChainData()
+{
+	BaseboneConstraintType = EBoneConstraintType::BCT_None;
+	BaseboneConstraintUV = FVector::ZeroVector;
+	BaseboneRelativeConstraintUV = FVector::ZeroVector;
+	BaseboneRelativeReferenceConstraintUV = FVector::ZeroVector;
+	FixedBaseLocation = FVector::ZeroVector;
+	FixedBaseMode = true;
+	HasSubBasePulls = false;
+	SpecializedSolveIK = nullptr;
+}
+
+void FFabrikChainData::SetNumBones(int32 InNumBones)
+{
+	Joints.SetNum(InNumBones + 1, false);
+	Directions.SetNum(InNumBones, false);
+	Lengths.SetNum(InNumBones, false);
+	JointTypes.SetNum(InNumBones, false);
+	RotorConstraintDegs.SetNum(InNumBones, false);
+	HingeClockwiseConstraintDegs.SetNum(InNumBones, false);
+	HingeAnticlockwiseConstraintDegs.SetNum(InNumBones, false);
+	RotorLimits.SetNum(InNumBones, false);
+	HingeClockwiseLimits.SetNum(InNumBones, false);
+	HingeAnticlockwiseLimits.SetNum(InNumBones, false);
+	RotationAxes.SetNum(InNumBones, false);
+	ReferenceAxes.SetNum(InNumBones, false);
+	SubBasePulls.SetNum(InNumBones + 1, false);
+	NumSubBasePulls.SetNum(InNumBones + 1, false);
+}
+
+void FFabrikChainData::UpdateDirections()
+{
+	const int32 NumBonesL = NumBones();
+	for (int32 Loop = 0; Loop < NumBonesL; ++Loop)
+	{
+		Directions[Loop] = (Joints[Loop + 1] - Joints[Loop]).GetSafeNormal();
+	}
+}
+
+SIZE_T FFabrikChainData::GetAllocatedSize() const
+{
+	return Joints.GetAllocatedSize() + Directions.GetAllocatedSize() + Lengths.GetAllocatedSize() + JointTypes.GetAllocatedSize() +
+		RotorConstraintDegs.GetAllocatedSize() + HingeClockwiseConstraintDegs.GetAllocatedSize() + HingeAnticlockwiseConstraintDegs.GetAllocatedSize() +
+		RotorLimits.GetAllocatedSize() + HingeClockwiseLimits.GetAllocatedSize() + HingeAnticlockwiseLimits.GetAllocatedSize() +
+		RotationAxes.GetAllocatedSize() + ReferenceAxes.GetAllocatedSize() + SubBasePulls.GetAllocatedSize() + NumSubBasePulls.GetAllocatedSize();
+}
+
+float FFabrikChainData::SolveIKGeneric(const FVector& InTarget)
+{
+	const int32 NumBonesL = NumBones();
+
+	// Sanity check that there are bones in the chain
+	if (NumBonesL == 0)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("It makes no sense to solve an IK chain with zero bones."));
+	}
+
+	SolveForwardPass(InTarget);
+	SolveBackwardPass();
+
+	// Finally, calculate and return the distance between the current effector location and the target.
+	return FVector::Dist(Joints[NumBonesL], InTarget);
+}
+
+void FFabrikChainData::SolveForwardPass(const FVector& InTarget)
+{
+	const int32 NumBonesL = NumBones();
+
+	// A chain connected at the end effector shares the effector with the target
+	FVector Target = InTarget;
+	if (HasSubBasePulls && NumSubBasePulls[NumBonesL] > 0)
+	{
+		Target = (InTarget + SubBasePulls[NumBonesL]) / (float)(NumSubBasePulls[NumBonesL] + 1);
+	}
+
+	// ---------- Forward pass from end effector to base -----------
+
+	for (int32 Loop = NumBonesL - 1; Loop >= 0; --Loop)
+	{
+		const bool bEffectorBone = (Loop == NumBonesL - 1);
+
+		switch (JointTypes[Loop])
+		{
+		case EJointType::JT_Ball: SolveForwardBone<EJointType::JT_Ball>(Loop, bEffectorBone, Target); break;
+		case EJointType::JT_GlobalHinge: SolveForwardBone<EJointType::JT_GlobalHinge>(Loop, bEffectorBone, Target); break;
+		case EJointType::JT_LocalHinge: SolveForwardBone<EJointType::JT_LocalHinge>(Loop, bEffectorBone, Target); break;
+		default: SolveForwardBone<EJointType::JT_None>(Loop, bEffectorBone, Target); break;
+		}
+
+		// Move a sub-base to the centroid of where this chain and the chains connected there want it. The bone
+		// outside it is left stretched until the backward pass puts it back to length.
+		if (HasSubBasePulls && NumSubBasePulls[Loop] > 0)
+		{
+			Joints[Loop] = (Joints[Loop] + SubBasePulls[Loop]) / (float)(NumSubBasePulls[Loop] + 1);
+			Directions[Loop] = (Joints[Loop + 1] - Joints[Loop]).GetSafeNormal();
+		}
+	}
+}
+
+void FFabrikChainData::SolveBackwardPass()
+{
+	const int32 NumBonesL = NumBones();
+
+	// ---------- Backward pass from base to end effector -----------
+
+	switch (BaseboneConstraintType)
+	{
+	case EBoneConstraintType::BCT_GlobalRotor: SolveBasebone<EBoneConstraintType::BCT_GlobalRotor>(); break;
+	case EBoneConstraintType::BCT_LocalRotor: SolveBasebone<EBoneConstraintType::BCT_LocalRotor>(); break;
+	case EBoneConstraintType::BCT_GlobalHinge: SolveBasebone<EBoneConstraintType::BCT_GlobalHinge>(); break;
+	case EBoneConstraintType::BCT_LocalHinge: SolveBasebone<EBoneConstraintType::BCT_LocalHinge>(); break;
+	default: SolveBasebone<EBoneConstraintType::BCT_None>(); break;
+	}
+
+	for (int32 Loop = 1; Loop < NumBonesL; ++Loop)
+	{
+		switch (JointTypes[Loop])
+		{
+		case EJointType::JT_Ball: SolveBackwardBone<EJointType::JT_Ball>(Loop); break;
+		case EJointType::JT_GlobalHinge: SolveBackwardBone<EJointType::JT_GlobalHinge>(Loop); break;
+		case EJointType::JT_LocalHinge: SolveBackwardBone<EJointType::JT_LocalHinge>(Loop); break;
+		default: SolveBackwardBone<EJointType::JT_None>(Loop); break;
+		}
+	}
+}
+
+// Constraints are checked with a little slack, since the iterative solve only gets within a whisker of them either
+static const float ClosedFormAngleToleranceDegs = 0.01f;
+static const float ClosedFormPlaneTolerance = 0.001f;
+
+static bool IsWithinHinge(const FVector& InDirection, const FVector& InRotationAxis, const FVector& InReferenceAxis, float InClockwiseDegs, float InAnticlockwiseDegs)
+{
+	if (FMath::Abs(FVector::DotProduct(InDirection, InRotationAxis)) > ClosedFormPlaneTolerance)
+	{
+		return false;
+	}
+
+	// Freely rotating hinges only need to stay in their plane
+	if (UFabrikUtil::ApproximatelyEquals(InClockwiseDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f) ||
+		UFabrikUtil::ApproximatelyEquals(InAnticlockwiseDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f))
+	{
+		return true;
+	}
+
+	const float SignedAngleDegs = UFabrikUtil::GetSignedAngleBetweenDegs(InReferenceAxis, InDirection, InRotationAxis);
+	return SignedAngleDegs <= InAnticlockwiseDegs + ClosedFormAngleToleranceDegs &&
+		SignedAngleDegs >= -InClockwiseDegs - ClosedFormAngleToleranceDegs;
+}
+
+bool FFabrikChainData::IsBaseboneDirectionAllowed(const FVector& InDirection) const
+{
+	switch (BaseboneConstraintType)
+	{
+	case EBoneConstraintType::BCT_GlobalRotor:
+		return UFabrikUtil::GetAngleBetweenDegs(BaseboneConstraintUV, InDirection) <= RotorConstraintDegs[0] + ClosedFormAngleToleranceDegs;
+	case EBoneConstraintType::BCT_LocalRotor:
+		return UFabrikUtil::GetAngleBetweenDegs(BaseboneRelativeConstraintUV, InDirection) <= RotorConstraintDegs[0] + ClosedFormAngleToleranceDegs;
+	case EBoneConstraintType::BCT_GlobalHinge:
+		return IsWithinHinge(InDirection, RotationAxes[0], ReferenceAxes[0], HingeClockwiseConstraintDegs[0], HingeAnticlockwiseConstraintDegs[0]);
+	case EBoneConstraintType::BCT_LocalHinge:
+		return IsWithinHinge(InDirection, BaseboneRelativeConstraintUV, BaseboneRelativeReferenceConstraintUV, HingeClockwiseConstraintDegs[0], HingeAnticlockwiseConstraintDegs[0]);
+	default:
+		return true;
+	}
+}
+
+bool FFabrikChainData::IsBoneDirectionAllowed(int32 InLoop, const FVector& InPrevDirection, const FVector& InDirection) const
+{
+	switch (JointTypes[InLoop])
+	{
+	case EJointType::JT_Ball:
+		return UFabrikUtil::GetAngleBetweenDegs(InPrevDirection, InDirection) <= RotorConstraintDegs[InLoop] + ClosedFormAngleToleranceDegs;
+	case EJointType::JT_GlobalHinge:
+		return IsWithinHinge(InDirection, RotationAxes[InLoop], ReferenceAxes[InLoop], HingeClockwiseConstraintDegs[InLoop], HingeAnticlockwiseConstraintDegs[InLoop]);
+	case EJointType::JT_LocalHinge: {
+		// Local hinge axes are relative to the previous bone's direction
+		FFabrikMat3f M = FFabrikMat3f::CreateRotationMatrix(InPrevDirection);
+		return IsWithinHinge(InDirection, M.Times(RotationAxes[InLoop]).GetSafeNormal(), M.Times(ReferenceAxes[InLoop]).GetSafeNormal(),
+			HingeClockwiseConstraintDegs[InLoop], HingeAnticlockwiseConstraintDegs[InLoop]);
+	}
+	default:
+		return true;
+	}
+}
+
+bool FFabrikChainData::SolveClosedForm(const FVector& InTarget, float& OutSolveDistance)
+{
+	const int32 NumBonesL = NumBones();
+
+	// A moving base drags the whole chain after the target, so there is no closed form for it
+	if (!FixedBaseMode || NumBonesL == 0)
+	{
+		return false;
+	}
+
+	// The forward pass projects the basebone onto its own joint too, and a local hinge there needs a host bone
+	if (JointTypes[0] == EJointType::JT_LocalHinge)
+	{
+		return false;
+	}
+
+	const FVector BaseLocation = FixedBaseLocation;
+	const FVector BaseToTarget = InTarget - BaseLocation;
+	const float TargetDistance = BaseToTarget.Size();
+	if (TargetDistance < KINDA_SMALL_NUMBER)
+	{
+		return false;
+	}
+	const FVector TargetUV = BaseToTarget / TargetDistance;
+
+	float ChainLengthL = 0.0f;
+	for (float Length : Lengths)
+	{
+		ChainLengthL += Length;
+	}
+
+	// ---------- Out of reach: every bone points straight at the target ----------
+
+	if (TargetDistance >= ChainLengthL)
+	{
+		if (!IsBaseboneDirectionAllowed(TargetUV) ||
+			(JointTypes[0] == EJointType::JT_GlobalHinge && !IsWithinHinge(TargetUV, RotationAxes[0], ReferenceAxes[0], HingeClockwiseConstraintDegs[0], HingeAnticlockwiseConstraintDegs[0])))
+		{
+			return false;
+		}
+		for (int32 Loop = 1; Loop < NumBonesL; ++Loop)
+		{
+			if (!IsBoneDirectionAllowed(Loop, TargetUV, TargetUV))
+			{
+				return false;
+			}
+		}
+
+		Joints[0] = BaseLocation;
+		for (int32 Loop = 0; Loop < NumBonesL; ++Loop)
+		{
+			Joints[Loop + 1] = Joints[Loop] + (TargetUV * Lengths[Loop]);
+			Directions[Loop] = TargetUV;
+		}
+
+		OutSolveDistance = TargetDistance - ChainLengthL;
+		return true;
+	}
+
+	// ---------- Two bones in reach: law of cosines ----------
+
+	if (NumBonesL != 2)
+	{
+		return false;
+	}
+
+	const float UpperLength = Lengths[0];
+	const float LowerLength = Lengths[1];
+	if (TargetDistance < FMath::Abs(UpperLength - LowerLength))
+	{
+		return false;
+	}
+
+	// Bend the same way the chain is bent now - or, for a global hinge, in the hinge plane on the same side
+	FVector BendUV;
+	if (JointTypes[1] == EJointType::JT_GlobalHinge)
+	{
+		BendUV = FVector::CrossProduct(RotationAxes[1], TargetUV).GetSafeNormal();
+		if (FVector::DotProduct(BendUV, Joints[1] - BaseLocation) < 0.0f)
+		{
+			BendUV = -BendUV;
+		}
+	}
+	else
+	{
+		const FVector BaseToJoint = Joints[1] - BaseLocation;
+		BendUV = (BaseToJoint - TargetUV * FVector::DotProduct(BaseToJoint, TargetUV)).GetSafeNormal();
+	}
+	if (BendUV.IsNearlyZero())
+	{
+		BendUV = UFabrikUtil::VectorGenPerpendicularVectorQuick(TargetUV);
+	}
+
+	// Distance of the middle joint along and out from the line between the base and the target
+	const float Along = (UpperLength * UpperLength - LowerLength * LowerLength + TargetDistance * TargetDistance) / (2.0f * TargetDistance);
+	const float Out = FMath::Sqrt(FMath::Max(UpperLength * UpperLength - Along * Along, 0.0f));
+
+	const FVector MiddleJoint = BaseLocation + (TargetUV * Along) + (BendUV * Out);
+	const FVector UpperUV = (MiddleJoint - BaseLocation).GetSafeNormal();
+	const FVector LowerUV = (InTarget - MiddleJoint).GetSafeNormal();
+
+	if (!IsBaseboneDirectionAllowed(UpperUV) || !IsBoneDirectionAllowed(1, UpperUV, LowerUV))
+	{
+		return false;
+	}
+
+	// Honour what the forward pass enforces on the basebone's own joint as well
+	if (JointTypes[0] == EJointType::JT_Ball && UFabrikUtil::GetAngleBetweenDegs(UpperUV, LowerUV) > RotorConstraintDegs[0] + ClosedFormAngleToleranceDegs)
+	{
+		return false;
+	}
+	if (JointTypes[0] == EJointType::JT_GlobalHinge && !IsWithinHinge(UpperUV, RotationAxes[0], ReferenceAxes[0], HingeClockwiseConstraintDegs[0], HingeAnticlockwiseConstraintDegs[0]))
+	{
+		return false;
+	}
+
+	Joints[0] = BaseLocation;
+	Joints[1] = BaseLocation + (UpperUV * UpperLength);
+	Joints[2] = Joints[1] + (LowerUV * LowerLength);
+	Directions[0] = UpperUV;
+	Directions[1] = LowerUV;
+
+	OutSolveDistance = FVector::Dist(Joints[2], InTarget);
+	return true;
+}
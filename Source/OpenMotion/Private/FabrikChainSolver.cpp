@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FabrikChainSolver.h"
+
+#include "OpenMotion.h"
+
+FFabrikChainSolverRegistry& FFabrikChainSolverRegistry::Get()
+{
+	static FFabrikChainSolverRegistry Registry;
+	return Registry;
+}
+
+FFabrikChainSolverRegistry::FFabrikChainSolverRegistry()
+{
+	// Two and three bone limbs
+	Register<FFabrikTwoBoneBallSolver>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_GlobalRotor, EJointType::JT_Ball, EJointType::JT_Ball>>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_None, EJointType::JT_Ball, EJointType::JT_GlobalHinge>>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_None, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball>>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_GlobalRotor, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball>>();
+
+	// Four bone arms, shoulder to hand
+	Register<FFabrikBallArmSolver>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_GlobalRotor, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball>>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_LocalRotor, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball>>();
+
+	// Fingers, either hanging off a ball knuckle or hinged all the way from a connected hand
+	Register<FFabrikLocalHingeFingerSolver>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_None, EJointType::JT_Ball, EJointType::JT_LocalHinge, EJointType::JT_LocalHinge, EJointType::JT_LocalHinge>>();
+	Register<TFabrikChainSolver<EBoneConstraintType::BCT_LocalHinge, EJointType::JT_LocalHinge, EJointType::JT_LocalHinge, EJointType::JT_LocalHinge>>();
+}
+
+uint64 FFabrikChainSolverRegistry::GetLayoutKey(EBoneConstraintType InBaseboneConstraintType, const EJointType* InJointTypes, int32 InNumBones)
+{
+	if (InNumBones <= 0 || InNumBones > MaxBones)
+	{
+		return 0;
+	}
+
+	// An explicit lack of constraint solves exactly the same as no constraint
+	if (InBaseboneConstraintType == EBoneConstraintType::BCT_NoConstraint)
+	{
+		InBaseboneConstraintType = EBoneConstraintType::BCT_None;
+	}
+
+	// 4 bits of basebone constraint, 5 bits of bone count, then 2 bits per joint type
+	uint64 Key = (uint64)InBaseboneConstraintType | ((uint64)InNumBones << 4);
+	for (int32 Loop = 0; Loop < InNumBones; ++Loop)
+	{
+		Key |= ((uint64)InJointTypes[Loop] & 3) << (9 + Loop * 2);
+	}
+	return Key;
+}
+
+void FFabrikChainSolverRegistry::Register(uint64 InLayoutKey, FFabrikSolveIKFunction InSolveIK)
+{
+	if (InLayoutKey == 0)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("Specialised chain solvers are limited to %d bones."), MaxBones);
+	}
+
+	Solvers.Add(InLayoutKey, InSolveIK);
+}
+
+FFabrikSolveIKFunction FFabrikChainSolverRegistry::Find(const FFabrikChainData& InData) const
+{
+	const uint64 Key = GetLayoutKey(InData.BaseboneConstraintType, InData.JointTypes.GetData(), InData.NumBones());
+	if (Key == 0)
+	{
+		return nullptr;
+	}
+
+	const FFabrikSolveIKFunction* SolveIK = Solvers.Find(Key);
+	return SolveIK ? *SolveIK : nullptr;
+}
@@ -1,6 +1,7 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "FabrikDebugComponent.h"
+#include "FabrikDebugDrawComponent.h"
 
 #include "FabrikStructure.h"
 #include "FabrikChain.h"
@@ -14,6 +15,11 @@
 
 #include "OpenMotion.h"
 
+DECLARE_CYCLE_STAT(TEXT("Fabrik Debug DrawBatched"), STAT_FabrikDebugDrawBatched, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Debug Chains Rebuilt"), STAT_FabrikDebugChainsRebuilt, STATGROUP_OpenMotion);
+DECLARE_CYCLE_STAT(TEXT("Fabrik Debug Build Glyph"), STAT_FabrikDebugBuildGlyph, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Debug Glyphs Built"), STAT_FabrikDebugGlyphsBuilt, STATGROUP_OpenMotion);
+
 // Sets default values for this component's properties
 UFabrikDebugComponent::UFabrikDebugComponent()
 {
@@ -24,6 +30,10 @@ UFabrikDebugComponent::UFabrikDebugComponent()
 	PointSize = 5.0f;
 	LineThickness = 2.0f;
 	DrawEnabled = true;
+	UseBatchedDrawing = true;
+	DrawComponent = nullptr;
+	CurrentGeometry = nullptr;
+	UnitCircleLines = 0;
 
 	// Constraint colours
 	 ANTICLOCKWISE_CONSTRAINT_COLOUR = FColor(255, 0, 0);
@@ -47,7 +57,25 @@ void UFabrikDebugComponent::BeginPlay()
 	Super::BeginPlay();
 
 	rotStep = 360.0f / (float)NUM_CONE_LINES;
-	
+
+	if (UseBatchedDrawing && GetOwner() != nullptr)
+	{
+		DrawComponent = NewObject<UFabrikDebugDrawComponent>(GetOwner(), NAME_None, RF_Transient);
+		DrawComponent->RegisterComponent();
+	}
+}
+
+void UFabrikDebugComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (DrawComponent != nullptr)
+	{
+		DrawComponent->DestroyComponent();
+		DrawComponent = nullptr;
+	}
+	ChainCaches.Reset();
+	JointGlyphs.Reset();
+
+	Super::EndPlay(EndPlayReason);
 }
 
 
@@ -57,12 +85,31 @@ void UFabrikDebugComponent::TickComponent( float DeltaTime, ELevelTick TickType,
 	Super::TickComponent( DeltaTime, TickType, ThisTickFunction );
 
 	if (DrawEnabled == false || Structure == NULL)
+	{
+		if (DrawComponent != nullptr)
+		{
+			DrawComponent->SetChains(TArray<FFabrikDebugChainGeometryPtr>());
+		}
 		return;
+	}
 
-	for (UFabrikChain* Chain : Structure->Chains)
+	if (DrawComponent != nullptr)
 	{
-		DrawChainBones(Chain);
-		DrawChainConstraints(Chain, 1);
+		DrawBatched();
+	}
+	else
+	{
+		for (UFabrikChain* Chain : Structure->Chains)
+		{
+			DrawChainBones(Chain);
+			DrawChainConstraints(Chain, 1);
+		}
+	}
+
+	// Joints that have been replaced or destroyed leave their glyphs behind
+	if (JointGlyphs.Num() > Structure->GetNumJoints())
+	{
+		PruneJointGlyphs();
 	}
 }
 
@@ -77,32 +124,11 @@ void UFabrikDebugComponent::DrawChainBones(UFabrikChain* Chain)
 
 		if (i == 0)
 		{
-			DrawDebugPoint(
-				GetWorld(),
-				Bone->StartLocation,
-				PointSize,  					//size
-				FColor(255, 0, 255),  //pink
-				false//,  				//persistent (never goes away)
-				//0.03 					//point leaves a trail on moving object
-			);
+			DrawPoint(Bone->StartLocation, FColor(255, 0, 255)); //pink
 		}
-		DrawDebugPoint(
-			GetWorld(),
-			Bone->EndLocation,
-			PointSize,  					//size
-			FColor(255, 0, 255),  //pink
-			false//,  				//persistent (never goes away)
-			//0.03 					//point leaves a trail on moving object
-		);
-
-		DrawDebugLine(
-			GetWorld(),
-			Bone->StartLocation,
-			Bone->EndLocation,
-			Bone->Color, // FColor(255, 0, 0),
-			false, -1, 0,
-			LineThickness
-		);
+		DrawPoint(Bone->EndLocation, FColor(255, 0, 255)); //pink
+
+		DrawThickLine(Bone->StartLocation, Bone->EndLocation, Bone->Color, LineThickness);
 
 	}
 }
@@ -120,24 +146,9 @@ void UFabrikDebugComponent::DrawConstraint(UFabrikBone* bone, FVector referenceD
 		// If the ball joint constraint is 180 degrees then it's not really constrained, so we won't draw it
 		if (UFabrikUtil::ApproximatelyEquals(constraintAngleDegs, 180.0f, 0.01f)) { return; }
 
-		// The constraint direction is the direction of the previous bone rotated about a perpendicular axis by the constraint angle of this bone
-		FVector constraintDirection = UFabrikUtil::RotateAboutAxisDegs(referenceDirection, constraintAngleDegs, UFabrikUtil::VectorGenPerpendicularVectorQuick(referenceDirection));// .normalised();
-		constraintDirection.Normalize();
-
-		// Draw the lines about the the bone (relative to the reference direction)				
-		FVector lineEnd;
-		for (int loop = 0; loop < NUM_CONE_LINES; ++loop)
-		{
-			lineEnd = lineStart + (constraintDirection * (boneLength * CONE_LENGTH_FACTOR));
-			constraintDirection = UFabrikUtil::RotateAboutAxisDegs(constraintDirection, rotStep, referenceDirection);// .normalised();
-			DrawLine(lineStart, lineEnd, BALL_JOINT_COLOUR, lineWidth);// , mvpMatrix);
-		}
-
-		// Draw the circle at the top of the cone
-		float pushDistance = (float)FMath::Cos(FMath::DegreesToRadians( constraintAngleDegs )) * boneLength;
-		float radius = (float)FMath::Sin( FMath::DegreesToRadians( constraintAngleDegs)) * boneLength;
-		FVector circleCentre = lineStart + (referenceDirection * (pushDistance * CONE_LENGTH_FACTOR));
-		DrawCircle(circleCentre, referenceDirection, radius * CONE_LENGTH_FACTOR, BALL_JOINT_COLOUR, lineWidth);// , mvpMatrix);
+		// The cone lines and the circle at the top of the cone, about the reference direction (i.e. the previous bone's direction)
+		DrawGlyph(GetJointGlyph(bone->Joint), lineStart, referenceDirection, UFabrikUtil::VectorGenPerpendicularVectorQuick(referenceDirection),
+			boneLength * CONE_LENGTH_FACTOR, BALL_JOINT_COLOUR, lineWidth);
 		break;
 	}
 	case EJointType::JT_GlobalHinge: {
@@ -146,36 +157,22 @@ void UFabrikDebugComponent::DrawConstraint(UFabrikBone* bone, FVector referenceD
 		float radius = boneLength * RADIUS_FACTOR;
 		DrawCircle(lineStart, hingeRotationAxis, radius, GLOBAL_HINGE_COLOUR, lineWidth);// , mvpMatrix);
 
-		// Note: While ACW rotation is negative and CW rotation about an axis is positive, we store both 
-		// of these as positive values between the range 0 to 180 degrees, as such we'll negate the
-		// clockwise rotation value for it to turn in the correct direction.
-		float anticlockwiseConstraintDegs = bone->Joint->HingeAnticlockwiseConstraintDegs;// getHingeJointAnticlockwiseConstraintDegs();
-		float clockwiseConstraintDegs = -bone->Joint->HingeClockwiseConstraintDegs;// getHingeJointClockwiseConstraintDegs();
-
-		// If both the anticlockwise (positive) and clockwise (negative) constraint angles are not 180 degrees (i.e. we
-		// are constraining the hinge about a reference direction which lies in the plane of the hinge rotation axis)...
-		if (!UFabrikUtil::ApproximatelyEquals(anticlockwiseConstraintDegs, 180.0f, 0.01f) &&
-			!UFabrikUtil::ApproximatelyEquals(clockwiseConstraintDegs, 180.0f, 0.01f))
+		// If both the anticlockwise and clockwise constraint angles are not 180 degrees (i.e. we are constraining the
+		// hinge about a reference direction which lies in the plane of the hinge rotation axis) then draw the hinge
+		// reference axis and ACW/CW constraints about it.
+		if (!UFabrikUtil::ApproximatelyEquals(bone->Joint->HingeAnticlockwiseConstraintDegs, 180.0f, 0.01f) &&
+			!UFabrikUtil::ApproximatelyEquals(-bone->Joint->HingeClockwiseConstraintDegs, 180.0f, 0.01f))
 		{
-			FVector hingeReferenceAxis = bone->Joint->ReferenceAxisUV;// HingeReferenceAxis;
-
-			// ...then draw the hinge reference axis and ACW/CW constraints about it.
-			DrawLine(lineStart, lineStart + (hingeReferenceAxis * (boneLength * RADIUS_FACTOR)), REFERENCE_AXIS_COLOUR, lineWidth);// , mvpMatrix);
-			FVector anticlockwiseDirection = UFabrikUtil::RotateAboutAxisDegs(hingeReferenceAxis, anticlockwiseConstraintDegs, hingeRotationAxis);
-			FVector clockwiseDirection = UFabrikUtil::RotateAboutAxisDegs(hingeReferenceAxis, clockwiseConstraintDegs, hingeRotationAxis);
-			FVector anticlockwisePoint = lineStart + (anticlockwiseDirection * (radius));
-			FVector clockwisePoint = lineStart + (clockwiseDirection * (radius));
-			DrawLine(lineStart, anticlockwisePoint, ANTICLOCKWISE_CONSTRAINT_COLOUR, lineWidth);// , mvpMatrix);
-			DrawLine(lineStart, clockwisePoint, CLOCKWISE_CONSTRAINT_COLOUR, lineWidth);// , mvpMatrix);
+			DrawGlyph(GetJointGlyph(bone->Joint), lineStart, hingeRotationAxis, bone->Joint->ReferenceAxisUV, radius, GLOBAL_HINGE_COLOUR, lineWidth);
 		}
 		break;
 	}
 	case EJointType::JT_LocalHinge: {
 		// Construct a rotation matrix based on the reference direction (i.e. the previous bone's direction)...
-		UFabrikMat3f* m = UFabrikMat3f::CreateRotationMatrix(referenceDirection);
+		FFabrikMat3f m = FFabrikMat3f::CreateRotationMatrix(referenceDirection);
 
 		// ...and transform the hinge rotation axis into the previous bone's frame of reference
-		FVector relativeHingeRotationAxis = m->Times(bone->Joint->RotationAxisUV);// GetHingeRotationAxis());// .normalise();
+		FVector relativeHingeRotationAxis = m.Times(bone->Joint->RotationAxisUV);// GetHingeRotationAxis());// .normalise();
 		relativeHingeRotationAxis.Normalize();
 
 		// Draw the circle describing the hinge rotation axis
@@ -183,25 +180,13 @@ void UFabrikDebugComponent::DrawConstraint(UFabrikBone* bone, FVector referenceD
 		DrawCircle(lineStart, relativeHingeRotationAxis, radius, LOCAL_HINGE_COLOUR, lineWidth);// , mvpMatrix);
 
 		// Draw the hinge reference and clockwise/anticlockwise constraints if necessary
-		float anticlockwiseConstraintDegs = bone->Joint->HingeAnticlockwiseConstraintDegs;// getHingeJointAnticlockwiseConstraintDegs();
-		float clockwiseConstraintDegs = -bone->Joint->HingeClockwiseConstraintDegs; //  .getHingeJointClockwiseConstraintDegs();
-		if (!UFabrikUtil::ApproximatelyEquals(anticlockwiseConstraintDegs, 180.0f, 0.01f) &&
-			!UFabrikUtil::ApproximatelyEquals(clockwiseConstraintDegs, 180.0f, 0.01f))
+		if (!UFabrikUtil::ApproximatelyEquals(bone->Joint->HingeAnticlockwiseConstraintDegs, 180.0f, 0.01f) &&
+			!UFabrikUtil::ApproximatelyEquals(-bone->Joint->HingeClockwiseConstraintDegs, 180.0f, 0.01f))
 		{
-			// Get the relative hinge rotation axis and draw it...
-			FVector relativeHingeReferenceAxis = UFabrikUtil::ProjectOntoPlane(bone->Joint->ReferenceAxisUV, relativeHingeRotationAxis); //;getHingeReferenceAxis().projectOntoPlane(relativeHingeRotationAxis);
-			relativeHingeReferenceAxis = m->Times(bone->Joint->ReferenceAxisUV);// getHingeReferenceAxis());// .normalise();
+			FVector relativeHingeReferenceAxis = m.Times(bone->Joint->ReferenceAxisUV);// getHingeReferenceAxis());// .normalise();
 			relativeHingeReferenceAxis.Normalize();
 
-			DrawLine(lineStart, lineStart + (relativeHingeReferenceAxis * radius), REFERENCE_AXIS_COLOUR, lineWidth);// , mvpMatrix);
-
-			// ...as well as the clockwise and anticlockwise constraints.
-			FVector anticlockwiseDirection = UFabrikUtil::RotateAboutAxisDegs(relativeHingeReferenceAxis, anticlockwiseConstraintDegs, relativeHingeRotationAxis);
-			FVector clockwiseDirection = UFabrikUtil::RotateAboutAxisDegs(relativeHingeReferenceAxis, clockwiseConstraintDegs, relativeHingeRotationAxis);
-			FVector anticlockwisePoint = lineStart + (anticlockwiseDirection * radius);
-			FVector clockwisePoint = lineStart + (clockwiseDirection * radius);
-			DrawLine(lineStart, anticlockwisePoint, ANTICLOCKWISE_CONSTRAINT_COLOUR, lineWidth);// , mvpMatrix);
-			DrawLine(lineStart, clockwisePoint, CLOCKWISE_CONSTRAINT_COLOUR, lineWidth);// , mvpMatrix);
+			DrawGlyph(GetJointGlyph(bone->Joint), lineStart, relativeHingeRotationAxis, relativeHingeReferenceAxis, radius, LOCAL_HINGE_COLOUR, lineWidth);
 		}
 		break;
 	}
@@ -209,8 +194,140 @@ void UFabrikDebugComponent::DrawConstraint(UFabrikBone* bone, FVector referenceD
 	} // End of switch statement
 }
 
+const UFabrikDebugComponent::FGlyph& UFabrikDebugComponent::GetJointGlyph(const UFabrikJoint* Joint)
+{
+	FJointGlyph* Cached = JointGlyphs.Find(Joint);
+	if (Cached != nullptr &&
+		Cached->JointType == Joint->JointType &&
+		Cached->RotorConstraintDegs == Joint->RotorConstraintDegs &&
+		Cached->HingeClockwiseConstraintDegs == Joint->HingeClockwiseConstraintDegs &&
+		Cached->HingeAnticlockwiseConstraintDegs == Joint->HingeAnticlockwiseConstraintDegs &&
+		Cached->NumConeLines == NUM_CONE_LINES &&
+		Cached->RotStep == rotStep)
+	{
+		return Cached->Glyph;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_FabrikDebugBuildGlyph);
+
+	FJointGlyph& Entry = JointGlyphs.FindOrAdd(Joint);
+	Entry.JointType = Joint->JointType;
+	Entry.RotorConstraintDegs = Joint->RotorConstraintDegs;
+	Entry.HingeClockwiseConstraintDegs = Joint->HingeClockwiseConstraintDegs;
+	Entry.HingeAnticlockwiseConstraintDegs = Joint->HingeAnticlockwiseConstraintDegs;
+	Entry.NumConeLines = NUM_CONE_LINES;
+	Entry.RotStep = rotStep;
+	Entry.Glyph.Lines.Reset();
+
+	// Points are (along the axis, along the reference, along axis x reference)
+	if (Joint->JointType == EJointType::JT_Ball)
+	{
+		// The constraint direction tipped off the axis by the constraint angle, then swept about the axis a step per line
+		float sinAngle, cosAngle;
+		FMath::SinCos(&sinAngle, &cosAngle, FMath::DegreesToRadians(Joint->RotorConstraintDegs));
+		for (int loop = 0; loop < NUM_CONE_LINES; ++loop)
+		{
+			float sinStep, cosStep;
+			FMath::SinCos(&sinStep, &cosStep, FMath::DegreesToRadians(loop * rotStep));
+			Entry.Glyph.AddLine(FVector::ZeroVector, FVector(cosAngle, sinAngle * sinStep, -sinAngle * cosStep), GC_Shape);
+		}
+
+		// The circle at the top of the cone
+		const FGlyph& Circle = GetUnitCircle();
+		for (const FGlyph::FLine& Line : Circle.Lines)
+		{
+			Entry.Glyph.AddLine(FVector(cosAngle, Line.Start.Y * sinAngle, Line.Start.Z * sinAngle), FVector(cosAngle, Line.End.Y * sinAngle, Line.End.Z * sinAngle), GC_Shape);
+		}
+	}
+	else
+	{
+		// Note: While ACW rotation is negative and CW rotation about an axis is positive, we store both of these as
+		// positive values between the range 0 to 180 degrees, as such we'll negate the clockwise rotation value for it
+		// to turn in the correct direction.
+		float sinAnticlockwise, cosAnticlockwise, sinClockwise, cosClockwise;
+		FMath::SinCos(&sinAnticlockwise, &cosAnticlockwise, FMath::DegreesToRadians(Joint->HingeAnticlockwiseConstraintDegs));
+		FMath::SinCos(&sinClockwise, &cosClockwise, FMath::DegreesToRadians(-Joint->HingeClockwiseConstraintDegs));
+
+		Entry.Glyph.AddLine(FVector::ZeroVector, FVector(0.0f, 1.0f, 0.0f), GC_Reference);
+		Entry.Glyph.AddLine(FVector::ZeroVector, FVector(0.0f, cosAnticlockwise, sinAnticlockwise), GC_Anticlockwise);
+		Entry.Glyph.AddLine(FVector::ZeroVector, FVector(0.0f, cosClockwise, sinClockwise), GC_Clockwise);
+	}
+
+	INC_DWORD_STAT(STAT_FabrikDebugGlyphsBuilt);
+	return Entry.Glyph;
+}
+
+void UFabrikDebugComponent::PruneJointGlyphs()
+{
+	// Anything not drawn this tick is rebuilt on demand, so only the joints still in the structure are kept
+	TSet<const UFabrikJoint*> Joints;
+	for (UFabrikChain* Chain : Structure->Chains)
+	{
+		for (int Loop = 0; Chain != nullptr && Loop < Chain->NumBones; ++Loop)
+		{
+			Joints.Add(Chain->GetBone(Loop)->Joint);
+		}
+	}
+
+	for (auto It = JointGlyphs.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid() || !Joints.Contains(It.Key().Get()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+const UFabrikDebugComponent::FGlyph& UFabrikDebugComponent::GetUnitCircle()
+{
+	if (UnitCircleLines != NUM_CONE_LINES)
+	{
+		UnitCircle.Lines.Reset();
+		UnitCircleLines = NUM_CONE_LINES;
+
+		// The reference swept about the axis, closed back on itself
+		if (NUM_CONE_LINES >= 2)
+		{
+			FVector firstPoint(0.0f, 1.0f, 0.0f);
+			FVector prevPoint = firstPoint;
+			for (int vertexNumLoop = 1; vertexNumLoop < NUM_CONE_LINES; vertexNumLoop++)
+			{
+				float sinAngle, cosAngle;
+				FMath::SinCos(&sinAngle, &cosAngle, FMath::DegreesToRadians(vertexNumLoop * (360.0f / (float)NUM_CONE_LINES)));
+				FVector point(0.0f, cosAngle, sinAngle);
+				UnitCircle.AddLine(prevPoint, point, GC_Shape);
+				prevPoint = point;
+			}
+			UnitCircle.AddLine(prevPoint, firstPoint, GC_Shape);
+		}
+	}
+	return UnitCircle;
+}
+
+void UFabrikDebugComponent::DrawGlyph(const FGlyph& Glyph, FVector Origin, FVector Axis, FVector Reference, float Scale, FColor ShapeColour, float LineWidth)
+{
+	// Keep the frame square even if the reference strays out of the plane of the axis
+	FVector ScaledAxis = Axis * Scale;
+	FVector ScaledReference = (Reference - Axis * FVector::DotProduct(Reference, Axis)).GetSafeNormal() * Scale;
+	FVector ScaledAcross = FVector::CrossProduct(Axis, ScaledReference);
+
+	const FColor Colours[4] = { ShapeColour, REFERENCE_AXIS_COLOUR, ANTICLOCKWISE_CONSTRAINT_COLOUR, CLOCKWISE_CONSTRAINT_COLOUR };
+	for (const FGlyph::FLine& Line : Glyph.Lines)
+	{
+		FVector Start = Origin + ScaledAxis * Line.Start.X + ScaledReference * Line.Start.Y + ScaledAcross * Line.Start.Z;
+		FVector End = Origin + ScaledAxis * Line.End.X + ScaledReference * Line.End.Y + ScaledAcross * Line.End.Z;
+		DrawLine(Start, End, Colours[Line.Colour], LineWidth);
+	}
+}
+
 void UFabrikDebugComponent::DrawLine(FVector Start, FVector End, FColor Color, float lineWidth)
 {
+	if (CurrentGeometry != nullptr)
+	{
+		CurrentGeometry->AddLine(Start, End, Color, 0.0f);
+		return;
+	}
+
 	DrawDebugLine(
 		GetWorld(),
 		Start,
@@ -221,48 +338,32 @@ void UFabrikDebugComponent::DrawLine(FVector Start, FVector End, FColor Color, f
 	);
 }
 
-void UFabrikDebugComponent::DrawCircle(FVector Location, FVector Axis, float Radius, FColor Color, float LineWidth)
+void UFabrikDebugComponent::DrawThickLine(FVector Start, FVector End, FColor Color, float Thickness)
 {
-	int NUM_VERTICES = NUM_CONE_LINES; //##
-
-	FVector firstPoint;
-	FVector prevPoint;
-	// Generate the circle data and put it into the FloatBuffer
-	for (int vertexNumLoop = 0; vertexNumLoop < NUM_VERTICES; vertexNumLoop++)
+	if (CurrentGeometry != nullptr)
 	{
-		// Create our circle in the plane perpendicular to the axis provided
-		float angleDegs = vertexNumLoop * (360.0f / (float)NUM_VERTICES);
-		FVector perpAxis = UFabrikUtil::VectorGenPerpendicularVectorQuick(Axis);
-		FVector point(Radius * perpAxis.X, Radius * perpAxis.Y, Radius * perpAxis.Z);
-
-		// Rotate each point about the axis given
-		point = UFabrikUtil::RotateAboutAxisDegs(point, angleDegs, Axis);
+		CurrentGeometry->AddLine(Start, End, Color, Thickness);
+		return;
+	}
 
-		// Translate to the given location
-		point = point + Location;
+	DrawDebugLine(GetWorld(), Start, End, Color, false, -1, 0, Thickness);
+}
 
-		if (vertexNumLoop == 0)
-		{
-			firstPoint = point;
-		}
-		else if (vertexNumLoop == NUM_VERTICES - 1)
-		{
-			// last point
-			DrawLine(prevPoint, point, Color, LineWidth);
-			DrawLine(point, firstPoint, Color, LineWidth);
-		}
-		else
-		{
-			DrawLine(prevPoint, point,  Color, LineWidth);
-		}
-		
-		prevPoint = point;
-		// Point x/y/z
-		//circleData[(vertexNumLoop * VERTEX_COMPONENTS)] = point.x;
-		//circleData[(vertexNumLoop * VERTEX_COMPONENTS) + 1] = point.y;
-		//circleData[(vertexNumLoop * VERTEX_COMPONENTS) + 2] = point.z;
+void UFabrikDebugComponent::DrawPoint(FVector Location, FColor Color)
+{
+	if (CurrentGeometry != nullptr)
+	{
+		CurrentGeometry->AddPoint(Location, Color, PointSize);
+		return;
 	}
 
+	DrawDebugPoint(GetWorld(), Location, PointSize, Color, false);
+}
+
+void UFabrikDebugComponent::DrawCircle(FVector Location, FVector Axis, float Radius, FColor Color, float LineWidth)
+{
+	// Create our circle in the plane perpendicular to the axis provided
+	DrawGlyph(GetUnitCircle(), Location, Axis, UFabrikUtil::VectorGenPerpendicularVectorQuick(Axis), Radius, Color, LineWidth);
 }
 
 
@@ -302,6 +403,105 @@ void UFabrikDebugComponent::DrawChainConstraints(UFabrikChain* Chain, float Line
 
 }
 
+void UFabrikDebugComponent::DrawBatched()
+{
+	SCOPE_CYCLE_COUNTER(STAT_FabrikDebugDrawBatched);
+
+	const int NumChains = Structure->Chains.Num();
+	ChainCaches.SetNum(NumChains);
+
+	TArray<FFabrikDebugChainGeometryPtr> Geometry;
+	Geometry.Reserve(NumChains);
+
+	for (int ChainLoop = 0; ChainLoop < NumChains; ++ChainLoop)
+	{
+		UFabrikChain* Chain = Structure->Chains[ChainLoop];
+		FChainCache& Cache = ChainCaches[ChainLoop];
+		if (Chain == nullptr)
+		{
+			continue;
+		}
+
+		// A chain drawn from exactly the same bones, joints and settings as last time draws exactly the same lines
+		MakeChainSignature(Chain, ScratchSignature);
+		if (!Cache.Geometry.IsValid() || Cache.Chain.Get() != Chain || Cache.Signature != ScratchSignature)
+		{
+			TSharedPtr<FFabrikDebugChainGeometry, ESPMode::ThreadSafe> NewGeometry = MakeShared<FFabrikDebugChainGeometry, ESPMode::ThreadSafe>();
+			CurrentGeometry = NewGeometry.Get();
+			DrawChainBones(Chain);
+			DrawChainConstraints(Chain, 1);
+			CurrentGeometry = nullptr;
+
+			Cache.Chain = Chain;
+			Cache.Geometry = NewGeometry;
+			Swap(Cache.Signature, ScratchSignature);
+			INC_DWORD_STAT(STAT_FabrikDebugChainsRebuilt);
+		}
+		Geometry.Add(Cache.Geometry);
+	}
+
+	DrawComponent->SetChains(Geometry);
+}
+
+void UFabrikDebugComponent::MakeChainSignature(UFabrikChain* Chain, TArray<float>& OutSignature) const
+{
+	OutSignature.Reset();
+
+	auto AddVector = [&OutSignature](const FVector& InVector)
+	{
+		OutSignature.Add(InVector.X);
+		OutSignature.Add(InVector.Y);
+		OutSignature.Add(InVector.Z);
+	};
+	auto AddColor = [&OutSignature](const FColor& InColor)
+	{
+		// Floats hold 24 bit integers exactly
+		OutSignature.Add((float)(InColor.R | (InColor.G << 8) | (InColor.B << 16)));
+		OutSignature.Add((float)InColor.A);
+	};
+
+	// ---------- Settings -----------
+
+	OutSignature.Add(PointSize);
+	OutSignature.Add(LineThickness);
+	OutSignature.Add(CONE_LENGTH_FACTOR);
+	OutSignature.Add(RADIUS_FACTOR);
+	OutSignature.Add((float)NUM_CONE_LINES);
+	OutSignature.Add(rotStep);
+	AddColor(ANTICLOCKWISE_CONSTRAINT_COLOUR);
+	AddColor(CLOCKWISE_CONSTRAINT_COLOUR);
+	AddColor(BALL_JOINT_COLOUR);
+	AddColor(GLOBAL_HINGE_COLOUR);
+	AddColor(LOCAL_HINGE_COLOUR);
+	AddColor(REFERENCE_AXIS_COLOUR);
+
+	// ---------- Basebone constraint -----------
+
+	OutSignature.Add((float)Chain->NumBones);
+	OutSignature.Add((float)(uint8)Chain->BaseboneConstraintType);
+	AddVector(Chain->BaseboneConstraintUV);
+	AddVector(Chain->BaseboneRelativeConstraintUV);
+
+	// ---------- Bones and joints -----------
+
+	for (int i = 0; i < Chain->NumBones; i++)
+	{
+		UFabrikBone* Bone = Chain->GetBone(i);
+		AddVector(Bone->StartLocation);
+		AddVector(Bone->EndLocation);
+		AddColor(Bone->Color);
+		OutSignature.Add(Bone->Length);
+
+		UFabrikJoint* Joint = Bone->Joint;
+		OutSignature.Add((float)(uint8)Joint->JointType);
+		OutSignature.Add(Joint->RotorConstraintDegs);
+		OutSignature.Add(Joint->HingeClockwiseConstraintDegs);
+		OutSignature.Add(Joint->HingeAnticlockwiseConstraintDegs);
+		AddVector(Joint->RotationAxisUV);
+		AddVector(Joint->ReferenceAxisUV);
+	}
+}
+
 
 /**
 public void drawBone(FabrikBone3D bone, Mat4f viewMatrix, Mat4f projectionMatrix, Colour4f colour)
@@ -0,0 +1,194 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FabrikDebugDrawComponent.h"
+
+#include "PrimitiveSceneProxy.h"
+#include "SceneManagement.h"
+#include "SceneView.h"
+#include "RenderingThread.h"
+
+#include "OpenMotion.h"
+
+DECLARE_CYCLE_STAT(TEXT("Fabrik Debug Draw GetDynamicMeshElements"), STAT_FabrikDebugDrawGetDynamicMeshElements, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Debug Draw Lines"), STAT_FabrikDebugDrawLines, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Debug Draw Chains Culled"), STAT_FabrikDebugDrawChainsCulled, STATGROUP_OpenMotion);
+
+void FFabrikDebugChainGeometry::AddLine(const FVector& InStart, const FVector& InEnd, const FColor& InColor, float InThickness)
+{
+	FFabrikDebugLine& Line = Lines.AddDefaulted_GetRef();
+	Line.Start = InStart;
+	Line.End = InEnd;
+	Line.Color = InColor;
+	Line.Thickness = InThickness;
+	Bounds += InStart;
+	Bounds += InEnd;
+}
+
+void FFabrikDebugChainGeometry::AddPoint(const FVector& InLocation, const FColor& InColor, float InSize)
+{
+	FFabrikDebugPoint& Point = Points.AddDefaulted_GetRef();
+	Point.Location = InLocation;
+	Point.Color = InColor;
+	Point.Size = InSize;
+	Bounds += InLocation;
+}
+
+
+class FFabrikDebugDrawSceneProxy final : public FPrimitiveSceneProxy
+{
+public:
+
+	SIZE_T GetTypeHash() const override
+	{
+		static size_t UniquePointer;
+		return reinterpret_cast<size_t>(&UniquePointer);
+	}
+
+	FFabrikDebugDrawSceneProxy(const UFabrikDebugDrawComponent* InComponent)
+		: FPrimitiveSceneProxy(InComponent)
+		, Chains(InComponent->Chains)
+	{
+		bWillEverBeLit = false;
+	}
+
+	void SetChains_RenderThread(TArray<FFabrikDebugChainGeometryPtr>&& InChains)
+	{
+		check(IsInRenderingThread());
+		Chains = MoveTemp(InChains);
+	}
+
+	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override
+	{
+		SCOPE_CYCLE_COUNTER(STAT_FabrikDebugDrawGetDynamicMeshElements);
+
+		for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+		{
+			if (!(VisibilityMap & (1 << ViewIndex)))
+			{
+				continue;
+			}
+
+			const FSceneView* View = Views[ViewIndex];
+			FPrimitiveDrawInterface* PDI = Collector.GetPDI(ViewIndex);
+
+			for (const FFabrikDebugChainGeometryPtr& Chain : Chains)
+			{
+				if (!Chain.IsValid() || !Chain->Bounds.IsValid)
+				{
+					continue;
+				}
+
+				if (!View->ViewFrustum.IntersectBox(Chain->Bounds.GetCenter(), Chain->Bounds.GetExtent()))
+				{
+					INC_DWORD_STAT(STAT_FabrikDebugDrawChainsCulled);
+					continue;
+				}
+
+				PDI->AddReserveLines(SDPG_World, Chain->Lines.Num());
+				for (const FFabrikDebugLine& Line : Chain->Lines)
+				{
+					PDI->DrawLine(Line.Start, Line.End, Line.Color, SDPG_World, Line.Thickness);
+				}
+				for (const FFabrikDebugPoint& Point : Chain->Points)
+				{
+					PDI->DrawPoint(Point.Location, Point.Color, Point.Size, SDPG_World);
+				}
+				INC_DWORD_STAT_BY(STAT_FabrikDebugDrawLines, Chain->Lines.Num());
+			}
+		}
+	}
+
+	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override
+	{
+		FPrimitiveViewRelevance Result;
+		Result.bDrawRelevance = IsShown(View);
+		Result.bDynamicRelevance = true;
+		Result.bShadowRelevance = false;
+		Result.bEditorPrimitiveRelevance = UseEditorCompositing(View);
+		return Result;
+	}
+
+	virtual uint32 GetMemoryFootprint() const override
+	{
+		return sizeof(*this) + GetAllocatedSize();
+	}
+
+	uint32 GetAllocatedSize() const
+	{
+		return FPrimitiveSceneProxy::GetAllocatedSize() + Chains.GetAllocatedSize();
+	}
+
+private:
+
+	TArray<FFabrikDebugChainGeometryPtr> Chains;
+};
+
+
+UFabrikDebugDrawComponent::UFabrikDebugDrawComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+	, ChainBounds(ForceInit)
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetGenerateOverlapEvents(false);
+	CastShadow = false;
+	bUseEditorCompositing = true;
+}
+
+void UFabrikDebugDrawComponent::SetChains(const TArray<FFabrikDebugChainGeometryPtr>& InChains)
+{
+	if (InChains == Chains)
+	{
+		return;
+	}
+	Chains = InChains;
+
+	FBox NewBounds(ForceInit);
+	for (const FFabrikDebugChainGeometryPtr& Chain : Chains)
+	{
+		if (Chain.IsValid() && Chain->Bounds.IsValid)
+		{
+			NewBounds += Chain->Bounds;
+		}
+	}
+
+	// The bounds go over with the transform, and only need sending when they've grown or shrunk
+	if (!(NewBounds == ChainBounds))
+	{
+		ChainBounds = NewBounds;
+		UpdateBounds();
+		MarkRenderTransformDirty();
+	}
+	MarkRenderDynamicDataDirty();
+}
+
+FPrimitiveSceneProxy* UFabrikDebugDrawComponent::CreateSceneProxy()
+{
+	return new FFabrikDebugDrawSceneProxy(this);
+}
+
+FBoxSphereBounds UFabrikDebugDrawComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	// The geometry is in world space already, whatever the component's transform
+	if (!ChainBounds.IsValid)
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+	}
+	return FBoxSphereBounds(ChainBounds);
+}
+
+void UFabrikDebugDrawComponent::SendRenderDynamicData_Concurrent()
+{
+	Super::SendRenderDynamicData_Concurrent();
+
+	if (SceneProxy)
+	{
+		FFabrikDebugDrawSceneProxy* Proxy = static_cast<FFabrikDebugDrawSceneProxy*>(SceneProxy);
+		TArray<FFabrikDebugChainGeometryPtr> NewChains = Chains;
+		ENQUEUE_RENDER_COMMAND(FabrikDebugDrawSetChains)(
+			[Proxy, NewChains](FRHICommandListImmediate& RHICmdList) mutable
+			{
+				Proxy->SetChains_RenderThread(MoveTemp(NewChains));
+			});
+	}
+}
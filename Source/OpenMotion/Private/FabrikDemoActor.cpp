@@ -7,12 +7,21 @@
 #include "FabrikChain.h"
 #include "FabrikBone.h"
 #include "FabrikUtil.h"
+#include "FabrikMat3f.h"
+#include "FabrikChainBatch.h"
+#include "FabrikChainSolver.h"
 #include "FabrikDebugComponent.h"
+#include "FabrikRigAsset.h"
+#include "FabrikIKSubsystem.h"
 
 #include "DrawDebugHelpers.h"
+#include "UObject/UObjectArray.h"
+#include "Async/TaskGraphInterfaces.h"
 
 #include "OpenMotion.h"
 
+DECLARE_CYCLE_STAT(TEXT("Fabrik Demo Actor Tick"), STAT_FabrikDemoActorTick, STATGROUP_OpenMotion);
+
 // Sets default values
 AFabrikDemoActor::AFabrikDemoActor()
 {
@@ -34,6 +43,17 @@ AFabrikDemoActor::AFabrikDemoActor()
 	LineThickness = 2.0f;
 
 	DemoType = EFabrikDemoType::FD_UnconstrainedBones;
+
+	BenchmarkNumSolves = 1000;
+	BenchmarkNumInstances = 256;
+	BenchmarkNumFrames = 60;
+	BenchmarkSolveBudgetMicroseconds = 20.0f;
+	BenchmarkNumFingers = 32;
+	UseIKSubsystem = true;
+
+	BenchmarkLODLevels.Add(FFabrikLODLevel(1000.0f, 0, 1.0f, 1));
+	BenchmarkLODLevels.Add(FFabrikLODLevel(3000.0f, 4, 2.0f, 2));
+	BenchmarkLODLevels.Add(FFabrikLODLevel(FLT_MAX, 2, 4.0f, 4));
 }
 
 // Called when the game starts or when spawned
@@ -43,7 +63,54 @@ void AFabrikDemoActor::BeginPlay()
 
 	FabrikDebugComponent = FindComponentByClass<UFabrikDebugComponent>();
 	
-	switch (DemoType)
+	BuildDemo(DemoType);
+
+	if (FabrikDebugComponent != NULL)
+	{
+		FabrikDebugComponent->Structure = this->Structure;
+	}
+
+	// The subsystem solves every registered structure in one job, so this actor has nothing left to tick for
+	if (UseIKSubsystem && TargetActor)
+	{
+		UFabrikIKSubsystem* IKSubsystem = GetWorld()->GetSubsystem<UFabrikIKSubsystem>();
+		IKSubsystem->RegisterStructure(Structure, TargetActor);
+		if (FabrikDebugComponent != NULL)
+		{
+			IKSubsystem->AddPoseConsumer(FabrikDebugComponent->PrimaryComponentTick);
+		}
+		SetActorTickEnabled(false);
+	}
+}
+
+void AFabrikDemoActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFabrikIKSubsystem* IKSubsystem = GetWorld()->GetSubsystem<UFabrikIKSubsystem>())
+	{
+		IKSubsystem->UnregisterStructure(Structure);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void AFabrikDemoActor::Tick( float DeltaTime )
+{
+	Super::Tick( DeltaTime );
+
+	SCOPE_CYCLE_COUNTER(STAT_FabrikDemoActorTick);
+
+	Structure->SolveForTarget(TargetActor->GetActorLocation());
+
+	/*for (UFabrikChain* Chain : Structure->Chains)
+	{
+		DrawChain(Chain);
+	}*/
+}
+
+void AFabrikDemoActor::BuildDemo(EFabrikDemoType InDemoType)
+{
+	switch (InDemoType)
 	{
 	case EFabrikDemoType::FD_UnconstrainedBones: DemoUnconstrainedBones();break;
 	case EFabrikDemoType::FD_RotorBallJointConstrainedBones: DemoRotorBallJointConstrainedBones(); break;
@@ -58,25 +125,918 @@ void AFabrikDemoActor::BeginPlay()
 	case EFabrikDemoType::FD_ConnectedChainsWithFreelyRotatingGlobalHingedBaseboneConstraints: DemoConnectedChainsWithFreelyRotatingGlobalHingedBaseboneConstraints(); break;
 	case EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets: DemoConnectedChainsWithEmbeddedTargets(); break;
 	}
+}
 
-	if (FabrikDebugComponent != NULL)
+void AFabrikDemoActor::RunSolverBenchmark()
+{
+	// Keep the live demo intact - every benchmark run builds its own copy of the rig
+	UFabrikStructure* LiveStructure = Structure;
+
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = 0; DemoLoop <= (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
 	{
-		FabrikDebugComponent->Structure = this->Structure;
+		EFabrikDemoType BenchmarkDemoType = (EFabrikDemoType)DemoLoop;
+
+		int BoneObjects = 0;
+		int ChainDataObjects = 0;
+		int InPlaceObjects = 0;
+		double BoneSeconds = TimeDemoSolves(BenchmarkDemoType, false, false, BoneObjects);
+		double ChainDataSeconds = TimeDemoSolves(BenchmarkDemoType, true, false, ChainDataObjects);
+		double InPlaceSeconds = TimeDemoSolves(BenchmarkDemoType, true, true, InPlaceObjects);
+
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: bones %.2f us/solve (%.1f UObjects/solve), chain data %.2f us/solve (%.1f UObjects/solve), in place %.2f us/solve (%.1f UObjects/solve)"),
+			*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(),
+			BoneSeconds * 1000000.0 / BenchmarkNumSolves, (float)BoneObjects / BenchmarkNumSolves,
+			ChainDataSeconds * 1000000.0 / BenchmarkNumSolves, (float)ChainDataObjects / BenchmarkNumSolves,
+			InPlaceSeconds * 1000000.0 / BenchmarkNumSolves, (float)InPlaceObjects / BenchmarkNumSolves);
+
+		// Solving through FFabrikChainData with in-place best solution tracking should never touch the object array
+		if (InPlaceObjects != 0)
+		{
+			UE_LOG(OpenMotionLog, Warning, TEXT("%s: %d UObjects were created while solving in place."),
+				*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(), InPlaceObjects);
+		}
 	}
 
+	Structure = LiveStructure;
 }
 
-// Called every frame
-void AFabrikDemoActor::Tick( float DeltaTime )
+void AFabrikDemoActor::RunMatrixBenchmark()
 {
-	Super::Tick( DeltaTime );
+	const int NumDirections = 64;
+	TArray<FVector> Directions;
+	TArray<FVector> Results;
+	Directions.SetNum(NumDirections);
+	Results.SetNum(NumDirections);
+	for (int DirectionLoop = 0; DirectionLoop < NumDirections; ++DirectionLoop)
+	{
+		Directions[DirectionLoop] = GetBenchmarkTarget(DirectionLoop).GetSafeNormal();
+	}
 
-	Structure->SolveForTarget(TargetActor->GetActorLocation());
+	// Accumulate the results so the optimiser can't throw the work away
+	FVector ObjectSum = FVector::ZeroVector;
+	int StartObjects = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	double StartSeconds = FPlatformTime::Seconds();
+	for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+	{
+		for (int DirectionLoop = 0; DirectionLoop < NumDirections; ++DirectionLoop)
+		{
+			UFabrikMat3f* M = UFabrikMat3f::CreateRotationMatrix(Directions[DirectionLoop]);
+			ObjectSum += M->Times(Directions[(DirectionLoop + 1) % NumDirections]);
+		}
+	}
+	double ObjectSeconds = FPlatformTime::Seconds() - StartSeconds;
+	int ObjectsCreated = GUObjectArray.GetObjectArrayNumMinusAvailable() - StartObjects;
 
-	/*for (UFabrikChain* Chain : Structure->Chains)
+	FVector ValueSum = FVector::ZeroVector;
+	StartObjects = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	StartSeconds = FPlatformTime::Seconds();
+	for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
 	{
-		DrawChain(Chain);
-	}*/
+		for (int DirectionLoop = 0; DirectionLoop < NumDirections; ++DirectionLoop)
+		{
+			FFabrikMat3f M = FFabrikMat3f::CreateRotationMatrix(Directions[DirectionLoop]);
+			ValueSum += M.Times(Directions[(DirectionLoop + 1) % NumDirections]);
+		}
+	}
+	double ValueSeconds = FPlatformTime::Seconds() - StartSeconds;
+	int ValuesCreated = GUObjectArray.GetObjectArrayNumMinusAvailable() - StartObjects;
+
+	// One matrix applied to the whole array at once
+	StartSeconds = FPlatformTime::Seconds();
+	for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+	{
+		FFabrikMat3f M = FFabrikMat3f::CreateRotationMatrix(Directions[SolveLoop % NumDirections]);
+		M.Times(Directions.GetData(), Results.GetData(), NumDirections);
+	}
+	double BatchSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	double NumMatrices = (double)BenchmarkNumSolves * NumDirections;
+	UE_LOG(OpenMotionLog, Log, TEXT("UFabrikMat3f %.1f ns/matrix (%d UObjects), FFabrikMat3f %.1f ns/matrix (%d UObjects, %.2fx), batch Times %.1f ns/vector, max result difference %f"),
+		ObjectSeconds * 1000000000.0 / NumMatrices, ObjectsCreated,
+		ValueSeconds * 1000000000.0 / NumMatrices, ValuesCreated, ObjectSeconds / FMath::Max(ValueSeconds, (double)SMALL_NUMBER),
+		BatchSeconds * 1000000000.0 / NumMatrices,
+		(ObjectSum - ValueSum).GetAbsMax());
+}
+
+// The degree based hinge clamp the FABRIK passes used before FFabrikAngleLimit
+static FVector LimitToHingeDegs(const FVector& InV, const FVector& InReferenceAxis, const FVector& InRotationAxis, float InCwConstraintDegs, float InAcwConstraintDegs)
+{
+	const float SignedAngleDegs = UFabrikUtil::GetSignedAngleBetweenDegs(InReferenceAxis, InV, InRotationAxis);
+	if (SignedAngleDegs > InAcwConstraintDegs)
+	{
+		return UFabrikUtil::RotateAboutAxisDegs(InReferenceAxis, InAcwConstraintDegs, InRotationAxis).GetSafeNormal();
+	}
+	else if (SignedAngleDegs < -InCwConstraintDegs)
+	{
+		return UFabrikUtil::RotateAboutAxisDegs(InReferenceAxis, -InCwConstraintDegs, InRotationAxis).GetSafeNormal();
+	}
+	return InV;
+}
+
+void AFabrikDemoActor::RunConstraintKernelBenchmark()
+{
+	const int NumCases = 1024;
+	FRandomStream Random(1234);
+
+	// Rotor cases: a direction, a baseline and a limit. Hinge cases: a rotation axis, a reference axis in its plane and a
+	// direction in its plane, with separate clockwise and anticlockwise limits.
+	TArray<FVector> Directions;
+	TArray<FVector> Baselines;
+	TArray<FVector> RotationAxes;
+	TArray<FVector> HingeDirections;
+	TArray<float> LimitDegs;
+	TArray<float> OtherLimitDegs;
+	TArray<FFabrikAngleLimit> Limits;
+	TArray<FFabrikAngleLimit> OtherLimits;
+	for (int CaseLoop = 0; CaseLoop < NumCases; ++CaseLoop)
+	{
+		Directions.Add(Random.GetUnitVector());
+		Baselines.Add(Random.GetUnitVector());
+		const FVector Axis = Random.GetUnitVector();
+		RotationAxes.Add(Axis);
+		Baselines[CaseLoop] = UFabrikUtil::ProjectOntoPlane(Baselines[CaseLoop], Axis);
+		HingeDirections.Add(UFabrikUtil::ProjectOntoPlane(Directions[CaseLoop], Axis));
+		LimitDegs.Add(Random.FRandRange(0.0f, 179.0f));
+		OtherLimitDegs.Add(Random.FRandRange(0.0f, 179.0f));
+		Limits.Add(FFabrikAngleLimit::FromDegs(LimitDegs[CaseLoop]));
+		OtherLimits.Add(FFabrikAngleLimit::FromDegs(OtherLimitDegs[CaseLoop]));
+	}
+
+	// ---------- Precision ----------
+
+	float MaxRotorDifference = 0.0f;
+	float MaxHingeDifference = 0.0f;
+	for (int CaseLoop = 0; CaseLoop < NumCases; ++CaseLoop)
+	{
+		const FVector RotorDegs = UFabrikUtil::GetAngleLimitedUnitVectorDegs(Directions[CaseLoop], Baselines[CaseLoop], LimitDegs[CaseLoop]);
+		const FVector RotorCos = UFabrikUtil::GetAngleLimitedUnitVector(Directions[CaseLoop], Baselines[CaseLoop], Limits[CaseLoop]);
+		MaxRotorDifference = FMath::Max(MaxRotorDifference, FVector::Dist(RotorDegs, RotorCos));
+
+		const FVector HingeDegs = LimitToHingeDegs(HingeDirections[CaseLoop], Baselines[CaseLoop], RotationAxes[CaseLoop], OtherLimitDegs[CaseLoop], LimitDegs[CaseLoop]);
+		const FVector HingeCos = UFabrikUtil::GetHingeLimitedUnitVector(HingeDirections[CaseLoop], Baselines[CaseLoop], RotationAxes[CaseLoop], OtherLimits[CaseLoop], Limits[CaseLoop]);
+		MaxHingeDifference = FMath::Max(MaxHingeDifference, FVector::Dist(HingeDegs, HingeCos));
+	}
+
+	// The lane-wise rotor clamp against the scalar one, on the random cases and on directions pointing straight back
+	// along their baseline, where there is no side to turn towards and both must pick the same one
+	float MaxBatchRotorDifference = 0.0f;
+	float MaxAntiparallelDifference = 0.0f;
+	for (int CaseLoop = 0; CaseLoop < NumCases; ++CaseLoop)
+	{
+		const FVector Scalar = UFabrikUtil::GetAngleLimitedUnitVector(Directions[CaseLoop], Baselines[CaseLoop], Limits[CaseLoop]);
+		const FVector Lanes = FFabrikChainBatch::LimitToRotor(Directions[CaseLoop], Baselines[CaseLoop], Limits[CaseLoop]);
+		MaxBatchRotorDifference = FMath::Max(MaxBatchRotorDifference, FVector::Dist(Scalar, Lanes));
+
+		const FVector Back = -Baselines[CaseLoop];
+		const FVector ScalarBack = UFabrikUtil::GetAngleLimitedUnitVector(Back, Baselines[CaseLoop], Limits[CaseLoop]);
+		const FVector LanesBack = FFabrikChainBatch::LimitToRotor(Back, Baselines[CaseLoop], Limits[CaseLoop]);
+		MaxAntiparallelDifference = FMath::Max(MaxAntiparallelDifference, FVector::Dist(ScalarBack, LanesBack));
+	}
+	// 90 degrees is where a missing perpendicular used to leave nothing at all
+	const FFabrikAngleLimit RightAngle = FFabrikAngleLimit::FromDegs(90.0f);
+	const FVector RightAngleBack = FFabrikChainBatch::LimitToRotor(-UFabrikUtil::Y_AXIS, UFabrikUtil::Y_AXIS, RightAngle);
+	MaxAntiparallelDifference = FMath::Max(MaxAntiparallelDifference,
+		FVector::Dist(RightAngleBack, UFabrikUtil::GetAngleLimitedUnitVector(-UFabrikUtil::Y_AXIS, UFabrikUtil::Y_AXIS, RightAngle)));
+	UE_LOG(OpenMotionLog, Log, TEXT("Rotor clamp lanes against scalar: max difference %f, antiparallel max difference %f, 90 degree antiparallel length %f"),
+		MaxBatchRotorDifference, MaxAntiparallelDifference, RightAngleBack.Size());
+
+	// ---------- Throughput ----------
+
+	// Accumulate the results so the optimiser can't throw the work away
+	double Seconds[4];
+	FVector Sums[4] = { FVector::ZeroVector, FVector::ZeroVector, FVector::ZeroVector, FVector::ZeroVector };
+	for (int KernelLoop = 0; KernelLoop < 4; ++KernelLoop)
+	{
+		double StartSeconds = FPlatformTime::Seconds();
+		for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+		{
+			for (int CaseLoop = 0; CaseLoop < NumCases; ++CaseLoop)
+			{
+				switch (KernelLoop)
+				{
+				case 0: Sums[0] += UFabrikUtil::GetAngleLimitedUnitVectorDegs(Directions[CaseLoop], Baselines[CaseLoop], LimitDegs[CaseLoop]); break;
+				case 1: Sums[1] += UFabrikUtil::GetAngleLimitedUnitVector(Directions[CaseLoop], Baselines[CaseLoop], Limits[CaseLoop]); break;
+				case 2: Sums[2] += LimitToHingeDegs(HingeDirections[CaseLoop], Baselines[CaseLoop], RotationAxes[CaseLoop], OtherLimitDegs[CaseLoop], LimitDegs[CaseLoop]); break;
+				default: Sums[3] += UFabrikUtil::GetHingeLimitedUnitVector(HingeDirections[CaseLoop], Baselines[CaseLoop], RotationAxes[CaseLoop], OtherLimits[CaseLoop], Limits[CaseLoop]); break;
+				}
+			}
+		}
+		Seconds[KernelLoop] = FPlatformTime::Seconds() - StartSeconds;
+	}
+
+	double NumClamps = (double)BenchmarkNumSolves * NumCases;
+	UE_LOG(OpenMotionLog, Log, TEXT("Rotor clamp: degrees %.1f ns, cosine %.1f ns (%.2fx), max difference %f"),
+		Seconds[0] * 1000000000.0 / NumClamps, Seconds[1] * 1000000000.0 / NumClamps,
+		Seconds[0] / FMath::Max(Seconds[1], (double)SMALL_NUMBER), MaxRotorDifference);
+	UE_LOG(OpenMotionLog, Log, TEXT("Hinge clamp: degrees %.1f ns, cosine %.1f ns (%.2fx), max difference %f (sum check %f)"),
+		Seconds[2] * 1000000000.0 / NumClamps, Seconds[3] * 1000000000.0 / NumClamps,
+		Seconds[2] / FMath::Max(Seconds[3], (double)SMALL_NUMBER), MaxHingeDifference,
+		(Sums[0] - Sums[1] + Sums[2] - Sums[3]).GetAbsMax());
+}
+
+void AFabrikDemoActor::RunBatchBenchmark()
+{
+	UFabrikStructure* LiveStructure = Structure;
+
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = 0; DemoLoop <= (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
+	{
+		BuildDemo((EFabrikDemoType)DemoLoop);
+
+		FFabrikChainData Rig;
+		Structure->Chains[0]->FillChainData(Rig);
+
+		FFabrikChainBatch Batches[2];
+		double Seconds[2];
+		int NumPasses[2];
+		for (int BatchLoop = 0; BatchLoop < 2; ++BatchLoop)
+		{
+			FFabrikChainBatch& Batch = Batches[BatchLoop];
+			Batch.Init(Rig, BenchmarkNumInstances, BatchLoop == 0);
+			NumPasses[BatchLoop] = 0;
+
+			double StartSeconds = FPlatformTime::Seconds();
+			for (int FrameLoop = 0; FrameLoop < BenchmarkNumFrames; ++FrameLoop)
+			{
+				for (int InstanceLoop = 0; InstanceLoop < BenchmarkNumInstances; ++InstanceLoop)
+				{
+					Batch.SetTarget(InstanceLoop, GetBenchmarkTarget(FrameLoop + InstanceLoop * 7));
+				}
+				Batch.SolveForTargets();
+				NumPasses[BatchLoop] += Batch.LastNumPasses;
+			}
+			Seconds[BatchLoop] = FPlatformTime::Seconds() - StartSeconds;
+		}
+
+		// Both paths follow the same solving rules, so they should only differ by float rounding
+		float MaxEffectorDifference = 0.0f;
+		for (int InstanceLoop = 0; InstanceLoop < BenchmarkNumInstances; ++InstanceLoop)
+		{
+			MaxEffectorDifference = FMath::Max(MaxEffectorDifference,
+				FVector::Dist(Batches[0].GetEffectorLocation(InstanceLoop), Batches[1].GetEffectorLocation(InstanceLoop)));
+		}
+
+		double NumSolves = (double)BenchmarkNumFrames * BenchmarkNumInstances;
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: %s %.2f us/chain (%d passes), one at a time %.2f us/chain (%d passes), %.2fx, max effector difference %f"),
+			*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(),
+			Batches[0].IsLockstep() ? TEXT("lockstep") : TEXT("fallback"),
+			Seconds[0] * 1000000.0 / NumSolves, NumPasses[0],
+			Seconds[1] * 1000000.0 / NumSolves, NumPasses[1],
+			Seconds[1] / FMath::Max(Seconds[0], (double)SMALL_NUMBER),
+			MaxEffectorDifference);
+	}
+
+	Structure = LiveStructure;
+}
+
+void AFabrikDemoActor::RunSpecializedSolverBenchmark()
+{
+	for (int RigLoop = 0; RigLoop < 2; ++RigLoop)
+	{
+		const bool bFinger = (RigLoop == 1);
+
+		// A four bone ball jointed arm, or a finger of two local hinges off a ball jointed knuckle
+		UFabrikChain* Chain = NewObject<UFabrikChain>();
+		UFabrikBone* Basebone = NewObject<UFabrikBone>();
+		Basebone->Init(FVector::ZeroVector, DefaultBoneDirection * DefaultBoneLength);
+		Chain->AddBone(Basebone);
+		for (int BoneLoop = 0; BoneLoop < (bFinger ? 2 : 3); ++BoneLoop)
+		{
+			if (bFinger)
+			{
+				Chain->AddConsecutiveHingedBone(DefaultBoneDirection, DefaultBoneLength, EJointType::JT_LocalHinge, UFabrikUtil::X_AXIS, 90.0f, 90.0f, UFabrikUtil::Y_AXIS);
+			}
+			else
+			{
+				Chain->AddConsecutiveRotorConstrainedBone(DefaultBoneDirection, DefaultBoneLength, 90.0f);
+			}
+		}
+
+		FFabrikChainData Specialized;
+		Chain->FillChainData(Specialized);
+		FFabrikChainData Generic = Specialized;
+		Generic.SpecializedSolveIK = nullptr;
+
+		double Seconds[2];
+		FFabrikChainData* Rigs[2] = { &Specialized, &Generic };
+		for (int PassLoop = 0; PassLoop < 2; ++PassLoop)
+		{
+			double StartSeconds = FPlatformTime::Seconds();
+			for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+			{
+				Rigs[PassLoop]->SolveIK(GetBenchmarkTarget(SolveLoop) * 0.5f);
+			}
+			Seconds[PassLoop] = FPlatformTime::Seconds() - StartSeconds;
+		}
+
+		// Both run the same steps, so they should finish in exactly the same pose
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: %s %.3f us/pass, generic %.3f us/pass (%.2fx), effector difference %f"),
+			bFinger ? TEXT("Local hinge finger") : TEXT("Ball arm"),
+			Specialized.SpecializedSolveIK ? TEXT("specialized") : TEXT("unregistered"),
+			Seconds[0] * 1000000.0 / BenchmarkNumSolves,
+			Seconds[1] * 1000000.0 / BenchmarkNumSolves,
+			Seconds[1] / FMath::Max(Seconds[0], (double)SMALL_NUMBER),
+			FVector::Dist(Specialized.GetEffectorLocation(), Generic.GetEffectorLocation()));
+	}
+}
+
+void AFabrikDemoActor::RunTemporalCoherenceBenchmark()
+{
+	UFabrikStructure* LiveStructure = Structure;
+
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = (int)EFabrikDemoType::FD_ConnectedChains; DemoLoop <= (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
+	{
+		TArray<int> Iterations[2];
+		TArray<int> EarlyOuts[2];
+		TArray<int> SinglePasses[2];
+		TArray<float> SolveDistances[2];
+		for (int ModeLoop = 0; ModeLoop < 2; ++ModeLoop)
+		{
+			BuildDemo((EFabrikDemoType)DemoLoop);
+			for (UFabrikChain* Chain : Structure->Chains)
+			{
+				Chain->UseTemporalCoherence = (ModeLoop == 1);
+				Chain->ResetTelemetry();
+			}
+
+			SolveDistances[ModeLoop].Init(0.0f, Structure->Chains.Num());
+			for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+			{
+				Structure->SolveForTarget(GetBenchmarkTarget(SolveLoop));
+				for (int ChainLoop = 0; ChainLoop < Structure->Chains.Num(); ++ChainLoop)
+				{
+					SolveDistances[ModeLoop][ChainLoop] += Structure->Chains[ChainLoop]->CurrentSolveDistance;
+				}
+			}
+
+			for (UFabrikChain* Chain : Structure->Chains)
+			{
+				Iterations[ModeLoop].Add(Chain->TotalSolveIterations);
+				EarlyOuts[ModeLoop].Add(Chain->NumTemporalEarlyOuts);
+				SinglePasses[ModeLoop].Add(Chain->NumTemporalSinglePassSolves);
+			}
+		}
+
+		for (int ChainLoop = 0; ChainLoop < Iterations[0].Num(); ++ChainLoop)
+		{
+			UE_LOG(OpenMotionLog, Log, TEXT("%s chain %d: %d iterations cold, %d warm, %d saved (%.1f%%), %d early outs, %d single passes, mean solve distance %.3f cold, %.3f warm"),
+				*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(), ChainLoop,
+				Iterations[0][ChainLoop], Iterations[1][ChainLoop], Iterations[0][ChainLoop] - Iterations[1][ChainLoop],
+				100.0f * (Iterations[0][ChainLoop] - Iterations[1][ChainLoop]) / FMath::Max(Iterations[0][ChainLoop], 1),
+				EarlyOuts[1][ChainLoop], SinglePasses[1][ChainLoop],
+				SolveDistances[0][ChainLoop] / BenchmarkNumSolves, SolveDistances[1][ChainLoop] / BenchmarkNumSolves);
+		}
+	}
+
+	Structure = LiveStructure;
+}
+
+void AFabrikDemoActor::RunClosedFormBenchmark()
+{
+	for (int RigLoop = 0; RigLoop < 2; ++RigLoop)
+	{
+		const bool bTwoBone = (RigLoop == 1);
+		const int NumBones = bTwoBone ? 2 : 4;
+
+		// Free ball joints, so the closed form pose is always within the constraints
+		UFabrikChain* Chain = NewObject<UFabrikChain>();
+		UFabrikBone* Basebone = NewObject<UFabrikBone>();
+		Basebone->Init(FVector::ZeroVector, DefaultBoneDirection * DefaultBoneLength);
+		Chain->AddBone(Basebone);
+		for (int BoneLoop = 1; BoneLoop < NumBones; ++BoneLoop)
+		{
+			Chain->AddConsecutiveBone(DefaultBoneDirection, DefaultBoneLength);
+		}
+
+		// Out of reach targets for the long chain, and targets well inside the reach of the limb
+		const float TargetDistance = Chain->ChainLength * (bTwoBone ? 0.6f : 1.5f);
+
+		double Seconds[2];
+		float SolveDistances[2];
+		int Iterations[2];
+		int ClosedFormSolves[2];
+		for (int ModeLoop = 0; ModeLoop < 2; ++ModeLoop)
+		{
+			Chain->UseClosedFormSolvers = (ModeLoop == 1);
+			Chain->ResetTelemetry();
+			SolveDistances[ModeLoop] = 0.0f;
+
+			double StartSeconds = FPlatformTime::Seconds();
+			for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+			{
+				SolveDistances[ModeLoop] += Chain->SolveForTarget(GetBenchmarkTarget(SolveLoop).GetSafeNormal() * TargetDistance);
+			}
+			Seconds[ModeLoop] = FPlatformTime::Seconds() - StartSeconds;
+			Iterations[ModeLoop] = Chain->TotalSolveIterations;
+			ClosedFormSolves[ModeLoop] = Chain->NumClosedFormSolves;
+		}
+
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: iterative %.3f us/solve, %d iterations, mean solve distance %.4f; closed form %.3f us/solve (%.2fx), %d iterations, %d closed form solves, mean solve distance %.4f"),
+			bTwoBone ? TEXT("Two bone limb in reach") : TEXT("Four bone chain out of reach"),
+			Seconds[0] * 1000000.0 / BenchmarkNumSolves, Iterations[0], SolveDistances[0] / BenchmarkNumSolves,
+			Seconds[1] * 1000000.0 / BenchmarkNumSolves, Seconds[0] / FMath::Max(Seconds[1], (double)SMALL_NUMBER),
+			Iterations[1], ClosedFormSolves[1], SolveDistances[1] / BenchmarkNumSolves);
+	}
+}
+
+void AFabrikDemoActor::RunSolveBudgetBenchmark()
+{
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = 0; DemoLoop <= (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
+	{
+		for (int ModeLoop = 0; ModeLoop < 2; ++ModeLoop)
+		{
+			BuildDemo((EFabrikDemoType)DemoLoop);
+			Structure->SolveBudgetMicroseconds = (ModeLoop == 1) ? BenchmarkSolveBudgetMicroseconds : 0.0f;
+			for (int ChainLoop = 0; ChainLoop < Structure->Chains.Num(); ++ChainLoop)
+			{
+				Structure->Chains[ChainLoop]->SolvePriority = (ChainLoop == 0) ? 2.0f : 1.0f;
+				Structure->Chains[ChainLoop]->ResetTelemetry();
+			}
+
+			float TotalMicroseconds = 0.0f;
+			float MaxMicroseconds = 0.0f;
+			float TotalSolveDistance = 0.0f;
+			for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+			{
+				Structure->SolveForTarget(GetBenchmarkTarget(SolveLoop));
+				TotalMicroseconds += Structure->LastSolveMicroseconds;
+				MaxMicroseconds = FMath::Max(MaxMicroseconds, Structure->LastSolveMicroseconds);
+				for (UFabrikChain* Chain : Structure->Chains)
+				{
+					TotalSolveDistance += Chain->CurrentSolveDistance;
+				}
+			}
+
+			FString CutShort;
+			for (int ChainLoop = 0; ChainLoop < Structure->Chains.Num(); ++ChainLoop)
+			{
+				CutShort += FString::Printf(TEXT("%s%d"), ChainLoop > 0 ? TEXT(", ") : TEXT(""), Structure->Chains[ChainLoop]->NumSolvesCutShort);
+			}
+
+			UE_LOG(OpenMotionLog, Log, TEXT("%s, %s: mean %.2f us/solve, max %.2f us, mean chain solve distance %.4f, solves cut short per chain [%s]"),
+				*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(),
+				(ModeLoop == 1) ? *FString::Printf(TEXT("%.1f us budget"), BenchmarkSolveBudgetMicroseconds) : TEXT("unbounded"),
+				TotalMicroseconds / BenchmarkNumSolves, MaxMicroseconds,
+				TotalSolveDistance / (BenchmarkNumSolves * FMath::Max(Structure->Chains.Num(), 1)),
+				*CutShort);
+		}
+	}
+}
+
+UFabrikStructure* AFabrikDemoActor::BuildBenchmarkHand()
+{
+	UFabrikStructure* Hand = NewObject<UFabrikStructure>();
+
+	UFabrikChain* Palm = NewObject<UFabrikChain>();
+	UFabrikBone* Basebone = NewObject<UFabrikBone>();
+	Basebone->Init(FVector::ZeroVector, DefaultBoneDirection * DefaultBoneLength);
+	Palm->AddBone(Basebone);
+	Palm->AddConsecutiveBone(DefaultBoneDirection, DefaultBoneLength);
+	Hand->AddChain(Palm);
+
+	// Fan the fingers out around the end of the palm so each one has its own work to do
+	for (int FingerLoop = 0; FingerLoop < BenchmarkNumFingers; ++FingerLoop)
+	{
+		const FVector FingerDirection = UFabrikUtil::RotateAboutAxisDegs(DefaultBoneDirection, 360.0f * FingerLoop / FMath::Max(BenchmarkNumFingers, 1), UFabrikUtil::VectorGenPerpendicularVectorQuick(DefaultBoneDirection));
+		UFabrikChain* Finger = NewObject<UFabrikChain>();
+		UFabrikBone* FingerBasebone = NewObject<UFabrikBone>();
+		FingerBasebone->Init(FVector::ZeroVector, FingerDirection * DefaultBoneLength * 0.5f);
+		Finger->AddBone(FingerBasebone);
+		for (int BoneLoop = 1; BoneLoop < 3; ++BoneLoop)
+		{
+			Finger->AddConsecutiveRotorConstrainedBone(FingerDirection, DefaultBoneLength * 0.5f, 60.0f);
+		}
+		Hand->ConnectChain(Finger, 0, 1);
+	}
+	return Hand;
+}
+
+void AFabrikDemoActor::RunParallelSolveBenchmark()
+{
+	UFabrikStructure* Serial = BuildBenchmarkHand();
+	double StartSeconds = FPlatformTime::Seconds();
+	for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+	{
+		Serial->SolveForTarget(GetBenchmarkTarget(SolveLoop));
+	}
+	const double SerialSeconds = FPlatformTime::Seconds() - StartSeconds;
+	UE_LOG(OpenMotionLog, Log, TEXT("Hand of %d fingers, serial: %.2f us/solve"), BenchmarkNumFingers, SerialSeconds * 1000000.0 / BenchmarkNumSolves);
+
+	const int MaxThreads = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	for (int ThreadLoop = 1; ThreadLoop <= MaxThreads; ++ThreadLoop)
+	{
+		UFabrikStructure* Parallel = BuildBenchmarkHand();
+		Parallel->UseParallelSolve = true;
+		Parallel->MaxSolveThreads = ThreadLoop;
+
+		StartSeconds = FPlatformTime::Seconds();
+		for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+		{
+			Parallel->SolveForTarget(GetBenchmarkTarget(SolveLoop));
+		}
+		const double ParallelSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+		// Every chain runs exactly the same steps as in the serial solve, so the poses should match exactly
+		float MaxDifference = 0.0f;
+		for (int ChainLoop = 0; ChainLoop < Serial->Chains.Num(); ++ChainLoop)
+		{
+			for (int BoneLoop = 0; BoneLoop < Serial->Chains[ChainLoop]->NumBones; ++BoneLoop)
+			{
+				MaxDifference = FMath::Max(MaxDifference, FVector::Dist(Serial->Chains[ChainLoop]->GetBone(BoneLoop)->EndLocation,
+					Parallel->Chains[ChainLoop]->GetBone(BoneLoop)->EndLocation));
+			}
+		}
+
+		UE_LOG(OpenMotionLog, Log, TEXT("Hand of %d fingers, %d threads: %.2f us/solve (%.2fx serial), max joint difference from serial %f"),
+			BenchmarkNumFingers, ThreadLoop, ParallelSeconds * 1000000.0 / BenchmarkNumSolves,
+			SerialSeconds / FMath::Max(ParallelSeconds, (double)SMALL_NUMBER), MaxDifference);
+	}
+}
+
+void AFabrikDemoActor::RunMultiTargetBenchmark()
+{
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = (int)EFabrikDemoType::FD_ConnectedChains; DemoLoop < (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
+	{
+		double Seconds[3];
+		TArray<FVector> Poses[3];
+		for (int ModeLoop = 0; ModeLoop < 3; ++ModeLoop)
+		{
+			BuildDemo((EFabrikDemoType)DemoLoop);
+			const int NumChainsL = Structure->Chains.Num();
+			if (ModeLoop == 0)
+			{
+				for (UFabrikChain* Chain : Structure->Chains)
+				{
+					Chain->UseEmbeddedTarget = (Chain->ConnectedChainNumber != -1);
+				}
+			}
+
+			TArray<FFabrikChainTarget> Targets;
+			TArray<FVector> TargetBuffer;
+			Targets.SetNum(NumChainsL);
+			TargetBuffer.SetNum(NumChainsL);
+
+			double StartSeconds = FPlatformTime::Seconds();
+			for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+			{
+				// Each chain follows the same path, out of step with the others
+				for (int ChainLoop = 0; ChainLoop < NumChainsL; ++ChainLoop)
+				{
+					TargetBuffer[ChainLoop] = GetBenchmarkTarget(SolveLoop + ChainLoop * 17);
+				}
+
+				if (ModeLoop == 0)
+				{
+					// Unconnected chains ignore their embedded target and take the shared one
+					for (int ChainLoop = 0; ChainLoop < NumChainsL; ++ChainLoop)
+					{
+						Structure->Chains[ChainLoop]->EmbeddedTarget = TargetBuffer[ChainLoop];
+					}
+					Structure->SolveForTarget(TargetBuffer[0]);
+				}
+				else if (ModeLoop == 1)
+				{
+					for (int ChainLoop = 0; ChainLoop < NumChainsL; ++ChainLoop)
+					{
+						Targets[ChainLoop] = FFabrikChainTarget(ChainLoop, TargetBuffer[ChainLoop]);
+					}
+					Structure->SolveForTargets(Targets);
+				}
+				else
+				{
+					Structure->SolveForTargetBuffer(TargetBuffer);
+				}
+			}
+			Seconds[ModeLoop] = FPlatformTime::Seconds() - StartSeconds;
+
+			for (UFabrikChain* Chain : Structure->Chains)
+			{
+				for (int BoneLoop = 0; BoneLoop < Chain->NumBones; ++BoneLoop)
+				{
+					Poses[ModeLoop].Add(Chain->GetBone(BoneLoop)->EndLocation);
+				}
+			}
+		}
+
+		float MaxDifference = 0.0f;
+		for (int JointLoop = 0; JointLoop < Poses[0].Num(); ++JointLoop)
+		{
+			MaxDifference = FMath::Max(MaxDifference, FVector::Dist(Poses[0][JointLoop], Poses[1][JointLoop]));
+			MaxDifference = FMath::Max(MaxDifference, FVector::Dist(Poses[0][JointLoop], Poses[2][JointLoop]));
+		}
+
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: embedded targets %.2f us/solve, target pairs %.2f us/solve, target buffer %.2f us/solve, max joint difference %f"),
+			*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(),
+			Seconds[0] * 1000000.0 / BenchmarkNumSolves, Seconds[1] * 1000000.0 / BenchmarkNumSolves, Seconds[2] * 1000000.0 / BenchmarkNumSolves,
+			MaxDifference);
+	}
+}
+
+void AFabrikDemoActor::RunDirtyPropagationBenchmark()
+{
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = (int)EFabrikDemoType::FD_ConnectedChains; DemoLoop <= (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
+	{
+		double Seconds[2];
+		TArray<FVector> Poses[2];
+		for (int ModeLoop = 0; ModeLoop < 2; ++ModeLoop)
+		{
+			BuildDemo((EFabrikDemoType)DemoLoop);
+			Structure->UseDirtyPropagation = (ModeLoop == 1);
+			Structure->ResetTelemetry();
+
+			double StartSeconds = FPlatformTime::Seconds();
+			for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+			{
+				Structure->SolveForTarget(GetBenchmarkTarget(SolveLoop / 10));
+			}
+			Seconds[ModeLoop] = FPlatformTime::Seconds() - StartSeconds;
+
+			for (UFabrikChain* Chain : Structure->Chains)
+			{
+				for (int BoneLoop = 0; BoneLoop < Chain->NumBones; ++BoneLoop)
+				{
+					Poses[ModeLoop].Add(Chain->GetBone(BoneLoop)->EndLocation);
+				}
+			}
+		}
+
+		float MaxDifference = 0.0f;
+		for (int JointLoop = 0; JointLoop < Poses[0].Num(); ++JointLoop)
+		{
+			MaxDifference = FMath::Max(MaxDifference, FVector::Dist(Poses[0][JointLoop], Poses[1][JointLoop]));
+		}
+
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: every chain %.2f us/solve, dirty propagation %.2f us/solve (%.2fx), %d of %d chain solves skipped, %d of %d structure solves skipped, max joint difference %f"),
+			*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(),
+			Seconds[0] * 1000000.0 / BenchmarkNumSolves, Seconds[1] * 1000000.0 / BenchmarkNumSolves,
+			Seconds[0] / FMath::Max(Seconds[1], (double)SMALL_NUMBER),
+			Structure->TotalChainsSkipped, BenchmarkNumSolves * Structure->Chains.Num(),
+			Structure->NumSolvesSkipped, BenchmarkNumSolves, MaxDifference);
+	}
+}
+
+void AFabrikDemoActor::RunMultiEffectorBenchmark()
+{
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = (int)EFabrikDemoType::FD_ConnectedChains; DemoLoop <= (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
+	{
+		double Seconds[2];
+		double BoneUpdates[2];
+		double SolveDistances[2];
+		int Iterations = 0;
+		for (int ModeLoop = 0; ModeLoop < 2; ++ModeLoop)
+		{
+			BuildDemo((EFabrikDemoType)DemoLoop);
+			Structure->UseMultiEffectorSolve = (ModeLoop == 1);
+			BoneUpdates[ModeLoop] = 0.0;
+			SolveDistances[ModeLoop] = 0.0;
+
+			double StartSeconds = FPlatformTime::Seconds();
+			for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+			{
+				Structure->SolveForTarget(GetBenchmarkTarget(SolveLoop));
+				BoneUpdates[ModeLoop] += Structure->LastBoneUpdates;
+				SolveDistances[ModeLoop] += Structure->LastTotalSolveDistance;
+				Iterations += Structure->LastMultiEffectorIterations;
+			}
+			Seconds[ModeLoop] = FPlatformTime::Seconds() - StartSeconds;
+		}
+
+		const double NumSolves = FMath::Max(BenchmarkNumSolves, 1);
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: anchored %.2f us/solve, %.1f bone updates/solve, effector distance %.3f; multi-effector %.2f us/solve, %.1f bone updates/solve, effector distance %.3f, %.2f iterations/solve"),
+			*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(),
+			Seconds[0] * 1000000.0 / NumSolves, BoneUpdates[0] / NumSolves, SolveDistances[0] / NumSolves,
+			Seconds[1] * 1000000.0 / NumSolves, BoneUpdates[1] / NumSolves, SolveDistances[1] / NumSolves,
+			Iterations / NumSolves);
+	}
+}
+
+void AFabrikDemoActor::RunRigAssetBenchmark()
+{
+	UEnum* DemoEnum = StaticEnum<EFabrikDemoType>();
+	for (int DemoLoop = 0; DemoLoop <= (int)EFabrikDemoType::FD_ConnectedChainsWithEmbeddedTargets; ++DemoLoop)
+	{
+		BuildDemo((EFabrikDemoType)DemoLoop);
+
+		UFabrikRigAsset* RigAsset = NewObject<UFabrikRigAsset>();
+		RigAsset->InitFromStructure(Structure);
+
+		FFabrikRigInstance Instance;
+		RigAsset->InitInstance(Instance, FVector::ZeroVector);
+		FFabrikRigSolveContext Context;
+		RigAsset->InitSolveContext(Context);
+
+		// Every chain reaches for the same target both ways, including those that would otherwise use embedded targets
+		TArray<FVector> ChainTargets;
+		ChainTargets.SetNum(Structure->Chains.Num());
+
+		double StructureSeconds = 0.0;
+		double RigSeconds = 0.0;
+		for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+		{
+			for (FVector& ChainTarget : ChainTargets)
+			{
+				ChainTarget = GetBenchmarkTarget(SolveLoop);
+			}
+
+			double StartSeconds = FPlatformTime::Seconds();
+			Structure->SolveForTargetBuffer(ChainTargets);
+			StructureSeconds += FPlatformTime::Seconds() - StartSeconds;
+
+			StartSeconds = FPlatformTime::Seconds();
+			RigAsset->SolveInstance(Instance, ChainTargets, Context);
+			RigSeconds += FPlatformTime::Seconds() - StartSeconds;
+		}
+
+		float MaxDifference = 0.0f;
+		for (int ChainLoop = 0; ChainLoop < Structure->Chains.Num(); ++ChainLoop)
+		{
+			UFabrikChain* Chain = Structure->Chains[ChainLoop];
+			for (int BoneLoop = 0; BoneLoop < Chain->NumBones; ++BoneLoop)
+			{
+				MaxDifference = FMath::Max(MaxDifference, FVector::Dist(Chain->GetBone(BoneLoop)->EndLocation, RigAsset->GetJointLocation(Instance, ChainLoop, BoneLoop + 1)));
+			}
+		}
+
+		const SIZE_T StructureBytes = UFabrikRigAsset::GetStructureAllocatedSize(Structure);
+		const SIZE_T InstanceBytes = Instance.GetAllocatedSize();
+		const SIZE_T SharedBytes = RigAsset->GetSharedAllocatedSize() + Context.GetAllocatedSize();
+		const int NumInstances = FMath::Max(BenchmarkNumInstances, 1);
+		const double NumSolves = FMath::Max(BenchmarkNumSolves, 1);
+
+		UE_LOG(OpenMotionLog, Log, TEXT("%s: structure %llu bytes/instance, rig instance %llu bytes/instance plus %llu shared; %d instances %llu vs %llu bytes; structure %.2f us/solve, rig asset %.2f us/solve, max joint difference %f"),
+			*DemoEnum->GetDisplayNameTextByValue(DemoLoop).ToString(),
+			(uint64)StructureBytes, (uint64)InstanceBytes, (uint64)SharedBytes,
+			NumInstances, (uint64)(StructureBytes * NumInstances), (uint64)(SharedBytes + InstanceBytes * NumInstances),
+			StructureSeconds * 1000000.0 / NumSolves, RigSeconds * 1000000.0 / NumSolves, MaxDifference);
+	}
+}
+
+void AFabrikDemoActor::RunIKSubsystemBenchmark()
+{
+	UFabrikIKSubsystem* IKSubsystem = GetWorld()->GetSubsystem<UFabrikIKSubsystem>();
+	if (!IKSubsystem)
+	{
+		return;
+	}
+
+	// Keep the live demo intact - every benchmark run builds its own copy of the rig
+	UFabrikStructure* LiveStructure = Structure;
+
+	double Seconds[2];
+	float MaxDifference = 0.0f;
+	TArray<UFabrikStructure*> Instances[2];
+	for (int ModeLoop = 0; ModeLoop < 2; ++ModeLoop)
+	{
+		for (int InstanceLoop = 0; InstanceLoop < BenchmarkNumInstances; ++InstanceLoop)
+		{
+			BuildDemo(DemoType);
+			Instances[ModeLoop].Add(Structure);
+			if (ModeLoop == 1)
+			{
+				IKSubsystem->RegisterStructure(Structure, nullptr);
+			}
+		}
+
+		double StartSeconds = FPlatformTime::Seconds();
+		for (int FrameLoop = 0; FrameLoop < BenchmarkNumFrames; ++FrameLoop)
+		{
+			// Give each instance its own target so they do not all early out together
+			for (int InstanceLoop = 0; InstanceLoop < BenchmarkNumInstances; ++InstanceLoop)
+			{
+				const FVector Target = GetBenchmarkTarget(FrameLoop + InstanceLoop);
+				if (ModeLoop == 0)
+				{
+					Instances[0][InstanceLoop]->SolveForTarget(Target);
+				}
+				else
+				{
+					IKSubsystem->SetTarget(Instances[1][InstanceLoop], Target);
+				}
+			}
+			if (ModeLoop == 1)
+			{
+				IKSubsystem->SolveFrame();
+			}
+		}
+		Seconds[ModeLoop] = FPlatformTime::Seconds() - StartSeconds;
+	}
+
+	for (int InstanceLoop = 0; InstanceLoop < BenchmarkNumInstances; ++InstanceLoop)
+	{
+		for (int ChainLoop = 0; ChainLoop < Instances[0][InstanceLoop]->Chains.Num(); ++ChainLoop)
+		{
+			UFabrikChain* Chain = Instances[0][InstanceLoop]->Chains[ChainLoop];
+			for (int BoneLoop = 0; BoneLoop < Chain->NumBones; ++BoneLoop)
+			{
+				MaxDifference = FMath::Max(MaxDifference, FVector::Dist(Chain->GetBone(BoneLoop)->EndLocation,
+					Instances[1][InstanceLoop]->Chains[ChainLoop]->GetBone(BoneLoop)->EndLocation));
+			}
+		}
+		IKSubsystem->UnregisterStructure(Instances[1][InstanceLoop]);
+	}
+
+	Structure = LiveStructure;
+
+	const double NumFrames = FMath::Max(BenchmarkNumFrames, 1);
+	UE_LOG(OpenMotionLog, Log, TEXT("%s x %d: per structure %.2f us/frame, IK subsystem %.2f us/frame (%.2fx) with %d of %d structures on workers, max joint difference %f"),
+		*StaticEnum<EFabrikDemoType>()->GetDisplayNameTextByValue((int64)DemoType).ToString(), BenchmarkNumInstances,
+		Seconds[0] * 1000000.0 / NumFrames, Seconds[1] * 1000000.0 / NumFrames,
+		Seconds[0] / FMath::Max(Seconds[1], (double)SMALL_NUMBER),
+		IKSubsystem->LastNumParallelStructures, IKSubsystem->LastNumStructuresSolved, MaxDifference);
+}
+
+void AFabrikDemoActor::RunLODBenchmark()
+{
+	// Keep the live demo intact - every benchmark run builds its own copy of the rig
+	UFabrikStructure* LiveStructure = Structure;
+
+	TArray<UFabrikStructure*> Crowd;
+	for (int InstanceLoop = 0; InstanceLoop < BenchmarkNumInstances; ++InstanceLoop)
+	{
+		BuildDemo(DemoType);
+		Structure->LODLevels = BenchmarkLODLevels;
+		Crowd.Add(Structure);
+	}
+	Structure = LiveStructure;
+
+	// Share of the crowd on each level, from everyone at full detail to everyone on the farthest level
+	const int NumLevels = FMath::Max(BenchmarkLODLevels.Num(), 1);
+	const float Mixes[][3] = { { 1.0f, 0.0f, 0.0f }, { 0.2f, 0.3f, 0.5f }, { 0.05f, 0.15f, 0.8f }, { 0.0f, 0.0f, 1.0f } };
+	for (const float* Mix : Mixes)
+	{
+		int NumOnLevel[3] = { 0, 0, 0 };
+		for (int InstanceLoop = 0; InstanceLoop < Crowd.Num(); ++InstanceLoop)
+		{
+			const float Position = (InstanceLoop + 0.5f) / Crowd.Num();
+			const int Level = (Position < Mix[0]) ? 0 : (Position < Mix[0] + Mix[1]) ? 1 : 2;
+			Crowd[InstanceLoop]->SetLOD(FMath::Min(Level, NumLevels - 1));
+			Crowd[InstanceLoop]->ResetTelemetry();
+			++NumOnLevel[Level];
+		}
+
+		double StartSeconds = FPlatformTime::Seconds();
+		for (int FrameLoop = 0; FrameLoop < BenchmarkNumFrames; ++FrameLoop)
+		{
+			for (int InstanceLoop = 0; InstanceLoop < Crowd.Num(); ++InstanceLoop)
+			{
+				Crowd[InstanceLoop]->SolveForTarget(GetBenchmarkTarget(FrameLoop + InstanceLoop));
+			}
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartSeconds;
+
+		int Iterations = 0;
+		int SolvesDecimated = 0;
+		for (UFabrikStructure* Instance : Crowd)
+		{
+			SolvesDecimated += Instance->NumSolvesDecimated;
+			for (UFabrikChain* Chain : Instance->Chains)
+			{
+				Iterations += Chain->TotalSolveIterations;
+			}
+		}
+
+		const double NumFrames = FMath::Max(BenchmarkNumFrames, 1);
+		UE_LOG(OpenMotionLog, Log, TEXT("%s x %d at LOD %d/%d/%d: %.2f us/frame, %.1f iterations/frame, %d of %d structure solves decimated"),
+			*StaticEnum<EFabrikDemoType>()->GetDisplayNameTextByValue((int64)DemoType).ToString(), Crowd.Num(),
+			NumOnLevel[0], NumOnLevel[1], NumOnLevel[2],
+			Seconds * 1000000.0 / NumFrames, Iterations / NumFrames, SolvesDecimated, BenchmarkNumFrames * Crowd.Num());
+	}
+}
+
+FVector AFabrikDemoActor::GetBenchmarkTarget(int InSolveNumber)
+{
+	// A deterministic path which sweeps in and out of reach of the demo chains
+	float Time = InSolveNumber * 0.05f;
+	return FVector(60.0f * FMath::Sin(Time * 1.3f), 60.0f * FMath::Cos(Time * 0.7f), 30.0f * FMath::Sin(Time));
+}
+
+double AFabrikDemoActor::TimeDemoSolves(EFabrikDemoType InDemoType, bool bInUseChainData, bool bInTrackBestSolutionInPlace, int& OutObjectsCreated)
+{
+	BuildDemo(InDemoType);
+
+	for (UFabrikChain* Chain : Structure->Chains)
+	{
+		Chain->UseChainData = bInUseChainData;
+		Chain->TrackBestSolutionInPlace = bInTrackBestSolutionInPlace;
+	}
+
+	// Garbage collection cannot run while we're in here, so the growth of the object array is the number of UObjects the solves created
+	int StartObjects = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	double StartSeconds = FPlatformTime::Seconds();
+	for (int SolveLoop = 0; SolveLoop < BenchmarkNumSolves; ++SolveLoop)
+	{
+		Structure->SolveForTarget(GetBenchmarkTarget(SolveLoop));
+	}
+	double ElapsedSeconds = FPlatformTime::Seconds() - StartSeconds;
+	OutObjectsCreated = GUObjectArray.GetObjectArrayNumMinusAvailable() - StartObjects;
+
+	return ElapsedSeconds;
 }
 
 void AFabrikDemoActor::DrawChain(UFabrikChain* Chain)
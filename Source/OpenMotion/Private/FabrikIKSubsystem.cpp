@@ -0,0 +1,200 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FabrikIKSubsystem.h"
+#include "FabrikStructure.h"
+#include "FabrikChain.h"
+
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Async/ParallelFor.h"
+
+#include "OpenMotion.h"
+
+DECLARE_CYCLE_STAT(TEXT("Fabrik IK Subsystem SolveFrame"), STAT_FabrikIKSubsystemSolveFrame, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik IK Subsystem Structures Solved"), STAT_FabrikIKSubsystemStructuresSolved, STATGROUP_OpenMotion);
+
+void FFabrikIKSolveTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Target->SolveFrame();
+	}
+}
+
+FString FFabrikIKSolveTickFunction::DiagnosticMessage()
+{
+	return TEXT("FFabrikIKSolveTickFunction");
+}
+
+UFabrikIKSubsystem::UFabrikIKSubsystem(const FObjectInitializer& ObjectInitializer)
+{
+	UseParallelSolve = true;
+	MaxSolveThreads = 0;
+	UseDistanceLOD = true;
+	LastNumStructuresSolved = 0;
+	LastNumParallelStructures = 0;
+	LastSolveMicroseconds = 0.0f;
+
+	SolveTickFunction.bCanEverTick = true;
+	SolveTickFunction.bStartWithTickEnabled = true;
+	SolveTickFunction.bRunOnAnyThread = false;
+	SolveTickFunction.TickGroup = TG_PostPhysics;
+}
+
+void UFabrikIKSubsystem::Deinitialize()
+{
+	if (SolveTickFunction.IsTickFunctionRegistered())
+	{
+		SolveTickFunction.UnRegisterTickFunction();
+	}
+	Registrations.Reset();
+
+	Super::Deinitialize();
+}
+
+void UFabrikIKSubsystem::RegisterSolveTickFunction()
+{
+	// The persistent level only exists once the world is up, so wait for the first registration
+	UWorld* World = GetWorld();
+	if (!SolveTickFunction.IsTickFunctionRegistered() && World && World->PersistentLevel)
+	{
+		SolveTickFunction.Target = this;
+		SolveTickFunction.RegisterTickFunction(World->PersistentLevel);
+	}
+}
+
+void UFabrikIKSubsystem::RegisterStructure(UFabrikStructure* InStructure, AActor* InTargetActor)
+{
+	if (!InStructure)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("Cannot register a null structure with the IK subsystem."));
+	}
+
+	FFabrikIKRegistration* Registration = FindRegistration(InStructure);
+	if (!Registration)
+	{
+		Registration = &Registrations[Registrations.AddDefaulted()];
+		Registration->Structure = InStructure;
+	}
+	Registration->TargetActor = InTargetActor;
+
+	RegisterSolveTickFunction();
+}
+
+void UFabrikIKSubsystem::UnregisterStructure(UFabrikStructure* InStructure)
+{
+	Registrations.RemoveAll([InStructure](const FFabrikIKRegistration& Registration) { return Registration.Structure == InStructure; });
+}
+
+void UFabrikIKSubsystem::SetTarget(UFabrikStructure* InStructure, FVector InTarget)
+{
+	FFabrikIKRegistration* Registration = FindRegistration(InStructure);
+	if (!Registration)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("Cannot set the target of a structure that is not registered with the IK subsystem."));
+	}
+
+	Registration->Target = InTarget;
+	Registration->bHasTarget = true;
+}
+
+void UFabrikIKSubsystem::AddPoseConsumer(FTickFunction& InConsumerTickFunction)
+{
+	RegisterSolveTickFunction();
+	InConsumerTickFunction.AddPrerequisite(this, SolveTickFunction);
+}
+
+FFabrikIKRegistration* UFabrikIKSubsystem::FindRegistration(UFabrikStructure* InStructure)
+{
+	return Registrations.FindByPredicate([InStructure](const FFabrikIKRegistration& Registration) { return Registration.Structure == InStructure; });
+}
+
+void UFabrikIKSubsystem::SolveFrame()
+{
+	SCOPE_CYCLE_COUNTER(STAT_FabrikIKSubsystemSolveFrame);
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	// ---------- Gather the targets on the game thread -----------
+
+	// Structures that were destroyed or are pending kill without unregistering are dropped
+	Registrations.RemoveAll([](const FFabrikIKRegistration& Registration) { return !Registration.Structure.IsValid(); });
+
+	FVector ViewLocation = FVector::ZeroVector;
+	bool bHaveViewLocation = false;
+	if (UseDistanceLOD)
+	{
+		APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+		if (PlayerController && PlayerController->PlayerCameraManager)
+		{
+			ViewLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+			bHaveViewLocation = true;
+		}
+	}
+
+	ParallelRegistrations.Reset();
+	GameThreadRegistrations.Reset();
+	for (int32 Loop = 0; Loop < Registrations.Num(); ++Loop)
+	{
+		FFabrikIKRegistration& Registration = Registrations[Loop];
+		if (AActor* TargetActor = Registration.TargetActor.Get())
+		{
+			Registration.Target = TargetActor->GetActorLocation();
+			Registration.bHasTarget = true;
+		}
+		if (!Registration.bHasTarget)
+		{
+			continue;
+		}
+
+		UFabrikStructure* Structure = Registration.Structure.Get();
+		if (bHaveViewLocation && Structure->LODLevels.Num() > 0 && Structure->Chains.Num() > 0)
+		{
+			Structure->SetLODFromDistance(FVector::Dist(ViewLocation, Structure->Chains[0]->FixedBaseLocation));
+		}
+
+		if (UseParallelSolve && Structure->CanSolveOffGameThread())
+		{
+			ParallelRegistrations.Add(Loop);
+		}
+		else
+		{
+			GameThreadRegistrations.Add(Loop);
+		}
+	}
+
+	// ---------- Solve -----------
+
+	for (int32 Index : GameThreadRegistrations)
+	{
+		SolveRegistration(Registrations[Index]);
+	}
+
+	// Every structure is independent of the others, so each chunk just works through its share of them
+	const int32 NumParallel = ParallelRegistrations.Num();
+	const int32 MaxChunks = (MaxSolveThreads > 0) ? MaxSolveThreads : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	const int32 NumChunks = FMath::Min(NumParallel, MaxChunks);
+	if (NumChunks > 0)
+	{
+		ParallelFor(NumChunks, [&](int32 Chunk)
+		{
+			for (int32 Index = Chunk; Index < NumParallel; Index += NumChunks)
+			{
+				SolveRegistration(Registrations[ParallelRegistrations[Index]]);
+			}
+		}, NumChunks <= 1);
+	}
+
+	LastNumStructuresSolved = GameThreadRegistrations.Num() + NumParallel;
+	LastNumParallelStructures = NumParallel;
+	LastSolveMicroseconds = (float)((FPlatformTime::Seconds() - StartSeconds) * 1000000.0);
+	INC_DWORD_STAT_BY(STAT_FabrikIKSubsystemStructuresSolved, LastNumStructuresSolved);
+}
+
+void UFabrikIKSubsystem::SolveRegistration(FFabrikIKRegistration& InRegistration)
+{
+	InRegistration.Structure->SolveForTarget(InRegistration.Target);
+}
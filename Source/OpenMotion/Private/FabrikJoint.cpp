@@ -20,8 +20,26 @@ UFabrikJoint::UFabrikJoint(const FObjectInitializer& ObjectInitializer)
 
 	//ReferenceAxisUV;// = new Vec3f();
 	JointType = EJointType::JT_Ball;
+	UpdateConstraintLimits();
 }
 
+void UFabrikJoint::PostLoad()
+{
+	Super::PostLoad();
+
+	// The limits are not saved, so rebuild them from the loaded angles
+	UpdateConstraintLimits();
+}
+
+#if WITH_EDITOR
+void UFabrikJoint::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	UpdateConstraintLimits();
+}
+#endif
+
 UFabrikJoint* UFabrikJoint::Init(UFabrikJoint* Source)
 { 
 	RotorConstraintDegs = Source->RotorConstraintDegs;
@@ -31,6 +49,9 @@ UFabrikJoint* UFabrikJoint::Init(UFabrikJoint* Source)
 	ReferenceAxisUV = Source->ReferenceAxisUV;
 	JointType = Source->JointType;
 	BoneConnectionPoint = Source->BoneConnectionPoint;
+	RotorLimit = Source->RotorLimit;
+	HingeClockwiseLimit = Source->HingeClockwiseLimit;
+	HingeAnticlockwiseLimit = Source->HingeAnticlockwiseLimit;
 	return this;
 }
 
@@ -48,6 +69,7 @@ void UFabrikJoint::SetAsBallJoint(float InConstraintAngleDegs)
 
 	// Set the rotor constraint angle and the joint type to be BALL.
 	RotorConstraintDegs = InConstraintAngleDegs;
+	RotorLimit = FFabrikAngleLimit::FromDegs(InConstraintAngleDegs);
 	JointType = EJointType::JT_Ball;
 
 }
@@ -76,6 +98,9 @@ void UFabrikJoint::SetHinge(EJointType InJointType, FVector InRotationAxis, floa
 
 	HingeAnticlockwiseConstraintDegs = InAnticlockwiseConstraintDegs;
 
+	HingeClockwiseLimit = FFabrikAngleLimit::FromDegs(InClockwiseConstraintDegs);
+	HingeAnticlockwiseLimit = FFabrikAngleLimit::FromDegs(InAnticlockwiseConstraintDegs);
+
 	JointType = InJointType;
 
 	RotationAxisUV = InRotationAxis; // set(rotationAxis.normalised());
@@ -96,6 +121,13 @@ void UFabrikJoint::SetAsLocalHinge(FVector InLocalRotationAxis, float InCwConstr
 	SetHinge(EJointType::JT_LocalHinge, InLocalRotationAxis, InCwConstraintDegs, InAcwConstraintDegs, InLocalReferenceAxis);
 }
 
+void UFabrikJoint::UpdateConstraintLimits()
+{
+	RotorLimit = FFabrikAngleLimit::FromDegs(RotorConstraintDegs);
+	HingeClockwiseLimit = FFabrikAngleLimit::FromDegs(HingeClockwiseConstraintDegs);
+	HingeAnticlockwiseLimit = FFabrikAngleLimit::FromDegs(HingeAnticlockwiseConstraintDegs);
+}
+
 
 // public float getHingeClockwiseConstraintDegs()
 // public float getHingeAnticlockwiseConstraintDegs()
@@ -9,28 +9,8 @@
 
 UFabrikMat3f* UFabrikMat3f::CreateRotationMatrix(FVector InReferenceDirection)
 {
-	FVector xAxis;
-	FVector yAxis;
-	InReferenceDirection.Normalize();
-	FVector zAxis = InReferenceDirection;// .normalise();
-	
-	// Handle the singularity (i.e. bone pointing along negative Z-Axis)...
-	if (InReferenceDirection.Z < -0.9999999f)
-	{
-		xAxis = FVector(1.0f, 0.0f, 0.0f); // ...in which case positive X runs directly to the right...
-		yAxis = FVector(0.0f, 1.0f, 0.0f); // ...and positive Y runs directly upwards.
-	}
-	else
-	{
-		float a = 1.0f / (1.0f + zAxis.Z);
-		float b = -zAxis.X * zAxis.Y * a;
-		xAxis = FVector(1.0f - zAxis.X * zAxis.X * a, b, -zAxis.X);// .normalise();
-		xAxis.Normalize();
-		yAxis = FVector(b, 1.0f - zAxis.Y * zAxis.Y * a, -zAxis.Y);// .normalise();
-	}
-
 	UFabrikMat3f* Res = NewObject<UFabrikMat3f>();
-	Res->Init(xAxis, yAxis, zAxis);
+	Res->Init(FFabrikMat3f::CreateRotationMatrix(InReferenceDirection));
 	return Res;// new Mat3f(xAxis, yAxis, zAxis);
 }
 
@@ -49,6 +29,21 @@ void UFabrikMat3f::Init(FVector xAxis, FVector yAxis, FVector zAxis)
 	m22 = zAxis.Z;
 }
 
+void UFabrikMat3f::Init(const FFabrikMat3f& InMatrix)
+{
+	m00 = InMatrix.m00;
+	m01 = InMatrix.m01;
+	m02 = InMatrix.m02;
+
+	m10 = InMatrix.m10;
+	m11 = InMatrix.m11;
+	m12 = InMatrix.m12;
+
+	m20 = InMatrix.m20;
+	m21 = InMatrix.m21;
+	m22 = InMatrix.m22;
+}
+
 FVector UFabrikMat3f::Times(FVector source)
 {
 	return FVector(this->m00 * source.X + this->m10 * source.Y + this->m20 * source.Z,
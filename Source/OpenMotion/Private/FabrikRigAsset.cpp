@@ -0,0 +1,354 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FabrikRigAsset.h"
+#include "FabrikStructure.h"
+#include "FabrikChain.h"
+#include "FabrikBone.h"
+#include "FabrikJoint.h"
+#include "FabrikMat3f.h"
+#include "FabrikUtil.h"
+#include "FabrikChainSolver.h"
+#include "Misc/ScopeRWLock.h"
+
+#include "OpenMotion.h"
+
+DECLARE_CYCLE_STAT(TEXT("Fabrik Rig SolveInstance"), STAT_FabrikRigSolveInstance, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Rig Chains Solved"), STAT_FabrikRigChainsSolved, STATGROUP_OpenMotion);
+
+SIZE_T FFabrikRigInstance::GetAllocatedSize() const
+{
+	return sizeof(FFabrikRigInstance) + Joints.GetAllocatedSize() + LastTargets.GetAllocatedSize() +
+		LastBaseLocations.GetAllocatedSize() + SolveDistances.GetAllocatedSize();
+}
+
+void FFabrikRigInstance::ForceSolve()
+{
+	for (FVector& LastTarget : LastTargets)
+	{
+		LastTarget = FVector(FLT_MAX, FLT_MAX, FLT_MAX);
+	}
+}
+
+SIZE_T FFabrikRigSolveContext::GetAllocatedSize() const
+{
+	SIZE_T Bytes = sizeof(FFabrikRigSolveContext) + Chains.GetAllocatedSize() + BestJoints.GetAllocatedSize();
+	for (const FFabrikChainData& Data : Chains)
+	{
+		Bytes += Data.GetAllocatedSize();
+	}
+	return Bytes;
+}
+
+FArchive& operator<<(FArchive& Ar, FFabrikRigChain& InOutChain)
+{
+	FFabrikChainData& Data = InOutChain.Data;
+
+	int32 NumBonesL = Data.NumBones();
+	Ar << NumBonesL;
+	if (Ar.IsLoading())
+	{
+		Data.SetNumBones(NumBonesL);
+	}
+
+	// The authored pose
+	for (int32 Loop = 0; Loop <= NumBonesL; ++Loop)
+	{
+		Ar << Data.Joints[Loop];
+	}
+
+	for (int32 Loop = 0; Loop < NumBonesL; ++Loop)
+	{
+		uint8 JointType = (uint8)Data.JointTypes[Loop];
+		Ar << Data.Lengths[Loop] << JointType;
+		Data.JointTypes[Loop] = (EJointType)JointType;
+
+		Ar << Data.RotorConstraintDegs[Loop] << Data.HingeClockwiseConstraintDegs[Loop] << Data.HingeAnticlockwiseConstraintDegs[Loop];
+		Ar << Data.RotationAxes[Loop] << Data.ReferenceAxes[Loop];
+	}
+
+	uint8 BaseboneConstraintType = (uint8)Data.BaseboneConstraintType;
+	Ar << BaseboneConstraintType;
+	Data.BaseboneConstraintType = (EBoneConstraintType)BaseboneConstraintType;
+	Ar << Data.BaseboneConstraintUV << Data.BaseboneRelativeConstraintUV << Data.BaseboneRelativeReferenceConstraintUV;
+	Ar << Data.FixedBaseLocation << Data.FixedBaseMode;
+
+	// Only whether the chain had a specialised pass, as the pass itself is a function pointer
+	bool bSpecialized = (Data.SpecializedSolveIK != nullptr);
+	Ar << bSpecialized;
+
+	Ar << InOutChain.HostChain << InOutChain.HostBone << InOutChain.HostJoint << InOutChain.JointStart;
+	Ar << InOutChain.SolveDistanceThreshold << InOutChain.MaxIterationAttempts << InOutChain.MinIterationChange << InOutChain.UseClosedFormSolvers;
+	Ar << InOutChain.Name;
+
+	if (Ar.IsLoading())
+	{
+		for (int32 Loop = 0; Loop < NumBonesL; ++Loop)
+		{
+			Data.RotorLimits[Loop] = FFabrikAngleLimit::FromDegs(Data.RotorConstraintDegs[Loop]);
+			Data.HingeClockwiseLimits[Loop] = FFabrikAngleLimit::FromDegs(Data.HingeClockwiseConstraintDegs[Loop]);
+			Data.HingeAnticlockwiseLimits[Loop] = FFabrikAngleLimit::FromDegs(Data.HingeAnticlockwiseConstraintDegs[Loop]);
+		}
+		Data.UpdateDirections();
+		Data.HasSubBasePulls = false;
+		Data.SpecializedSolveIK = bSpecialized ? FFabrikChainSolverRegistry::Get().Find(Data) : nullptr;
+	}
+
+	return Ar;
+}
+
+UFabrikRigAsset::UFabrikRigAsset(const FObjectInitializer& ObjectInitializer)
+{
+	NumJoints = 0;
+	Generation = 0;
+}
+
+void UFabrikRigAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar << RigChains;
+}
+
+void UFabrikRigAsset::InitFromStructure(UFabrikStructure* InStructure)
+{
+	if (!InStructure)
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("Cannot build a rig asset without a structure."));
+	}
+
+	// Build the new definition aside, so readers are only held up while it is swapped in
+	int32 NewNumJoints = 0;
+	const int32 NumChainsL = InStructure->Chains.Num();
+	TArray<FFabrikRigChain> NewRigChains;
+	NewRigChains.SetNum(NumChainsL);
+
+	for (int32 Loop = 0; Loop < NumChainsL; ++Loop)
+	{
+		UFabrikChain* Chain = InStructure->Chains[Loop];
+		FFabrikRigChain& RigChain = NewRigChains[Loop];
+
+		Chain->FillChainData(RigChain.Data);
+
+		RigChain.HostChain = Chain->ConnectedChainNumber;
+		RigChain.HostBone = Chain->ConnectedBoneNumber;
+		RigChain.HostJoint = -1;
+		if (RigChain.HostChain != -1)
+		{
+			// Hosts must come first so their joints are solved by the time a connected chain reads them
+			if (RigChain.HostChain < 0 || RigChain.HostChain >= Loop)
+			{
+				UE_LOG(OpenMotionLog, Fatal, TEXT("Chain %d is connected to chain %d - rig assets need every chain to come after the chain it is connected to."), Loop, RigChain.HostChain);
+			}
+
+			UFabrikBone* HostBone = InStructure->Chains[RigChain.HostChain]->GetBone(RigChain.HostBone);
+			RigChain.HostJoint = (HostBone->BoneConnectionPoint == EBoneConnectionPoint::BCP_Start) ? RigChain.HostBone : RigChain.HostBone + 1;
+		}
+
+		RigChain.JointStart = NewNumJoints;
+		NewNumJoints += RigChain.Data.Joints.Num();
+
+		RigChain.SolveDistanceThreshold = Chain->SolveDistanceThreshold;
+		RigChain.MaxIterationAttempts = Chain->MaxIterationAttempts;
+		RigChain.MinIterationChange = Chain->MinIterationChange;
+		RigChain.UseClosedFormSolvers = Chain->UseClosedFormSolvers;
+		RigChain.Name = Chain->Name;
+	}
+
+	FWriteScopeLock WriteLock(DefinitionLock);
+	Name = InStructure->Name;
+	NumJoints = NewNumJoints;
+	RigChains = MoveTemp(NewRigChains);
+	++Generation;
+}
+
+void UFabrikRigAsset::InitInstance(FFabrikRigInstance& OutInstance, const FVector& InLocation) const
+{
+	const int32 NumChainsL = RigChains.Num();
+
+	OutInstance.Location = InLocation;
+	OutInstance.Joints.SetNumUninitialized(NumJoints);
+	OutInstance.LastTargets.Init(FVector(FLT_MAX, FLT_MAX, FLT_MAX), NumChainsL);
+	OutInstance.LastBaseLocations.Init(FVector(FLT_MAX, FLT_MAX, FLT_MAX), NumChainsL);
+	OutInstance.SolveDistances.Init(FLT_MAX, NumChainsL);
+
+	for (const FFabrikRigChain& RigChain : RigChains)
+	{
+		for (int32 Loop = 0; Loop < RigChain.Data.Joints.Num(); ++Loop)
+		{
+			OutInstance.Joints[RigChain.JointStart + Loop] = RigChain.Data.Joints[Loop] + InLocation;
+		}
+	}
+}
+
+void UFabrikRigAsset::InitSolveContext(FFabrikRigSolveContext& OutContext) const
+{
+	OutContext.Chains.Reset(RigChains.Num());
+	for (const FFabrikRigChain& RigChain : RigChains)
+	{
+		OutContext.Chains.Add(RigChain.Data);
+	}
+}
+
+int32 UFabrikRigAsset::SolveInstance(FFabrikRigInstance& InOutInstance, const FVector& InTarget, FFabrikRigSolveContext& InOutContext) const
+{
+	return SolveInstanceChains(InOutInstance, InTarget, nullptr, InOutContext);
+}
+
+int32 UFabrikRigAsset::SolveInstance(FFabrikRigInstance& InOutInstance, const TArray<FVector>& InChainTargets, FFabrikRigSolveContext& InOutContext) const
+{
+	if (InChainTargets.Num() != RigChains.Num())
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("Target buffer holds %d targets for %d chains - there must be one target per chain."), InChainTargets.Num(), RigChains.Num());
+	}
+
+	return SolveInstanceChains(InOutInstance, FVector::ZeroVector, &InChainTargets, InOutContext);
+}
+
+int32 UFabrikRigAsset::SolveInstanceChains(FFabrikRigInstance& InOutInstance, const FVector& InTarget, const TArray<FVector>* InChainTargets, FFabrikRigSolveContext& InOutContext) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_FabrikRigSolveInstance);
+
+	check(InOutInstance.Joints.Num() == NumJoints);
+	check(InOutContext.Chains.Num() == RigChains.Num());
+
+	int32 NumChainsSolved = 0;
+
+	// Hosts come first, so a connected chain always reads its host's pose from this solve
+	for (int32 ChainLoop = 0; ChainLoop < RigChains.Num(); ++ChainLoop)
+	{
+		const FFabrikRigChain& RigChain = RigChains[ChainLoop];
+		FFabrikChainData& Data = InOutContext.Chains[ChainLoop];
+		const int32 NumBonesL = Data.NumBones();
+		if (NumBonesL == 0)
+		{
+			continue;
+		}
+
+		FVector* Joints = &InOutInstance.Joints[RigChain.JointStart];
+		const FVector Target = InChainTargets ? (*InChainTargets)[ChainLoop] : InTarget;
+
+		FVector BaseLocation;
+		if (RigChain.HostChain != -1)
+		{
+			BaseLocation = InOutInstance.Joints[RigChains[RigChain.HostChain].JointStart + RigChain.HostJoint];
+		}
+		else
+		{
+			BaseLocation = (RigChain.Data.FixedBaseMode && !InOutInstance.UseJointBases) ? RigChain.Data.FixedBaseLocation + InOutInstance.Location : Joints[0];
+		}
+
+		// If we have both the same target and base location as the last run then do not solve
+		if (UFabrikUtil::VectorApproximatelyEquals(InOutInstance.LastTargets[ChainLoop], Target, 0.001f) &&
+			UFabrikUtil::VectorApproximatelyEquals(InOutInstance.LastBaseLocations[ChainLoop], BaseLocation, 0.001f))
+		{
+			continue;
+		}
+
+		for (int32 Loop = 0; Loop <= NumBonesL; ++Loop)
+		{
+			Data.Joints[Loop] = Joints[Loop];
+		}
+		Data.UpdateDirections();
+		Data.FixedBaseLocation = BaseLocation;
+
+		// Local basebone constraints are relative to the direction of the host bone, as in UFabrikStructure::SolveChain
+		if (RigChain.HostChain != -1 &&
+			(Data.BaseboneConstraintType == EBoneConstraintType::BCT_LocalRotor || Data.BaseboneConstraintType == EBoneConstraintType::BCT_LocalHinge))
+		{
+			const FVector* HostJoints = &InOutInstance.Joints[RigChains[RigChain.HostChain].JointStart];
+			FFabrikMat3f ConnectionBoneMatrix = FFabrikMat3f::CreateRotationMatrix((HostJoints[RigChain.HostBone + 1] - HostJoints[RigChain.HostBone]).GetSafeNormal());
+
+			Data.BaseboneRelativeConstraintUV = ConnectionBoneMatrix.Times(RigChain.Data.BaseboneConstraintUV).GetSafeNormal();
+			if (Data.BaseboneConstraintType == EBoneConstraintType::BCT_LocalHinge)
+			{
+				Data.BaseboneRelativeReferenceConstraintUV = ConnectionBoneMatrix.Times(RigChain.Data.ReferenceAxes[0]);
+			}
+		}
+
+		// Same iteration rules as UFabrikChain::SolveForTarget, keeping the best pass
+		TArray<FVector>& BestJoints = InOutContext.BestJoints;
+		BestJoints.SetNum(NumBonesL + 1, false);
+
+		float BestSolveDistance = FLT_MAX;
+		float LastPassSolveDistance = FLT_MAX;
+		float SolveDistance;
+
+		if (RigChain.UseClosedFormSolvers && Data.SolveClosedForm(Target, SolveDistance))
+		{
+			BestSolveDistance = SolveDistance;
+			FMemory::Memcpy(BestJoints.GetData(), Data.Joints.GetData(), (NumBonesL + 1) * sizeof(FVector));
+		}
+		else
+		{
+			for (int32 Loop = 0; Loop < RigChain.MaxIterationAttempts; ++Loop)
+			{
+				SolveDistance = Data.SolveIK(Target);
+
+				if (SolveDistance < BestSolveDistance)
+				{
+					BestSolveDistance = SolveDistance;
+					FMemory::Memcpy(BestJoints.GetData(), Data.Joints.GetData(), (NumBonesL + 1) * sizeof(FVector));
+
+					if (SolveDistance < RigChain.SolveDistanceThreshold)
+					{
+						break;
+					}
+				}
+				else if (FMath::Abs(SolveDistance - LastPassSolveDistance) < RigChain.MinIterationChange)
+				{
+					break;
+				}
+
+				LastPassSolveDistance = SolveDistance;
+			}
+		}
+
+		if (BestSolveDistance < FLT_MAX)
+		{
+			FMemory::Memcpy(Joints, BestJoints.GetData(), (NumBonesL + 1) * sizeof(FVector));
+		}
+
+		InOutInstance.SolveDistances[ChainLoop] = BestSolveDistance;
+		InOutInstance.LastTargets[ChainLoop] = Target;
+		InOutInstance.LastBaseLocations[ChainLoop] = BaseLocation;
+		++NumChainsSolved;
+	}
+
+	INC_DWORD_STAT_BY(STAT_FabrikRigChainsSolved, NumChainsSolved);
+	return NumChainsSolved;
+}
+
+SIZE_T UFabrikRigAsset::GetSharedAllocatedSize() const
+{
+	SIZE_T Bytes = GetClass()->GetStructureSize() + RigChains.GetAllocatedSize();
+	for (const FFabrikRigChain& RigChain : RigChains)
+	{
+		Bytes += RigChain.Data.GetAllocatedSize();
+	}
+	return Bytes;
+}
+
+SIZE_T UFabrikRigAsset::GetStructureAllocatedSize(UFabrikStructure* InStructure)
+{
+	SIZE_T Bytes = InStructure->GetClass()->GetStructureSize() + InStructure->Chains.GetAllocatedSize() +
+		InStructure->ChainDeadlines.GetAllocatedSize() + InStructure->ChainBudgetWeights.GetAllocatedSize() +
+		InStructure->SolveLevelChains.GetAllocatedSize() +
+		InStructure->SolveLevelStarts.GetAllocatedSize() + InStructure->ChainTargets.GetAllocatedSize() +
+		InStructure->LastCutShortChains.GetAllocatedSize();
+
+	for (UFabrikChain* Chain : InStructure->Chains)
+	{
+		Bytes += Chain->GetClass()->GetStructureSize() + Chain->Chain.GetAllocatedSize() + Chain->BestSolutionJoints.GetAllocatedSize() +
+			Chain->ChainData.GetAllocatedSize() + Chain->SubBasePulls.GetAllocatedSize() + Chain->NumSubBasePulls.GetAllocatedSize();
+
+		for (UFabrikBone* Bone : Chain->Chain)
+		{
+			Bytes += Bone->GetClass()->GetStructureSize();
+			if (Bone->Joint)
+			{
+				Bytes += Bone->Joint->GetClass()->GetStructureSize();
+			}
+		}
+	}
+	return Bytes;
+}
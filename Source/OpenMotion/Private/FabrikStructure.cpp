@@ -4,110 +4,704 @@
 #include "FabrikChain.h"
 #include "FabrikBone.h"
 #include "FabrikMat3f.h"
+#include "FabrikUtil.h"
 #include "EBoneConstraintType.h"
 
+#include "Async/ParallelFor.h"
+
 #include "OpenMotion.h"
 
+DECLARE_CYCLE_STAT(TEXT("Fabrik Structure SolveForTarget"), STAT_FabrikStructureSolveForTarget, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Chains Cut Short"), STAT_FabrikChainsCutShort, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Chains Skipped"), STAT_FabrikChainsSkipped, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Structure Solves Skipped"), STAT_FabrikStructureSolvesSkipped, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fabrik Structure Solves Decimated"), STAT_FabrikStructureSolvesDecimated, STATGROUP_OpenMotion);
+
 UFabrikStructure::UFabrikStructure(const FObjectInitializer& ObjectInitializer)
 {
 	NumChains = 0;
+	SolveBudgetMicroseconds = 0.0f;
+	UseParallelSolve = false;
+	MaxSolveThreads = 0;
+	UseDirtyPropagation = true;
+	UseMultiEffectorSolve = false;
+	MultiEffectorIterations = 4;
+	MultiEffectorMinChange = 0.01f;
+	LastSolveMicroseconds = 0.0f;
+	LastNumChainsSkipped = 0;
+	TotalChainsSkipped = 0;
+	NumSolvesSkipped = 0;
+	LastMultiEffectorIterations = 0;
+	bWarnedMultiEffectorFallback = false;
+	LastBoneUpdates = 0;
+	LastTotalSolveDistance = 0.0f;
+	CurrentLOD = 0;
+	LastSolveDecimated = false;
+	NumSolvesDecimated = 0;
+	LODFramesSinceSolve = 0;
+	bSolveLevelsValid = true;
 }
 
  void UFabrikStructure::SolveForTarget(FVector InNewTargetLocation)
 {
-	int NumChainsL = Chains.Num();
-	int ConnectedChainNumber;
+	SolveChains(InNewTargetLocation, nullptr);
+}
 
-	// Loop over all chains in this structure...
+void UFabrikStructure::SolveForTargets(const TArray<FFabrikChainTarget>& InTargets)
+{
+	const int NumChainsL = Chains.Num();
+	ChainTargets.SetNumUninitialized(NumChainsL, false);
 	for (int Loop = 0; Loop < NumChainsL; ++Loop)
 	{
-		// Get this chain, and get the number of the chain in this structure it's connected to (if any)
 		UFabrikChain* ThisChain = Chains[Loop];
+		if (ThisChain->UseEmbeddedTarget)
+		{
+			ChainTargets[Loop] = ThisChain->EmbeddedTarget;
+		}
+		else if (ThisChain->LastTargetLocation.X != FLT_MAX)
+		{
+			ChainTargets[Loop] = ThisChain->LastTargetLocation;
+		}
+		else
+		{
+			ChainTargets[Loop] = ThisChain->GetEffectorLocation();
+		}
+	}
+
+	for (const FFabrikChainTarget& ChainTarget : InTargets)
+	{
+		if (!ChainTargets.IsValidIndex(ChainTarget.ChainIndex))
+		{
+			UE_LOG(OpenMotionLog, Fatal, TEXT("Cannot target chain %d - no such chain (remember that chains are zero indexed)."), ChainTarget.ChainIndex);
+		}
+		ChainTargets[ChainTarget.ChainIndex] = ChainTarget.Target;
+	}
 
-		ConnectedChainNumber = ThisChain->ConnectedChainNumber;// getConnectedChainNumber();
+	SolveChains(FVector::ZeroVector, &ChainTargets);
+}
 
-		// If this chain isn't connected to another chain then update as normal...
-		if (ConnectedChainNumber == -1)
+void UFabrikStructure::SolveForTargetBuffer(const TArray<FVector>& InChainTargets)
+{
+	if (InChainTargets.Num() != Chains.Num())
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("Target buffer holds %d targets for %d chains - there must be one target per chain."), InChainTargets.Num(), Chains.Num());
+	}
+
+	SolveChains(FVector::ZeroVector, &InChainTargets);
+}
+
+void UFabrikStructure::SolveChains(FVector InNewTargetLocation, const TArray<FVector>* InChainTargets)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FabrikStructureSolveForTarget);
+
+	int NumChainsL = Chains.Num();
+
+	// ---------- Level of detail -----------
+
+	const FFabrikLODLevel* LODLevel = LODLevels.IsValidIndex(CurrentLOD) ? &LODLevels[CurrentLOD] : nullptr;
+	const int SolveEveryNthFrame = LODLevel ? FMath::Max(LODLevel->SolveEveryNthFrame, 1) : 1;
+	const bool bInterpolate = LODLevel && LODLevel->InterpolateSkippedFrames && SolveEveryNthFrame > 1;
+
+	// Kept poses only hold while no bones have been added or removed
+	const bool bHaveLODPose = LODLastJoints.Num() > 0 && LODLastJoints.Num() == GetNumJoints();
+
+	LastSolveDecimated = false;
+	if (SolveEveryNthFrame > 1 && ++LODFramesSinceSolve < SolveEveryNthFrame && bHaveLODPose)
+	{
+		// Not our frame - either hold the last pose or carry on blending towards it. The blend runs one solve behind,
+		// reaching the last solved pose just as the next solve is due.
+		if (bInterpolate && LODPreviousJoints.Num() == LODLastJoints.Num())
 		{
-			ThisChain->SolveForTarget(InNewTargetLocation);
+			ApplyBlendedJoints(LODPreviousJoints, LODLastJoints, (float)(LODFramesSinceSolve + 1) / SolveEveryNthFrame);
 		}
-		else // ...however, if this chain IS connected to another chain...
+
+		LastSolveDecimated = true;
+		++NumSolvesDecimated;
+		INC_DWORD_STAT(STAT_FabrikStructureSolvesDecimated);
+		return;
+	}
+	LODFramesSinceSolve = 0;
+
+	for (UFabrikChain* Chain : Chains)
+	{
+		Chain->LODMaxIterationAttempts = LODLevel ? LODLevel->MaxIterationAttempts : 0;
+		Chain->LODSolveDistanceThresholdScale = LODLevel ? LODLevel->SolveDistanceThresholdScale : 1.0f;
+	}
+
+	// The bones may show a blend, so put the solver back where it left off
+	if (bHaveLODPose)
+	{
+		ApplyJoints(LODLastJoints);
+	}
+
+	const double StartSeconds = FPlatformTime::Seconds();
+	const double BudgetEndSeconds = (SolveBudgetMicroseconds > 0.0f) ? StartSeconds + SolveBudgetMicroseconds / 1000000.0 : 0.0;
+	GetChainBudgetWeights(ChainBudgetWeights);
+	ChainDeadlines.Reset(Chains.Num());
+	ChainDeadlines.AddZeroed(Chains.Num());
+	LastCutShortChains.Reset();
+	LastBoneUpdates = 0;
+	LastMultiEffectorIterations = 0;
+
+	// Only FFabrikChainData::SolveForwardPass follows the sub-base pulls, so a chain solving on its bones would ignore them
+	const bool bMultiEffector = UseMultiEffectorSolve && CanSolveOffGameThread();
+	if (UseMultiEffectorSolve && !bMultiEffector && !bWarnedMultiEffectorFallback)
+	{
+		UE_LOG(OpenMotionLog, Warning, TEXT("%s: multi-effector solve needs every chain to use chain data and track its best solution in place, solving anchored instead."),
+			*GetName());
+		bWarnedMultiEffectorFallback = true;
+	}
+
+	if (bMultiEffector)
+	{
+		// Each pass solves the hosts with their connected joints pulled towards where the chains on them want to be, and
+		// the chains from wherever that leaves their hosts. Later passes start from the previous pass's pose.
+		const int NumPasses = FMath::Max(MultiEffectorIterations, 1);
+		float LastPassSolveDistance = FLT_MAX;
+		for (int Iteration = 0; Iteration < NumPasses; ++Iteration)
 		{
-			// ... get the host chain and bone which this chain is connected to
-			UFabrikChain* HostChain = Chains[ConnectedChainNumber];
-			UFabrikBone* HostBone = HostChain->GetBone(ThisChain->ConnectedBoneNumber); //.getConnectedBoneNumber());
+			GatherSubBasePulls(InNewTargetLocation, InChainTargets);
 
-			if (HostBone->BoneConnectionPoint == EBoneConnectionPoint::BCP_Start)
-			{ 
-				// setBaseLocation => mFixedBaseLocation 
-				ThisChain->FixedBaseLocation = HostBone->StartLocation; // setBaseLocation(hostBone.getStartLocation());
+			// Each pass gets an even share of whatever budget the passes before it left
+			double PassEndSeconds = 0.0;
+			if (BudgetEndSeconds > 0.0)
+			{
+				const double NowSeconds = FPlatformTime::Seconds();
+				PassEndSeconds = NowSeconds + FMath::Max(BudgetEndSeconds - NowSeconds, 0.0) / (NumPasses - Iteration);
 			}
-			else 
-			{ 
-				// setBaseLocation => mFixedBaseLocation 
-				ThisChain->FixedBaseLocation = HostBone->EndLocation;  // setBaseLocation(hostBone.getEndLocation()); } 
+			SolveChainsOnce(InNewTargetLocation, InChainTargets, PassEndSeconds);
+			++LastMultiEffectorIterations;
+
+			bool bAllSolved = true;
+			float TotalSolveDistance = 0.0f;
+			for (UFabrikChain* Chain : Chains)
+			{
+				TotalSolveDistance += Chain->CurrentSolveDistance;
+				bAllSolved &= (Chain->CurrentSolveDistance <= Chain->SolveDistanceThreshold);
 			}
 
-			// Now that we've clamped the base location of this chain to the start or end point of the bone in the chain we are connected to, it's
-			// time to deal with any base bone constraints...
+			if (bAllSolved || LastPassSolveDistance - TotalSolveDistance < MultiEffectorMinChange ||
+				(BudgetEndSeconds > 0.0 && FPlatformTime::Seconds() >= BudgetEndSeconds))
+			{
+				break;
+			}
+			LastPassSolveDistance = TotalSolveDistance;
+		}
 
-			// What type of base bone constraint is this (connected to another) chain using? 
-			EBoneConstraintType ConstraintType = ThisChain->BaseboneConstraintType;
+		for (UFabrikChain* Chain : Chains)
+		{
+			Chain->ClearSubBasePulls();
+		}
+	}
+	else
+	{
+		SolveChainsOnce(InNewTargetLocation, InChainTargets, BudgetEndSeconds);
+	}
 
-			switch (ConstraintType)
+	LastNumChainsSkipped = 0;
+	LastTotalSolveDistance = 0.0f;
+	for (int Loop = 0; Loop < NumChainsL; ++Loop)
+	{
+		if (Chains[Loop]->LastSolveCutShort)
+		{
+			LastCutShortChains.Add(Loop);
+		}
+		if (Chains[Loop]->LastSolveSkipped)
+		{
+			++LastNumChainsSkipped;
+		}
+		LastTotalSolveDistance += Chains[Loop]->CurrentSolveDistance;
+	}
+	TotalChainsSkipped += LastNumChainsSkipped;
+	if (NumChainsL > 0 && LastNumChainsSkipped == NumChainsL)
+	{
+		++NumSolvesSkipped;
+		INC_DWORD_STAT(STAT_FabrikStructureSolvesSkipped);
+	}
+
+	// Keep the last two solved poses for blending on the frames that are skipped
+	if (SolveEveryNthFrame > 1)
+	{
+		Swap(LODPreviousJoints, LODLastJoints);
+		GatherJoints(LODLastJoints);
+		if (LODPreviousJoints.Num() != LODLastJoints.Num())
+		{
+			LODPreviousJoints = LODLastJoints;
+		}
+
+		if (bInterpolate)
+		{
+			ApplyBlendedJoints(LODPreviousJoints, LODLastJoints, 1.0f / SolveEveryNthFrame);
+		}
+	}
+	else
+	{
+		LODPreviousJoints.Reset();
+		LODLastJoints.Reset();
+	}
+
+	LastSolveMicroseconds = (float)((FPlatformTime::Seconds() - StartSeconds) * 1000000.0);
+	INC_DWORD_STAT_BY(STAT_FabrikChainsCutShort, LastCutShortChains.Num());
+	INC_DWORD_STAT_BY(STAT_FabrikChainsSkipped, LastNumChainsSkipped);
+
+} // End of updateTarget method
+
+void UFabrikStructure::SolveChainsOnce(FVector InNewTargetLocation, const TArray<FVector>* InChainTargets, double InEndSeconds)
+{
+	int NumChainsL = Chains.Num();
+
+	if (UseParallelSolve && CanSolveInParallel())
+	{
+		// Every chain in a level only reads from chains in the levels below it, so each level can be shared out
+		// between the workers, and the result is the same as solving the chains one at a time
+		const int MaxChunks = (MaxSolveThreads > 0) ? MaxSolveThreads : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+
+		// The chains of a level run side by side, so a level costs as much as its heaviest chain
+		float LevelWeightLeft = 0.0f;
+		for (int Level = 0; Level + 1 < SolveLevelStarts.Num(); ++Level)
+		{
+			LevelWeightLeft += GetLevelBudgetWeight(Level);
+		}
+
+		for (int Level = 0; Level + 1 < SolveLevelStarts.Num(); ++Level)
+		{
+			const int FirstIndex = SolveLevelStarts[Level];
+			const int NumLevelChains = SolveLevelStarts[Level + 1] - FirstIndex;
+			const int NumChunks = FMath::Min(NumLevelChains, MaxChunks);
+
+			// Every chain's share is measured from when its level starts, not stacked after the others in the level
+			if (InEndSeconds > 0.0)
 			{
-				// None or global basebone constraints? Nothing to do, because these will be handled in FabrikChain3D.solveIK() as we do not
-				// need information from another chain to handle them.
-			case EBoneConstraintType::BCT_None: // NONE:         // Nothing to do because there's no basebone constraint
-			case EBoneConstraintType::BCT_GlobalRotor:// GLOBAL_ROTOR: // Nothing to do because the basebone constraint is not relative to bones in other chains in this structure
-			case EBoneConstraintType::BCT_GlobalHinge: //  GLOBAL_HINGE: // Nothing to do because the basebone constraint is not relative to bones in other chains in this structure
-				break;
+				const double LevelStartSeconds = FPlatformTime::Seconds();
+				for (int Index = FirstIndex; Index < FirstIndex + NumLevelChains; ++Index)
+				{
+					const int ChainIndex = SolveLevelChains[Index];
+					ChainDeadlines[ChainIndex] = GetDeadline(LevelStartSeconds, InEndSeconds, ChainBudgetWeights[ChainIndex], LevelWeightLeft);
+				}
+			}
+			LevelWeightLeft -= GetLevelBudgetWeight(Level);
 
-				// If we have a local rotor or hinge constraint then we must calculate the relative basebone constraint before calling updateTarget
-			case EBoneConstraintType::BCT_LocalRotor: // LOCAL_ROTOR:
-			case EBoneConstraintType::BCT_LocalHinge: { // LOCAL_HINGE: {
-				// Get the direction of the bone this chain is connected to and create a rotation matrix from it.
-				//Mat3f ConnectionBoneMatrix = Mat3f.createRotationMatrix(HostBone.getDirectionUV());
-				UFabrikMat3f* ConnectionBoneMatrix = UFabrikMat3f::CreateRotationMatrix(HostBone->GetDirectionUV());
-				// We'll then get the basebone constraint UV and multiply it by the rotation matrix of the connected bone 
-				// to make the basebone constraint UV relative to the direction of bone it's connected to.
-				FVector RelativeBaseboneConstraintUV = ConnectionBoneMatrix->Times(ThisChain->BaseboneConstraintUV);// .normalised();
-				RelativeBaseboneConstraintUV.Normalize();
-
-				// Update our basebone relative constraint UV property
-				ThisChain->BaseboneRelativeConstraintUV = RelativeBaseboneConstraintUV;
-
-				// Update the relative reference constraint UV if we hav a local hinge
-				if (ConstraintType == EBoneConstraintType::BCT_LocalHinge)
+			ParallelFor(NumChunks, [&](int32 Chunk)
+			{
+				for (int Index = FirstIndex + Chunk; Index < FirstIndex + NumLevelChains; Index += NumChunks)
 				{
-					//getHingeReferenceAxis() => mReferenceAxisUV
-					ThisChain->BaseboneRelativeReferenceConstraintUV = ConnectionBoneMatrix->Times(ThisChain->GetBone(0)->Joint->ReferenceAxisUV);// .getHingeReferenceAxis()));
+					SolveChain(SolveLevelChains[Index], InNewTargetLocation, InChainTargets);
 				}
-				break;
+			}, NumChunks <= 1);
+		}
+	}
+	else
+	{
+		float WeightLeft = 0.0f;
+		for (float Weight : ChainBudgetWeights)
+		{
+			WeightLeft += Weight;
+		}
+
+		// Loop over all chains in this structure...
+		for (int Loop = 0; Loop < NumChainsL; ++Loop)
+		{
+			// Each chain gets its share of what is left, so time one chain leaves unused rolls on to the next, and a chain
+			// that overruns eats into the ones after it
+			if (InEndSeconds > 0.0)
+			{
+				ChainDeadlines[Loop] = GetDeadline(FPlatformTime::Seconds(), InEndSeconds, ChainBudgetWeights[Loop], WeightLeft);
 			}
-							  // No need for a default - constraint types are enums and we've covered them all.
+			WeightLeft -= ChainBudgetWeights[Loop];
+
+			SolveChain(Loop, InNewTargetLocation, InChainTargets);
+		}
+	}
+
+	// Each iteration of a chain places every bone twice, and a closed form answer places each bone once
+	for (UFabrikChain* Chain : Chains)
+	{
+		if (Chain->LastSolveChangedPose && !Chain->LastSolveSkipped)
+		{
+			LastBoneUpdates += (Chain->LastSolveIterations > 0) ? Chain->LastSolveIterations * Chain->NumBones * 2 : Chain->NumBones;
+		}
+	}
+}
+
+void UFabrikStructure::GatherSubBasePulls(FVector InNewTargetLocation, const TArray<FVector>* InChainTargets)
+{
+	for (UFabrikChain* Chain : Chains)
+	{
+		Chain->ClearSubBasePulls();
+	}
+
+	// Connected chains always come after their hosts, so walking backwards reaches every chain after all the chains
+	// connected to it have added their pulls, and its own forward pass already leans towards them
+	for (int Loop = Chains.Num() - 1; Loop >= 0; --Loop)
+	{
+		UFabrikChain* ThisChain = Chains[Loop];
+		const int HostChainNumber = ThisChain->ConnectedChainNumber;
+		if (HostChainNumber < 0 || HostChainNumber >= Loop || ThisChain->NumBones == 0)
+		{
+			continue;
+		}
+
+		UFabrikChain* HostChain = Chains[HostChainNumber];
+		const int HostBoneNumber = ThisChain->ConnectedBoneNumber;
+		const int HostJointNumber = (HostChain->GetBone(HostBoneNumber)->BoneConnectionPoint == EBoneConnectionPoint::BCP_Start) ? HostBoneNumber : HostBoneNumber + 1;
+
+		HostChain->AddSubBasePull(HostJointNumber, ThisChain->ReachForward(GetChainTarget(Loop, InNewTargetLocation, InChainTargets)));
+		LastBoneUpdates += ThisChain->NumBones;
+	}
+}
+
+FVector UFabrikStructure::GetChainTarget(int InChainIndex, FVector InNewTargetLocation, const TArray<FVector>* InChainTargets)
+{
+	// A target buffer overrides both the shared target and any embedded target
+	if (InChainTargets)
+	{
+		return (*InChainTargets)[InChainIndex];
+	}
+
+	UFabrikChain* ThisChain = Chains[InChainIndex];
+	return (ThisChain->ConnectedChainNumber != -1 && ThisChain->UseEmbeddedTarget) ? ThisChain->EmbeddedTarget : InNewTargetLocation;
+}
 
+void UFabrikStructure::SolveChain(int InChainIndex, FVector InNewTargetLocation, const TArray<FVector>* InChainTargets)
+{
+	int ConnectedChainNumber;
+
+	// Get this chain, and get the number of the chain in this structure it's connected to (if any)
+	UFabrikChain* ThisChain = Chains[InChainIndex];
+
+	ConnectedChainNumber = ThisChain->ConnectedChainNumber;// getConnectedChainNumber();
+
+	// A target buffer overrides both the shared target and any embedded target
+	if (InChainTargets)
+	{
+		InNewTargetLocation = (*InChainTargets)[InChainIndex];
+	}
+
+	// Nothing this chain depends on has changed? Then its solve would be a no-op, so skip the host bone lookups and
+	// local basebone matrices as well
+	const bool bUsesEmbeddedTarget = (ConnectedChainNumber != -1) && !InChainTargets && ThisChain->UseEmbeddedTarget;
+	if (UseDirtyPropagation && IsChainClean(InChainIndex, bUsesEmbeddedTarget ? ThisChain->EmbeddedTarget : InNewTargetLocation))
+	{
+		ThisChain->LastSolveChangedPose = false;
+		ThisChain->LastSolveCutShort = false;
+		ThisChain->LastSolveSkipped = true;
+		++ThisChain->NumSolvesSkipped;
+		return;
+	}
+
+	// If this chain isn't connected to another chain then update as normal...
+	if (ConnectedChainNumber == -1)
+	{
+		ThisChain->SolveForTarget(InNewTargetLocation, ChainDeadlines[InChainIndex]);
+	}
+	else // ...however, if this chain IS connected to another chain...
+	{
+		// ... get the host chain and bone which this chain is connected to
+		UFabrikChain* HostChain = Chains[ConnectedChainNumber];
+		UFabrikBone* HostBone = HostChain->GetBone(ThisChain->ConnectedBoneNumber); //.getConnectedBoneNumber());
+
+		if (HostBone->BoneConnectionPoint == EBoneConnectionPoint::BCP_Start)
+		{ 
+			// setBaseLocation => mFixedBaseLocation 
+			ThisChain->FixedBaseLocation = HostBone->StartLocation; // setBaseLocation(hostBone.getStartLocation());
+		}
+		else 
+		{ 
+			// setBaseLocation => mFixedBaseLocation 
+			ThisChain->FixedBaseLocation = HostBone->EndLocation;  // setBaseLocation(hostBone.getEndLocation()); } 
+		}
+
+		// Now that we've clamped the base location of this chain to the start or end point of the bone in the chain we are connected to, it's
+		// time to deal with any base bone constraints...
+
+		// What type of base bone constraint is this (connected to another) chain using? 
+		EBoneConstraintType ConstraintType = ThisChain->BaseboneConstraintType;
+
+		switch (ConstraintType)
+		{
+			// None or global basebone constraints? Nothing to do, because these will be handled in FabrikChain3D.solveIK() as we do not
+			// need information from another chain to handle them.
+		case EBoneConstraintType::BCT_None: // NONE:         // Nothing to do because there's no basebone constraint
+		case EBoneConstraintType::BCT_GlobalRotor:// GLOBAL_ROTOR: // Nothing to do because the basebone constraint is not relative to bones in other chains in this structure
+		case EBoneConstraintType::BCT_GlobalHinge: //  GLOBAL_HINGE: // Nothing to do because the basebone constraint is not relative to bones in other chains in this structure
+			break;
+
+			// If we have a local rotor or hinge constraint then we must calculate the relative basebone constraint before calling updateTarget
+		case EBoneConstraintType::BCT_LocalRotor: // LOCAL_ROTOR:
+		case EBoneConstraintType::BCT_LocalHinge: { // LOCAL_HINGE: {
+			// Get the direction of the bone this chain is connected to and create a rotation matrix from it.
+			//Mat3f ConnectionBoneMatrix = Mat3f.createRotationMatrix(HostBone.getDirectionUV());
+			FFabrikMat3f ConnectionBoneMatrix = FFabrikMat3f::CreateRotationMatrix(HostBone->GetDirectionUV());
+			// We'll then get the basebone constraint UV and multiply it by the rotation matrix of the connected bone 
+			// to make the basebone constraint UV relative to the direction of bone it's connected to.
+			FVector RelativeBaseboneConstraintUV = ConnectionBoneMatrix.Times(ThisChain->BaseboneConstraintUV);// .normalised();
+			RelativeBaseboneConstraintUV.Normalize();
+
+			// Update our basebone relative constraint UV property
+			ThisChain->BaseboneRelativeConstraintUV = RelativeBaseboneConstraintUV;
+
+			// Update the relative reference constraint UV if we hav a local hinge
+			if (ConstraintType == EBoneConstraintType::BCT_LocalHinge)
+			{
+				//getHingeReferenceAxis() => mReferenceAxisUV
+				ThisChain->BaseboneRelativeReferenceConstraintUV = ConnectionBoneMatrix.Times(ThisChain->GetBone(0)->Joint->ReferenceAxisUV);// .getHingeReferenceAxis()));
 			}
+			break;
+		}
+						  // No need for a default - constraint types are enums and we've covered them all.
 
-			// NOTE: If the base bone constraint type is NONE then we don't do anything with the base bone constraint of the connected chain.
+		}
+
+		// NOTE: If the base bone constraint type is NONE then we don't do anything with the base bone constraint of the connected chain.
 
-			// Finally, update the target and solve the chain
-			// Update the target and solve the chain
-			if (!ThisChain->UseEmbeddedTarget) // GetEmbeddedTargetMode)
+		// Finally, update the target and solve the chain
+		// Update the target and solve the chain
+		if (InChainTargets || !ThisChain->UseEmbeddedTarget) // GetEmbeddedTargetMode)
+		{
+			ThisChain->SolveForTarget(InNewTargetLocation, ChainDeadlines[InChainIndex]);
+		}
+		else
+		{
+			ThisChain->SolveForEmbeddedTarget(ChainDeadlines[InChainIndex]);
+		}
+
+	} // End of if chain is connected to another chain section
+}
+
+void UFabrikStructure::RebuildSolveLevels()
+{
+	const int NumChainsL = Chains.Num();
+	SolveLevelChains.Reset(NumChainsL);
+	SolveLevelStarts.Reset();
+	bSolveLevelsValid = true;
+
+	// A chain sits one level above its host, which ConnectChain guarantees comes before it
+	TArray<int> ChainLevels;
+	ChainLevels.SetNumUninitialized(NumChainsL);
+	int NumLevels = 0;
+	for (int Loop = 0; Loop < NumChainsL; ++Loop)
+	{
+		const int HostChainNumber = Chains[Loop]->ConnectedChainNumber;
+		if (HostChainNumber == -1)
+		{
+			ChainLevels[Loop] = 0;
+		}
+		else if (HostChainNumber >= 0 && HostChainNumber < Loop)
+		{
+			ChainLevels[Loop] = ChainLevels[HostChainNumber] + 1;
+		}
+		else
+		{
+			ChainLevels[Loop] = 0;
+			bSolveLevelsValid = false;
+		}
+		NumLevels = FMath::Max(NumLevels, ChainLevels[Loop] + 1);
+	}
+
+	for (int Level = 0; Level < NumLevels; ++Level)
+	{
+		SolveLevelStarts.Add(SolveLevelChains.Num());
+		for (int Loop = 0; Loop < NumChainsL; ++Loop)
+		{
+			if (ChainLevels[Loop] == Level)
 			{
-				ThisChain->SolveForTarget(InNewTargetLocation);
+				SolveLevelChains.Add(Loop);
 			}
-			else
+		}
+	}
+	SolveLevelStarts.Add(SolveLevelChains.Num());
+}
+
+bool UFabrikStructure::IsChainClean(int InChainIndex, const FVector& InTarget)
+{
+	UFabrikChain* Chain = Chains[InChainIndex];
+	if (Chain->PoseDirty || !Chain->SubBasePullsMatchLastSolve() || !UFabrikUtil::VectorApproximatelyEquals(Chain->LastTargetLocation, InTarget, 0.001f))
+	{
+		return false;
+	}
+
+	// Connected chains are based on their host bone, which only moves when the host chain does. Host chains always
+	// come first, so the host's flag is already up to date for this solve.
+	const int HostChainNumber = Chain->ConnectedChainNumber;
+	if (HostChainNumber != -1)
+	{
+		return HostChainNumber >= 0 && HostChainNumber < InChainIndex && !Chains[HostChainNumber]->LastSolveChangedPose;
+	}
+
+	// Otherwise a fixed base only moves if someone moved it
+	return !Chain->FixedBaseMode || UFabrikUtil::VectorApproximatelyEquals(Chain->FixedBaseLocation, Chain->LastBaseLocation, 0.001f);
+}
+
+void UFabrikStructure::SetLOD(int InLOD)
+{
+	CurrentLOD = LODLevels.Num() > 0 ? FMath::Clamp(InLOD, 0, LODLevels.Num() - 1) : 0;
+}
+
+void UFabrikStructure::SetLODFromDistance(float InDistance)
+{
+	for (int Loop = 0; Loop < LODLevels.Num(); ++Loop)
+	{
+		if (InDistance <= LODLevels[Loop].MaxDistance)
+		{
+			SetLOD(Loop);
+			return;
+		}
+	}
+	SetLOD(LODLevels.Num() - 1);
+}
+
+int UFabrikStructure::GetNumJoints() const
+{
+	int NumJoints = 0;
+	for (UFabrikChain* Chain : Chains)
+	{
+		NumJoints += (Chain->NumBones > 0) ? Chain->NumBones + 1 : 0;
+	}
+	return NumJoints;
+}
+
+void UFabrikStructure::GatherJoints(TArray<FVector>& OutJoints)
+{
+	OutJoints.Reset();
+	for (UFabrikChain* Chain : Chains)
+	{
+		for (int Loop = 0; Loop < Chain->NumBones; ++Loop)
+		{
+			OutJoints.Add(Chain->GetBone(Loop)->StartLocation);
+		}
+		if (Chain->NumBones > 0)
+		{
+			OutJoints.Add(Chain->GetBone(Chain->NumBones - 1)->EndLocation);
+		}
+	}
+}
+
+void UFabrikStructure::ApplyJoints(const TArray<FVector>& InJoints)
+{
+	int JointIndex = 0;
+	for (UFabrikChain* Chain : Chains)
+	{
+		for (int Loop = 0; Loop < Chain->NumBones; ++Loop)
+		{
+			UFabrikBone* Bone = Chain->GetBone(Loop);
+			Bone->StartLocation = InJoints[JointIndex + Loop];
+			Bone->EndLocation = InJoints[JointIndex + Loop + 1];
+		}
+		JointIndex += (Chain->NumBones > 0) ? Chain->NumBones + 1 : 0;
+	}
+}
+
+void UFabrikStructure::ApplyBlendedJoints(const TArray<FVector>& InFromJoints, const TArray<FVector>& InToJoints, float InAlpha)
+{
+	int JointIndex = 0;
+	for (int ChainIndex = 0; ChainIndex < Chains.Num(); ++ChainIndex)
+	{
+		UFabrikChain* Chain = Chains[ChainIndex];
+		if (Chain->NumBones == 0)
+		{
+			continue;
+		}
+
+		// A connected chain sits on its host's bone as already blended, so it stays attached mid blend. Hosts come
+		// first, so that bone is in place by now. Any other base slides from one location to the other.
+		FVector StartLocation;
+		const int HostChainNumber = Chain->ConnectedChainNumber;
+		if (HostChainNumber >= 0 && HostChainNumber < ChainIndex && Chains[HostChainNumber]->NumBones > 0)
+		{
+			UFabrikBone* HostBone = Chains[HostChainNumber]->GetBone(Chain->ConnectedBoneNumber);
+			StartLocation = (HostBone->BoneConnectionPoint == EBoneConnectionPoint::BCP_Start) ? HostBone->StartLocation : HostBone->EndLocation;
+		}
+		else
+		{
+			StartLocation = FMath::Lerp(InFromJoints[JointIndex], InToJoints[JointIndex], InAlpha);
+		}
+
+		// Then turn each bone from one direction towards the other and lay it end to end
+		for (int Loop = 0; Loop < Chain->NumBones; ++Loop)
+		{
+			const FVector FromDirection = (InFromJoints[JointIndex + Loop + 1] - InFromJoints[JointIndex + Loop]).GetSafeNormal();
+			const FVector ToDirection = (InToJoints[JointIndex + Loop + 1] - InToJoints[JointIndex + Loop]).GetSafeNormal();
+			FVector Direction = FMath::Lerp(FromDirection, ToDirection, InAlpha).GetSafeNormal();
+			if (Direction.IsZero())
 			{
-				ThisChain->SolveForEmbeddedTarget();
+				Direction = ToDirection;
 			}
 
-		} // End of if chain is connected to another chain section
+			UFabrikBone* Bone = Chain->GetBone(Loop);
+			Bone->StartLocation = StartLocation;
+			Bone->EndLocation = StartLocation + Direction * Bone->Length;
+			StartLocation = Bone->EndLocation;
+		}
+		JointIndex += Chain->NumBones + 1;
+	}
+}
+
+void UFabrikStructure::ResetTelemetry()
+{
+	LastNumChainsSkipped = 0;
+	TotalChainsSkipped = 0;
+	NumSolvesSkipped = 0;
+	NumSolvesDecimated = 0;
+	for (UFabrikChain* Chain : Chains)
+	{
+		Chain->ResetTelemetry();
+	}
+}
 
-	} // End of loop over chains
+bool UFabrikStructure::CanSolveInParallel()
+{
+	// Chains is editable from outside, so catch up with any changes that did not go through AddChain or RemoveChain
+	if (SolveLevelChains.Num() != Chains.Num())
+	{
+		RebuildSolveLevels();
+	}
+	return bSolveLevelsValid && CanSolveOffGameThread();
+}
 
-} // End of updateTarget method
+bool UFabrikStructure::CanSolveOffGameThread() const
+{
+	// Cloning bones for the best solution creates UObjects, which must stay on the game thread
+	for (UFabrikChain* Chain : Chains)
+	{
+		if (!Chain->UseChainData || !Chain->TrackBestSolutionInPlace)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void UFabrikStructure::GetChainBudgetWeights(TArray<float>& OutWeights) const
+{
+	float TotalPriority = 0.0f;
+	for (UFabrikChain* Chain : Chains)
+	{
+		TotalPriority += FMath::Max(Chain->SolvePriority, 0.0f);
+	}
+
+	// Without any priorities set every chain gets the same share
+	OutWeights.SetNumUninitialized(Chains.Num(), false);
+	for (int Loop = 0; Loop < Chains.Num(); ++Loop)
+	{
+		OutWeights[Loop] = TotalPriority > 0.0f ? FMath::Max(Chains[Loop]->SolvePriority, 0.0f) : 1.0f;
+	}
+}
+
+float UFabrikStructure::GetLevelBudgetWeight(int InLevel) const
+{
+	float LevelWeight = 0.0f;
+	for (int Index = SolveLevelStarts[InLevel]; Index < SolveLevelStarts[InLevel + 1]; ++Index)
+	{
+		LevelWeight = FMath::Max(LevelWeight, ChainBudgetWeights[SolveLevelChains[Index]]);
+	}
+	return LevelWeight;
+}
 
+double UFabrikStructure::GetDeadline(double InNowSeconds, double InEndSeconds, float InWeight, float InWeightLeft)
+{
+	const double Share = InWeightLeft > 0.0f ? FMath::Min(InWeight / InWeightLeft, 1.0f) : 1.0;
+	return InNowSeconds + FMath::Max(InEndSeconds - InNowSeconds, 0.0) * Share;
+}
 
 void UFabrikStructure::SolveForTarget(float InTargetX, float InTargetY, float InTargetZ)
  {
@@ -121,6 +715,7 @@ void UFabrikStructure::AddChain(UFabrikChain* InChain)
 {
 	Chains.Add(InChain);
 	++NumChains;
+	RebuildSolveLevels();
 }
 
 void UFabrikStructure::RemoveChain(int InChainIndex)
@@ -128,6 +723,7 @@ void UFabrikStructure::RemoveChain(int InChainIndex)
 
 	Chains.RemoveAt(InChainIndex);
 	--NumChains;
+	RebuildSolveLevels();
 }
 
 void UFabrikStructure::ConnectChain(UFabrikChain* InNewChain, int InExistingChainNumber, int InExistingBoneNumber)
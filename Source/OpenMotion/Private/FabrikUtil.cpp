@@ -25,36 +25,8 @@ const FVector UFabrikUtil::Z_AXIS(0, 0, 1);
 
 FVector UFabrikUtil::RotateAboutAxisRads(FVector InSource, float InAngleRads, FVector InRotationAxis)
 {
-	
-	//Mat3f rotationMatrix = new Mat3f();
-	UFabrikMat3f* RotationMatrix = NewObject<UFabrikMat3f>();
-
-	float sinTheta = (float)FMath::Sin(InAngleRads);
-	float cosTheta = (float)FMath::Cos(InAngleRads);
-	float oneMinusCosTheta = 1.0f - cosTheta;
-
-	// It's quicker to pre-calc these and reuse than calculate x * y, then y * x later (same thing).
-	float xyOne = InRotationAxis.X * InRotationAxis.Y * oneMinusCosTheta;
-	float xzOne = InRotationAxis.X * InRotationAxis.Z * oneMinusCosTheta;
-	float yzOne = InRotationAxis.Y * InRotationAxis.Z * oneMinusCosTheta;
-
-	// Calculate rotated x-axis
-	RotationMatrix->m00 = InRotationAxis.X * InRotationAxis.X * oneMinusCosTheta + cosTheta;
-	RotationMatrix->m01 = xyOne + InRotationAxis.Z * sinTheta;
-	RotationMatrix->m02 = xzOne - InRotationAxis.Y * sinTheta;
-
-	// Calculate rotated y-axis
-	RotationMatrix->m10 = xyOne - InRotationAxis.Z * sinTheta;
-	RotationMatrix->m11 = InRotationAxis.Y * InRotationAxis.Y * oneMinusCosTheta + cosTheta;
-	RotationMatrix->m12 = yzOne + InRotationAxis.X * sinTheta;
-
-	// Calculate rotated z-axis
-	RotationMatrix->m20 = xzOne + InRotationAxis.Y * sinTheta;
-	RotationMatrix->m21 = yzOne - InRotationAxis.X * sinTheta;
-	RotationMatrix->m22 = InRotationAxis.Z * InRotationAxis.Z * oneMinusCosTheta + cosTheta;
-
-	// Multiply the source by the rotation matrix we just created to perform the rotation
-	return RotationMatrix->Times(InSource);
+	// Multiply the source by the rotation matrix to perform the rotation
+	return FFabrikMat3f::CreateAxisAngleMatrix(InRotationAxis, InAngleRads).Times(InSource);
 }
 
 
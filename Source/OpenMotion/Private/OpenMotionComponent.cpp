@@ -5,11 +5,12 @@
 #include "..\Public\OpenMotionComponent.h"
 
 #include "Engine.h"
-//#include "Kismet/KismetSystemLibrary.h"
-#include "Kismet/KismetMathLibrary.h"
-#include "Kismet/GameplayStatics.h"
 
+#include "Engine/SkeletalMeshSocket.h"
 #include "GameFramework/Character.h"
+#include "Net/UnrealNetwork.h"
+
+#include "OpenMotion.h"
 
 // Sets default values for this component's properties
 UOpenMotionComponent::UOpenMotionComponent()
@@ -17,8 +18,14 @@ UOpenMotionComponent::UOpenMotionComponent()
 	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UOpenMotionComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	// ...
+	// The owner has the trackers themselves
+	DOREPLIFETIME_CONDITION(UOpenMotionComponent, ReplicatedEffectors, COND_SkipOwner);
 }
 
 
@@ -27,8 +34,11 @@ void UOpenMotionComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// ...
-	
+	// Only ReplicatedEffectors is replicated, so components that don't share their effectors stay off the network
+	if (ReplicateEffectors)
+	{
+		SetIsReplicated(true);
+	}
 }
 
 
@@ -49,11 +59,9 @@ void UOpenMotionComponent::TickComponent(float DeltaTime, ELevelTick TickType, F
 
 void UOpenMotionComponent::CustomTick(USkeletalMeshComponent* OwnerMesh)
 {
-	ConvertTransforms();
-	SetShoulder();
-	SetLeftUpperArm(); SetRightUpperArm();
-	ResetUpperArmsLocation(OwnerMesh); SolveArms();
-	CharacterSettings.CharacterBaseTransform = GetBaseCharTransform();
+	FOpenMotionUpperBodyPose Pose = GetPose();
+	FOpenMotionUpperBodySolver::Solve(MakeInput(OwnerMesh), TransformSettings, Pose);
+	SetPose(Pose);
 
 	if (TransformSettings.DrawDebug)
 	{
@@ -61,132 +69,152 @@ void UOpenMotionComponent::CustomTick(USkeletalMeshComponent* OwnerMesh)
 	}
 }
 
-void UOpenMotionComponent::ConvertTransforms()
+void UOpenMotionComponent::CustomTickBatch(const TArray<UOpenMotionComponent*>& Components, const TArray<USkeletalMeshComponent*>& OwnerMeshes)
 {
-	FTransform LeftHandInverseLocation = WorldTransforms.LeftHandEffector.Inverse();
-	FTransform RightHandInverseLocation = WorldTransforms.RightHandEffector.Inverse();
+	// Everything that touches a UObject happens here on the game thread, either side of the solve. The inputs are
+	// already filtered and predicted, per avatar, by SetCharacterTransforms.
+	TArray<FOpenMotionUpperBodyInput> Inputs;
+	TArray<FTransformSettings> Settings;
+	TArray<FOpenMotionUpperBodyPose> Poses;
+	TArray<UOpenMotionComponent*> Solved;
+	for (int32 Loop = 0; Loop < Components.Num(); ++Loop)
+	{
+		UOpenMotionComponent* Component = Components[Loop];
+		if (Component != nullptr)
+		{
+			Inputs.Add(Component->MakeInput(OwnerMeshes.IsValidIndex(Loop) ? OwnerMeshes[Loop] : nullptr));
+			Settings.Add(Component->TransformSettings);
+			Poses.Add(Component->GetPose());
+			Solved.Add(Component);
+		}
+	}
 
-	WorldTransforms.LeftHandEffector = FTransform(LeftHandInverseLocation.GetRotation(), LeftHandInverseLocation.GetLocation() + FVector(8.0f, 0.f, 0.f), LeftHandInverseLocation.GetScale3D());
-	WorldTransforms.RightHandEffector = FTransform(RightHandInverseLocation.GetRotation(), RightHandInverseLocation.GetLocation() + FVector(8.0f, 0.f, 0.f), RightHandInverseLocation.GetScale3D()).Inverse();
+	FOpenMotionUpperBodySolver::SolveBatch(Inputs, Settings, Poses);
 
-	FTransform LocalComponentTransform = WorldTransforms.Component.Inverse();
-	ComponentTransforms.HeadEffector = WorldTransforms.HeadEffector * LocalComponentTransform;
-	ComponentTransforms.LeftHandEffector = WorldTransforms.LeftHandEffector * LocalComponentTransform;
-	ComponentTransforms.RightHandEffector = WorldTransforms.RightHandEffector * LocalComponentTransform;
+	for (int32 Loop = 0; Loop < Solved.Num(); ++Loop)
+	{
+		Solved[Loop]->SetPose(Poses[Loop]);
+		if (Solved[Loop]->TransformSettings.DrawDebug)
+		{
+			Solved[Loop]->DebugDraw();
+		}
+	}
+}
 
-	WorldTransforms.Shoulder = ComponentTransforms.Shoulder * WorldTransforms.Component;
-	FTransform LocalShoulderTransform = WorldTransforms.Shoulder.Inverse();
-	ShoulderTransforms.HeadEffector = WorldTransforms.HeadEffector * LocalShoulderTransform;
-	ShoulderTransforms.LeftHandEffector = WorldTransforms.LeftHandEffector * LocalShoulderTransform;
-	ShoulderTransforms.RightHandEffector = WorldTransforms.RightHandEffector * LocalShoulderTransform;
+void UOpenMotionComponent::ConvertTransforms()
+{
+	FOpenMotionUpperBodyPose Pose = GetPose();
+	FOpenMotionUpperBodySolver::ConvertTransforms(Pose);
+	SetPose(Pose);
 }
 
 void UOpenMotionComponent::SetCharacterTransforms(FTransform LeftHandEffector, FTransform RightHandEffector, FTransform HeadEffector, FTransform ComponentTransform)
 {
+	if (ReplicateEffectors)
+	{
+		if (IsDrivenLocally())
+		{
+			ReplicatedEffectors.SetEffectors(ComponentTransform, HeadEffector, LeftHandEffector, RightHandEffector);
+			if (GetOwnerRole() != ROLE_Authority)
+			{
+				ServerSetEffectors(ReplicatedEffectors);
+			}
+		}
+		else
+		{
+			// A remote avatar follows its owner's trackers, placed on wherever the avatar is here
+			ReplicatedEffectors.GetEffectors(ComponentTransform, HeadEffector, LeftHandEffector, RightHandEffector);
+		}
+	}
+
 	WorldTransforms.LeftHandEffector = LeftHandEffector;
 	WorldTransforms.RightHandEffector = RightHandEffector;
 	WorldTransforms.HeadEffector = HeadEffector;
 	WorldTransforms.Component = ComponentTransform;
+
+	const double SampleTime = FPlatformTime::Seconds();
+	const float SampleDeltaSeconds = (LastSampleTime > 0.0) ? (float)(SampleTime - LastSampleTime) : 0.f;
+	LastSampleTime = SampleTime;
+
+	// Smooth out the tracker jitter first, so the prediction works from a steady signal
+	if (FilterSettings.Enabled)
+	{
+		FOpenMotionEffectorFilter::Filter(FilterSettings, SampleDeltaSeconds, WorldTransforms.HeadEffector, WorldTransforms.LeftHandEffector, WorldTransforms.RightHandEffector, FilterState);
+	}
+
+	if (PredictionSettings.Enabled)
+	{
+		// Solve for where the trackers will be when this frame is displayed rather than where they were sampled
+		const double DisplayTime = SampleTime + PredictionSettings.PredictionSeconds;
+
+		LeftHandPredictor.AddSample(WorldTransforms.LeftHandEffector, SampleTime);
+		RightHandPredictor.AddSample(WorldTransforms.RightHandEffector, SampleTime);
+		HeadPredictor.AddSample(WorldTransforms.HeadEffector, SampleTime);
+
+		WorldTransforms.LeftHandEffector = LeftHandPredictor.Predict(DisplayTime, PredictionSettings);
+		WorldTransforms.RightHandEffector = RightHandPredictor.Predict(DisplayTime, PredictionSettings);
+		WorldTransforms.HeadEffector = HeadPredictor.Predict(DisplayTime, PredictionSettings);
+	}
 }
 
-void UOpenMotionComponent::SetShoulder()
+bool UOpenMotionComponent::ServerSetEffectors_Validate(const FOpenMotionReplicatedEffectors& Effectors)
 {
-	FVector A = UKismetMathLibrary::Multiply_VectorFloat(UKismetMathLibrary::Vector_Down(), 0.7f) + UKismetMathLibrary::Multiply_VectorFloat(UKismetMathLibrary::Vector_Backward(), 9.f);
-	FRotator B = FRotator(0.f, ComponentTransforms.HeadEffector.GetRotation().Z, ComponentTransforms.HeadEffector.GetRotation().X);
-	FVector RotatedVector = UKismetMathLibrary::GreaterGreater_VectorRotator(A, B);
+	return true;
+}
 
-	FRotator Delta = FRotator(ComponentTransforms.HeadEffector.GetRotation().Y, 0.f, 0.f);
-	FVector TransformedLocation = ComponentTransforms.HeadEffector.GetLocation() + RotatedVector;
-	FTransform RotationPoint = FTransform(FRotator(0.f, 0.f, 0.f), TransformedLocation, FVector(1, 1, 1));
+void UOpenMotionComponent::ServerSetEffectors_Implementation(const FOpenMotionReplicatedEffectors& Effectors)
+{
+	ReplicatedEffectors.HeadEffector = Effectors.HeadEffector;
+	ReplicatedEffectors.LeftHandEffector = Effectors.LeftHandEffector;
+	ReplicatedEffectors.RightHandEffector = Effectors.RightHandEffector;
+}
 
-	FVector ComponentShoulderLocation = RotatePointAroundPivot(RotationPoint, ComponentTransforms.HeadEffector, Delta).GetLocation() + FVector(0, 0, -17);
-	FRotator ComponentShoulderRotation = FRotator(0.f, UKismetMathLibrary::RLerp(GetShoulderRotationFromHead(), GetShoulderRotationFromHands(), 0.7f, true).Yaw, 0.f);
+bool UOpenMotionComponent::IsDrivenLocally() const
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	return Pawn ? Pawn->IsLocallyControlled() : GetOwnerRole() == ROLE_Authority;
+}
 
-	ComponentTransforms.Shoulder = FTransform(ComponentShoulderRotation, ComponentShoulderLocation, FVector(1, 1, 1));
+void UOpenMotionComponent::SetShoulder()
+{
+	FOpenMotionUpperBodyPose Pose = GetPose();
+	FOpenMotionUpperBodySolver::SetShoulder(TransformSettings, Pose);
+	SetPose(Pose);
 }
 
 void UOpenMotionComponent::SetLeftUpperArm()
 {
-	ShoulderTransforms.LeftUpperArm = RotateUpperArm(true, ShoulderTransforms.LeftHandEffector.GetLocation());
-	FRotator ModifiedRotator = UKismetMathLibrary::MakeRotFromXZ((ShoulderTransforms.LeftUpperArm * WorldTransforms.Shoulder).GetLocation() - WorldTransforms.Shoulder.GetLocation(), UKismetMathLibrary::Vector_Up());
-	ComponentTransforms.LeftClavicle = FTransform(ModifiedRotator, FVector(0, 0, 0), FVector(1, 1, 1)) * WorldTransforms.Component.Inverse();
+	FOpenMotionUpperBodyPose Pose = GetPose();
+	FOpenMotionUpperBodySolver::SetLeftUpperArm(TransformSettings, Pose);
+	SetPose(Pose);
 }
 
 void UOpenMotionComponent::SetRightUpperArm()
 {
-	ShoulderTransforms.RightUpperArm = RotateUpperArm(false, ShoulderTransforms.RightHandEffector.GetLocation());
-	FRotator ModifiedRotator = UKismetMathLibrary::MakeRotFromXZ((ShoulderTransforms.RightUpperArm * WorldTransforms.Shoulder).GetLocation() - WorldTransforms.Shoulder.GetLocation(), UKismetMathLibrary::Vector_Up());
-	ComponentTransforms.RightClavicle = FTransform(ModifiedRotator, FVector(0, 0, 0), FVector(1, 1, 1)) * WorldTransforms.Component.Inverse();
+	FOpenMotionUpperBodyPose Pose = GetPose();
+	FOpenMotionUpperBodySolver::SetRightUpperArm(TransformSettings, Pose);
+	SetPose(Pose);
 }
 
 void UOpenMotionComponent::ResetUpperArmsLocation(USkeletalMeshComponent* OwnerMesh)
 {
 	if (OwnerMesh != nullptr)
 	{
-		FVector LeftUpperArmLocation = OwnerMesh->GetSocketLocation("UpperArm_l");
-		FVector RightUpperArmLocation = OwnerMesh->GetSocketLocation("UpperArm_r");
-		ShoulderTransforms.LeftUpperArm = FTransform(FRotator(0.f, 0.f, 0.f), WorldTransforms.Shoulder.InverseTransformPosition(LeftUpperArmLocation), FVector(1, 1, 1));
-		ShoulderTransforms.RightUpperArm = FTransform(FRotator(0.f, 0.f, 0.f), WorldTransforms.Shoulder.InverseTransformPosition(RightUpperArmLocation), FVector(1, 1, 1));
+		FVector LeftUpperArmLocation;
+		FVector RightUpperArmLocation;
+		GetUpperArmLocations(OwnerMesh, LeftUpperArmLocation, RightUpperArmLocation);
+
+		FOpenMotionUpperBodyPose Pose = GetPose();
+		FOpenMotionUpperBodySolver::ResetUpperArmsLocation(LeftUpperArmLocation, RightUpperArmLocation, Pose);
+		SetPose(Pose);
 	}
 }
 
 void UOpenMotionComponent::SolveArms()
 {
-	FVector Local_HandLocation = FVector(ShoulderTransforms.LeftHandEffector.GetLocation());
-	FRotator Local_HandRotation = FRotator(ShoulderTransforms.LeftHandEffector.GetRotation());
-	FArmTransforms Local_BasePosition = SetElbowBasePosition(true, ShoulderTransforms.LeftLowerArm.GetLocation(), Local_HandLocation);
-	float Local_Angle = RotateElbowByHandPosition(true, Local_HandLocation);
-	FArmTransforms TempArms = RotateElbow(true, Local_Angle, Local_BasePosition, Local_HandLocation);
-	float TempAngle = RotateElbowByHandRotation(TempArms.LowerArmTransform, Local_HandRotation);
-
-	CharacterSettings.LeftElbowHandAngle = UKismetMathLibrary::FInterpTo(
-		CharacterSettings.LeftElbowHandAngle,
-		SafeguardAngle(CharacterSettings.LeftElbowHandAngle, TempAngle, 120.f),
-		UGameplayStatics::GetWorldDeltaSeconds(GEngine->GetWorldContexts()[0].World()),
-		TransformSettings.ElbowHandRotSpeed);
-
-	FArmTransforms TempArms2 = RotateElbow(true, CharacterSettings.LeftElbowHandAngle + Local_Angle, Local_BasePosition, Local_HandLocation);
-	ShoulderTransforms.LeftUpperArm = TempArms2.UpperArmTransform;
-	WorldTransforms.LeftUpperArm = ShoulderTransforms.LeftUpperArm * WorldTransforms.Shoulder;
-
-	ShoulderTransforms.LeftLowerArm = TempArms2.LowerArmTransform;
-	WorldTransforms.LeftLowerArm = ShoulderTransforms.LeftLowerArm * WorldTransforms.Shoulder;
-	FTransform TempTransform = WorldTransforms.LeftUpperArm * WorldTransforms.Component.Inverse();
-	FVector TempLocation = WorldTransforms.LeftHandEffector.GetLocation() - WorldTransforms.LeftUpperArm.GetLocation();
-	FRotator TempRotator = UKismetMathLibrary::ComposeRotators(FRotator(0.f, 0.f, UKismetMathLibrary::Max(TempLocation.Z, 0.f)), FRotator(TempTransform.GetRotation()));
-
-	ComponentTransforms.LeftUpperArm = FTransform(TempRotator, TempTransform.GetLocation(), FVector(1, 1, 1));
-
-	ComponentTransforms.LeftLowerArm = WorldTransforms.LeftLowerArm * WorldTransforms.Component.Inverse();
-
-	//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-	FVector Local_HandLocation2 = FVector(ShoulderTransforms.RightHandEffector.GetLocation());
-	FRotator Local_HandRotation2 = FRotator(ShoulderTransforms.RightHandEffector.GetRotation());
-	FArmTransforms Local_BasePosition2 = SetElbowBasePosition(true, ShoulderTransforms.RightLowerArm.GetLocation(), Local_HandLocation2);
-	float Local_Angle2 = RotateElbowByHandPosition(true, Local_HandLocation2);
-	FArmTransforms TempArms3 = RotateElbow(true, Local_Angle2, Local_BasePosition2, Local_HandLocation2);
-	float TempAngle2 = RotateElbowByHandRotation(TempArms3.LowerArmTransform, Local_HandRotation2);
-
-	CharacterSettings.RightElbowHandAngle = UKismetMathLibrary::FInterpTo(
-		CharacterSettings.RightElbowHandAngle,
-		SafeguardAngle(CharacterSettings.RightElbowHandAngle, TempAngle2, 120.f),
-		UGameplayStatics::GetWorldDeltaSeconds(GEngine->GetWorldContexts()[0].World()),
-		TransformSettings.ElbowHandRotSpeed);
-
-	FArmTransforms TempArms4 = RotateElbow(true, CharacterSettings.RightElbowHandAngle + Local_Angle2, Local_BasePosition2, Local_HandLocation2);
-	ShoulderTransforms.RightUpperArm = TempArms4.UpperArmTransform;
-	WorldTransforms.RightUpperArm = ShoulderTransforms.RightUpperArm * WorldTransforms.Shoulder;
-
-	ShoulderTransforms.RightLowerArm = TempArms4.LowerArmTransform;
-	WorldTransforms.RightLowerArm = ShoulderTransforms.RightLowerArm * WorldTransforms.Shoulder;
-	FTransform TempTransform2 = WorldTransforms.RightUpperArm * WorldTransforms.Component.Inverse();
-	FVector TempLocation2 = WorldTransforms.RightHandEffector.GetLocation() - WorldTransforms.RightUpperArm.GetLocation();
-	FRotator TempRotator2 = UKismetMathLibrary::ComposeRotators(FRotator(0.f, 0.f, UKismetMathLibrary::Max(TempLocation2.Z, 0.f) * -1.f), FRotator(TempTransform2.GetRotation()));
-
-	ComponentTransforms.RightUpperArm = FTransform(TempRotator2, TempTransform2.GetLocation(), FVector(1, 1, 1));
-
-	ComponentTransforms.RightLowerArm = WorldTransforms.LeftLowerArm * WorldTransforms.Component.Inverse();
+	FOpenMotionUpperBodyPose Pose = GetPose();
+	FOpenMotionUpperBodySolver::SolveArms(TransformSettings, GetSolveDeltaSeconds(), Pose);
+	SetPose(Pose);
 }
 
 void UOpenMotionComponent::DebugDraw()
@@ -195,94 +223,47 @@ void UOpenMotionComponent::DebugDraw()
 
 void UOpenMotionComponent::Calibrate(float CharacterHeight)
 {
-	CharacterSettings.ArmLength = (CharacterHeight / 2) - TransformSettings.UpperArmsDistance;
-	CharacterSettings.UpperArmLength = CharacterSettings.ArmLength * (1.f - 0.48f);
-	CharacterSettings.LowerArmLength = CharacterSettings.ArmLength * 0.48f;
-	CharacterSettings.HeadHandAngleLimitDot = UKismetMathLibrary::DegCos(TransformSettings.HeadHandAngleLimit);
+	FOpenMotionUpperBodySolver::Calibrate(TransformSettings, CharacterHeight, CharacterSettings);
 }
 
 FTransform UOpenMotionComponent::RotateUpperArm(bool bIsLeftArm, FVector HandLocation)
 {
-	float TempFloat = TransformSettings.UpperArmsDistance / 2.f * UKismetMathLibrary::SelectFloat(1.f, -1.f, bIsLeftArm);
-	FVector LInitialUpperArmPos = UKismetMathLibrary::Multiply_VectorFloat(UKismetMathLibrary::Vector_Right(), TempFloat);
-	FVector LHandUpperArmDir = HandLocation - LInitialUpperArmPos;
-	float LForwardDistanceRatio = UKismetMathLibrary::Dot_VectorVector(LHandUpperArmDir, UKismetMathLibrary::Vector_Forward()) / CharacterSettings.ArmLength;
-	float LUpwardsDistanceRatio = UKismetMathLibrary::Dot_VectorVector(LHandUpperArmDir, UKismetMathLibrary::Vector_Up()) / CharacterSettings.ArmLength;
-
-	float LYaw = 0.f;
-	float LRoll = 0.f;
-
-	if (LForwardDistanceRatio > 0.f)
-	{
-		LYaw = UKismetMathLibrary::FClamp((LForwardDistanceRatio - 0.5f) * TransformSettings.DistinctShoulderRotationMultiplier, 0.f, TransformSettings.DistinctShoulderRotationLimit) + TransformSettings.ClavicleOffset;
-	}
-	else
-	{
-		LYaw = UKismetMathLibrary::FClamp((LForwardDistanceRatio - 0.08f) * TransformSettings.DistinctShoulderRotationMultiplier, TransformSettings.DistinctShoulderRotationLimit * -1.f, 0.f) + TransformSettings.ClavicleOffset;
-	}
-
-	LRoll = UKismetMathLibrary::FClamp((LUpwardsDistanceRatio - 0.2f) * TransformSettings.DistinctShoulderRotationMultiplier, 0.f, TransformSettings.DistinctShoulderRotationLimit) + TransformSettings.ClavicleOffset;
-
-	return FTransform(FRotator(0.f, LYaw * UKismetMathLibrary::SelectFloat(-1.f, 1.f, bIsLeftArm), LRoll * UKismetMathLibrary::SelectFloat(-1.f, 1.f, bIsLeftArm)), LInitialUpperArmPos, FVector(1, 1, 1)).Inverse();
+	return FOpenMotionUpperBodySolver::RotateUpperArm(TransformSettings, CharacterSettings, bIsLeftArm, HandLocation);
 }
 
 FArmTransforms UOpenMotionComponent::SetElbowBasePosition(bool bIsLeftArm, FVector UpperArmLocation, FVector HandLocation)
 {
-	float LUpperArmToHandLen = (UpperArmLocation - HandLocation).Size();
-	float LBeta = CosineRule(CharacterSettings.UpperArmLength, LUpperArmToHandLen, CharacterSettings.LowerArmLength) * UKismetMathLibrary::SelectFloat(-1.f, 1.f, bIsLeftArm);
-	float CRule = CosineRule(CharacterSettings.LowerArmLength, CharacterSettings.UpperArmLength, LUpperArmToHandLen);
-	float LOmega = UKismetMathLibrary::SelectFloat(180.f - CRule, CRule + 180, bIsLeftArm);
-	FVector B = HandLocation - UpperArmLocation;
-	UKismetMathLibrary::Vector_Normalize(B, 0.0001);
-	FRotator Normal = FindBetweenNormals(UKismetMathLibrary::Vector_Forward(), B);
-	FRotator Rotator = FRotator(UKismetMathLibrary::ComposeRotators(Normal, UKismetMathLibrary::RotatorFromAxisAndAngle(UKismetMathLibrary::GetUpVector(Normal), LBeta)));
-	FTransform T1 = FTransform(Rotator, UpperArmLocation, FVector(1, 1, 1));
-	FTransform T2 = FTransform(FRotator(0.f, LOmega, 0.f), UKismetMathLibrary::Multiply_VectorFloat(UKismetMathLibrary::Vector_Forward(), CharacterSettings.UpperArmLength), FVector(1, 1, 1));
-	return FArmTransforms(T1, T2 * T1);
+	return FOpenMotionUpperBodySolver::SetElbowBasePosition(CharacterSettings, bIsLeftArm, UpperArmLocation, HandLocation);
 }
 
 float UOpenMotionComponent::RotateElbowByHandPosition(bool bIsLeftArm, FVector HandLocation)
 {
-	float Temp = UKismetMathLibrary::Divide_VectorFloat(HandLocation, CharacterSettings.ArmLength).Y * UKismetMathLibrary::SelectFloat(1.f, -1.f, bIsLeftArm);
-	return TransformSettings.ElbowBaseOffsetAngle + (TransformSettings.ElbowYWeight + UKismetMathLibrary::Max(0.f, Temp + TransformSettings.ElbowYDistanceStart));
+	return FOpenMotionUpperBodySolver::RotateElbowByHandPosition(TransformSettings, CharacterSettings, bIsLeftArm, HandLocation);
 }
 
 float UOpenMotionComponent::RotateElbowByHandRotation(FTransform LowerArmLocation, FRotator HandRotation)
 {
-	FVector RightVector = UKismetMathLibrary::GetRightVector(FRotator(LowerArmLocation.GetRotation()));
-	FVector NormalizedVector = UKismetMathLibrary::ProjectVectorOnToPlane(UKismetMathLibrary::GetForwardVector(HandRotation), RightVector);
-	UKismetMathLibrary::Vector_Normalize(NormalizedVector, 0.0001);
-	FVector ForwardVector = UKismetMathLibrary::GetForwardVector(FRotator(LowerArmLocation.GetRotation()));
-	float Length = (NormalizedVector - ForwardVector).Size();
-	float Dot = UKismetMathLibrary::Dot_VectorVector(UKismetMathLibrary::Cross_VectorVector(NormalizedVector, ForwardVector), RightVector);
-	return (CosineRule(1.f, 1.f, Length) * UKismetMathLibrary::SelectFloat(1.f, -1.f, Dot < 0.f)) * 0.6f;
+	return FOpenMotionUpperBodySolver::RotateElbowByHandRotation(LowerArmLocation, HandRotation);
 }
 
 float UOpenMotionComponent::CosineRule(float AdjacentA, float AdjacentB, float Opposite)
 {
-	return UKismetMathLibrary::Acos((((AdjacentA * AdjacentA) + (AdjacentB * AdjacentB)) - (Opposite * Opposite)) / (AdjacentA * AdjacentB * 2));
+	return FOpenMotionUpperBodySolver::CosineRule(AdjacentA, AdjacentB, Opposite);
 }
 
 FArmTransforms UOpenMotionComponent::RotateElbow(bool bIsLeftArm, float Angle, FArmTransforms UpperAndLowerArms, FVector HandLocation)
 {
-	FVector UpperArmHandAxis = UpperAndLowerArms.UpperArmTransform.GetLocation() - HandLocation;
-	FVector PointDirectionVector = UKismetMathLibrary::ProjectVectorOnToVector(UpperAndLowerArms.UpperArmTransform.GetLocation() - UpperAndLowerArms.LowerArmTransform.GetLocation(), UpperArmHandAxis);
-	FVector PivotLocation = UpperAndLowerArms.UpperArmTransform.GetLocation() + PointDirectionVector;
-	FVector UpperArmRotationUpVector = UpperAndLowerArms.UpperArmTransform.GetRotation().GetUpVector();
-	FRotator PivotRotation = FRotator(UKismetMathLibrary::MakeRotationFromAxes(UpperArmHandAxis, UKismetMathLibrary::Cross_VectorVector(UpperArmRotationUpVector, UpperArmHandAxis), UpperArmRotationUpVector));
-	FTransform TempTransform = FTransform(PivotRotation, PivotLocation, FVector(1, 1, 1));
-	FRotator TempRotator = FRotator(0.f, 0.f, UKismetMathLibrary::SelectFloat(180.f - Angle, 180.f + Angle, bIsLeftArm));
-	return FArmTransforms(RotatePointAroundPivot(UpperAndLowerArms.UpperArmTransform, TempTransform, TempRotator), RotatePointAroundPivot(UpperAndLowerArms.LowerArmTransform, TempTransform, TempRotator));
+	return FOpenMotionUpperBodySolver::RotateElbow(bIsLeftArm, Angle, UpperAndLowerArms, HandLocation);
 }
 
 float UOpenMotionComponent::SafeguardAngle(float Current, float Last, float Threshold)
 {	
-	return UKismetMathLibrary::SelectFloat(Last, Current, bool(UKismetMathLibrary::Abs(Last - Current) > Threshold));
+	return FOpenMotionUpperBodySolver::SafeguardAngle(Current, Last, Threshold);
 }
 
 FTransform UOpenMotionComponent::RotatePointAroundPivot(FTransform Point, FTransform Pivot, FRotator Delta)
 {
-	return (((Point * Pivot.Inverse()) * FTransform(Delta, FVector(0, 0, 0), FVector(1, 1, 1))) * Pivot);
+	return FOpenMotionUpperBodySolver::RotatePointAroundPivot(Point, Pivot, Delta);
 }
 
 FVector UOpenMotionComponent::GetDebugValues()
@@ -292,63 +273,259 @@ FVector UOpenMotionComponent::GetDebugValues()
 
 float UOpenMotionComponent::GetHeadHandAngle(float LastAngle, FVector HandLocation, FVector HandHeadDelta)
 {
-	float Local_LastAngle = LastAngle;
-	FVector Local_SubAngle = FVector(FVector(HandLocation.X, HandLocation.Y, 0).Normalize(0.0001));
-	float Local_Angle = UKismetMathLibrary::Atan2(Local_SubAngle.Y, Local_SubAngle.X);
-
-	float Local_Alpha = UKismetMathLibrary::MapRangeClamped(UKismetMathLibrary::VSizeXY(HandHeadDelta), 20.f, 50.f, 0.f, 1.f);
-
-	bool OR = ((UKismetMathLibrary::SignOfFloat(Local_LastAngle) == UKismetMathLibrary::SignOfFloat(Local_Angle)) || Local_Angle < TransformSettings.HeadHandAngleOkSpan && Local_Angle > TransformSettings.HeadHandAngleOkSpan * -1.f);
-	bool bPickA = ((UKismetMathLibrary::Dot_VectorVector(Local_SubAngle, UKismetMathLibrary::Vector_Forward()) > CharacterSettings.HeadHandAngleLimitDot) && OR);
-	return UKismetMathLibrary::Lerp(0.f, UKismetMathLibrary::SelectFloat(Local_Angle, TransformSettings.HeadHandAngleLimit * UKismetMathLibrary::SignOfFloat(Local_LastAngle), bPickA), Local_Alpha);
+	return FOpenMotionUpperBodySolver::GetHeadHandAngle(TransformSettings, CharacterSettings, LastAngle, HandLocation, HandHeadDelta);
 }
 
 FTransform UOpenMotionComponent::GetBaseCharTransform()
 {
-	return FTransform(ComponentTransforms.Shoulder.GetRotation(), ComponentTransforms.Shoulder.GetLocation() - FVector(0.f, 0.f, 12.f + 43.25f), FVector(1, 1, 1));
+	return FOpenMotionUpperBodySolver::GetBaseCharTransform(GetPose());
 }
 
 FRotator UOpenMotionComponent::GetShoulderRotationFromHead()
 {
-	return FRotator(0.f, ComponentTransforms.HeadEffector.GetRotation().Z, 0.f);
+	return FOpenMotionUpperBodySolver::GetShoulderRotationFromHead(GetPose());
 }
 
 FRotator UOpenMotionComponent::GetShoulderRotationFromHands()
 {
-	FVector Local_TopHead = UKismetMathLibrary::GreaterGreater_VectorRotator(
-		UKismetMathLibrary::Multiply_VectorFloat(UKismetMathLibrary::Vector_Up(), 15.f) + UKismetMathLibrary::Multiply_VectorFloat(UKismetMathLibrary::Vector_Forward(), 0.f),
-		FRotator(WorldTransforms.HeadEffector.GetRotation())) + WorldTransforms.HeadEffector.GetLocation();
-	CharacterSettings.LeftHeadHandAngle = GetHeadHandAngle(CharacterSettings.LeftHeadHandAngle, UKismetMathLibrary::ComposeTransforms(WorldTransforms.LeftHandEffector, WorldTransforms.HeadEffector.Inverse()).GetLocation(), WorldTransforms.LeftHandEffector.GetLocation() - Local_TopHead);
-	CharacterSettings.RightHeadHandAngle = GetHeadHandAngle(CharacterSettings.RightHeadHandAngle, UKismetMathLibrary::ComposeTransforms(WorldTransforms.RightHandEffector, WorldTransforms.HeadEffector.Inverse()).GetLocation(), WorldTransforms.RightHandEffector.GetLocation() - Local_TopHead);
-	
-	FTransform TempTransform = FTransform(FRotator(0.f, CharacterSettings.LeftHeadHandAngle + CharacterSettings.RightHeadHandAngle / 2, 0.f), FVector(0.f, 0.f, 0.f), FVector(1, 1, 1)) * WorldTransforms.HeadEffector * WorldTransforms.Component.Inverse();
-	return FRotator(TempTransform.GetRotation());
+	FOpenMotionUpperBodyPose Pose = GetPose();
+	const FRotator Rotation = FOpenMotionUpperBodySolver::GetShoulderRotationFromHands(TransformSettings, Pose);
+	SetPose(Pose);
+	return Rotation;
 }
 
 FRotator UOpenMotionComponent::FindBetweenNormals(FVector A, FVector B)
 {
-	float W = UKismetMathLibrary::Dot_VectorVector(A, B) + 1.f;
-	if (W > 0.000001)
+	return FOpenMotionUpperBodySolver::FindBetweenNormals(A, B);
+}
+
+FOpenMotionUpperBodyPose UOpenMotionComponent::GetPose() const
+{
+	FOpenMotionUpperBodyPose Pose;
+	Pose.WorldTransforms = WorldTransforms;
+	Pose.ShoulderTransforms = ShoulderTransforms;
+	Pose.ComponentTransforms = ComponentTransforms;
+	Pose.CharacterSettings = CharacterSettings;
+	Pose.LocalComponentTransform = WorldTransforms.Component.Inverse();
+	return Pose;
+}
+
+void UOpenMotionComponent::SetPose(const FOpenMotionUpperBodyPose& InPose)
+{
+	WorldTransforms = InPose.WorldTransforms;
+	ShoulderTransforms = InPose.ShoulderTransforms;
+	ComponentTransforms = InPose.ComponentTransforms;
+	CharacterSettings = InPose.CharacterSettings;
+}
+
+float UOpenMotionComponent::GetSolveDeltaSeconds() const
+{
+	// The world this component is in, rather than whichever world happens to be first in the engine's list
+	const UWorld* World = GetWorld();
+	return World ? World->GetDeltaSeconds() : 0.f;
+}
+
+void UOpenMotionComponent::SetOwnerMesh(USkeletalMeshComponent* OwnerMesh)
+{
+	CachedOwnerMesh = OwnerMesh;
+	CachedSkeletalMesh = OwnerMesh ? OwnerMesh->SkeletalMesh : nullptr;
+	CachedBoneNames = BoneNames;
+	ResolveBone(OwnerMesh, BoneNames.LeftUpperArm, LeftUpperArmBone);
+	ResolveBone(OwnerMesh, BoneNames.RightUpperArm, RightUpperArmBone);
+}
+
+void UOpenMotionComponent::ResolveBone(USkeletalMeshComponent* InOwnerMesh, FName InName, FCachedBone& OutBone) const
+{
+	OutBone = FCachedBone();
+	if (InOwnerMesh == nullptr || InOwnerMesh->SkeletalMesh == nullptr)
 	{
-		float X = UKismetMathLibrary::Cross_VectorVector(A, B).X;
-		float Y = UKismetMathLibrary::Cross_VectorVector(A, B).Y;
-		float Z = UKismetMathLibrary::Cross_VectorVector(A, B).Z;
-		FQuat QQQ = FQuat(X, Y, Z, W);
+		return;
+	}
 
-		UKismetMathLibrary::Quat_Normalize(QQQ, 0.0001);
-		return FRotator(QQQ.Rotator());
+	if (const USkeletalMeshSocket* Socket = InOwnerMesh->SkeletalMesh->FindSocket(InName))
+	{
+		OutBone.BoneIndex = InOwnerMesh->GetBoneIndex(Socket->BoneName);
+		OutBone.SocketLocal = Socket->GetSocketLocalTransform();
 	}
 	else
 	{
-		W = 0;
+		OutBone.BoneIndex = InOwnerMesh->GetBoneIndex(InName);
+	}
+}
 
-		FVector AVec = FVector(A.Z * 1.f, 0.f, A.X);
-		FVector BVec = FVector(0.f, A.Z * -1.f, A.Y);
-		FVector www = UKismetMathLibrary::SelectVector(AVec, BVec, bool(UKismetMathLibrary::Abs(A.X) > UKismetMathLibrary::Abs(A.Y)));
-		FQuat QQQ = FQuat(www.X, www.Y, www.Z, W);
+FVector UOpenMotionComponent::GetBoneLocation(USkeletalMeshComponent* InOwnerMesh, const FCachedBone& InBone, FName InName) const
+{
+	// A mesh following a master pose has no pose of its own to read, so it goes the long way round
+	const TArray<FTransform>& ComponentSpaceTransforms = InOwnerMesh->GetComponentSpaceTransforms();
+	if (!ComponentSpaceTransforms.IsValidIndex(InBone.BoneIndex))
+	{
+		return InOwnerMesh->GetSocketLocation(InName);
+	}
+
+	const FVector ComponentSpaceLocation = ComponentSpaceTransforms[InBone.BoneIndex].TransformPosition(InBone.SocketLocal.GetLocation());
+	return InOwnerMesh->GetComponentTransform().TransformPosition(ComponentSpaceLocation);
+}
 
-		UKismetMathLibrary::Quat_Normalize(QQQ, 0.0001);
-		return FRotator(QQQ.Rotator());
+void UOpenMotionComponent::GetUpperArmLocations(USkeletalMeshComponent* InOwnerMesh, FVector& OutLeft, FVector& OutRight)
+{
+	if (CachedOwnerMesh.Get() != InOwnerMesh || CachedSkeletalMesh.Get() != InOwnerMesh->SkeletalMesh
+		|| CachedBoneNames.LeftUpperArm != BoneNames.LeftUpperArm || CachedBoneNames.RightUpperArm != BoneNames.RightUpperArm)
+	{
+		SetOwnerMesh(InOwnerMesh);
 	}
+
+	OutLeft = GetBoneLocation(InOwnerMesh, LeftUpperArmBone, BoneNames.LeftUpperArm);
+	OutRight = GetBoneLocation(InOwnerMesh, RightUpperArmBone, BoneNames.RightUpperArm);
 }
 
+FOpenMotionUpperBodyInput UOpenMotionComponent::MakeInput(USkeletalMeshComponent* InOwnerMesh)
+{
+	FOpenMotionUpperBodyInput Input;
+	Input.HeadEffector = WorldTransforms.HeadEffector;
+	Input.LeftHandEffector = WorldTransforms.LeftHandEffector;
+	Input.RightHandEffector = WorldTransforms.RightHandEffector;
+	Input.Component = WorldTransforms.Component;
+	if (InOwnerMesh != nullptr)
+	{
+		Input.HasUpperArmLocations = true;
+		GetUpperArmLocations(InOwnerMesh, Input.LeftUpperArmLocation, Input.RightUpperArmLocation);
+	}
+	Input.DeltaSeconds = GetSolveDeltaSeconds();
+	return Input;
+}
+
+FOpenMotionUpperBodyInput UOpenMotionComponent::MakeBenchmarkInput(int InAvatar, int InFrame)
+{
+	const float Time = (InFrame + InAvatar * 7) * (1.f / 90.f);
+	const FVector Origin = FVector(InAvatar * 100.f, 0.f, 0.f);
+
+	FOpenMotionUpperBodyInput Input;
+	Input.Component = FTransform(Origin);
+	Input.HeadEffector = FTransform(FRotator(10.f * FMath::Sin(Time), 30.f * FMath::Sin(Time * 0.7f), 0.f), Origin + FVector(0.f, 0.f, 170.f));
+	Input.LeftHandEffector = FTransform(FRotator(0.f, 20.f * FMath::Cos(Time), 90.f), Origin + FVector(30.f + 20.f * FMath::Sin(Time * 1.3f), -25.f, 120.f + 30.f * FMath::Cos(Time)));
+	Input.RightHandEffector = FTransform(FRotator(0.f, -20.f * FMath::Cos(Time), -90.f), Origin + FVector(30.f + 20.f * FMath::Cos(Time * 1.1f), 25.f, 120.f + 30.f * FMath::Sin(Time)));
+	Input.DeltaSeconds = 1.f / 90.f;
+	return Input;
+}
+
+FOpenMotionUpperBodyPose UOpenMotionComponent::MakeBenchmarkPose() const
+{
+	FOpenMotionUpperBodyPose Pose;
+	Pose.CharacterSettings = CharacterSettings;
+	if (Pose.CharacterSettings.ArmLength <= 0.f)
+	{
+		FOpenMotionUpperBodySolver::Calibrate(TransformSettings, 180.f, Pose.CharacterSettings);
+	}
+	return Pose;
+}
+
+void UOpenMotionComponent::RunUpperBodySolverBenchmark(int NumAvatars, int NumFrames)
+{
+	NumAvatars = FMath::Max(NumAvatars, 1);
+	NumFrames = FMath::Max(NumFrames, 1);
+
+	// Keep the live pose intact - the component path below solves every avatar through this component
+	const FOpenMotionUpperBodyPose LivePose = GetPose();
+	TGuardValue<bool> DisablePrediction(PredictionSettings.Enabled, false);
+	TGuardValue<bool> DisableFilter(FilterSettings.Enabled, false);
+	TGuardValue<bool> DisableReplication(ReplicateEffectors, false);
+
+	const FOpenMotionUpperBodyPose StartPose = MakeBenchmarkPose();
+
+	TArray<FOpenMotionUpperBodyPose> Poses;
+	Poses.Init(StartPose, NumAvatars);
+
+	double StartSeconds = FPlatformTime::Seconds();
+	for (int FrameLoop = 0; FrameLoop < NumFrames; ++FrameLoop)
+	{
+		for (int AvatarLoop = 0; AvatarLoop < NumAvatars; ++AvatarLoop)
+		{
+			FOpenMotionUpperBodySolver::Solve(MakeBenchmarkInput(AvatarLoop, FrameLoop), TransformSettings, Poses[AvatarLoop]);
+		}
+	}
+	const double SolverSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	// The same solve as a Blueprint calling each step of the component would make it
+	TArray<FOpenMotionUpperBodyPose> ComponentPoses;
+	ComponentPoses.Init(StartPose, NumAvatars);
+
+	StartSeconds = FPlatformTime::Seconds();
+	for (int FrameLoop = 0; FrameLoop < NumFrames; ++FrameLoop)
+	{
+		for (int AvatarLoop = 0; AvatarLoop < NumAvatars; ++AvatarLoop)
+		{
+			const FOpenMotionUpperBodyInput Input = MakeBenchmarkInput(AvatarLoop, FrameLoop);
+			SetPose(ComponentPoses[AvatarLoop]);
+			SetCharacterTransforms(Input.LeftHandEffector, Input.RightHandEffector, Input.HeadEffector, Input.Component);
+			ConvertTransforms();
+			SetShoulder();
+			SetLeftUpperArm(); SetRightUpperArm();
+
+			// SolveArms would take the world's delta time rather than the benchmark's
+			FOpenMotionUpperBodyPose Pose = GetPose();
+			FOpenMotionUpperBodySolver::SolveArms(TransformSettings, Input.DeltaSeconds, Pose);
+			Pose.CharacterSettings.CharacterBaseTransform = FOpenMotionUpperBodySolver::GetBaseCharTransform(Pose);
+			ComponentPoses[AvatarLoop] = Pose;
+		}
+	}
+	const double ComponentSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	SetPose(LivePose);
+
+	float MaxDifference = 0.f;
+	for (int AvatarLoop = 0; AvatarLoop < NumAvatars; ++AvatarLoop)
+	{
+		const FComponentTransforms& A = Poses[AvatarLoop].ComponentTransforms;
+		const FComponentTransforms& B = ComponentPoses[AvatarLoop].ComponentTransforms;
+		MaxDifference = FMath::Max(MaxDifference, FVector::Dist(A.LeftLowerArm.GetLocation(), B.LeftLowerArm.GetLocation()));
+		MaxDifference = FMath::Max(MaxDifference, FVector::Dist(A.RightUpperArm.GetLocation(), B.RightUpperArm.GetLocation()));
+	}
+
+	const double NumSolves = (double)NumAvatars * NumFrames;
+	UE_LOG(OpenMotionLog, Log, TEXT("Upper body x %d for %d frames: solver %.3f us/avatar, component %.3f us/avatar, largest arm difference %f"),
+		NumAvatars, NumFrames, SolverSeconds * 1000000.0 / NumSolves, ComponentSeconds * 1000000.0 / NumSolves, MaxDifference);
+}
+
+void UOpenMotionComponent::RunUpperBodyBatchBenchmark(int NumFrames)
+{
+	NumFrames = FMath::Max(NumFrames, 1);
+
+	const TArray<FTransformSettings> Settings = { TransformSettings };
+	const FOpenMotionUpperBodyPose StartPose = MakeBenchmarkPose();
+	const int32 NumWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+
+	for (int NumAvatars = 1; NumAvatars <= 256; NumAvatars *= 2)
+	{
+		// Built up front so only the solves are timed
+		TArray<TArray<FOpenMotionUpperBodyInput>> FrameInputs;
+		FrameInputs.SetNum(NumFrames);
+		for (int FrameLoop = 0; FrameLoop < NumFrames; ++FrameLoop)
+		{
+			for (int AvatarLoop = 0; AvatarLoop < NumAvatars; ++AvatarLoop)
+			{
+				FrameInputs[FrameLoop].Add(MakeBenchmarkInput(AvatarLoop, FrameLoop));
+			}
+		}
+
+		double Seconds[2];
+		for (int Pass = 0; Pass < 2; ++Pass)
+		{
+			TArray<FOpenMotionUpperBodyPose> Poses;
+			Poses.Init(StartPose, NumAvatars);
+
+			double StartSeconds = FPlatformTime::Seconds();
+			for (int FrameLoop = 0; FrameLoop < NumFrames; ++FrameLoop)
+			{
+				FOpenMotionUpperBodySolver::SolveBatch(FrameInputs[FrameLoop], Settings, Poses, (Pass == 0) ? 1 : 0);
+			}
+			Seconds[Pass] = FPlatformTime::Seconds() - StartSeconds;
+		}
+
+		UE_LOG(OpenMotionLog, Log, TEXT("Upper body batch x %d: 1 thread %.2f us/frame (%.3f us/avatar), %d threads %.2f us/frame (%.3f us/avatar), %.2fx"),
+			NumAvatars,
+			Seconds[0] * 1000000.0 / NumFrames, Seconds[0] * 1000000.0 / ((double)NumFrames * NumAvatars),
+			FMath::Min(NumAvatars, NumWorkers),
+			Seconds[1] * 1000000.0 / NumFrames, Seconds[1] * 1000000.0 / ((double)NumFrames * NumAvatars),
+			Seconds[0] / FMath::Max(Seconds[1], (double)SMALL_NUMBER));
+	}
+}
@@ -0,0 +1,138 @@
+// Copyright (c) Name 2020
+
+
+#include "OpenMotionEffectorFilter.h"
+#include "OpenMotionUpperBodySolver.h"
+
+#include "OpenMotion.h"
+
+DECLARE_CYCLE_STAT(TEXT("OpenMotion Effector FilterBatch"), STAT_OpenMotionEffectorFilterBatch, STATGROUP_OpenMotion);
+
+// Smoothing factor of a low pass filter with each lane's cutoff over InDeltaSeconds
+static FORCEINLINE VectorRegister OneEuroAlpha(const VectorRegister& InCutoff, const VectorRegister& InDeltaSeconds)
+{
+	const VectorRegister Scaled = VectorMultiply(VectorMultiply(InCutoff, VectorSetFloat1(2.f * PI)), InDeltaSeconds);
+	return VectorDivide(Scaled, VectorAdd(Scaled, VectorOne()));
+}
+
+// Channels 0 to 3 go in one register and 4 and 5 in another, which is padded out with settings that do no harm
+static void FilterChannels(const FOpenMotionEffectorFilterSettings& InSettings, float InDeltaSeconds, const FVector4* InSamples, FOpenMotionEffectorFilterState& InOutState)
+{
+	typedef FOpenMotionEffectorFilterState FState;
+	const FOpenMotionOneEuroSettings* ChannelSettings[FState::NumChannels] =
+	{
+		&InSettings.HeadLocation, &InSettings.HeadRotation,
+		&InSettings.HandLocation, &InSettings.HandRotation,
+		&InSettings.HandLocation, &InSettings.HandRotation
+	};
+
+	MS_ALIGN(16) float DerivativeCutoffs[8] GCC_ALIGN(16) = { 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f };
+	MS_ALIGN(16) float MinCutoffs[8] GCC_ALIGN(16) = { 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f };
+	MS_ALIGN(16) float Betas[8] GCC_ALIGN(16) = {};
+	for (int32 Channel = 0; Channel < FState::NumChannels; ++Channel)
+	{
+		DerivativeCutoffs[Channel] = ChannelSettings[Channel]->DerivativeCutoff;
+		MinCutoffs[Channel] = ChannelSettings[Channel]->MinCutoff;
+		Betas[Channel] = ChannelSettings[Channel]->Beta;
+	}
+
+	const VectorRegister DeltaSeconds = VectorSetFloat1(InDeltaSeconds);
+	const VectorRegister Rate = VectorSetFloat1(1.f / InDeltaSeconds);
+
+	// ---------- Speed of each channel -----------
+
+	MS_ALIGN(16) float DerivativeAlphas[8] GCC_ALIGN(16);
+	VectorStoreAligned(OneEuroAlpha(VectorLoadAligned(DerivativeCutoffs), DeltaSeconds), DerivativeAlphas);
+	VectorStoreAligned(OneEuroAlpha(VectorLoadAligned(DerivativeCutoffs + 4), DeltaSeconds), DerivativeAlphas + 4);
+
+	MS_ALIGN(16) float SpeedsSquared[8] GCC_ALIGN(16) = {};
+	for (int32 Channel = 0; Channel < FState::NumChannels; ++Channel)
+	{
+		const VectorRegister Previous = VectorLoadAligned(&InOutState.Values[Channel]);
+		const VectorRegister PreviousDerivative = VectorLoadAligned(&InOutState.Derivatives[Channel]);
+		const VectorRegister Derivative = VectorMultiply(VectorSubtract(VectorLoadAligned(&InSamples[Channel]), Previous), Rate);
+		const VectorRegister FilteredDerivative = VectorMultiplyAdd(VectorSetFloat1(DerivativeAlphas[Channel]), VectorSubtract(Derivative, PreviousDerivative), PreviousDerivative);
+		VectorStoreAligned(FilteredDerivative, &InOutState.Derivatives[Channel]);
+		SpeedsSquared[Channel] = VectorGetComponent(VectorDot4(FilteredDerivative, FilteredDerivative), 0);
+	}
+
+	// ---------- Cutoff of each channel from its speed -----------
+
+	MS_ALIGN(16) float Alphas[8] GCC_ALIGN(16);
+	for (int32 First = 0; First < 8; First += 4)
+	{
+		// The squared speed over its own square root, which stays at zero for a channel at rest
+		const VectorRegister SpeedSquared = VectorLoadAligned(SpeedsSquared + First);
+		const VectorRegister Speed = VectorMultiply(SpeedSquared, VectorReciprocalSqrtAccurate(VectorMax(SpeedSquared, VectorSetFloat1(SMALL_NUMBER))));
+		const VectorRegister Cutoff = VectorMultiplyAdd(VectorLoadAligned(Betas + First), Speed, VectorLoadAligned(MinCutoffs + First));
+		VectorStoreAligned(OneEuroAlpha(Cutoff, DeltaSeconds), Alphas + First);
+	}
+
+	// ---------- Filter each channel -----------
+
+	for (int32 Channel = 0; Channel < FState::NumChannels; ++Channel)
+	{
+		const VectorRegister Previous = VectorLoadAligned(&InOutState.Values[Channel]);
+		const VectorRegister Filtered = VectorMultiplyAdd(VectorSetFloat1(Alphas[Channel]), VectorSubtract(VectorLoadAligned(&InSamples[Channel]), Previous), Previous);
+		VectorStoreAligned(Filtered, &InOutState.Values[Channel]);
+	}
+}
+
+void FOpenMotionEffectorFilter::Filter(const FOpenMotionEffectorFilterSettings& InSettings, float InDeltaSeconds, FTransform& InOutHead, FTransform& InOutLeftHand, FTransform& InOutRightHand, FOpenMotionEffectorFilterState& InOutState)
+{
+	typedef FOpenMotionEffectorFilterState FState;
+	FTransform* Effectors[3] = { &InOutHead, &InOutLeftHand, &InOutRightHand };
+
+	// ---------- Read the samples -----------
+
+	FVector4 Samples[FState::NumChannels];
+	for (int32 Effector = 0; Effector < 3; ++Effector)
+	{
+		const FQuat Rotation = Effectors[Effector]->GetRotation();
+		Samples[Effector * 2] = FVector4(Effectors[Effector]->GetLocation(), 0.f);
+		Samples[Effector * 2 + 1] = FVector4(Rotation.X, Rotation.Y, Rotation.Z, Rotation.W);
+
+		// Keep each rotation on the same side of the hypersphere as the last one, or filtering it would swing the long way
+		const FVector4& Last = InOutState.Values[Effector * 2 + 1];
+		if (InOutState.Initialized && Dot4(Samples[Effector * 2 + 1], Last) < 0.f)
+		{
+			Samples[Effector * 2 + 1] = -Samples[Effector * 2 + 1];
+		}
+	}
+
+	if (!InOutState.Initialized)
+	{
+		for (int32 Channel = 0; Channel < FState::NumChannels; ++Channel)
+		{
+			InOutState.Values[Channel] = Samples[Channel];
+			InOutState.Derivatives[Channel] = FVector4(0.f, 0.f, 0.f, 0.f);
+		}
+		InOutState.Initialized = true;
+		return;
+	}
+
+	// With no time passed there is nothing to learn from the samples, so the effectors just hold
+	if (InDeltaSeconds > 0.f)
+	{
+		FilterChannels(InSettings, InDeltaSeconds, Samples, InOutState);
+	}
+
+	for (int32 Effector = 0; Effector < 3; ++Effector)
+	{
+		const FVector4& Location = InOutState.Values[Effector * 2];
+		const FVector4& Rotation = InOutState.Values[Effector * 2 + 1];
+		Effectors[Effector]->SetLocation(FVector(Location.X, Location.Y, Location.Z));
+		Effectors[Effector]->SetRotation(FQuat(Rotation.X, Rotation.Y, Rotation.Z, Rotation.W).GetNormalized());
+	}
+}
+
+void FOpenMotionEffectorFilter::FilterBatch(const FOpenMotionEffectorFilterSettings& InSettings, int32 InNum, FOpenMotionUpperBodyInput* InOutInputs, FOpenMotionEffectorFilterState* InOutStates)
+{
+	SCOPE_CYCLE_COUNTER(STAT_OpenMotionEffectorFilterBatch);
+
+	for (int32 Loop = 0; Loop < InNum; ++Loop)
+	{
+		FOpenMotionUpperBodyInput& Input = InOutInputs[Loop];
+		Filter(InSettings, Input.DeltaSeconds, Input.HeadEffector, Input.LeftHandEffector, Input.RightHandEffector, InOutStates[Loop]);
+	}
+}
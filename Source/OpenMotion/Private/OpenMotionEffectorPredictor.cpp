@@ -0,0 +1,104 @@
+// Copyright (c) Name 2020
+
+
+#include "OpenMotionEffectorPredictor.h"
+
+FOpenMotionEffectorPredictor::FOpenMotionEffectorPredictor()
+{
+	Reset();
+}
+
+void FOpenMotionEffectorPredictor::Reset()
+{
+	Newest = HistoryCapacity - 1;
+	Count = 0;
+}
+
+void FOpenMotionEffectorPredictor::AddSample(const FTransform& InTransform, double InTime)
+{
+	if (Count == 0 || InTime > Times[Newest])
+	{
+		Newest = (Newest + 1) % HistoryCapacity;
+		Count = FMath::Min(Count + 1, HistoryCapacity);
+	}
+
+	Transforms[Newest] = InTransform;
+	Times[Newest] = InTime;
+}
+
+void FOpenMotionEffectorPredictor::GetVelocities(const FOpenMotionPredictionSettings& InSettings, FVector& OutLinearVelocity, FVector& OutAngularVelocity) const
+{
+	OutLinearVelocity = FVector::ZeroVector;
+	OutAngularVelocity = FVector::ZeroVector;
+
+	const double NewestTime = Times[Newest];
+	const FQuat NewestRotation = Transforms[Newest].GetRotation();
+	const FVector NewestLocation = Transforms[Newest].GetLocation();
+
+	// Fit both velocities through the newest sample, so the prediction starts from exactly where the trackers last were
+	double SumTimeSquared = 0.0;
+	FVector SumLocation = FVector::ZeroVector;
+	FVector SumRotation = FVector::ZeroVector;
+	for (int32 Age = 1; Age < Count; ++Age)
+	{
+		const int32 Slot = GetSlot(Age);
+		const float DeltaTime = (float)(Times[Slot] - NewestTime);
+		if (-DeltaTime > InSettings.HistorySeconds)
+		{
+			break;
+		}
+
+		// The turn from the newest sample back to this one, as an axis scaled by the angle
+		FQuat Delta = Transforms[Slot].GetRotation() * NewestRotation.Inverse();
+		if (Delta.W < 0.f)
+		{
+			Delta = -Delta;
+		}
+		FVector Axis;
+		float Angle;
+		Delta.ToAxisAndAngle(Axis, Angle);
+
+		SumTimeSquared += DeltaTime * DeltaTime;
+		SumLocation += (Transforms[Slot].GetLocation() - NewestLocation) * DeltaTime;
+		SumRotation += Axis * (Angle * DeltaTime);
+	}
+
+	if (SumTimeSquared > SMALL_NUMBER)
+	{
+		OutLinearVelocity = SumLocation / (float)SumTimeSquared;
+		OutAngularVelocity = SumRotation / (float)SumTimeSquared;
+	}
+}
+
+FTransform FOpenMotionEffectorPredictor::Predict(double InTime, const FOpenMotionPredictionSettings& InSettings) const
+{
+	if (Count == 0)
+	{
+		return FTransform::Identity;
+	}
+
+	FTransform Prediction = Transforms[Newest];
+	if (Count < 2)
+	{
+		return Prediction;
+	}
+
+	const float Lookahead = FMath::Clamp((float)(InTime - Times[Newest]), 0.f, InSettings.MaxLookaheadSeconds);
+
+	FVector LinearVelocity;
+	FVector AngularVelocity;
+	GetVelocities(InSettings, LinearVelocity, AngularVelocity);
+
+	// Bound the error a bad fit can cause by limiting how far the effector may move from where it was sampled
+	const FVector Offset = (LinearVelocity * Lookahead).GetClampedToMaxSize(InSettings.MaxPredictionDistance);
+	Prediction.SetLocation(Prediction.GetLocation() + Offset);
+
+	const float Speed = AngularVelocity.Size();
+	if (Speed > KINDA_SMALL_NUMBER)
+	{
+		const float Angle = FMath::Min(Speed * Lookahead, FMath::DegreesToRadians(InSettings.MaxPredictionDegrees));
+		Prediction.SetRotation(FQuat(AngularVelocity / Speed, Angle) * Prediction.GetRotation());
+	}
+
+	return Prediction;
+}
@@ -0,0 +1,425 @@
+// Copyright (c) Name 2020
+
+
+#include "OpenMotionEffectorReplication.h"
+
+#include "OpenMotion.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("OpenMotion Effector Bits Sent"), STAT_OpenMotionEffectorBitsSent, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("OpenMotion Effector Deltas Dropped"), STAT_OpenMotionEffectorDeltasDropped, STATGROUP_OpenMotion);
+
+// Bits for the width of a location or rotation delta, enough for a change across the whole range
+static const int32 LocationWidthBits = 5;
+static const int32 RotationWidthBits = 4;
+
+// No quaternion component but the largest can be further than this from zero
+static const float RotationRange = 0.70710678f;
+
+static void SerializeUnsigned(FArchive& Ar, uint32& Value, int32 NumBits)
+{
+	if (Ar.IsLoading())
+	{
+		Value = 0;
+		Ar.SerializeBits(&Value, NumBits);
+		Value &= (NumBits < 32) ? (1u << NumBits) - 1 : ~0u;
+	}
+	else
+	{
+		Ar.SerializeBits(&Value, NumBits);
+	}
+}
+
+static uint32 ZigZag(int32 Value)
+{
+	return (Value < 0) ? ((uint32)(-Value) << 1) - 1 : (uint32)Value << 1;
+}
+
+static int32 UnZigZag(uint32 Value)
+{
+	return (Value & 1) ? -(int32)((Value + 1) >> 1) : (int32)(Value >> 1);
+}
+
+static int32 BitsNeeded(uint32 Value)
+{
+	return FMath::Max(32 - (int32)FMath::CountLeadingZeros(Value), 1);
+}
+
+// Three signed deltas with one width between them, or nothing when they are all zero
+static void WriteDeltas(FArchive& Ar, const int32* InValues, const int32* InBase, int32 InWidthBits)
+{
+	uint32 Encoded[3];
+	uint32 Largest = 0;
+	for (int32 Loop = 0; Loop < 3; ++Loop)
+	{
+		Encoded[Loop] = ZigZag(InValues[Loop] - InBase[Loop]);
+		Largest = FMath::Max(Largest, Encoded[Loop]);
+	}
+
+	uint32 Changed = (Largest != 0) ? 1 : 0;
+	SerializeUnsigned(Ar, Changed, 1);
+	if (Changed)
+	{
+		uint32 Width = BitsNeeded(Largest) - 1;
+		SerializeUnsigned(Ar, Width, InWidthBits);
+		for (int32 Loop = 0; Loop < 3; ++Loop)
+		{
+			SerializeUnsigned(Ar, Encoded[Loop], Width + 1);
+		}
+	}
+}
+
+static void ReadDeltas(FArchive& Ar, int32* OutValues, const int32* InBase, int32 InWidthBits)
+{
+	uint32 Changed = 0;
+	SerializeUnsigned(Ar, Changed, 1);
+	uint32 Width = 0;
+	if (Changed)
+	{
+		SerializeUnsigned(Ar, Width, InWidthBits);
+	}
+	for (int32 Loop = 0; Loop < 3; ++Loop)
+	{
+		uint32 Encoded = 0;
+		if (Changed)
+		{
+			SerializeUnsigned(Ar, Encoded, Width + 1);
+		}
+		OutValues[Loop] = InBase[Loop] + UnZigZag(Encoded);
+	}
+}
+
+static void SerializeFullRotation(FArchive& Ar, FOpenMotionQuantizedEffector& InOutEffector)
+{
+	uint32 Largest = InOutEffector.LargestComponent;
+	SerializeUnsigned(Ar, Largest, 2);
+	InOutEffector.LargestComponent = Largest;
+	for (int32 Loop = 0; Loop < 3; ++Loop)
+	{
+		uint32 Value = InOutEffector.Rotation[Loop];
+		SerializeUnsigned(Ar, Value, FOpenMotionQuantizedEffector::RotationBits);
+		InOutEffector.Rotation[Loop] = Value;
+	}
+}
+
+static void SerializeFullEffector(FArchive& Ar, FOpenMotionQuantizedEffector& InOutEffector)
+{
+	const int32 Offset = 1 << (FOpenMotionQuantizedEffector::LocationBits - 1);
+	for (int32 Loop = 0; Loop < 3; ++Loop)
+	{
+		uint32 Value = InOutEffector.Location[Loop] + Offset;
+		SerializeUnsigned(Ar, Value, FOpenMotionQuantizedEffector::LocationBits);
+		InOutEffector.Location[Loop] = (int32)Value - Offset;
+	}
+	SerializeFullRotation(Ar, InOutEffector);
+}
+
+// Read a state written by WriteEffectors, failing when it is a delta against a state not among InReceived.
+// Every bit is read whether or not the base is there, so the archive is left in the right place either way.
+static bool ReadEffectors(FArchive& Ar, const FOpenMotionQuantizedEffectors* InReceived, const bool* InReceivedValid, int32 InNumReceived, FOpenMotionQuantizedEffectors& OutState)
+{
+	uint32 Sequence = 0;
+	SerializeUnsigned(Ar, Sequence, 8);
+	OutState.Sequence = Sequence;
+
+	uint32 HasBase = 0;
+	SerializeUnsigned(Ar, HasBase, 1);
+
+	const FOpenMotionQuantizedEffectors* Base = nullptr;
+	bool BaseMissing = false;
+	if (HasBase)
+	{
+		uint32 BaseSequence = 0;
+		SerializeUnsigned(Ar, BaseSequence, 8);
+		const int32 Slot = BaseSequence % InNumReceived;
+		if (InReceived && InReceivedValid[Slot] && InReceived[Slot].Sequence == BaseSequence)
+		{
+			Base = &InReceived[Slot];
+		}
+		else
+		{
+			BaseMissing = true;
+		}
+	}
+
+	// A delta with no base is still read, against zeros, and thrown away
+	const FOpenMotionQuantizedEffectors Zero;
+	for (int32 Loop = 0; Loop < FOpenMotionQuantizedEffectors::NumEffectors; ++Loop)
+	{
+		FOpenMotionQuantizedEffector& Effector = OutState.Effectors[Loop];
+		if (!HasBase)
+		{
+			SerializeFullEffector(Ar, Effector);
+			continue;
+		}
+
+		const FOpenMotionQuantizedEffector& BaseEffector = Base ? Base->Effectors[Loop] : Zero.Effectors[Loop];
+		Effector = BaseEffector;
+
+		uint32 Changed = 0;
+		SerializeUnsigned(Ar, Changed, 1);
+		if (!Changed)
+		{
+			continue;
+		}
+
+		ReadDeltas(Ar, Effector.Location, BaseEffector.Location, LocationWidthBits);
+
+		uint32 SameLargest = 0;
+		SerializeUnsigned(Ar, SameLargest, 1);
+		if (SameLargest)
+		{
+			ReadDeltas(Ar, Effector.Rotation, BaseEffector.Rotation, RotationWidthBits);
+		}
+		else
+		{
+			SerializeFullRotation(Ar, Effector);
+		}
+	}
+
+	return !BaseMissing && !Ar.IsError();
+}
+
+
+FOpenMotionQuantizedEffector::FOpenMotionQuantizedEffector()
+	: LargestComponent(3)
+{
+	const int32 RotationMid = 1 << (RotationBits - 1);
+	for (int32 Loop = 0; Loop < 3; ++Loop)
+	{
+		Location[Loop] = 0;
+		Rotation[Loop] = RotationMid;
+	}
+}
+
+FOpenMotionQuantizedEffector FOpenMotionQuantizedEffector::Quantize(const FTransform& InLocal)
+{
+	FOpenMotionQuantizedEffector Result;
+
+	const int32 MaxLocation = (1 << (LocationBits - 1)) - 1;
+	const FVector Location = InLocal.GetLocation();
+	for (int32 Loop = 0; Loop < 3; ++Loop)
+	{
+		Result.Location[Loop] = FMath::Clamp(FMath::RoundToInt(Location[Loop] * LocationUnitsPerCm), -MaxLocation, MaxLocation);
+	}
+
+	// The largest component is left out and rebuilt from the others, so the rest all lie within one over root two of zero
+	const FQuat Quat = InLocal.GetRotation().GetNormalized();
+	float Components[4] = { Quat.X, Quat.Y, Quat.Z, Quat.W };
+	int32 Largest = 0;
+	for (int32 Loop = 1; Loop < 4; ++Loop)
+	{
+		if (FMath::Abs(Components[Loop]) > FMath::Abs(Components[Largest]))
+		{
+			Largest = Loop;
+		}
+	}
+	const float Sign = (Components[Largest] < 0.f) ? -1.f : 1.f;
+
+	const int32 MaxRotation = (1 << RotationBits) - 1;
+	int32 Out = 0;
+	for (int32 Loop = 0; Loop < 4; ++Loop)
+	{
+		if (Loop != Largest)
+		{
+			const float Unit = (Components[Loop] * Sign / RotationRange + 1.f) * 0.5f;
+			Result.Rotation[Out++] = FMath::Clamp(FMath::RoundToInt(Unit * MaxRotation), 0, MaxRotation);
+		}
+	}
+	Result.LargestComponent = Largest;
+	return Result;
+}
+
+FTransform FOpenMotionQuantizedEffector::Dequantize() const
+{
+	const int32 MaxRotation = (1 << RotationBits) - 1;
+	float Components[4];
+	float SumSquares = 0.f;
+	int32 In = 0;
+	for (int32 Loop = 0; Loop < 4; ++Loop)
+	{
+		if (Loop != LargestComponent)
+		{
+			Components[Loop] = ((float)Rotation[In++] / MaxRotation * 2.f - 1.f) * RotationRange;
+			SumSquares += FMath::Square(Components[Loop]);
+		}
+	}
+	Components[LargestComponent] = FMath::Sqrt(FMath::Max(1.f - SumSquares, 0.f));
+
+	const FVector Translation = FVector(Location[0], Location[1], Location[2]) / (float)LocationUnitsPerCm;
+	return FTransform(FQuat(Components[0], Components[1], Components[2], Components[3]).GetNormalized(), Translation);
+}
+
+bool FOpenMotionQuantizedEffector::operator==(const FOpenMotionQuantizedEffector& InOther) const
+{
+	return LargestComponent == InOther.LargestComponent
+		&& FMemory::Memcmp(Location, InOther.Location, sizeof(Location)) == 0
+		&& FMemory::Memcmp(Rotation, InOther.Rotation, sizeof(Rotation)) == 0;
+}
+
+bool FOpenMotionQuantizedEffectors::HasSameValues(const FOpenMotionQuantizedEffectors& InOther) const
+{
+	for (int32 Loop = 0; Loop < NumEffectors; ++Loop)
+	{
+		if (Effectors[Loop] != InOther.Effectors[Loop])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FOpenMotionEffectorsDeltaState::IsStateEqual(INetDeltaBaseState* OtherState)
+{
+	const FOpenMotionEffectorsDeltaState* Other = static_cast<FOpenMotionEffectorsDeltaState*>(OtherState);
+	return Other && Other->State.Sequence == State.Sequence && Other->State.HasSameValues(State);
+}
+
+
+void FOpenMotionReplicatedEffectors::SetEffectors(const FTransform& InComponent, const FTransform& InHead, const FTransform& InLeftHand, const FTransform& InRightHand)
+{
+	HeadEffector = InHead.GetRelativeTransform(InComponent);
+	LeftHandEffector = InLeftHand.GetRelativeTransform(InComponent);
+	RightHandEffector = InRightHand.GetRelativeTransform(InComponent);
+}
+
+void FOpenMotionReplicatedEffectors::GetEffectors(const FTransform& InComponent, FTransform& OutHead, FTransform& OutLeftHand, FTransform& OutRightHand) const
+{
+	OutHead = HeadEffector * InComponent;
+	OutLeftHand = LeftHandEffector * InComponent;
+	OutRightHand = RightHandEffector * InComponent;
+}
+
+FOpenMotionQuantizedEffectors FOpenMotionReplicatedEffectors::Quantize() const
+{
+	FOpenMotionQuantizedEffectors Result;
+	Result.Effectors[0] = FOpenMotionQuantizedEffector::Quantize(HeadEffector);
+	Result.Effectors[1] = FOpenMotionQuantizedEffector::Quantize(LeftHandEffector);
+	Result.Effectors[2] = FOpenMotionQuantizedEffector::Quantize(RightHandEffector);
+	return Result;
+}
+
+void FOpenMotionReplicatedEffectors::ApplyState(const FOpenMotionQuantizedEffectors& InState)
+{
+	HeadEffector = InState.Effectors[0].Dequantize();
+	LeftHandEffector = InState.Effectors[1].Dequantize();
+	RightHandEffector = InState.Effectors[2].Dequantize();
+	LastAppliedSequence = InState.Sequence;
+}
+
+void FOpenMotionReplicatedEffectors::WriteEffectors(FArchive& Ar, const FOpenMotionQuantizedEffectors& InState, const FOpenMotionQuantizedEffectors* InBase)
+{
+	uint32 Sequence = InState.Sequence;
+	SerializeUnsigned(Ar, Sequence, 8);
+
+	uint32 HasBase = InBase ? 1 : 0;
+	SerializeUnsigned(Ar, HasBase, 1);
+	if (InBase)
+	{
+		uint32 BaseSequence = InBase->Sequence;
+		SerializeUnsigned(Ar, BaseSequence, 8);
+	}
+
+	for (int32 Loop = 0; Loop < FOpenMotionQuantizedEffectors::NumEffectors; ++Loop)
+	{
+		FOpenMotionQuantizedEffector Effector = InState.Effectors[Loop];
+		if (!InBase)
+		{
+			SerializeFullEffector(Ar, Effector);
+			continue;
+		}
+
+		// An effector that hasn't moved costs one bit
+		const FOpenMotionQuantizedEffector& BaseEffector = InBase->Effectors[Loop];
+		uint32 Changed = (Effector != BaseEffector) ? 1 : 0;
+		SerializeUnsigned(Ar, Changed, 1);
+		if (!Changed)
+		{
+			continue;
+		}
+
+		WriteDeltas(Ar, Effector.Location, BaseEffector.Location, LocationWidthBits);
+
+		// The three components only carry on from the base while the same one is left out
+		uint32 SameLargest = (Effector.LargestComponent == BaseEffector.LargestComponent) ? 1 : 0;
+		SerializeUnsigned(Ar, SameLargest, 1);
+		if (SameLargest)
+		{
+			WriteDeltas(Ar, Effector.Rotation, BaseEffector.Rotation, RotationWidthBits);
+		}
+		else
+		{
+			SerializeFullRotation(Ar, Effector);
+		}
+	}
+}
+
+bool FOpenMotionReplicatedEffectors::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	if (Ar.IsSaving())
+	{
+		WriteEffectors(Ar, Quantize(), nullptr);
+		bOutSuccess = true;
+		return true;
+	}
+
+	FOpenMotionQuantizedEffectors Received;
+	bOutSuccess = ReadEffectors(Ar, nullptr, nullptr, NumReceivedStates, Received);
+	if (bOutSuccess)
+	{
+		ApplyState(Received);
+	}
+	return true;
+}
+
+bool FOpenMotionReplicatedEffectors::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	if (DeltaParms.Writer)
+	{
+		const FOpenMotionEffectorsDeltaState* OldState = static_cast<FOpenMotionEffectorsDeltaState*>(DeltaParms.OldState);
+
+		FOpenMotionQuantizedEffectors Current = Quantize();
+		if (OldState && OldState->State.HasSameValues(Current))
+		{
+			return false;
+		}
+
+		// Start the connection over from a full update every so often, and before its base is so old the sequence
+		// could be mistaken for a newer one
+		const FOpenMotionQuantizedEffectors* Base = nullptr;
+		if (OldState && OldState->DeltasSinceFull < FullUpdateInterval && (uint8)(NextSequence - OldState->State.Sequence) < MaxBaseAge)
+		{
+			Base = &OldState->State;
+		}
+		Current.Sequence = NextSequence++;
+
+		TSharedPtr<FOpenMotionEffectorsDeltaState> NewState = MakeShared<FOpenMotionEffectorsDeltaState>();
+		NewState->State = Current;
+		NewState->DeltasSinceFull = Base ? OldState->DeltasSinceFull + 1 : 0;
+		*DeltaParms.NewState = NewState;
+
+		const int64 StartBits = DeltaParms.Writer->GetNumBits();
+		WriteEffectors(*DeltaParms.Writer, Current, Base);
+		INC_DWORD_STAT_BY(STAT_OpenMotionEffectorBitsSent, DeltaParms.Writer->GetNumBits() - StartBits);
+		return true;
+	}
+
+	if (DeltaParms.Reader)
+	{
+		FOpenMotionQuantizedEffectors Received;
+		if (!ReadEffectors(*DeltaParms.Reader, ReceivedStates, ReceivedStateValid, NumReceivedStates, Received))
+		{
+			// Written against a state that was lost on the way or has since been overwritten. The next full update
+			// starts us off again, if the sender hasn't gone back to a state we have before then.
+			++NumDeltasDropped;
+			INC_DWORD_STAT(STAT_OpenMotionEffectorDeltasDropped);
+			return !DeltaParms.Reader->IsError();
+		}
+
+		const int32 Slot = Received.Sequence % NumReceivedStates;
+		ReceivedStates[Slot] = Received;
+		ReceivedStateValid[Slot] = true;
+		ApplyState(Received);
+	}
+
+	return true;
+}
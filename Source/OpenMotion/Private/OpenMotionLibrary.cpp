@@ -2,4 +2,437 @@
 
 
 #include "OpenMotionLibrary.h"
+#include "OpenMotionUpperBodySolver.h"
+#include "OpenMotionEffectorReplication.h"
 
+#include "Algo/BinarySearch.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#include "OpenMotion.h"
+
+FOpenMotionPredictionReplayResult UOpenMotionLibrary::ReplayPredictionTrace(const TArray<float>& SampleTimes, const TArray<FTransform>& Samples, const FOpenMotionPredictionSettings& Settings)
+{
+	FOpenMotionPredictionReplayResult Result;
+	if (SampleTimes.Num() != Samples.Num() || Samples.Num() < 2)
+	{
+		return Result;
+	}
+
+	const float Latency = Settings.PredictionSeconds;
+	const float EndTime = SampleTimes.Last();
+
+	// Error of the real effector against itself some fraction of the latency earlier, for working out the effective latency
+	const int32 NumLags = 20;
+	double LagDistances[NumLags + 1] = {};
+
+	double RawDistance = 0.0;
+	double RawDegrees = 0.0;
+	double PredictedDistance = 0.0;
+	double PredictedDegrees = 0.0;
+
+	FOpenMotionEffectorPredictor Predictor;
+	for (int32 Loop = 0; Loop < Samples.Num(); ++Loop)
+	{
+		const float SampleTime = SampleTimes[Loop];
+		const float DisplayTime = SampleTime + Latency;
+		if (DisplayTime > EndTime)
+		{
+			break;
+		}
+
+		Predictor.AddSample(Samples[Loop], SampleTime);
+		const FTransform Truth = SampleTrackerTrace(SampleTimes, Samples, DisplayTime);
+		const FTransform Predicted = Predictor.Predict(DisplayTime, Settings);
+
+		RawDistance += FVector::Dist(Samples[Loop].GetLocation(), Truth.GetLocation());
+		RawDegrees += FMath::RadiansToDegrees(Samples[Loop].GetRotation().AngularDistance(Truth.GetRotation()));
+
+		const float Distance = FVector::Dist(Predicted.GetLocation(), Truth.GetLocation());
+		PredictedDistance += Distance;
+		PredictedDegrees += FMath::RadiansToDegrees(Predicted.GetRotation().AngularDistance(Truth.GetRotation()));
+		Result.PredictedMaxDistance = FMath::Max(Result.PredictedMaxDistance, Distance);
+
+		for (int32 Lag = 0; Lag <= NumLags; ++Lag)
+		{
+			const FTransform Shown = SampleTrackerTrace(SampleTimes, Samples, DisplayTime - Latency * Lag / NumLags);
+			LagDistances[Lag] += FVector::Dist(Shown.GetLocation(), Truth.GetLocation());
+		}
+
+		++Result.NumSamples;
+	}
+
+	if (Result.NumSamples == 0)
+	{
+		return Result;
+	}
+
+	const double NumSamples = Result.NumSamples;
+	Result.RawMeanDistance = RawDistance / NumSamples;
+	Result.RawMeanDegrees = RawDegrees / NumSamples;
+	Result.PredictedMeanDistance = PredictedDistance / NumSamples;
+	Result.PredictedMeanDegrees = PredictedDegrees / NumSamples;
+
+	// The lag whose mean error matches the prediction's, between the two lags either side of it
+	Result.EffectiveLatencySeconds = Latency;
+	for (int32 Lag = 1; Lag <= NumLags; ++Lag)
+	{
+		const double Below = LagDistances[Lag - 1] / NumSamples;
+		const double Above = LagDistances[Lag] / NumSamples;
+		if (Above >= Result.PredictedMeanDistance)
+		{
+			const double Alpha = (Result.PredictedMeanDistance - Below) / FMath::Max(Above - Below, (double)SMALL_NUMBER);
+			Result.EffectiveLatencySeconds = Latency * (Lag - 1 + FMath::Clamp(Alpha, 0.0, 1.0)) / NumLags;
+			break;
+		}
+	}
+
+	return Result;
+}
+
+bool UOpenMotionLibrary::LoadTrackerTrace(const FString& FileName, TArray<float>& OutSampleTimes, TArray<FTransform>& OutSamples)
+{
+	OutSampleTimes.Reset();
+	OutSamples.Reset();
+
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *FileName))
+	{
+		return false;
+	}
+
+	TArray<FString> Fields;
+	for (const FString& Line : Lines)
+	{
+		Line.ParseIntoArray(Fields, TEXT(","), true);
+		if (Fields.Num() < 8 || !Fields[0].TrimStartAndEnd().IsNumeric())
+		{
+			continue;
+		}
+
+		float Values[8];
+		for (int32 Field = 0; Field < 8; ++Field)
+		{
+			Values[Field] = FCString::Atof(*Fields[Field].TrimStartAndEnd());
+		}
+
+		FQuat Rotation(Values[4], Values[5], Values[6], Values[7]);
+		Rotation.Normalize();
+		OutSampleTimes.Add(Values[0]);
+		OutSamples.Add(FTransform(Rotation, FVector(Values[1], Values[2], Values[3])));
+	}
+
+	return OutSamples.Num() > 0;
+}
+
+void UOpenMotionLibrary::MakeSyntheticTrackerTrace(float Seconds, TArray<float>& OutSampleTimes, TArray<FTransform>& OutSamples)
+{
+	const int32 NumSamples = FMath::Max(FMath::FloorToInt(Seconds * 90.f), 2);
+	OutSampleTimes.SetNum(NumSamples);
+	OutSamples.SetNum(NumSamples);
+
+	FRandomStream Noise(1234);
+	for (int32 Loop = 0; Loop < NumSamples; ++Loop)
+	{
+		const float Time = Loop / 90.f;
+		const float Phase = 2.f * PI * Time;
+
+		const FVector Location = FVector(
+			40.f + 20.f * FMath::Sin(Phase * 0.8f),
+			25.f * FMath::Sin(Phase * 1.3f),
+			120.f + 15.f * FMath::Sin(Phase * 0.5f + 1.f));
+		const FRotator Rotation = FRotator(30.f * FMath::Sin(Phase * 0.6f), 45.f * FMath::Sin(Phase * 0.9f), 20.f * FMath::Cos(Phase * 1.1f));
+		const FVector Jitter = FVector(Noise.FRandRange(-0.05f, 0.05f), Noise.FRandRange(-0.05f, 0.05f), Noise.FRandRange(-0.05f, 0.05f));
+
+		OutSampleTimes[Loop] = Time;
+		OutSamples[Loop] = FTransform(Rotation, Location + Jitter);
+	}
+}
+
+void UOpenMotionLibrary::RunPredictionReplay(const FString& FileName, const FOpenMotionPredictionSettings& Settings)
+{
+	TArray<float> SampleTimes;
+	TArray<FTransform> Samples;
+	FString TraceName = FPaths::GetCleanFilename(FileName);
+	if (FileName.IsEmpty() || !LoadTrackerTrace(FileName, SampleTimes, Samples))
+	{
+		MakeSyntheticTrackerTrace(10.f, SampleTimes, Samples);
+		TraceName = TEXT("synthetic trace");
+	}
+
+	const FOpenMotionPredictionReplayResult Result = ReplayPredictionTrace(SampleTimes, Samples, Settings);
+	UE_LOG(OpenMotionLog, Log, TEXT("Prediction replay of %s, %d samples %.1f ms ahead: raw %.3f cm %.2f deg, predicted %.3f cm %.2f deg (max %.3f cm), effective latency %.1f ms (%.1f ms saved)"),
+		*TraceName, Result.NumSamples, Settings.PredictionSeconds * 1000.f,
+		Result.RawMeanDistance, Result.RawMeanDegrees,
+		Result.PredictedMeanDistance, Result.PredictedMeanDegrees, Result.PredictedMaxDistance,
+		Result.EffectiveLatencySeconds * 1000.f, (Settings.PredictionSeconds - Result.EffectiveLatencySeconds) * 1000.f);
+}
+
+void UOpenMotionLibrary::RunEffectorFilterBenchmark(const FOpenMotionEffectorFilterSettings& Settings, int NumAvatars, int NumFrames)
+{
+	NumAvatars = FMath::Max(NumAvatars, 1);
+	NumFrames = FMath::Max(NumFrames, 3);
+
+	TArray<float> SampleTimes;
+	TArray<FTransform> Clean;
+	MakeSyntheticTrackerTrace(NumFrames / 90.f, SampleTimes, Clean);
+	NumFrames = Clean.Num();
+
+	// Every avatar gets the same hand with its own noise, a few millimetres of it as a cheap tracker would give
+	FRandomStream Noise(5678);
+	TArray<FOpenMotionUpperBodyInput> FrameInputs;
+	FrameInputs.SetNum(NumFrames * NumAvatars);
+	for (int FrameLoop = 0; FrameLoop < NumFrames; ++FrameLoop)
+	{
+		for (int AvatarLoop = 0; AvatarLoop < NumAvatars; ++AvatarLoop)
+		{
+			FOpenMotionUpperBodyInput& Input = FrameInputs[FrameLoop * NumAvatars + AvatarLoop];
+			const FVector Jitter = FVector(Noise.FRandRange(-0.3f, 0.3f), Noise.FRandRange(-0.3f, 0.3f), Noise.FRandRange(-0.3f, 0.3f));
+			const FRotator TurnJitter = FRotator(Noise.FRandRange(-0.5f, 0.5f), Noise.FRandRange(-0.5f, 0.5f), Noise.FRandRange(-0.5f, 0.5f));
+			const FTransform Noisy = FTransform(FQuat(TurnJitter) * Clean[FrameLoop].GetRotation(), Clean[FrameLoop].GetLocation() + Jitter);
+			Input.HeadEffector = Noisy;
+			Input.LeftHandEffector = Noisy;
+			Input.RightHandEffector = Noisy;
+			Input.DeltaSeconds = (FrameLoop > 0) ? SampleTimes[FrameLoop] - SampleTimes[FrameLoop - 1] : 0.f;
+		}
+	}
+	const TArray<FOpenMotionUpperBodyInput> RawInputs = FrameInputs;
+
+	TArray<FOpenMotionEffectorFilterState> States;
+	States.SetNum(NumAvatars);
+
+	const double StartSeconds = FPlatformTime::Seconds();
+	for (int FrameLoop = 0; FrameLoop < NumFrames; ++FrameLoop)
+	{
+		FOpenMotionEffectorFilter::FilterBatch(Settings, NumAvatars, &FrameInputs[FrameLoop * NumAvatars], States.GetData());
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartSeconds;
+
+	// Jitter is the mean size of the second difference, error the mean distance from the clean hand, both for the first avatar
+	auto Measure = [&](const TArray<FOpenMotionUpperBodyInput>& InInputs, double& OutJitter, double& OutError)
+	{
+		OutJitter = 0.0;
+		OutError = 0.0;
+		for (int FrameLoop = 0; FrameLoop < NumFrames; ++FrameLoop)
+		{
+			const FVector Location = InInputs[FrameLoop * NumAvatars].LeftHandEffector.GetLocation();
+			OutError += FVector::Dist(Location, Clean[FrameLoop].GetLocation());
+			if (FrameLoop >= 2)
+			{
+				const FVector Previous = InInputs[(FrameLoop - 1) * NumAvatars].LeftHandEffector.GetLocation();
+				const FVector BeforePrevious = InInputs[(FrameLoop - 2) * NumAvatars].LeftHandEffector.GetLocation();
+				OutJitter += (Location - 2.f * Previous + BeforePrevious).Size();
+			}
+		}
+		OutJitter /= NumFrames - 2;
+		OutError /= NumFrames;
+	};
+
+	double RawJitter, RawError, FilteredJitter, FilteredError;
+	Measure(RawInputs, RawJitter, RawError);
+	Measure(FrameInputs, FilteredJitter, FilteredError);
+
+	UE_LOG(OpenMotionLog, Log, TEXT("Effector filter x %d for %d frames: %.3f us/avatar, raw jitter %.3f cm error %.3f cm, filtered jitter %.3f cm error %.3f cm"),
+		NumAvatars, NumFrames, Seconds * 1000000.0 / ((double)NumFrames * NumAvatars),
+		RawJitter, RawError, FilteredJitter, FilteredError);
+}
+
+void UOpenMotionLibrary::RunEffectorReplicationBenchmark(int NumAvatars, float SendRate, float PacketLoss, float Seconds)
+{
+	NumAvatars = FMath::Max(NumAvatars, 1);
+	SendRate = FMath::Max(SendRate, 1.f);
+	Seconds = FMath::Max(Seconds, 1.f);
+	const int32 NumSends = FMath::CeilToInt(Seconds * SendRate);
+	const int32 AckDelaySends = FMath::Max(FMath::RoundToInt(0.1f * SendRate), 1);
+
+	TArray<float> SampleTimes;
+	TArray<FTransform> Trace;
+	MakeSyntheticTrackerTrace(Seconds + 3.f, SampleTimes, Trace);
+
+	// An update the sender hasn't heard back about yet
+	struct FInFlight
+	{
+		TSharedPtr<INetDeltaBaseState> Base;
+		TSharedPtr<INetDeltaBaseState> State;
+		int32 SendIndex;
+		bool Lost;
+	};
+
+	// What the net driver keeps for each connection: the state the next update is written against, and the state of the
+	// newest update known to have arrived, which is where it goes back to when it hears an update was lost
+	TArray<FOpenMotionReplicatedEffectors> Senders;
+	TArray<FOpenMotionReplicatedEffectors> Receivers;
+	TArray<TSharedPtr<INetDeltaBaseState>> RecentStates;
+	TArray<TSharedPtr<INetDeltaBaseState>> AckedStates;
+	TArray<TArray<FInFlight>> InFlight;
+	Senders.SetNum(NumAvatars);
+	Receivers.SetNum(NumAvatars);
+	RecentStates.SetNum(NumAvatars);
+	AckedStates.SetNum(NumAvatars);
+	InFlight.SetNum(NumAvatars);
+
+	FRandomStream Loss(4321);
+	int64 DeltaBits = 0;
+	int64 FullBits = 0;
+	int32 NumUpdates = 0;
+	int32 NumFullUpdates = 0;
+	int32 NumLost = 0;
+	TArray<int32> DropRuns;
+	DropRuns.Init(0, NumAvatars);
+	int32 MaxDropRun = 0;
+	int32 NumApplied = 0;
+	double SumDistance = 0.0;
+	double SumDegrees = 0.0;
+	float MaxDistance = 0.f;
+	float MaxDegrees = 0.f;
+	double CodecSeconds = 0.0;
+
+	for (int32 Send = 0; Send < NumSends; ++Send)
+	{
+		const float Time = Send / SendRate;
+		for (int32 Avatar = 0; Avatar < NumAvatars; ++Avatar)
+		{
+			// Both hands and the head from different stretches of the trace, so no two avatars or effectors move alike
+			const float AvatarTime = Time + FMath::Fmod(Avatar * 0.37f, 2.f);
+			const FTransform Left = SampleTrackerTrace(SampleTimes, Trace, AvatarTime);
+			const FTransform Right = SampleTrackerTrace(SampleTimes, Trace, AvatarTime + 0.5f);
+			const FTransform Swing = SampleTrackerTrace(SampleTimes, Trace, AvatarTime + 1.f);
+			const FTransform Head = FTransform(Swing.GetRotation(), FVector(10.f, 0.f, 160.f) + 0.2f * (Swing.GetLocation() - FVector(40.f, 0.f, 120.f)));
+			const FTransform Component = FTransform(FRotator(0.f, Avatar * 37.f, 0.f), FVector(Avatar * 200.f, 0.f, 0.f));
+
+			FOpenMotionReplicatedEffectors& Sender = Senders[Avatar];
+			FOpenMotionReplicatedEffectors& Receiver = Receivers[Avatar];
+			Sender.SetEffectors(Component, Head * Component, Left * Component, FTransform(Right.GetRotation(), Right.GetLocation() * FVector(1.f, -1.f, 1.f)) * Component);
+
+			// The same update in full, to compare against
+			FBitWriter FullWriter(0, true);
+			FOpenMotionReplicatedEffectors::WriteEffectors(FullWriter, Sender.Quantize(), nullptr);
+			FullBits += FullWriter.GetNumBits();
+
+			const double StartSeconds = FPlatformTime::Seconds();
+
+			FBitWriter Writer(0, true);
+			TSharedPtr<INetDeltaBaseState> NewState;
+			FNetDeltaSerializeInfo WriteParms;
+			WriteParms.Writer = &Writer;
+			WriteParms.OldState = RecentStates[Avatar].Get();
+			WriteParms.NewState = &NewState;
+
+			bool Applied = false;
+			const bool bSent = Sender.NetDeltaSerialize(WriteParms);
+			if (bSent)
+			{
+				++NumUpdates;
+				DeltaBits += Writer.GetNumBits();
+				if (static_cast<FOpenMotionEffectorsDeltaState*>(NewState.Get())->DeltasSinceFull == 0)
+				{
+					++NumFullUpdates;
+				}
+
+				FInFlight Update;
+				Update.Base = RecentStates[Avatar];
+				Update.State = NewState;
+				Update.SendIndex = Send;
+				Update.Lost = Loss.FRand() < PacketLoss;
+				InFlight[Avatar].Add(Update);
+				RecentStates[Avatar] = NewState;
+
+				if (Update.Lost)
+				{
+					++NumLost;
+				}
+				else
+				{
+					const int32 DroppedBefore = Receiver.NumDeltasDropped;
+					FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+					FNetDeltaSerializeInfo ReadParms;
+					ReadParms.Reader = &Reader;
+					Receiver.NetDeltaSerialize(ReadParms);
+					Applied = (Receiver.NumDeltasDropped == DroppedBefore);
+				}
+			}
+
+			// How long the receiver went without a usable update, which the full updates keep bounded
+			if (bSent)
+			{
+				DropRuns[Avatar] = Applied ? 0 : DropRuns[Avatar] + 1;
+				MaxDropRun = FMath::Max(MaxDropRun, DropRuns[Avatar]);
+			}
+
+			// Word of each update comes back AckDelaySends later. As with the engine, an acknowledgement only says the
+			// packet arrived, whether or not the receiver had the base to apply it.
+			TArray<FInFlight>& Pending = InFlight[Avatar];
+			while (Pending.Num() > 0 && Send - Pending[0].SendIndex >= AckDelaySends)
+			{
+				const FInFlight Oldest = Pending[0];
+				Pending.RemoveAt(0);
+				if (Oldest.Lost)
+				{
+					RecentStates[Avatar] = AckedStates[Avatar];
+				}
+				else
+				{
+					AckedStates[Avatar] = Oldest.State;
+				}
+			}
+
+			CodecSeconds += FPlatformTime::Seconds() - StartSeconds;
+
+			if (Applied)
+			{
+				++NumApplied;
+				const FTransform* Sent[3] = { &Sender.HeadEffector, &Sender.LeftHandEffector, &Sender.RightHandEffector };
+				const FTransform* Rebuilt[3] = { &Receiver.HeadEffector, &Receiver.LeftHandEffector, &Receiver.RightHandEffector };
+				for (int32 Loop = 0; Loop < 3; ++Loop)
+				{
+					const float Distance = FVector::Dist(Sent[Loop]->GetLocation(), Rebuilt[Loop]->GetLocation());
+					const float Degrees = FMath::RadiansToDegrees(Sent[Loop]->GetRotation().AngularDistance(Rebuilt[Loop]->GetRotation()));
+					SumDistance += Distance;
+					SumDegrees += Degrees;
+					MaxDistance = FMath::Max(MaxDistance, Distance);
+					MaxDegrees = FMath::Max(MaxDegrees, Degrees);
+				}
+			}
+		}
+	}
+
+	int32 NumDropped = 0;
+	for (const FOpenMotionReplicatedEffectors& Receiver : Receivers)
+	{
+		NumDropped += Receiver.NumDeltasDropped;
+	}
+
+	// Three transforms of ten floats each, as the effectors go when replicated as they are
+	const double RawBytesPerSecond = 3.0 * 10.0 * sizeof(float) * SendRate;
+	const double AvatarSeconds = (double)NumAvatars * NumSends / SendRate;
+	const double Effectors = FMath::Max(3.0 * NumApplied, 1.0);
+
+	UE_LOG(OpenMotionLog, Log, TEXT("Effector replication x %d at %.0f Hz, %.0f%% loss: %.1f bytes/avatar/s as deltas, %.1f as full updates, %.0f as raw transforms; %d updates (%d in full), %d lost, %d dropped for want of a base, at most %d sends in a row without one applied; %.3f us/update"),
+		NumAvatars, SendRate, PacketLoss * 100.f,
+		DeltaBits / 8.0 / AvatarSeconds, FullBits / 8.0 / AvatarSeconds, RawBytesPerSecond,
+		NumUpdates, NumFullUpdates, NumLost, NumDropped, MaxDropRun,
+		CodecSeconds * 1000000.0 / FMath::Max(NumUpdates, 1));
+	UE_LOG(OpenMotionLog, Log, TEXT("Effector replication loopback error: mean %.4f cm %.4f deg, max %.4f cm %.4f deg"),
+		SumDistance / Effectors, SumDegrees / Effectors, MaxDistance, MaxDegrees);
+}
+
+FTransform UOpenMotionLibrary::SampleTrackerTrace(const TArray<float>& InSampleTimes, const TArray<FTransform>& InSamples, float InTime)
+{
+	const int32 Next = Algo::UpperBound(InSampleTimes, InTime);
+	if (Next <= 0)
+	{
+		return InSamples[0];
+	}
+	if (Next >= InSamples.Num())
+	{
+		return InSamples.Last();
+	}
+
+	const int32 Previous = Next - 1;
+	const float Alpha = (InTime - InSampleTimes[Previous]) / FMath::Max(InSampleTimes[Next] - InSampleTimes[Previous], SMALL_NUMBER);
+	return FTransform(
+		FQuat::Slerp(InSamples[Previous].GetRotation(), InSamples[Next].GetRotation(), Alpha),
+		FMath::Lerp(InSamples[Previous].GetLocation(), InSamples[Next].GetLocation(), Alpha));
+}
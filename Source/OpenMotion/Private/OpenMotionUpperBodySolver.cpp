@@ -0,0 +1,349 @@
+// Copyright (c) Name 2020
+
+
+#include "OpenMotionUpperBodySolver.h"
+
+#include "Async/ParallelFor.h"
+
+#include "OpenMotion.h"
+
+DECLARE_CYCLE_STAT(TEXT("OpenMotion Upper Body Solve"), STAT_OpenMotionUpperBodySolve, STATGROUP_OpenMotion);
+DECLARE_CYCLE_STAT(TEXT("OpenMotion Upper Body SolveBatch"), STAT_OpenMotionUpperBodySolveBatch, STATGROUP_OpenMotion);
+DECLARE_DWORD_COUNTER_STAT(TEXT("OpenMotion Upper Bodies Solved"), STAT_OpenMotionUpperBodiesSolved, STATGROUP_OpenMotion);
+
+void FOpenMotionUpperBodySolver::Solve(const FOpenMotionUpperBodyInput& InInput, const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose)
+{
+	SCOPE_CYCLE_COUNTER(STAT_OpenMotionUpperBodySolve);
+
+	InOutPose.WorldTransforms.HeadEffector = InInput.HeadEffector;
+	InOutPose.WorldTransforms.LeftHandEffector = InInput.LeftHandEffector;
+	InOutPose.WorldTransforms.RightHandEffector = InInput.RightHandEffector;
+	InOutPose.WorldTransforms.Component = InInput.Component;
+
+	ConvertTransforms(InOutPose);
+	SetShoulder(InSettings, InOutPose);
+	SetLeftUpperArm(InSettings, InOutPose); SetRightUpperArm(InSettings, InOutPose);
+	if (InInput.HasUpperArmLocations)
+	{
+		ResetUpperArmsLocation(InInput.LeftUpperArmLocation, InInput.RightUpperArmLocation, InOutPose);
+	}
+	SolveArms(InSettings, InInput.DeltaSeconds, InOutPose);
+	InOutPose.CharacterSettings.CharacterBaseTransform = GetBaseCharTransform(InOutPose);
+}
+
+FOpenMotionUpperBodyPose FOpenMotionUpperBodySolver::Solve(const FOpenMotionUpperBodyInput& InInput, const FTransformSettings& InSettings, const FOpenMotionUpperBodyPose& InLastPose)
+{
+	FOpenMotionUpperBodyPose Pose = InLastPose;
+	Solve(InInput, InSettings, Pose);
+	return Pose;
+}
+
+void FOpenMotionUpperBodySolver::SolveBatch(const TArray<FOpenMotionUpperBodyInput>& InInputs, const TArray<FTransformSettings>& InSettings, TArray<FOpenMotionUpperBodyPose>& InOutPoses, int32 InMaxThreads)
+{
+	SCOPE_CYCLE_COUNTER(STAT_OpenMotionUpperBodySolveBatch);
+
+	const int32 NumAvatars = InInputs.Num();
+	if (InOutPoses.Num() != NumAvatars || (InSettings.Num() != 1 && InSettings.Num() != NumAvatars))
+	{
+		UE_LOG(OpenMotionLog, Fatal, TEXT("SolveBatch needs a pose for each of the %d inputs and one set of settings or one for each."), NumAvatars);
+	}
+
+	// Every avatar is independent of the others, so each chunk just works through its share of them
+	const bool bSharedSettings = InSettings.Num() == 1;
+	const int32 MaxChunks = (InMaxThreads > 0) ? InMaxThreads : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	const int32 NumChunks = FMath::Min(NumAvatars, MaxChunks);
+	if (NumChunks > 0)
+	{
+		ParallelFor(NumChunks, [&](int32 Chunk)
+		{
+			for (int32 Index = Chunk; Index < NumAvatars; Index += NumChunks)
+			{
+				Solve(InInputs[Index], InSettings[bSharedSettings ? 0 : Index], InOutPoses[Index]);
+			}
+		}, NumChunks <= 1);
+	}
+
+	INC_DWORD_STAT_BY(STAT_OpenMotionUpperBodiesSolved, NumAvatars);
+}
+
+void FOpenMotionUpperBodySolver::ConvertTransforms(FOpenMotionUpperBodyPose& InOutPose)
+{
+	FWorldTransforms& World = InOutPose.WorldTransforms;
+
+	const FTransform LeftHandInverseLocation = World.LeftHandEffector.Inverse();
+	const FTransform RightHandInverseLocation = World.RightHandEffector.Inverse();
+
+	World.LeftHandEffector = FTransform(LeftHandInverseLocation.GetRotation(), LeftHandInverseLocation.GetLocation() + FVector(8.0f, 0.f, 0.f), LeftHandInverseLocation.GetScale3D());
+	World.RightHandEffector = FTransform(RightHandInverseLocation.GetRotation(), RightHandInverseLocation.GetLocation() + FVector(8.0f, 0.f, 0.f), RightHandInverseLocation.GetScale3D()).Inverse();
+
+	InOutPose.LocalComponentTransform = World.Component.Inverse();
+	const FTransform& LocalComponentTransform = InOutPose.LocalComponentTransform;
+	InOutPose.ComponentTransforms.HeadEffector = World.HeadEffector * LocalComponentTransform;
+	InOutPose.ComponentTransforms.LeftHandEffector = World.LeftHandEffector * LocalComponentTransform;
+	InOutPose.ComponentTransforms.RightHandEffector = World.RightHandEffector * LocalComponentTransform;
+
+	// The shoulder is still the one solved last frame - SetShoulder only moves it in component space
+	World.Shoulder = InOutPose.ComponentTransforms.Shoulder * World.Component;
+	const FTransform LocalShoulderTransform = World.Shoulder.Inverse();
+	InOutPose.ShoulderTransforms.HeadEffector = World.HeadEffector * LocalShoulderTransform;
+	InOutPose.ShoulderTransforms.LeftHandEffector = World.LeftHandEffector * LocalShoulderTransform;
+	InOutPose.ShoulderTransforms.RightHandEffector = World.RightHandEffector * LocalShoulderTransform;
+}
+
+void FOpenMotionUpperBodySolver::SetShoulder(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose)
+{
+	const FTransform& HeadEffector = InOutPose.ComponentTransforms.HeadEffector;
+	const FQuat HeadRotation = HeadEffector.GetRotation();
+
+	// The head quaternion's components are used as angles in degrees
+	const FVector RotatedVector = FRotator(0.f, HeadRotation.Z, HeadRotation.X).RotateVector(FVector(-9.f, 0.f, -0.7f));
+	const FRotator Delta = FRotator(HeadRotation.Y, 0.f, 0.f);
+	const FTransform RotationPoint = FTransform(HeadEffector.GetLocation() + RotatedVector);
+
+	const FVector ComponentShoulderLocation = RotatePointAroundPivot(RotationPoint, HeadEffector, Delta).GetLocation() + FVector(0, 0, -17);
+
+	// Shortest path rotator lerp
+	const FQuat FromHead = FQuat(GetShoulderRotationFromHead(InOutPose));
+	const FQuat FromHands = FQuat(GetShoulderRotationFromHands(InSettings, InOutPose));
+	const FRotator ComponentShoulderRotation = FRotator(0.f, FQuat::Slerp(FromHead, FromHands, 0.7f).Rotator().Yaw, 0.f);
+
+	InOutPose.ComponentTransforms.Shoulder = FTransform(ComponentShoulderRotation, ComponentShoulderLocation, FVector(1, 1, 1));
+}
+
+void FOpenMotionUpperBodySolver::SetLeftUpperArm(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose)
+{
+	const FTransform& Shoulder = InOutPose.WorldTransforms.Shoulder;
+
+	InOutPose.ShoulderTransforms.LeftUpperArm = RotateUpperArm(InSettings, InOutPose.CharacterSettings, true, InOutPose.ShoulderTransforms.LeftHandEffector.GetLocation());
+	const FRotator ModifiedRotator = FRotationMatrix::MakeFromXZ((InOutPose.ShoulderTransforms.LeftUpperArm * Shoulder).GetLocation() - Shoulder.GetLocation(), FVector::UpVector).Rotator();
+	InOutPose.ComponentTransforms.LeftClavicle = FTransform(ModifiedRotator, FVector(0, 0, 0), FVector(1, 1, 1)) * InOutPose.LocalComponentTransform;
+}
+
+void FOpenMotionUpperBodySolver::SetRightUpperArm(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose)
+{
+	const FTransform& Shoulder = InOutPose.WorldTransforms.Shoulder;
+
+	InOutPose.ShoulderTransforms.RightUpperArm = RotateUpperArm(InSettings, InOutPose.CharacterSettings, false, InOutPose.ShoulderTransforms.RightHandEffector.GetLocation());
+	const FRotator ModifiedRotator = FRotationMatrix::MakeFromXZ((InOutPose.ShoulderTransforms.RightUpperArm * Shoulder).GetLocation() - Shoulder.GetLocation(), FVector::UpVector).Rotator();
+	InOutPose.ComponentTransforms.RightClavicle = FTransform(ModifiedRotator, FVector(0, 0, 0), FVector(1, 1, 1)) * InOutPose.LocalComponentTransform;
+}
+
+void FOpenMotionUpperBodySolver::ResetUpperArmsLocation(FVector InLeftUpperArmLocation, FVector InRightUpperArmLocation, FOpenMotionUpperBodyPose& InOutPose)
+{
+	const FTransform& Shoulder = InOutPose.WorldTransforms.Shoulder;
+	InOutPose.ShoulderTransforms.LeftUpperArm = FTransform(Shoulder.InverseTransformPosition(InLeftUpperArmLocation));
+	InOutPose.ShoulderTransforms.RightUpperArm = FTransform(Shoulder.InverseTransformPosition(InRightUpperArmLocation));
+}
+
+FArmTransforms FOpenMotionUpperBodySolver::SolveArm(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, const FTransform& InHand, const FTransform& InLastLowerArm, float InDeltaSeconds, float& InOutElbowHandAngle)
+{
+	// Both arms are placed as a left arm
+	const FVector HandLocation = InHand.GetLocation();
+	const FRotator HandRotation = FRotator(InHand.GetRotation());
+	const FArmTransforms BasePosition = SetElbowBasePosition(InCharacterSettings, true, InLastLowerArm.GetLocation(), HandLocation);
+	const float Angle = RotateElbowByHandPosition(InSettings, InCharacterSettings, true, HandLocation);
+	const FArmTransforms TempArms = RotateElbow(true, Angle, BasePosition, HandLocation);
+	const float TempAngle = RotateElbowByHandRotation(TempArms.LowerArmTransform, HandRotation);
+
+	InOutElbowHandAngle = FMath::FInterpTo(InOutElbowHandAngle, SafeguardAngle(InOutElbowHandAngle, TempAngle, 120.f), InDeltaSeconds, InSettings.ElbowHandRotSpeed);
+
+	return RotateElbow(true, InOutElbowHandAngle + Angle, BasePosition, HandLocation);
+}
+
+void FOpenMotionUpperBodySolver::SolveArms(const FTransformSettings& InSettings, float InDeltaSeconds, FOpenMotionUpperBodyPose& InOutPose)
+{
+	FWorldTransforms& World = InOutPose.WorldTransforms;
+	FShoulderTransforms& Shoulder = InOutPose.ShoulderTransforms;
+	FCharacterSettings& Character = InOutPose.CharacterSettings;
+	const FTransform& LocalComponentTransform = InOutPose.LocalComponentTransform;
+
+	const FArmTransforms LeftArm = SolveArm(InSettings, Character, Shoulder.LeftHandEffector, Shoulder.LeftLowerArm, InDeltaSeconds, Character.LeftElbowHandAngle);
+	Shoulder.LeftUpperArm = LeftArm.UpperArmTransform;
+	World.LeftUpperArm = Shoulder.LeftUpperArm * World.Shoulder;
+
+	Shoulder.LeftLowerArm = LeftArm.LowerArmTransform;
+	World.LeftLowerArm = Shoulder.LeftLowerArm * World.Shoulder;
+	const FTransform TempTransform = World.LeftUpperArm * LocalComponentTransform;
+	const FVector TempLocation = World.LeftHandEffector.GetLocation() - World.LeftUpperArm.GetLocation();
+	const FQuat TempRotation = TempTransform.GetRotation() * FQuat(FRotator(0.f, 0.f, FMath::Max(TempLocation.Z, 0.f)));
+
+	InOutPose.ComponentTransforms.LeftUpperArm = FTransform(TempRotation, TempTransform.GetLocation(), FVector(1, 1, 1));
+
+	InOutPose.ComponentTransforms.LeftLowerArm = World.LeftLowerArm * LocalComponentTransform;
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	const FArmTransforms RightArm = SolveArm(InSettings, Character, Shoulder.RightHandEffector, Shoulder.RightLowerArm, InDeltaSeconds, Character.RightElbowHandAngle);
+	Shoulder.RightUpperArm = RightArm.UpperArmTransform;
+	World.RightUpperArm = Shoulder.RightUpperArm * World.Shoulder;
+
+	Shoulder.RightLowerArm = RightArm.LowerArmTransform;
+	World.RightLowerArm = Shoulder.RightLowerArm * World.Shoulder;
+	const FTransform TempTransform2 = World.RightUpperArm * LocalComponentTransform;
+	const FVector TempLocation2 = World.RightHandEffector.GetLocation() - World.RightUpperArm.GetLocation();
+	const FQuat TempRotation2 = TempTransform2.GetRotation() * FQuat(FRotator(0.f, 0.f, FMath::Max(TempLocation2.Z, 0.f) * -1.f));
+
+	InOutPose.ComponentTransforms.RightUpperArm = FTransform(TempRotation2, TempTransform2.GetLocation(), FVector(1, 1, 1));
+
+	// Taken from the left lower arm
+	InOutPose.ComponentTransforms.RightLowerArm = World.LeftLowerArm * LocalComponentTransform;
+}
+
+void FOpenMotionUpperBodySolver::Calibrate(const FTransformSettings& InSettings, float InCharacterHeight, FCharacterSettings& InOutCharacterSettings)
+{
+	InOutCharacterSettings.ArmLength = (InCharacterHeight / 2) - InSettings.UpperArmsDistance;
+	InOutCharacterSettings.UpperArmLength = InOutCharacterSettings.ArmLength * (1.f - 0.48f);
+	InOutCharacterSettings.LowerArmLength = InOutCharacterSettings.ArmLength * 0.48f;
+	InOutCharacterSettings.HeadHandAngleLimitDot = FMath::Cos(FMath::DegreesToRadians(InSettings.HeadHandAngleLimit));
+}
+
+FTransform FOpenMotionUpperBodySolver::RotateUpperArm(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, bool bInIsLeftArm, const FVector& InHandLocation)
+{
+	const float Side = bInIsLeftArm ? 1.f : -1.f;
+	const FVector LInitialUpperArmPos = FVector::RightVector * (InSettings.UpperArmsDistance / 2.f * Side);
+	const FVector LHandUpperArmDir = InHandLocation - LInitialUpperArmPos;
+	const float LForwardDistanceRatio = LHandUpperArmDir.X / InCharacterSettings.ArmLength;
+	const float LUpwardsDistanceRatio = LHandUpperArmDir.Z / InCharacterSettings.ArmLength;
+
+	float LYaw = 0.f;
+	if (LForwardDistanceRatio > 0.f)
+	{
+		LYaw = FMath::Clamp((LForwardDistanceRatio - 0.5f) * InSettings.DistinctShoulderRotationMultiplier, 0.f, InSettings.DistinctShoulderRotationLimit) + InSettings.ClavicleOffset;
+	}
+	else
+	{
+		LYaw = FMath::Clamp((LForwardDistanceRatio - 0.08f) * InSettings.DistinctShoulderRotationMultiplier, InSettings.DistinctShoulderRotationLimit * -1.f, 0.f) + InSettings.ClavicleOffset;
+	}
+
+	const float LRoll = FMath::Clamp((LUpwardsDistanceRatio - 0.2f) * InSettings.DistinctShoulderRotationMultiplier, 0.f, InSettings.DistinctShoulderRotationLimit) + InSettings.ClavicleOffset;
+
+	return FTransform(FRotator(0.f, LYaw * -Side, LRoll * -Side), LInitialUpperArmPos, FVector(1, 1, 1)).Inverse();
+}
+
+FArmTransforms FOpenMotionUpperBodySolver::SetElbowBasePosition(const FCharacterSettings& InCharacterSettings, bool bInIsLeftArm, const FVector& InUpperArmLocation, const FVector& InHandLocation)
+{
+	const float LUpperArmToHandLen = (InUpperArmLocation - InHandLocation).Size();
+	const float LBeta = CosineRule(InCharacterSettings.UpperArmLength, LUpperArmToHandLen, InCharacterSettings.LowerArmLength) * (bInIsLeftArm ? -1.f : 1.f);
+	const float CRule = CosineRule(InCharacterSettings.LowerArmLength, InCharacterSettings.UpperArmLength, LUpperArmToHandLen);
+	const float LOmega = bInIsLeftArm ? 180.f - CRule : CRule + 180;
+
+	FVector B = InHandLocation - InUpperArmLocation;
+	B.Normalize(0.0001);
+	const FRotator Normal = FindBetweenNormals(FVector::ForwardVector, B);
+	const FVector NormalUp = FRotationMatrix(Normal).GetScaledAxis(EAxis::Z).GetSafeNormal();
+	const FRotator Rotator = FRotator(FQuat(NormalUp, FMath::DegreesToRadians(LBeta)) * FQuat(Normal));
+
+	const FTransform T1 = FTransform(Rotator, InUpperArmLocation, FVector(1, 1, 1));
+	const FTransform T2 = FTransform(FRotator(0.f, LOmega, 0.f), FVector::ForwardVector * InCharacterSettings.UpperArmLength, FVector(1, 1, 1));
+	return FArmTransforms(T1, T2 * T1);
+}
+
+float FOpenMotionUpperBodySolver::RotateElbowByHandPosition(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, bool bInIsLeftArm, const FVector& InHandLocation)
+{
+	const float Temp = (InHandLocation.Y / InCharacterSettings.ArmLength) * (bInIsLeftArm ? 1.f : -1.f);
+	return InSettings.ElbowBaseOffsetAngle + (InSettings.ElbowYWeight + FMath::Max(0.f, Temp + InSettings.ElbowYDistanceStart));
+}
+
+float FOpenMotionUpperBodySolver::RotateElbowByHandRotation(const FTransform& InLowerArm, const FRotator& InHandRotation)
+{
+	const FRotationMatrix LowerArmMatrix(FRotator(InLowerArm.GetRotation()));
+	const FVector RightVector = LowerArmMatrix.GetScaledAxis(EAxis::Y);
+	FVector NormalizedVector = FVector::VectorPlaneProject(InHandRotation.Vector(), RightVector);
+	NormalizedVector.Normalize(0.0001);
+	const FVector ForwardVector = LowerArmMatrix.GetScaledAxis(EAxis::X);
+	const float Length = (NormalizedVector - ForwardVector).Size();
+	const float Dot = FVector::DotProduct(FVector::CrossProduct(NormalizedVector, ForwardVector), RightVector);
+	return (CosineRule(1.f, 1.f, Length) * (Dot < 0.f ? 1.f : -1.f)) * 0.6f;
+}
+
+float FOpenMotionUpperBodySolver::CosineRule(float InAdjacentA, float InAdjacentB, float InOpposite)
+{
+	// In radians, though callers treat it as degrees
+	return FMath::Acos((((InAdjacentA * InAdjacentA) + (InAdjacentB * InAdjacentB)) - (InOpposite * InOpposite)) / (InAdjacentA * InAdjacentB * 2));
+}
+
+FArmTransforms FOpenMotionUpperBodySolver::RotateElbow(bool bInIsLeftArm, float InAngle, const FArmTransforms& InUpperAndLowerArms, const FVector& InHandLocation)
+{
+	const FVector UpperArmLocation = InUpperAndLowerArms.UpperArmTransform.GetLocation();
+	const FVector UpperArmHandAxis = UpperArmLocation - InHandLocation;
+	const FVector PointDirection = UpperArmLocation - InUpperAndLowerArms.LowerArmTransform.GetLocation();
+	const FVector PointDirectionVector = (UpperArmHandAxis.SizeSquared() > SMALL_NUMBER) ? PointDirection.ProjectOnTo(UpperArmHandAxis) : FVector::ZeroVector;
+	const FVector PivotLocation = UpperArmLocation + PointDirectionVector;
+	const FVector UpperArmRotationUpVector = InUpperAndLowerArms.UpperArmTransform.GetRotation().GetUpVector();
+
+	FVector PivotForward = UpperArmHandAxis;
+	FVector PivotRight = FVector::CrossProduct(UpperArmRotationUpVector, UpperArmHandAxis);
+	FVector PivotUp = UpperArmRotationUpVector;
+	PivotForward.Normalize(); PivotRight.Normalize(); PivotUp.Normalize();
+	const FRotator PivotRotation = FMatrix(PivotForward, PivotRight, PivotUp, FVector::ZeroVector).Rotator();
+	const FTransform TempTransform = FTransform(PivotRotation, PivotLocation, FVector(1, 1, 1));
+	const FRotator TempRotator = FRotator(0.f, 0.f, bInIsLeftArm ? 180.f - InAngle : 180.f + InAngle);
+	return FArmTransforms(RotatePointAroundPivot(InUpperAndLowerArms.UpperArmTransform, TempTransform, TempRotator), RotatePointAroundPivot(InUpperAndLowerArms.LowerArmTransform, TempTransform, TempRotator));
+}
+
+float FOpenMotionUpperBodySolver::SafeguardAngle(float InCurrent, float InLast, float InThreshold)
+{
+	return (FMath::Abs(InLast - InCurrent) > InThreshold) ? InLast : InCurrent;
+}
+
+FTransform FOpenMotionUpperBodySolver::RotatePointAroundPivot(const FTransform& InPoint, const FTransform& InPivot, const FRotator& InDelta)
+{
+	return (((InPoint * InPivot.Inverse()) * FTransform(InDelta, FVector(0, 0, 0), FVector(1, 1, 1))) * InPivot);
+}
+
+float FOpenMotionUpperBodySolver::GetHeadHandAngle(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, float InLastAngle, const FVector& InHandLocation, const FVector& InHandHeadDelta)
+{
+	// Built from the bool FVector::Normalize returns, so every component is one, or zero with the hand straight over the head
+	const float SubAngle = FVector(InHandLocation.X, InHandLocation.Y, 0).Normalize(0.0001) ? 1.f : 0.f;
+	const float Angle = FMath::Atan2(SubAngle, SubAngle);
+
+	const float Alpha = FMath::GetMappedRangeValueClamped(FVector2D(20.f, 50.f), FVector2D(0.f, 1.f), InHandHeadDelta.Size2D());
+
+	const bool OR = ((FMath::Sign(InLastAngle) == FMath::Sign(Angle)) || (Angle < InSettings.HeadHandAngleOkSpan && Angle > InSettings.HeadHandAngleOkSpan * -1.f));
+	const bool bPickA = ((SubAngle > InCharacterSettings.HeadHandAngleLimitDot) && OR);
+	return Alpha * (bPickA ? Angle : InSettings.HeadHandAngleLimit * FMath::Sign(InLastAngle));
+}
+
+FTransform FOpenMotionUpperBodySolver::GetBaseCharTransform(const FOpenMotionUpperBodyPose& InPose)
+{
+	const FTransform& Shoulder = InPose.ComponentTransforms.Shoulder;
+	return FTransform(Shoulder.GetRotation(), Shoulder.GetLocation() - FVector(0.f, 0.f, 12.f + 43.25f), FVector(1, 1, 1));
+}
+
+FRotator FOpenMotionUpperBodySolver::GetShoulderRotationFromHead(const FOpenMotionUpperBodyPose& InPose)
+{
+	return FRotator(0.f, InPose.ComponentTransforms.HeadEffector.GetRotation().Z, 0.f);
+}
+
+FRotator FOpenMotionUpperBodySolver::GetShoulderRotationFromHands(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose)
+{
+	const FWorldTransforms& World = InOutPose.WorldTransforms;
+	FCharacterSettings& Character = InOutPose.CharacterSettings;
+
+	const FTransform HeadInverse = World.HeadEffector.Inverse();
+	const FVector Local_TopHead = World.HeadEffector.GetRotation().Rotator().RotateVector(FVector(0.f, 0.f, 15.f)) + World.HeadEffector.GetLocation();
+	Character.LeftHeadHandAngle = GetHeadHandAngle(InSettings, Character, Character.LeftHeadHandAngle, (World.LeftHandEffector * HeadInverse).GetLocation(), World.LeftHandEffector.GetLocation() - Local_TopHead);
+	Character.RightHeadHandAngle = GetHeadHandAngle(InSettings, Character, Character.RightHeadHandAngle, (World.RightHandEffector * HeadInverse).GetLocation(), World.RightHandEffector.GetLocation() - Local_TopHead);
+
+	const FTransform TempTransform = FTransform(FRotator(0.f, Character.LeftHeadHandAngle + Character.RightHeadHandAngle / 2, 0.f), FVector(0.f, 0.f, 0.f), FVector(1, 1, 1)) * World.HeadEffector * InOutPose.LocalComponentTransform;
+	return FRotator(TempTransform.GetRotation());
+}
+
+FRotator FOpenMotionUpperBodySolver::FindBetweenNormals(const FVector& InA, const FVector& InB)
+{
+	float W = FVector::DotProduct(InA, InB) + 1.f;
+	FVector Axis;
+	if (W > 0.000001)
+	{
+		Axis = FVector::CrossProduct(InA, InB);
+	}
+	else
+	{
+		W = 0;
+		Axis = (FMath::Abs(InA.X) > FMath::Abs(InA.Y)) ? FVector(InA.Z * 1.f, 0.f, InA.X) : FVector(0.f, InA.Z * -1.f, InA.Y);
+	}
+
+	FQuat QQQ = FQuat(Axis.X, Axis.Y, Axis.Z, W);
+	QQQ.Normalize(0.0001);
+	return QQQ.Rotator();
+}
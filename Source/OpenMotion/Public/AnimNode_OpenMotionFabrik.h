@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoneContainer.h"
+#include "BoneControllers/AnimNode_SkeletalControlBase.h"
+#include "FabrikRigAsset.h"
+#include "AnimNode_OpenMotionFabrik.generated.h"
+
+/**
+ * Skeleton bones standing in for the joints of one chain of a UFabrikRigAsset.
+ */
+USTRUCT(BlueprintType)
+struct OPENMOTION_API FOpenMotionFabrikChainBones
+{
+	GENERATED_BODY()
+
+	// One bone per joint, from the base of the chain to the end effector - NumBones + 1 in all
+	UPROPERTY(EditAnywhere, Category = Setting)
+		TArray<FBoneReference> Joints;
+};
+
+/**
+ * Solves a UFabrikRigAsset against skeleton bones in component space, as part of the animation evaluation.
+ *
+ * Each evaluation reads the joint locations from the incoming pose, solves every chain for its entry in ChainTargets and
+ * writes the bones back, turning each bone to face the next joint. The rig asset is only read, under its definition
+ * lock, and the pose and scratch space belong to the node, so the solve runs on whichever animation worker evaluates
+ * the graph. The rig's bone lengths should match the skeleton's.
+ *
+ * Only the chain bases are read from the incoming pose once the node has solved, and the rest of each chain carries on
+ * from the last solve, so a chain whose base and target have not moved is skipped.
+ */
+USTRUCT(BlueprintInternalUseOnly)
+struct OPENMOTION_API FAnimNode_OpenMotionFabrik : public FAnimNode_SkeletalControlBase
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = Setting, meta = (PinShownByDefault))
+		UFabrikRigAsset* RigAsset;
+
+	// Per chain of RigAsset, the bones its joints drive
+	UPROPERTY(EditAnywhere, Category = Setting)
+		TArray<FOpenMotionFabrikChainBones> ChainBones;
+
+	// Per chain component space target. Chains without an entry hold their end effector where the pose put it.
+	UPROPERTY(EditAnywhere, Category = Setting, meta = (PinShownByDefault))
+		TArray<FVector> ChainTargets;
+
+	FAnimNode_OpenMotionFabrik();
+
+	// FAnimNode_Base interface
+	virtual void GatherDebugData(FNodeDebugData& DebugData) override;
+	// End of FAnimNode_Base interface
+
+	// FAnimNode_SkeletalControlBase interface
+	virtual void EvaluateSkeletalControl_AnyThread(FComponentSpacePoseContext& Output, TArray<FBoneTransform>& OutBoneTransforms) override;
+	virtual bool IsValidToEvaluate(const USkeleton* Skeleton, const FBoneContainer& RequiredBones) override;
+	// End of FAnimNode_SkeletalControlBase interface
+
+private:
+
+	// FAnimNode_SkeletalControlBase interface
+	virtual void InitializeBoneReferences(const FBoneContainer& RequiredBones) override;
+	// End of FAnimNode_SkeletalControlBase interface
+
+	// Whether ChainBones has a bone for every joint of RigAsset. Must hold RigAsset's definition lock.
+	bool DoChainBonesMatchRig() const;
+
+	// Pose and scratch space for RigAsset, rebuilt when the asset or its definition changes
+	const UFabrikRigAsset* InitializedRigAsset;
+	int32 InitializedRigGeneration;
+	FFabrikRigInstance Instance;
+	FFabrikRigSolveContext SolveContext;
+	TArray<FVector> SolveTargets;
+
+	// Per joint of Instance, the compact pose bone it reads from and writes to
+	TArray<FCompactPoseBoneIndex> JointBoneIndices;
+
+	// Per compact pose bone, whether a joint has written it this evaluation
+	TBitArray<> WrittenBones;
+};
@@ -5,6 +5,7 @@
 #include "UObject/NoExportTypes.h"
 #include "EJointType.h"
 #include "EBoneConstraintType.h"
+#include "FabrikChainData.h"
 #include "FabrikChain.generated.h"
 
 
@@ -88,6 +89,102 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
 	bool UseEmbeddedTarget;
 
+	// Solve on the contiguous FFabrikChainData copy of this chain rather than walking the bone objects
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+	bool UseChainData;
+
+	// Keep the best iteration of SolveForTarget as a joint location snapshot and copy it back into the existing bones,
+	// rather than cloning the whole chain every time the solve distance improves
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+	bool TrackBestSolutionInPlace;
+
+	// Solve through the unrolled TFabrikChainSolver pass when this chain's joint layout has one registered
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+	bool UseSpecializedSolvers;
+
+	// Start each solve from the last pose swung towards the new target, and skip or cut short the iterations when the
+	// target has barely moved
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+	bool UseTemporalCoherence;
+
+	// With temporal coherence, target moves up to this distance try a single iteration first, and only carry on to the
+	// usual iteration limit when that pass misses the solve distance threshold
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+	float TemporalSingleIterationDistance;
+
+	// Answer out of reach targets and two bone chains in one step when the closed form pose honours the constraints
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+	bool UseClosedFormSolvers;
+
+	// Share of a structure's solve budget this chain gets, relative to the other chains in the structure
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+	float SolvePriority;
+
+	// Iteration cap and solve distance threshold multiplier of the structure's current LOD level. A cap of zero or less
+	// leaves MaxIterationAttempts alone.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = LOD)
+	int LODMaxIterationAttempts;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = LOD)
+	float LODSolveDistanceThresholdScale;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	int LastSolveIterations;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	int TotalSolveIterations;
+
+	// Solves that temporal coherence answered without iterating
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	int NumTemporalEarlyOuts;
+
+	// Solves that temporal coherence finished in its single pass, without going on to the usual iteration limit
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	int NumTemporalSinglePassSolves;
+
+	// Solves answered by FFabrikChainData::SolveClosedForm instead of iterating
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	int NumClosedFormSolves;
+
+	// Whether the last solve stopped iterating at its deadline rather than converging or grinding to a halt
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	bool LastSolveCutShort;
+
+	// Solves that stopped iterating at their deadline
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	int NumSolvesCutShort;
+
+	// Whether the last solve moved any bones. Chains connected to this one only need solving again when it did.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	bool LastSolveChangedPose;
+
+	// Whether UFabrikStructure skipped this chain on its last solve because nothing it depends on had changed
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	bool LastSolveSkipped;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+	int NumSolvesSkipped;
+
+	// Set when the bones or constraints change outside of a solve, so the next solve cannot be skipped
+	bool PoseDirty;
+
+	// Per joint sum and count of where the chains connected to this one would like that joint to be, gathered by a
+	// multi-effector UFabrikStructure solve and honoured by the forward pass when solving on chain data
+	TArray<FVector> SubBasePulls;
+	TArray<int> NumSubBasePulls;
+	bool HasSubBasePulls;
+
+	// The pulls the last solve that ran was a compromise with, so an unchanged multi-effector solve can still be skipped
+	TArray<FVector> LastSolveSubBasePulls;
+	TArray<int> LastSolveNumSubBasePulls;
+	bool LastSolveHadSubBasePulls;
+
+	// Solver-facing copy of this chain, filled in from the bones before a solve and read back afterwards
+	FFabrikChainData ChainData;
+
+	// Joint locations of the best iteration so far, sized once per bone count and reused between solves
+	TArray<FVector> BestSolutionJoints;
+
 	FVector GetBaseLocation();
 
 	FVector CreateMaxVector()
@@ -149,10 +246,42 @@ public:
 	void ConnectToStructure(UFabrikStructure* InStructure, int InChainNumber, int InBoneNumber);
 	void SetColour(FColor InColour);
 	float SolveForEmbeddedTarget();
+	float SolveForEmbeddedTarget(double InDeadlineSeconds);
 	float SolveForTarget(FVector InNewTarget);
 
+	/**
+	 * Solve for InNewTarget, but stop iterating once FPlatformTime::Seconds() passes InDeadlineSeconds and keep the best
+	 * pose found so far. At least one iteration always runs, so the chain still follows its target. A deadline of zero
+	 * or less means no deadline.
+	 */
+	float SolveForTarget(FVector InNewTarget, double InDeadlineSeconds);
+
 	// public String toString()
 	float SolveIK(FVector InTarget);
+	float SolveIKBones(FVector InTarget);
+	void FillChainData(FFabrikChainData& OutData);
+	void ApplyChainData(const FFabrikChainData& InData);
+	void WarmStart(FVector InNewTarget, bool bInOnChainData);
+	void ResetTelemetry();
+
+	// Force the next solve to run even if the target and base have not moved. Call after editing bones directly.
+	void MarkDirty() { PoseDirty = true; }
+
+	void ClearSubBasePulls();
+
+	// Whether the pulls gathered for this solve are the ones the last solve ran with, or there are none either time
+	bool SubBasePullsMatchLastSolve() const;
+
+	// Ask the next solve to pull joint InJointNumber (bone start locations, then the end effector) towards InLocation
+	void AddSubBasePull(int InJointNumber, FVector InLocation);
+
+	/**
+	 * Run a single forward pass towards InTarget on a copy of the current pose, without touching the bones, and return
+	 * where that leaves the base. This is where the chain would like its base to be if the base were free.
+	 */
+	FVector ReachForward(FVector InTarget);
+	void StoreBestSolution(bool bInFromChainData);
+	void RestoreBestSolution();
 	void UpdateChainLength();
 	//void UpdateEmbeddedTarget(FVector InNewEmbeddedTarget);
 	TArray<UFabrikBone*> CloneIkChain();
@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FabrikChainData.h"
+
+struct FFabrikAngleLimit;
+
+/**
+ * Lockstep FABRIK solver for many instances of one chain layout.
+ *
+ * Every instance shares the rig of a single FFabrikChainData (bone count, lengths, joint types and constraints) and
+ * only has its own base location, target and pose. Instances are packed four to a group as a structure of arrays, so
+ * the forward and backward passes run on VectorRegister (SSE or NEON) one group at a time. Each lane keeps its own best
+ * solution and is retired by a convergence mask using the same rules as UFabrikChain::SolveForTarget; a group stops
+ * iterating once all four of its lanes are retired.
+ *
+ * Local hinges and local basebone constraints depend on the previous bone's frame or on a host structure, so rigs that
+ * use them are solved one instance at a time through FFabrikChainData instead.
+ */
+struct OPENMOTION_API FFabrikChainBatch
+{
+	static const int32 LaneCount = 4;
+
+	float SolveDistanceThreshold;
+	int32 MaxIterationAttempts;
+	float MinIterationChange;
+
+	// Forward and backward passes run by the last call to SolveForTargets, summed over every group or instance
+	int32 LastNumPasses;
+
+	FFabrikChainBatch();
+
+	/**
+	 * Take the shared rig from InRig and start every instance in InRig's pose.
+	 *
+	 * @param	bInAllowLockstep	Pass false to always solve one instance at a time, for comparison.
+	 */
+	void Init(const FFabrikChainData& InRig, int32 InNumInstances, bool bInAllowLockstep = true);
+
+	/** Whether the rig only uses constraints the vector passes understand. */
+	static bool CanSolveLockstep(const FFabrikChainData& InRig);
+
+	bool IsLockstep() const { return bLockstep; }
+	int32 NumInstances() const { return NumInstancesL; }
+	int32 NumBones() const { return Rig.NumBones(); }
+
+	void SetBaseLocation(int32 InInstance, const FVector& InBaseLocation);
+	void SetTarget(int32 InInstance, const FVector& InTarget);
+
+	/** Overwrite the pose of one instance. InJoints holds NumBones() + 1 joint locations. */
+	void SetPose(int32 InInstance, const TArray<FVector>& InJoints);
+
+	FVector GetJointLocation(int32 InInstance, int32 InJoint) const;
+	FVector GetEffectorLocation(int32 InInstance) const { return GetJointLocation(InInstance, NumBones()); }
+	float GetSolveDistance(int32 InInstance) const { return SolveDistances[InInstance]; }
+
+	/**
+	 * Solve every instance whose target or base location moved since it was last solved.
+	 *
+	 * @return	The number of instances that were solved.
+	 */
+	int32 SolveForTargets();
+
+	/** The lane-wise rotor clamp the vector passes use, run on a single direction, for checking against the scalar one. */
+	static FVector LimitToRotor(const FVector& InV, const FVector& InBaseline, const FFabrikAngleLimit& InLimit);
+
+	// One component per register, one instance per lane
+	struct FVectorRegister3
+	{
+		VectorRegister X;
+		VectorRegister Y;
+		VectorRegister Z;
+	};
+
+private:
+
+	typedef TArray<float, TAlignedHeapAllocator<16>> FLaneArray;
+
+	// Per bone rig constants, splatted across the lanes once in Init
+	struct FBoneLanes
+	{
+		VectorRegister Length;
+		VectorRegister CosRotor;
+		VectorRegister SinRotor;
+		FVectorRegister3 RotationAxis;
+		FVectorRegister3 ReferenceAxis;
+		VectorRegister CosAnticlockwise;
+		VectorRegister SinAnticlockwise;
+		VectorRegister CosClockwise;
+		VectorRegister SinClockwise;
+		EJointType JointType;
+		bool bHingeLimited;
+	};
+
+	FFabrikChainData Rig;
+	bool bLockstep;
+	int32 NumInstancesL;
+	int32 NumGroups;
+	int32 GroupStride;
+
+	TArray<FBoneLanes, TAlignedHeapAllocator<16>> BoneLanes;
+	FVectorRegister3 BaseboneConstraintLanes;
+	bool bBaseboneHingeLimited;
+
+	// [Group][Joint][Axis][Lane]
+	FLaneArray Joints;
+
+	// [Group][Axis][Lane]
+	FLaneArray Targets;
+	FLaneArray BaseLocations;
+
+	// One group's worth of scratch, reused by every group
+	FLaneArray Directions;
+	FLaneArray BestJoints;
+
+	// Best pose of the instance being solved when not in lockstep
+	TArray<FVector> BestSolutionJoints;
+
+	TArray<float> SolveDistances;
+	TArray<FVector> LastTargets;
+	TArray<FVector> LastBaseLocations;
+
+	float* GetLane(FLaneArray& InArray, int32 InGroupStride, int32 InInstance, int32 InIndex, int32 InAxis);
+	const float* GetLane(const FLaneArray& InArray, int32 InGroupStride, int32 InInstance, int32 InIndex, int32 InAxis) const;
+
+	bool NeedsSolve(int32 InInstance) const;
+	VectorRegister SolveGroupIK(int32 InGroup);
+	int32 SolveGroup(int32 InGroup);
+	int32 SolveInstance(int32 InInstance);
+};
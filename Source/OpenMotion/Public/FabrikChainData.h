@@ -0,0 +1,302 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EJointType.h"
+#include "EBoneConstraintType.h"
+#include "FabrikJoint.h"
+#include "FabrikUtil.h"
+#include "FabrikMat3f.h"
+
+struct FFabrikChainData;
+
+/** A single forward and backward pass over a chain, returning the distance left to the target. */
+typedef float (*FFabrikSolveIKFunction)(FFabrikChainData& InOutData, const FVector& InTarget);
+
+/**
+ * Solver-facing, plain-data copy of a UFabrikChain.
+ *
+ * Everything the FABRIK passes touch lives in contiguous arrays so a solve does not have to chase UFabrikBone and
+ * UFabrikJoint pointers. Joint locations are stored once per joint: the start of bone N is Joints[N] and its end is
+ * Joints[N + 1]. UFabrikChain fills this in before solving and reads the joint locations back afterwards.
+ */
+struct OPENMOTION_API FFabrikChainData
+{
+	// ---------- Pose ----------
+
+	// NumBones + 1 joint locations, from the base of the basebone to the end effector
+	TArray<FVector> Joints;
+
+	// Inner-to-outer unit vector of each bone, kept in step with Joints so the passes do not have to renormalise
+	TArray<FVector> Directions;
+
+	// ---------- Rig ----------
+
+	TArray<float> Lengths;
+	TArray<EJointType> JointTypes;
+	TArray<float> RotorConstraintDegs;
+	TArray<float> HingeClockwiseConstraintDegs;
+	TArray<float> HingeAnticlockwiseConstraintDegs;
+
+	// The constraint angles above as cosines and sines, which is all the passes use
+	TArray<FFabrikAngleLimit> RotorLimits;
+	TArray<FFabrikAngleLimit> HingeClockwiseLimits;
+	TArray<FFabrikAngleLimit> HingeAnticlockwiseLimits;
+
+	TArray<FVector> RotationAxes;
+	TArray<FVector> ReferenceAxes;
+
+	// ---------- Basebone ----------
+
+	EBoneConstraintType BaseboneConstraintType;
+	FVector BaseboneConstraintUV;
+	FVector BaseboneRelativeConstraintUV;
+	FVector BaseboneRelativeReferenceConstraintUV;
+	FVector FixedBaseLocation;
+	bool FixedBaseMode;
+
+	// ---------- Sub-bases ----------
+
+	// Per joint sum and count of the locations chains connected there would like it to be at, for multi-effector
+	// solving. The forward pass moves each such joint to the centroid of its own location and these.
+	TArray<FVector> SubBasePulls;
+	TArray<int32> NumSubBasePulls;
+	bool HasSubBasePulls;
+
+	// Pass specialised for this chain's joint layout, see FFabrikChainSolverRegistry. Null runs the generic pass.
+	FFabrikSolveIKFunction SpecializedSolveIK;
+
+	FFabrikChainData();
+
+	int32 NumBones() const { return Lengths.Num(); }
+
+	/** Resize every per-bone array. Does not reallocate when the bone count is unchanged. */
+	void SetNumBones(int32 InNumBones);
+
+	/** Recalculate the cached bone directions from the joint locations. */
+	void UpdateDirections();
+
+	/** Bytes held by the arrays of this chain, not counting the struct itself. */
+	SIZE_T GetAllocatedSize() const;
+
+	FVector GetBaseLocation() const { return Joints[0]; }
+	FVector GetEffectorLocation() const { return Joints.Last(); }
+
+	/**
+	 * Run a single forward and backward FABRIK pass towards the target.
+	 *
+	 * @return	The distance between the end effector and the target after the pass.
+	 */
+	float SolveIK(const FVector& InTarget)
+	{
+		return (SpecializedSolveIK && !HasSubBasePulls) ? SpecializedSolveIK(*this, InTarget) : SolveIKGeneric(InTarget);
+	}
+
+	/** As SolveIK, but always switching on each bone's joint type and the basebone constraint type. */
+	float SolveIKGeneric(const FVector& InTarget);
+
+	/** The forward half of SolveIKGeneric, from the end effector to the base, honouring any sub-base pulls. */
+	void SolveForwardPass(const FVector& InTarget);
+
+	/** The backward half of SolveIKGeneric, from the base to the end effector. */
+	void SolveBackwardPass();
+
+	/**
+	 * Solve the chain in one step when there is a closed form answer: a straight line towards a target out of reach,
+	 * or the law of cosines for a two bone chain. The pose is only written when it honours every constraint.
+	 *
+	 * @return	True if the chain was solved, in which case OutSolveDistance holds the distance left to the target.
+	 */
+	bool SolveClosedForm(const FVector& InTarget, float& OutSolveDistance);
+
+	/** Whether the basebone may point along InDirection under the basebone constraint. */
+	bool IsBaseboneDirectionAllowed(const FVector& InDirection) const;
+
+	/** Whether bone InLoop may point along InDirection when the bone before it points along InPrevDirection. */
+	bool IsBoneDirectionAllowed(int32 InLoop, const FVector& InPrevDirection, const FVector& InDirection) const;
+
+	// The steps of a pass. These are templated on the constraint so that TFabrikChainSolver can build a pass with no
+	// constraint switches at all, while SolveIKGeneric switches once per bone to reach the same code.
+
+	/** Place the start of one bone on the forward pass. bInEffectorBone is true for the last bone of the chain. */
+	template <EJointType JointType>
+	FORCEINLINE void SolveForwardBone(int32 InLoop, bool bInEffectorBone, const FVector& InTarget);
+
+	/** Place the end of one bone on the backward pass. Not used for the basebone. */
+	template <EJointType JointType>
+	FORCEINLINE void SolveBackwardBone(int32 InLoop);
+
+	/** Place the basebone on the backward pass. */
+	template <EBoneConstraintType ConstraintType>
+	FORCEINLINE void SolveBasebone();
+};
+
+template <EJointType JointType>
+FORCEINLINE void FFabrikChainData::SolveForwardBone(int32 InLoop, bool bInEffectorBone, const FVector& InTarget)
+{
+	// Snap the end effector's end location to the target, otherwise the outer bone was placed on the previous step
+	if (bInEffectorBone)
+	{
+		Joints[InLoop + 1] = InTarget;
+	}
+	const FVector OuterJoint = Joints[InLoop + 1];
+
+	// Get the outer-to-inner unit vector of this bone
+	FVector ThisBoneOuterToInnerUV = (Joints[InLoop] - OuterJoint).GetSafeNormal();
+
+	if (JointType == EJointType::JT_Ball)
+	{
+		// Ball joints do not get constrained on the end effector, otherwise constrain to the relative angle between
+		// this bone and the outer bone
+		if (!bInEffectorBone)
+		{
+			const FVector OuterBoneOuterToInnerUV = -Directions[InLoop + 1];
+			ThisBoneOuterToInnerUV = UFabrikUtil::GetAngleLimitedUnitVector(ThisBoneOuterToInnerUV, OuterBoneOuterToInnerUV, RotorLimits[InLoop]);
+		}
+	}
+	else if (JointType == EJointType::JT_GlobalHinge)
+	{
+		// Project this bone outer-to-inner direction onto the hinge rotation axis
+		// NOTE: Constraining about the hinge reference axis on this forward pass leads to poor solutions... so we won't.
+		ThisBoneOuterToInnerUV = UFabrikUtil::ProjectOntoPlane(ThisBoneOuterToInnerUV, RotationAxes[InLoop]);
+	}
+	else if (JointType == EJointType::JT_LocalHinge)
+	{
+		FVector RelativeHingeRotationAxis;
+		if (InLoop > 0)
+		{
+			// Not a basebone? Then construct a rotation matrix based on the previous bones inner-to-to-inner direction...
+			FFabrikMat3f M = FFabrikMat3f::CreateRotationMatrix((Joints[InLoop] - Joints[InLoop - 1]).GetSafeNormal());
+
+			// ...and transform the hinge rotation axis into the previous bones frame of reference.
+			RelativeHingeRotationAxis = M.Times(RotationAxes[InLoop]);
+			RelativeHingeRotationAxis.Normalize();
+		}
+		else // ...basebone? Need to construct matrix from the relative constraint UV.
+		{
+			RelativeHingeRotationAxis = BaseboneRelativeConstraintUV;
+		}
+
+		// Project this bone's outer-to-inner direction onto the plane described by the relative hinge rotation axis
+		ThisBoneOuterToInnerUV = UFabrikUtil::ProjectOntoPlane(ThisBoneOuterToInnerUV, RelativeHingeRotationAxis);
+	}
+
+	// The new inner joint location is the end joint location of this bone plus the constrained
+	// outer-to-inner direction unit vector multiplied by the length of the bone.
+	Joints[InLoop] = OuterJoint + (ThisBoneOuterToInnerUV * Lengths[InLoop]);
+	Directions[InLoop] = -ThisBoneOuterToInnerUV;
+}
+
+template <EJointType JointType>
+FORCEINLINE void FFabrikChainData::SolveBackwardBone(int32 InLoop)
+{
+	// Get the inner-to-outer direction of this bone as well as the previous bone to use as a baseline
+	FVector ThisBoneInnerToOuterUV = (Joints[InLoop + 1] - Joints[InLoop]).GetSafeNormal();
+	const FVector PrevBoneInnerToOuterUV = Directions[InLoop - 1];
+
+	if (JointType == EJointType::JT_Ball)
+	{
+		// Keep this bone direction constrained within the rotor about the previous bone direction
+		ThisBoneInnerToOuterUV = UFabrikUtil::GetAngleLimitedUnitVector(ThisBoneInnerToOuterUV, PrevBoneInnerToOuterUV, RotorLimits[InLoop]);
+	}
+	else if (JointType == EJointType::JT_GlobalHinge)
+	{
+		// Get the hinge rotation axis and project our inner-to-outer UV onto it
+		const FVector HingeRotationAxis = RotationAxes[InLoop];
+		ThisBoneInnerToOuterUV = UFabrikUtil::ProjectOntoPlane(ThisBoneInnerToOuterUV, HingeRotationAxis);
+
+		// If there are joint constraints, then we must honour them...
+		const float CwConstraintDegs = -HingeClockwiseConstraintDegs[InLoop];
+		const float AcwConstraintDegs = HingeAnticlockwiseConstraintDegs[InLoop];
+		if (!(UFabrikUtil::ApproximatelyEquals(CwConstraintDegs, -UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f)) &&
+			!(UFabrikUtil::ApproximatelyEquals(AcwConstraintDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f)))
+		{
+			// Make our bone inner-to-outer UV the hinge reference axis rotated by its maximum clockwise or anticlockwise rotation as required
+			ThisBoneInnerToOuterUV = UFabrikUtil::GetHingeLimitedUnitVector(ThisBoneInnerToOuterUV, ReferenceAxes[InLoop], HingeRotationAxis,
+				HingeClockwiseLimits[InLoop], HingeAnticlockwiseLimits[InLoop]);
+		}
+	}
+	else if (JointType == EJointType::JT_LocalHinge)
+	{
+		// Construct a rotation matrix based on the previous bone's direction
+		FFabrikMat3f M = FFabrikMat3f::CreateRotationMatrix(PrevBoneInnerToOuterUV);
+
+		// Transform the hinge rotation axis into the previous bone's frame of reference
+		FVector RelativeHingeRotationAxis = M.Times(RotationAxes[InLoop]);
+		RelativeHingeRotationAxis.Normalize();
+
+		// Project this bone direction onto the plane described by the hinge rotation axis
+		ThisBoneInnerToOuterUV = UFabrikUtil::ProjectOntoPlane(ThisBoneInnerToOuterUV, RelativeHingeRotationAxis);
+
+		// Constrain rotation about reference axis if required
+		const float CwConstraintDegs = -HingeClockwiseConstraintDegs[InLoop];
+		const float AcwConstraintDegs = HingeAnticlockwiseConstraintDegs[InLoop];
+		if (!(UFabrikUtil::ApproximatelyEquals(CwConstraintDegs, -UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f)) &&
+			!(UFabrikUtil::ApproximatelyEquals(AcwConstraintDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.001f)))
+		{
+			// Calc. the reference axis in local space
+			FVector RelativeHingeReferenceAxis = M.Times(ReferenceAxes[InLoop]);
+			RelativeHingeReferenceAxis.Normalize();
+
+			ThisBoneInnerToOuterUV = UFabrikUtil::GetHingeLimitedUnitVector(ThisBoneInnerToOuterUV, RelativeHingeReferenceAxis, RelativeHingeRotationAxis,
+				HingeClockwiseLimits[InLoop], HingeAnticlockwiseLimits[InLoop]);
+		}
+	}
+
+	// The new end joint location is the start joint location of this bone plus the constrained
+	// inner-to-outer direction unit vector multiplied by the length of the bone.
+	Joints[InLoop + 1] = Joints[InLoop] + (ThisBoneInnerToOuterUV * Lengths[InLoop]);
+	Directions[InLoop] = ThisBoneInnerToOuterUV;
+}
+
+template <EBoneConstraintType ConstraintType>
+FORCEINLINE void FFabrikChainData::SolveBasebone()
+{
+	const float ThisBoneLength = Lengths[0];
+
+	// If the base location is fixed then snap the start location of the basebone back to the fixed base...
+	if (FixedBaseMode)
+	{
+		Joints[0] = FixedBaseLocation;
+	}
+	else // ...otherwise project it backwards from the end to the start by its length.
+	{
+		Joints[0] = Joints[1] - (Directions[0] * ThisBoneLength);
+	}
+
+	FVector ThisBoneInnerToOuterUV = (Joints[1] - Joints[0]).GetSafeNormal();
+
+	if (ConstraintType == EBoneConstraintType::BCT_GlobalRotor || ConstraintType == EBoneConstraintType::BCT_LocalRotor)
+	{
+		// Note: The relative constraint UV of a local rotor is updated by UFabrikStructure::SolveForTarget() before we are called.
+		const FVector ConstraintUV = (ConstraintType == EBoneConstraintType::BCT_GlobalRotor) ? BaseboneConstraintUV : BaseboneRelativeConstraintUV;
+		ThisBoneInnerToOuterUV = UFabrikUtil::GetAngleLimitedUnitVector(ThisBoneInnerToOuterUV, ConstraintUV, RotorLimits[0]);
+	}
+	else if (ConstraintType == EBoneConstraintType::BCT_GlobalHinge || ConstraintType == EBoneConstraintType::BCT_LocalHinge)
+	{
+		// A local hinge uses the basebone relative constraint as its hinge rotation and reference axes
+		const bool bGlobal = (ConstraintType == EBoneConstraintType::BCT_GlobalHinge);
+		const FVector HingeRotationAxis = bGlobal ? RotationAxes[0] : BaseboneRelativeConstraintUV;
+		const float CwConstraintDegs = -HingeClockwiseConstraintDegs[0];     // Clockwise rotation is negative!
+		const float AcwConstraintDegs = HingeAnticlockwiseConstraintDegs[0];
+
+		// Get the inner-to-outer direction of this bone and project it onto the hinge rotation axis
+		ThisBoneInnerToOuterUV = UFabrikUtil::ProjectOntoPlane(ThisBoneInnerToOuterUV, HingeRotationAxis);
+
+		// If we have a hinge which is not freely rotating then we must constrain about the reference axis
+		if (!(UFabrikUtil::ApproximatelyEquals(CwConstraintDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.01f) &&
+			UFabrikUtil::ApproximatelyEquals(AcwConstraintDegs, UFabrikJoint::MAX_CONSTRAINT_ANGLE_DEGS, 0.01f)))
+		{
+			const FVector HingeReferenceAxis = bGlobal ? ReferenceAxes[0] : BaseboneRelativeReferenceConstraintUV;
+
+			// Constrain as necessary
+			ThisBoneInnerToOuterUV = UFabrikUtil::GetHingeLimitedUnitVector(ThisBoneInnerToOuterUV, HingeReferenceAxis, HingeRotationAxis,
+				HingeClockwiseLimits[0], HingeAnticlockwiseLimits[0]);
+		}
+	}
+
+	// Set the new end location of the basebone, which is also the start location of the next bone
+	Joints[1] = Joints[0] + (ThisBoneInnerToOuterUV * ThisBoneLength);
+	Directions[0] = ThisBoneInnerToOuterUV;
+}
@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FabrikChainData.h"
+
+/** Forward pass over bone Index and every bone outside it, working in from the end effector. */
+template <int32 NumBones, int32 Index, EJointType... JointTypes>
+struct TFabrikForwardPass
+{
+	static FORCEINLINE void Run(FFabrikChainData& InOutData, const FVector& InTarget) {}
+};
+
+template <int32 NumBones, int32 Index, EJointType ThisJointType, EJointType... OuterJointTypes>
+struct TFabrikForwardPass<NumBones, Index, ThisJointType, OuterJointTypes...>
+{
+	static FORCEINLINE void Run(FFabrikChainData& InOutData, const FVector& InTarget)
+	{
+		// The outer bones have to be placed before this one
+		TFabrikForwardPass<NumBones, Index + 1, OuterJointTypes...>::Run(InOutData, InTarget);
+		InOutData.SolveForwardBone<ThisJointType>(Index, Index == NumBones - 1, InTarget);
+	}
+};
+
+/** Backward pass over bone Index and every bone outside it, working out towards the end effector. */
+template <int32 Index, EJointType... JointTypes>
+struct TFabrikBackwardPass
+{
+	static FORCEINLINE void Run(FFabrikChainData& InOutData) {}
+};
+
+template <int32 Index, EJointType ThisJointType, EJointType... OuterJointTypes>
+struct TFabrikBackwardPass<Index, ThisJointType, OuterJointTypes...>
+{
+	static FORCEINLINE void Run(FFabrikChainData& InOutData)
+	{
+		InOutData.SolveBackwardBone<ThisJointType>(Index);
+		TFabrikBackwardPass<Index + 1, OuterJointTypes...>::Run(InOutData);
+	}
+};
+
+/**
+ * FABRIK pass for one fixed chain layout: a basebone constraint and the joint type of every bone, basebone first.
+ *
+ * Both passes are unrolled at compile time and every joint type and constraint test is a constant, so the pass has
+ * none of the per-bone switching FFabrikChainData::SolveIKGeneric does. The solve itself is the same code, so the
+ * result matches the generic pass exactly.
+ */
+template <EBoneConstraintType BaseboneConstraintType, EJointType BaseboneJointType, EJointType... OuterJointTypes>
+struct TFabrikChainSolver
+{
+	static const int32 NumBones = 1 + sizeof...(OuterJointTypes);
+
+	static float SolveIK(FFabrikChainData& InOutData, const FVector& InTarget)
+	{
+		checkSlow(InOutData.NumBones() == NumBones);
+
+		TFabrikForwardPass<NumBones, 0, BaseboneJointType, OuterJointTypes...>::Run(InOutData, InTarget);
+		InOutData.SolveBasebone<BaseboneConstraintType>();
+		TFabrikBackwardPass<1, OuterJointTypes...>::Run(InOutData);
+
+		return FVector::Dist(InOutData.Joints[NumBones], InTarget);
+	}
+
+	static uint64 GetLayoutKey();
+};
+
+/**
+ * Looks up the specialised pass for a chain layout.
+ *
+ * Common layouts are registered when the registry is first used. Anything else can be added with Register, which
+ * is not thread safe, so do it from module startup rather than while chains are being solved.
+ */
+class OPENMOTION_API FFabrikChainSolverRegistry
+{
+public:
+
+	// Layouts longer than this are never specialised
+	static const int32 MaxBones = 24;
+
+	static FFabrikChainSolverRegistry& Get();
+
+	/** Pack a layout into a key, or return 0 if it is too long to specialise. */
+	static uint64 GetLayoutKey(EBoneConstraintType InBaseboneConstraintType, const EJointType* InJointTypes, int32 InNumBones);
+
+	template <typename SolverType>
+	void Register()
+	{
+		Register(SolverType::GetLayoutKey(), &SolverType::SolveIK);
+	}
+
+	void Register(uint64 InLayoutKey, FFabrikSolveIKFunction InSolveIK);
+
+	/** @return	The specialised pass for this chain's layout, or null if there isn't one. */
+	FFabrikSolveIKFunction Find(const FFabrikChainData& InData) const;
+
+	int32 Num() const { return Solvers.Num(); }
+
+private:
+
+	FFabrikChainSolverRegistry();
+
+	TMap<uint64, FFabrikSolveIKFunction> Solvers;
+};
+
+template <EBoneConstraintType BaseboneConstraintType, EJointType BaseboneJointType, EJointType... OuterJointTypes>
+uint64 TFabrikChainSolver<BaseboneConstraintType, BaseboneJointType, OuterJointTypes...>::GetLayoutKey()
+{
+	const EJointType JointTypes[] = { BaseboneJointType, OuterJointTypes... };
+	return FFabrikChainSolverRegistry::GetLayoutKey(BaseboneConstraintType, JointTypes, NumBones);
+}
+
+// Layouts registered by default
+typedef TFabrikChainSolver<EBoneConstraintType::BCT_None, EJointType::JT_Ball, EJointType::JT_Ball> FFabrikTwoBoneBallSolver;
+typedef TFabrikChainSolver<EBoneConstraintType::BCT_None, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball, EJointType::JT_Ball> FFabrikBallArmSolver;
+typedef TFabrikChainSolver<EBoneConstraintType::BCT_None, EJointType::JT_Ball, EJointType::JT_LocalHinge, EJointType::JT_LocalHinge> FFabrikLocalHingeFingerSolver;
@@ -2,12 +2,16 @@
 
 #pragma once
 #include "Components/ActorComponent.h"
+#include "FabrikDebugDrawComponent.h"
+#include "EJointType.h"
 #include "FabrikDebugComponent.generated.h"
 
 class UFabrikStructure;
 class UFabrikChain;
 class UFabrikMat3f;
 class UFabrikBone;
+class UFabrikJoint;
+class UFabrikDebugDrawComponent;
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class OPENMOTION_API UFabrikDebugComponent : public UActorComponent
@@ -30,6 +34,11 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Debug)
 		float LineThickness;
 
+	// Draw through one UFabrikDebugDrawComponent, rebuilding only the chains that changed, instead of a debug line per
+	// segment every tick. Read at BeginPlay.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Debug)
+		bool UseBatchedDrawing;
+
 
 
 	// Constraint colours
@@ -68,6 +77,7 @@ public:
 
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
 	// Called every frame
 	virtual void TickComponent( float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction ) override;
@@ -79,4 +89,76 @@ public:
 	void DrawLine(FVector Start, FVector End, FColor Color, float lineWidth);
 	void DrawCircle(FVector Start, FVector Axis, float Radius, FColor Color, float LineWidth);
 	void DrawChainConstraints(UFabrikChain* Chain, float LineWidth);
+
+private:
+
+	// What was last drawn for one chain, and everything about the chain and this component it was drawn from
+	struct FChainCache
+	{
+		TWeakObjectPtr<UFabrikChain> Chain;
+		TArray<float> Signature;
+		FFabrikDebugChainGeometryPtr Geometry;
+	};
+
+	enum EGlyphColour : uint8
+	{
+		GC_Shape,
+		GC_Reference,
+		GC_Anticlockwise,
+		GC_Clockwise
+	};
+
+	// Lines of one constraint shape at unit size, as amounts of an axis, a reference direction at right angles to it and
+	// their cross product, so drawing it on a bone takes no trig at all
+	struct FGlyph
+	{
+		struct FLine
+		{
+			FVector Start;
+			FVector End;
+			EGlyphColour Colour;
+		};
+
+		TArray<FLine> Lines;
+
+		void AddLine(FVector InStart, FVector InEnd, EGlyphColour InColour) { Lines.Add({ InStart, InEnd, InColour }); }
+	};
+
+	// A joint's rotor cone or hinge limits, and the constraint they were built for
+	struct FJointGlyph
+	{
+		EJointType JointType;
+		float RotorConstraintDegs;
+		float HingeClockwiseConstraintDegs;
+		float HingeAnticlockwiseConstraintDegs;
+		int NumConeLines;
+		float RotStep;
+		FGlyph Glyph;
+	};
+
+	UPROPERTY(Transient)
+		UFabrikDebugDrawComponent* DrawComponent;
+
+	// Weak so a joint that goes away can never be mistaken for a new one at the same address. Pruned once it holds
+	// more entries than the structure has joints.
+	TMap<TWeakObjectPtr<const UFabrikJoint>, FJointGlyph> JointGlyphs;
+	FGlyph UnitCircle;
+	int UnitCircleLines;
+
+	TArray<FChainCache> ChainCaches;
+	TArray<float> ScratchSignature;
+
+	// Where DrawLine and DrawPoint put their geometry while a chain is being rebuilt, or null to draw debug lines
+	FFabrikDebugChainGeometry* CurrentGeometry;
+
+	// The cached glyph for Joint, built again only when its constraint angles or NUM_CONE_LINES have changed
+	const FGlyph& GetJointGlyph(const UFabrikJoint* Joint);
+	void PruneJointGlyphs();
+	const FGlyph& GetUnitCircle();
+	void DrawGlyph(const FGlyph& Glyph, FVector Origin, FVector Axis, FVector Reference, float Scale, FColor ShapeColour, float LineWidth);
+
+	void DrawBatched();
+	void MakeChainSignature(UFabrikChain* Chain, TArray<float>& OutSignature) const;
+	void DrawPoint(FVector Location, FColor Color);
+	void DrawThickLine(FVector Start, FVector End, FColor Color, float Thickness);
 };
@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "FabrikDebugDrawComponent.generated.h"
+
+struct FFabrikDebugLine
+{
+	FVector Start;
+	FVector End;
+	FColor Color;
+	float Thickness;
+};
+
+struct FFabrikDebugPoint
+{
+	FVector Location;
+	FColor Color;
+	float Size;
+};
+
+/**
+ * The lines and points drawn for one chain, in world space. Built on the game thread and never changed after it is handed
+ * to UFabrikDebugDrawComponent, so the render thread can keep reading it while a newer one is being built.
+ */
+struct OPENMOTION_API FFabrikDebugChainGeometry
+{
+	TArray<FFabrikDebugLine> Lines;
+	TArray<FFabrikDebugPoint> Points;
+	FBox Bounds;
+
+	FFabrikDebugChainGeometry() : Bounds(ForceInit) {}
+
+	void AddLine(const FVector& InStart, const FVector& InEnd, const FColor& InColor, float InThickness);
+	void AddPoint(const FVector& InLocation, const FColor& InColor, float InSize);
+};
+
+typedef TSharedPtr<const FFabrikDebugChainGeometry, ESPMode::ThreadSafe> FFabrikDebugChainGeometryPtr;
+
+/**
+ * Draws the debug geometry of many chains through one scene proxy. Every line of a view goes into the same batch, so a
+ * frame costs one dynamic vertex buffer per view rather than a debug line draw per segment. Chains whose bounds are out
+ * of the view frustum are skipped.
+ */
+UCLASS(ClassGroup=(Custom))
+class OPENMOTION_API UFabrikDebugDrawComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	UFabrikDebugDrawComponent(const FObjectInitializer& ObjectInitializer);
+
+	// Draw InChains from now on. Nothing is sent to the render thread when they are the same chains as last time.
+	void SetChains(const TArray<FFabrikDebugChainGeometryPtr>& InChains);
+
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+protected:
+
+	virtual void SendRenderDynamicData_Concurrent() override;
+
+private:
+
+	TArray<FFabrikDebugChainGeometryPtr> Chains;
+	FBox ChainBounds;
+
+	friend class FFabrikDebugDrawSceneProxy;
+};
@@ -2,6 +2,7 @@
 
 #pragma once
 #include "GameFramework/Actor.h"
+#include "FabrikStructure.h"
 #include "FabrikDemoActor.generated.h"
 
 class UFabrikStructure;
@@ -37,8 +38,16 @@ public:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 	
+	// Called when the game ends or the actor is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// Called every frame
 	virtual void Tick( float DeltaSeconds ) override;
+
+	// Hand the structure to the world's UFabrikIKSubsystem to be solved with every other registered structure, instead
+	// of solving it from this actor's tick
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+		bool UseIKSubsystem;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
 		UFabrikDebugComponent* FabrikDebugComponent;
 	
@@ -82,8 +91,111 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Debug)
 		float LineThickness;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+		int BenchmarkNumSolves;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+		int BenchmarkNumInstances;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+		int BenchmarkNumFrames;
+
+	// Structure solve budget used by RunSolveBudgetBenchmark
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+		float BenchmarkSolveBudgetMicroseconds;
+
+	// LOD levels given to the crowd RunLODBenchmark builds
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+		TArray<FFabrikLODLevel> BenchmarkLODLevels;
+
+	// Fingers on the hand RunParallelSolveBenchmark builds
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+		int BenchmarkNumFingers;
+
 	void DrawChain(UFabrikChain* Chain);
 
+	// Replace Structure with a freshly built demo rig
+	void BuildDemo(EFabrikDemoType InDemoType);
+
+	// Time solving every demo rig through the bone objects and through FFabrikChainData, and log the results along with
+	// the number of UObjects each configuration creates per solve
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunSolverBenchmark();
+
+	// Time building and applying rotation matrices as UFabrikMat3f objects against FFabrikMat3f values, and log the results
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunMatrixBenchmark();
+
+	// Check the trig-free rotor and hinge clamps against GetAngleLimitedUnitVectorDegs and the signed angle hinge clamp
+	// over random directions and limits, and log the largest difference and the time each takes
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunConstraintKernelBenchmark();
+
+	// Time solving many copies of each demo's first chain through FFabrikChainBatch, in lockstep and one instance at a
+	// time, and log the results
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunBatchBenchmark();
+
+	// Time the unrolled TFabrikChainSolver passes for a ball jointed arm and a local hinge finger against the generic
+	// FFabrikChainData pass, and log the results
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunSpecializedSolverBenchmark();
+
+	// Follow a smooth target path with each connected chain demo, with and without temporal coherence, and log the
+	// iterations each chain saved
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunTemporalCoherenceBenchmark();
+
+	// Solve a free four bone chain towards targets out of reach and a two bone limb towards targets in reach, with and
+	// without the closed form solvers, and log the time and iterations each took
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunClosedFormBenchmark();
+
+	// Solve each demo with and without a BenchmarkSolveBudgetMicroseconds budget, giving the first chain twice the
+	// priority of the others, and log the solve times, solve distances and how often each chain was cut short
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunSolveBudgetBenchmark();
+
+	// Solve a hand of BenchmarkNumFingers fingers connected to one palm serially, then in parallel on one worker up to
+	// every worker, and log the time per solve and how far each parallel pose strays from the serial one
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunParallelSolveBenchmark();
+
+	UFabrikStructure* BuildBenchmarkHand();
+
+	// Drive every chain of each connected chain demo towards its own target by writing embedded targets, by
+	// SolveForTargets and by SolveForTargetBuffer, and log the time each takes and how far their poses differ
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunMultiTargetBenchmark();
+
+	// Solve each connected chain demo with a target that only moves every tenth solve, with and without dirty
+	// propagation, and log the time per solve, the chains and solves skipped and how far the poses differ
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunDirtyPropagationBenchmark();
+
+	// Solve each connected chain demo with every chain anchored to its host and as a multi-effector structure, and log
+	// the time per solve, the bone placements per solve and the summed effector distance each leaves
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunMultiEffectorBenchmark();
+
+	// Build a UFabrikRigAsset from each demo and log the bytes BenchmarkNumInstances instances take as structures and
+	// as rig instances, the time per solve each way and how far their poses differ
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunRigAssetBenchmark();
+
+	// Solve BenchmarkNumInstances copies of the current demo for BenchmarkNumFrames frames one structure at a time, as
+	// per actor ticking would, then through UFabrikIKSubsystem, and log the game thread time per frame each way
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunIKSubsystemBenchmark();
+
+	// Solve a crowd of BenchmarkNumInstances copies of the current demo for BenchmarkNumFrames frames with more and more
+	// of it on the far BenchmarkLODLevels, and log the time per frame, iterations and decimated solves for each mix
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunLODBenchmark();
+
+	FVector GetBenchmarkTarget(int InSolveNumber);
+	double TimeDemoSolves(EFabrikDemoType InDemoType, bool bInUseChainData, bool bInTrackBestSolutionInPlace, int& OutObjectsCreated);
+
 	FColor Brightness(FColor color, float correctionFactor);
 
 	void DemoUnconstrainedBones();
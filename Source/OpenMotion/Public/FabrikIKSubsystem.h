@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineBaseTypes.h"
+#include "FabrikIKSubsystem.generated.h"
+
+class UFabrikStructure;
+class UFabrikIKSubsystem;
+
+/**
+ * Runs UFabrikIKSubsystem::SolveFrame once per frame in TG_PostPhysics, after the targets have moved.
+ */
+USTRUCT()
+struct FFabrikIKSolveTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	UFabrikIKSubsystem* Target;
+
+	FFabrikIKSolveTickFunction() : Target(nullptr) {}
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FFabrikIKSolveTickFunction> : public TStructOpsTypeTraitsBase2<FFabrikIKSolveTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/**
+ * A structure solved by UFabrikIKSubsystem, and where its target comes from.
+ */
+USTRUCT()
+struct FFabrikIKRegistration
+{
+	GENERATED_BODY()
+
+	// Weak so a registration never keeps a structure alive after its owner has gone
+	UPROPERTY()
+		TWeakObjectPtr<UFabrikStructure> Structure;
+
+	// Followed when set, otherwise the structure solves for Target once one has been given
+	UPROPERTY()
+		TWeakObjectPtr<AActor> TargetActor;
+
+	FVector Target;
+	bool bHasTarget;
+
+	FFabrikIKRegistration() : Target(FVector::ZeroVector), bHasTarget(false) {}
+};
+
+/**
+ * Solves every registered UFabrikStructure in one job per frame instead of one actor tick each.
+ *
+ * Targets are gathered on the game thread and the structures whose chains create UObjects while solving are solved there,
+ * then the rest are shared out between the task graph workers and the game thread. The job runs in
+ * TG_PostPhysics and is finished before the tick returns, so anything that reads the poses later in the frame sees
+ * this frame's solve. Tick functions that read poses earlier can be ordered after it with AddPoseConsumer.
+ */
+UCLASS()
+class OPENMOTION_API UFabrikIKSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UFabrikIKSubsystem(const FObjectInitializer& ObjectInitializer);
+
+	virtual void Deinitialize() override;
+
+	// Share structures out between worker threads. Off solves every structure on the game thread, for comparison.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+		bool UseParallelSolve;
+
+	// Most structures solved at once. Zero or less uses every task graph worker and the game thread.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+		int MaxSolveThreads;
+
+	// Set the LOD level of each structure that has some from its distance to the first player's camera
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+		bool UseDistanceLOD;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+		int LastNumStructuresSolved;
+
+	// Structures the last frame solved on worker threads
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+		int LastNumParallelStructures;
+
+	// Game thread time the last frame's job took, gathering and waiting included
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+		float LastSolveMicroseconds;
+
+	/** Solve InStructure every frame, following InTargetActor if given. Registering twice just updates the target actor. */
+	UFUNCTION(BlueprintCallable, Category = OpenMotion)
+		void RegisterStructure(UFabrikStructure* InStructure, AActor* InTargetActor);
+
+	UFUNCTION(BlueprintCallable, Category = OpenMotion)
+		void UnregisterStructure(UFabrikStructure* InStructure);
+
+	/** Set the target of a structure that does not follow an actor. */
+	UFUNCTION(BlueprintCallable, Category = OpenMotion)
+		void SetTarget(UFabrikStructure* InStructure, FVector InTarget);
+
+	/** Gather the targets and solve every registered structure now. Called once per frame by the tick function. */
+	UFUNCTION(BlueprintCallable, Category = OpenMotion)
+		void SolveFrame();
+
+	/** Make InConsumerTickFunction wait for this frame's solve. */
+	void AddPoseConsumer(FTickFunction& InConsumerTickFunction);
+
+	int32 NumRegisteredStructures() const { return Registrations.Num(); }
+
+private:
+
+	UPROPERTY()
+		TArray<FFabrikIKRegistration> Registrations;
+
+	FFabrikIKSolveTickFunction SolveTickFunction;
+
+	// Per frame split of Registrations, kept to avoid reallocating every frame
+	TArray<int32> ParallelRegistrations;
+	TArray<int32> GameThreadRegistrations;
+
+	FFabrikIKRegistration* FindRegistration(UFabrikStructure* InStructure);
+	void SolveRegistration(FFabrikIKRegistration& InRegistration);
+	void RegisterSolveTickFunction();
+};
@@ -5,6 +5,7 @@
 #include "UObject/NoExportTypes.h"
 #include "EBoneConnectionPoint.h"
 #include "EJointType.h"
+#include "FabrikUtil.h"
 
 #include "FabrikJoint.generated.h"
 
@@ -44,8 +45,18 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
 		EBoneConnectionPoint BoneConnectionPoint;
 
+	// The constraint angles above as cosines and sines, kept up to date by the setters, loading and editing for the trig-free clamps
+	FFabrikAngleLimit RotorLimit;
+	FFabrikAngleLimit HingeClockwiseLimit;
+	FFabrikAngleLimit HingeAnticlockwiseLimit;
+
 	UFabrikJoint(const FObjectInitializer& ObjectInitializer);
 	
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
 	UFabrikJoint* Init(UFabrikJoint* Source);
 
 	UFabrikJoint* Clone(UFabrikJoint* Source);
@@ -54,6 +65,9 @@ public:
 	void SetHinge(EJointType InJointType, FVector InRotationAxis, float InClockwiseConstraintDegs, float InAnticlockwiseConstraintDegs, FVector InReferenceAxis);
 	void SetAsGlobalHinge(FVector InGlobalRotationAxis, float InCwConstraintDegs, float InAcwConstraintDegs, FVector InGlobalReferenceAxis);
 	void SetAsLocalHinge(FVector InLocalRotationAxis, float InCwConstraintDegs, float InAcwConstraintDegs, FVector InLocalReferenceAxis);
+
+	// Recalculate the cached limits. Only needed after writing the constraint angle properties directly.
+	void UpdateConstraintLimits();
 	
 	static void ValidateConstraintAngleDegs(float InAngleDegs);
 	static void ValidateAxis(FVector InAxis);
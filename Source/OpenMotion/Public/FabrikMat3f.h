@@ -5,6 +5,114 @@
 #include "UObject/NoExportTypes.h"
 #include "FabrikMat3f.generated.h"
 
+/**
+ * Stack allocated 3x3 matrix used by the solver.
+ *
+ * Same column layout and maths as UFabrikMat3f, but a plain value so it can be built and thrown away per bone without
+ * creating garbage collected objects.
+ */
+struct OPENMOTION_API FFabrikMat3f
+{
+	float m00, m01, m02; // First  column - typically the direction of the positive X-axis
+	float m10, m11, m12; // Second column - typically the direction of the positive Y-axis
+	float m20, m21, m22; // Third  column - typically the direction of the positive Z-axis
+
+	FORCEINLINE FFabrikMat3f() {}
+
+	FORCEINLINE FFabrikMat3f(const FVector& xAxis, const FVector& yAxis, const FVector& zAxis)
+		: m00(xAxis.X), m01(xAxis.Y), m02(xAxis.Z)
+		, m10(yAxis.X), m11(yAxis.Y), m12(yAxis.Z)
+		, m20(zAxis.X), m21(zAxis.Y), m22(zAxis.Z)
+	{
+	}
+
+	/** Build a matrix whose Z axis is the given reference direction. */
+	static FORCEINLINE FFabrikMat3f CreateRotationMatrix(FVector InReferenceDirection)
+	{
+		FVector xAxis;
+		FVector yAxis;
+		InReferenceDirection.Normalize();
+		const FVector& zAxis = InReferenceDirection;
+
+		// Handle the singularity (i.e. bone pointing along negative Z-Axis)...
+		if (InReferenceDirection.Z < -0.9999999f)
+		{
+			xAxis = FVector(1.0f, 0.0f, 0.0f); // ...in which case positive X runs directly to the right...
+			yAxis = FVector(0.0f, 1.0f, 0.0f); // ...and positive Y runs directly upwards.
+		}
+		else
+		{
+			float a = 1.0f / (1.0f + zAxis.Z);
+			float b = -zAxis.X * zAxis.Y * a;
+			xAxis = FVector(1.0f - zAxis.X * zAxis.X * a, b, -zAxis.X);
+			xAxis.Normalize();
+			yAxis = FVector(b, 1.0f - zAxis.Y * zAxis.Y * a, -zAxis.Y);
+		}
+
+		return FFabrikMat3f(xAxis, yAxis, zAxis);
+	}
+
+	/** Build a matrix that rotates by the given angle about a unit length axis. */
+	static FORCEINLINE FFabrikMat3f CreateAxisAngleMatrix(const FVector& InRotationAxis, float InAngleRads)
+	{
+		return CreateAxisAngleMatrix(InRotationAxis, FMath::Sin(InAngleRads), FMath::Cos(InAngleRads));
+	}
+
+	/** As above, for callers that already have the sine and cosine of the angle. */
+	static FORCEINLINE FFabrikMat3f CreateAxisAngleMatrix(const FVector& InRotationAxis, float InSinTheta, float InCosTheta)
+	{
+		FFabrikMat3f Res;
+		float oneMinusCosTheta = 1.0f - InCosTheta;
+
+		// It's quicker to pre-calc these and reuse than calculate x * y, then y * x later (same thing).
+		float xyOne = InRotationAxis.X * InRotationAxis.Y * oneMinusCosTheta;
+		float xzOne = InRotationAxis.X * InRotationAxis.Z * oneMinusCosTheta;
+		float yzOne = InRotationAxis.Y * InRotationAxis.Z * oneMinusCosTheta;
+
+		// Calculate rotated x-axis
+		Res.m00 = InRotationAxis.X * InRotationAxis.X * oneMinusCosTheta + InCosTheta;
+		Res.m01 = xyOne + InRotationAxis.Z * InSinTheta;
+		Res.m02 = xzOne - InRotationAxis.Y * InSinTheta;
+
+		// Calculate rotated y-axis
+		Res.m10 = xyOne - InRotationAxis.Z * InSinTheta;
+		Res.m11 = InRotationAxis.Y * InRotationAxis.Y * oneMinusCosTheta + InCosTheta;
+		Res.m12 = yzOne + InRotationAxis.X * InSinTheta;
+
+		// Calculate rotated z-axis
+		Res.m20 = xzOne + InRotationAxis.Y * InSinTheta;
+		Res.m21 = yzOne - InRotationAxis.X * InSinTheta;
+		Res.m22 = InRotationAxis.Z * InRotationAxis.Z * oneMinusCosTheta + InCosTheta;
+
+		return Res;
+	}
+
+	FORCEINLINE FVector Times(const FVector& source) const
+	{
+		return FVector(m00 * source.X + m10 * source.Y + m20 * source.Z,
+			m01 * source.X + m11 * source.Y + m21 * source.Z,
+			m02 * source.X + m12 * source.Y + m22 * source.Z);
+	}
+
+	/** Transform InNum vectors. InSource and OutResult may be the same array. */
+	FORCEINLINE void Times(const FVector* InSource, FVector* OutResult, int32 InNum) const
+	{
+		for (int32 Loop = 0; Loop < InNum; ++Loop)
+		{
+			OutResult[Loop] = Times(InSource[Loop]);
+		}
+	}
+
+	/** Transform every vector in the array in place. */
+	FORCEINLINE void Times(TArray<FVector>& InOutVectors) const
+	{
+		Times(InOutVectors.GetData(), InOutVectors.GetData(), InOutVectors.Num());
+	}
+};
+
+/**
+ * Garbage collected 3x3 matrix, kept for Blueprint and existing callers. The solver uses FFabrikMat3f.
+ */
 UCLASS()
 class OPENMOTION_API UFabrikMat3f : public UObject
 {
@@ -18,5 +126,6 @@ public:
 	
 	static UFabrikMat3f* CreateRotationMatrix(FVector InReferenceDirection);
 	void Init(FVector xAxis, FVector yAxis, FVector zAxis);
+	void Init(const FFabrikMat3f& InMatrix);
 	FVector Times(FVector source);
 };
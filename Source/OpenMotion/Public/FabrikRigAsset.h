@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "HAL/CriticalSection.h"
+#include "FabrikChainData.h"
+#include "FabrikRigAsset.generated.h"
+
+class UFabrikStructure;
+
+/**
+ * Pose and solver state of one instance of a UFabrikRigAsset. Bone lengths, constraints, names and connections all
+ * live in the asset and are shared by every instance, so this is all a crowd member has to carry.
+ */
+USTRUCT(BlueprintType)
+struct OPENMOTION_API FFabrikRigInstance
+{
+	GENERATED_BODY()
+
+	// Joint locations of every chain, one chain after another, NumBones + 1 per chain
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Pose)
+		TArray<FVector> Joints;
+
+	// Offset from where the rig was authored, applied to the base of every chain not connected to another chain
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Pose)
+		FVector Location;
+
+	// Take the base of every chain not connected to another chain from Joints, rather than from where the rig was
+	// authored plus Location. For poses that come from somewhere else each frame, such as an animation.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Pose)
+		bool UseJointBases;
+
+	// Per chain target and base location of the last solve, so chains that would not move can be skipped
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+		TArray<FVector> LastTargets;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+		TArray<FVector> LastBaseLocations;
+
+	// Per chain distance between the end effector and its target after the last solve
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+		TArray<float> SolveDistances;
+
+	FFabrikRigInstance() : Location(FVector::ZeroVector), UseJointBases(false) {}
+
+	/** Forget the last targets and bases, so the next solve runs every chain even if nothing seems to have moved. */
+	void ForceSolve();
+
+	/** Bytes held by this instance, the struct and its arrays. */
+	SIZE_T GetAllocatedSize() const;
+};
+
+/**
+ * One chain of a UFabrikRigAsset.
+ */
+struct OPENMOTION_API FFabrikRigChain
+{
+	// Lengths, joint types and constraints of the chain. Its pose arrays hold the authored pose new instances start in.
+	FFabrikChainData Data;
+
+	// Chain and bone this chain is connected to, or -1, and the joint of that chain its base sits on
+	int32 HostChain;
+	int32 HostBone;
+	int32 HostJoint;
+
+	// Index of this chain's base in FFabrikRigInstance::Joints
+	int32 JointStart;
+
+	float SolveDistanceThreshold;
+	int32 MaxIterationAttempts;
+	float MinIterationChange;
+	bool UseClosedFormSolvers;
+
+	FName Name;
+};
+
+/** Save or load a rig chain. Only the rig is written; the cached directions, limits and specialised pass are rebuilt on load. */
+OPENMOTION_API FArchive& operator<<(FArchive& Ar, FFabrikRigChain& InOutChain);
+
+/**
+ * Scratch space for solving instances of one UFabrikRigAsset. Each chain starts as a copy of the asset's definition and
+ * only its pose is overwritten per instance, so nothing is copied from the rig between solves. Solving on several
+ * threads needs one context per thread.
+ */
+struct OPENMOTION_API FFabrikRigSolveContext
+{
+	TArray<FFabrikChainData> Chains;
+	TArray<FVector> BestJoints;
+
+	SIZE_T GetAllocatedSize() const;
+};
+
+/**
+ * The immutable part of a UFabrikStructure - topology, bone lengths and constraints - shared by any number of
+ * FFabrikRigInstance poses. Build it once from a structure that has been set up as usual, then solve instances
+ * against it instead of giving every instance its own chain, bone and joint objects.
+ */
+UCLASS(BlueprintType)
+class OPENMOTION_API UFabrikRigAsset : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UFabrikRigAsset(const FObjectInitializer& ObjectInitializer);
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Setting)
+		FName Name;
+
+	// Joints over every chain, which is the length of FFabrikRigInstance::Joints
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Setting)
+		int NumJoints;
+
+	/**
+	 * Take the rig and the current pose of InStructure as the definition. Later changes to InStructure are not seen.
+	 * Waits for any reader holding GetDefinitionLock, and bumps GetGeneration so instances know to start again.
+	 */
+	UFUNCTION(BlueprintCallable, Category = OpenMotion)
+		void InitFromStructure(UFabrikStructure* InStructure);
+
+	/** Changes every time InitFromStructure replaces the definition. */
+	int32 GetGeneration() const { return Generation; }
+
+	/** Hold for reading while using the definition on a thread other than the one that may call InitFromStructure. */
+	FRWLock& GetDefinitionLock() const { return DefinitionLock; }
+
+	int32 NumChains() const { return RigChains.Num(); }
+	const FFabrikRigChain& GetChain(int32 InChainIndex) const { return RigChains[InChainIndex]; }
+
+	/** Start an instance in the authored pose, moved to InLocation. */
+	void InitInstance(FFabrikRigInstance& OutInstance, const FVector& InLocation) const;
+
+	/** Size the scratch space for solving this rig. Only needs doing once per context. */
+	void InitSolveContext(FFabrikRigSolveContext& OutContext) const;
+
+	/**
+	 * Solve every chain of an instance for one shared target, with the same rules as UFabrikChain::SolveForTarget.
+	 *
+	 * @return	The number of chains that were solved rather than skipped.
+	 */
+	int32 SolveInstance(FFabrikRigInstance& InOutInstance, const FVector& InTarget, FFabrikRigSolveContext& InOutContext) const;
+
+	/** As above, with chain N reaching for InChainTargets[N]. There must be one target per chain. */
+	int32 SolveInstance(FFabrikRigInstance& InOutInstance, const TArray<FVector>& InChainTargets, FFabrikRigSolveContext& InOutContext) const;
+
+	FVector GetJointLocation(const FFabrikRigInstance& InInstance, int32 InChainIndex, int32 InJoint) const
+	{
+		return InInstance.Joints[RigChains[InChainIndex].JointStart + InJoint];
+	}
+
+	/** Bytes held by the shared definition, which every instance of this rig uses. */
+	SIZE_T GetSharedAllocatedSize() const;
+
+	/** Bytes held by a structure and its chain, bone and joint objects, which is what one instance costs without a rig asset. */
+	static SIZE_T GetStructureAllocatedSize(UFabrikStructure* InStructure);
+
+private:
+
+	// Plain structs rather than properties, so Serialize writes them out
+	TArray<FFabrikRigChain> RigChains;
+
+	int32 Generation;
+	mutable FRWLock DefinitionLock;
+
+	int32 SolveInstanceChains(FFabrikRigInstance& InOutInstance, const FVector& InTarget, const TArray<FVector>* InChainTargets, FFabrikRigSolveContext& InOutContext) const;
+};
@@ -8,6 +8,59 @@
 
 class UFabrikChain;
 
+/**
+ * One chain's target for UFabrikStructure::SolveForTargets.
+ */
+USTRUCT(BlueprintType)
+struct OPENMOTION_API FFabrikChainTarget
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+		int ChainIndex;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+		FVector Target;
+
+	FFabrikChainTarget() : ChainIndex(0), Target(FVector::ZeroVector) {}
+	FFabrikChainTarget(int InChainIndex, const FVector& InTarget) : ChainIndex(InChainIndex), Target(InTarget) {}
+};
+
+/**
+ * How much effort a UFabrikStructure spends on its solves at one level of detail.
+ */
+USTRUCT(BlueprintType)
+struct OPENMOTION_API FFabrikLODLevel
+{
+	GENERATED_BODY()
+
+	// Viewer distance up to which this level applies. Levels are checked in order, so list them nearest first.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+		float MaxDistance;
+
+	// Cap on every chain's MaxIterationAttempts. Zero or less leaves the chains alone.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+		int MaxIterationAttempts;
+
+	// Multiplier on every chain's SolveDistanceThreshold
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+		float SolveDistanceThresholdScale;
+
+	// Only solve on one frame in this many
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+		int SolveEveryNthFrame;
+
+	// On the frames in between, blend from the second to last solved pose to the last one rather than holding still
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+		bool InterpolateSkippedFrames;
+
+	FFabrikLODLevel()
+		: MaxDistance(FLT_MAX), MaxIterationAttempts(0), SolveDistanceThresholdScale(1.0f), SolveEveryNthFrame(1), InterpolateSkippedFrames(true) {}
+	FFabrikLODLevel(float InMaxDistance, int InMaxIterationAttempts, float InSolveDistanceThresholdScale, int InSolveEveryNthFrame)
+		: MaxDistance(InMaxDistance), MaxIterationAttempts(InMaxIterationAttempts), SolveDistanceThresholdScale(InSolveDistanceThresholdScale),
+		SolveEveryNthFrame(InSolveEveryNthFrame), InterpolateSkippedFrames(true) {}
+};
+
 /**
  * 
  */
@@ -28,13 +81,188 @@ public:
 
 		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
 			int NumChains;
+
+		// Time each SolveForTarget may take, shared between the chains by their SolvePriority. Zero or less leaves every
+		// chain to its MaxIterationAttempts.
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+			float SolveBudgetMicroseconds;
+
+		// Solve chains that do not depend on each other at the same time. Only used when every chain solves on its
+		// FFabrikChainData and tracks its best solution in place, since those paths create no UObjects.
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+			bool UseParallelSolve;
+
+		// Most chains solved at once by a parallel solve. Zero or less uses every task graph worker and this thread.
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+			int MaxSolveThreads;
+
+		// Skip chains whose target has not moved, whose base is where it was and whose host chain did not move on this
+		// solve, so a structure whose effectors sit still costs next to nothing
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+			bool UseDirtyPropagation;
+
+		// Solve the chains as one multi-effector structure: each iteration gathers where every connected chain's forward
+		// pass would put its base, moves the joint it is connected to towards the centroid of those on its host's forward
+		// pass, then solves from the roots out. Needs every chain to solve on its FFabrikChainData, as CanSolveOffGameThread
+		// checks; otherwise the structure falls back to solving each chain once from its anchored base.
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+			bool UseMultiEffectorSolve;
+
+		// Most gather and solve iterations a multi-effector solve runs
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+			int MultiEffectorIterations;
+
+		// A multi-effector solve stops once an iteration improves the summed effector distance by less than this
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Setting)
+			float MultiEffectorMinChange;
+
+		// Levels of detail, nearest first. Empty solves every frame at full effort.
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+			TArray<FFabrikLODLevel> LODLevels;
+
+		// Index into LODLevels in use, set by SetLOD or SetLODFromDistance
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = LOD)
+			int CurrentLOD;
+
+		// Whether the last solve was skipped by the current level's SolveEveryNthFrame
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			bool LastSolveDecimated;
+
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			int NumSolvesDecimated;
+
+		// Indices of the chains the last SolveForTarget stopped at their deadline
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			TArray<int> LastCutShortChains;
+
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			float LastSolveMicroseconds;
+
+		// Chains skipped by the last solve, and over every solve since the telemetry was reset
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			int LastNumChainsSkipped;
+
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			int TotalChainsSkipped;
+
+		// Solves that skipped every chain
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			int NumSolvesSkipped;
+
+		// Gather and solve iterations run by the last multi-effector solve
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			int LastMultiEffectorIterations;
+
+		// Bone placements made by the last solve's forward and backward passes, for comparing solve modes
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			int LastBoneUpdates;
+
+		// Effector distances of every chain from its target after the last solve, summed
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Telemetry)
+			float LastTotalSolveDistance;
+
+		// Per chain deadlines for the solve in progress, kept to avoid reallocating every solve
+		TArray<double> ChainDeadlines;
+
+		// Each chain's weight in sharing out the solve budget, gathered once per solve
+		TArray<float> ChainBudgetWeights;
+
+		// Chain indices grouped by dependency level: a chain is one level above the chain it is connected to, so every
+		// chain in a level can be solved at once. Level N holds SolveLevelChains[SolveLevelStarts[N]] up to, but not
+		// including, SolveLevelChains[SolveLevelStarts[N + 1]].
+		TArray<int> SolveLevelChains;
+		TArray<int> SolveLevelStarts;
+
+		// False when a chain is connected to a chain that does not come before it, which only the serial order handles
+		bool bSolveLevelsValid;
 	
 		void SolveForTarget(FVector InNewTargetLocation);
 		void SolveForTarget(float InTargetX, float InTargetY, float InTargetZ);
+
+		/**
+		 * Solve the whole structure with each listed chain reaching for its own target, connected or not, without
+		 * touching any chain's EmbeddedTarget. Chains that are not listed reach for their embedded target if they use
+		 * one, otherwise for their last target, or hold their effector where it is if they have never been solved.
+		 */
+		void SolveForTargets(const TArray<FFabrikChainTarget>& InTargets);
+
+		/** Solve the whole structure with chain N reaching for InChainTargets[N]. There must be one target per chain. */
+		void SolveForTargetBuffer(const TArray<FVector>& InChainTargets);
 		void AddChain(UFabrikChain* InChain);
 		void RemoveChain(int InChainIndex);
 		void ConnectChain(UFabrikChain* InNewChain, int InExistingChainNumber, int InExistingBoneNumber);
 		void ConnectChain(UFabrikChain* InNewChain, int InExistingChainNumber, int InExistingBoneNumber, EBoneConnectionPoint InBoneConnectionPoint);
 
 		void SetFixedBaseMode(bool InFixedBaseMode);
+
+		// Regroup the chains into dependency levels. Called whenever chains are added, connected or removed.
+		void RebuildSolveLevels();
+
+		// Whether the next solve can run the dependency levels in parallel
+		bool CanSolveInParallel();
+
+		// Whether a whole solve creates no UObjects, so it may run on a worker thread
+		bool CanSolveOffGameThread() const;
+
+		// Whether a chain solving for InTarget would end up exactly where it is, going by its dirty flag, its last target
+		// and base, and whether its host chain moved
+		bool IsChainClean(int InChainIndex, const FVector& InTarget);
+
+		void ResetTelemetry();
+
+		/** Use LOD level InLOD, clamped to the levels there are. Significance managers can call this directly. */
+		void SetLOD(int InLOD);
+
+		/** Use the first LOD level whose MaxDistance covers InDistance, or the last level if none does. */
+		void SetLODFromDistance(float InDistance);
+
+		// Frames since the last real solve, counting towards the current level's SolveEveryNthFrame
+		int LODFramesSinceSolve;
+
+		// Joint locations of every chain, chain after chain, after the last two real solves
+		TArray<FVector> LODPreviousJoints;
+		TArray<FVector> LODLastJoints;
+
+		// Joint locations over every chain, NumBones + 1 per chain with any bones
+		int GetNumJoints() const;
+
+		// Copy every chain's joint locations into or out of OutJoints, in the order above
+		void GatherJoints(TArray<FVector>& OutJoints);
+		void ApplyJoints(const TArray<FVector>& InJoints);
+
+		// Pose every chain between two sets of gathered joints, turning the bones rather than sliding the joints so that
+		// bone lengths hold
+		void ApplyBlendedJoints(const TArray<FVector>& InFromJoints, const TArray<FVector>& InToJoints, float InAlpha);
+
+		// Per chain targets filled in by SolveForTargets, kept to avoid reallocating every solve
+		TArray<FVector> ChainTargets;
+
+		// Solve every chain, serially or by dependency level, for either the shared target or InChainTargets
+		void SolveChains(FVector InNewTargetLocation, const TArray<FVector>* InChainTargets);
+
+		// Solve every chain once, serially or by dependency level, as one pass of SolveChains. The chains share out the
+		// time left until InEndSeconds as they start, or have no deadline when it is zero.
+		void SolveChainsOnce(FVector InNewTargetLocation, const TArray<FVector>* InChainTargets, double InEndSeconds);
+
+		// Pull each host joint that chains are connected to towards where those chains would like their bases to be
+		void GatherSubBasePulls(FVector InNewTargetLocation, const TArray<FVector>* InChainTargets);
+
+		// Whether the multi-effector fallback has been logged, so a structure only warns about it once
+		bool bWarnedMultiEffectorFallback;
+
+		// The target chain InChainIndex solves for, given the shared target and any target buffer
+		FVector GetChainTarget(int InChainIndex, FVector InNewTargetLocation, const TArray<FVector>* InChainTargets);
+
+		// Clamp the base of a connected chain to its host bone and solve it, as one step of SolveChains
+		void SolveChain(int InChainIndex, FVector InNewTargetLocation, const TArray<FVector>* InChainTargets);
+
+		// Each chain's SolvePriority, or the same for all when none is set
+		void GetChainBudgetWeights(TArray<float>& OutWeights) const;
+
+		// Weight of a dependency level, that of its heaviest chain as the level's chains are solved side by side
+		float GetLevelBudgetWeight(int InLevel) const;
+
+		// When a chain starting at InNowSeconds must stop, given InWeight out of the InWeightLeft still to share the time
+		// until InEndSeconds
+		static double GetDeadline(double InNowSeconds, double InEndSeconds, float InWeight, float InWeightLeft);
 };
@@ -8,6 +8,24 @@
 
 #include "FabrikUtil.generated.h"
 
+/**
+ * A constraint angle kept as its cosine and sine, so clamping against it needs no acos, sin or cos.
+ */
+struct FFabrikAngleLimit
+{
+	float Cos;
+	float Sin;
+
+	FFabrikAngleLimit() : Cos(-1.0f), Sin(0.0f) {}
+
+	static FFabrikAngleLimit FromDegs(float InAngleDegs)
+	{
+		FFabrikAngleLimit Limit;
+		FMath::SinCos(&Limit.Sin, &Limit.Cos, FMath::DegreesToRadians(InAngleDegs));
+		return Limit;
+	}
+};
+
 // https://wiki.unrealengine.com/Static_Function_Libraries,_Your_Own_Version_of_UE4_C%2B%2B,_No_Engine_Compile_Times
 UCLASS()
 class UFabrikUtil : public UObject
@@ -251,6 +269,56 @@ class UFabrikUtil : public UObject
 
 	static FVector GetAngleLimitedUnitVectorDegs(FVector InVecToLimit, FVector InVecBaseline, float InAngleLimitDegs);
 
+	// Rotate InSource about a unit axis, given the cosine and sine of the angle (Rodrigues' rotation formula)
+	static FORCEINLINE FVector RotateAboutAxis(const FVector& InSource, const FVector& InRotationAxis, float InCos, float InSin)
+	{
+		return InSource * InCos + FVector::CrossProduct(InRotationAxis, InSource) * InSin + InRotationAxis * (FVector::DotProduct(InRotationAxis, InSource) * (1.0f - InCos));
+	}
+
+	/**
+	 * GetAngleLimitedUnitVectorDegs for unit vectors, without any trig. The angle is compared as a cosine and the limited
+	 * vector is built from the baseline and the unit vector perpendicular to it towards InVecToLimit.
+	 */
+	static FORCEINLINE FVector GetAngleLimitedUnitVector(const FVector& InVecToLimit, const FVector& InVecBaseline, const FFabrikAngleLimit& InLimit)
+	{
+		const float CosAngle = FVector::DotProduct(InVecBaseline, InVecToLimit);
+		if (CosAngle >= InLimit.Cos)
+		{
+			return InVecToLimit;
+		}
+
+		// Pointing straight back along the baseline leaves no preferred side, so pick any
+		FVector Perpendicular = (InVecToLimit - InVecBaseline * CosAngle).GetSafeNormal();
+		if (Perpendicular.IsZero())
+		{
+			Perpendicular = VectorGenPerpendicularVectorQuick(InVecBaseline);
+		}
+		return (InVecBaseline * InLimit.Cos + Perpendicular * InLimit.Sin).GetSafeNormal();
+	}
+
+	/**
+	 * Keep a unit vector already projected onto the hinge plane within its clockwise and anticlockwise limits about the
+	 * reference axis, without any trig. Matches the GetSignedAngleBetweenDegs convention: anticlockwise is positive and
+	 * a vector exactly on the reference axis counts as anticlockwise.
+	 */
+	static FORCEINLINE FVector GetHingeLimitedUnitVector(const FVector& InVecToLimit, const FVector& InReferenceAxis, const FVector& InRotationAxis,
+		const FFabrikAngleLimit& InClockwiseLimit, const FFabrikAngleLimit& InAnticlockwiseLimit)
+	{
+		const float CosAngle = FVector::DotProduct(InReferenceAxis, InVecToLimit);
+		if (FVector::DotProduct(FVector::CrossProduct(InReferenceAxis, InVecToLimit), InRotationAxis) >= 0.0f)
+		{
+			if (CosAngle < InAnticlockwiseLimit.Cos)
+			{
+				return RotateAboutAxis(InReferenceAxis, InRotationAxis, InAnticlockwiseLimit.Cos, InAnticlockwiseLimit.Sin).GetSafeNormal();
+			}
+		}
+		else if (CosAngle < InClockwiseLimit.Cos)
+		{
+			return RotateAboutAxis(InReferenceAxis, InRotationAxis, InClockwiseLimit.Cos, -InClockwiseLimit.Sin).GetSafeNormal();
+		}
+		return InVecToLimit;
+	}
+
 
 	static FVector RotateYRads(FVector InSource, float InAngleRads)
 	{
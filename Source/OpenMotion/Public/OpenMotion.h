@@ -6,6 +6,7 @@
 #include "Modules/ModuleManager.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(OpenMotionLog, Log, All);
+DECLARE_STATS_GROUP(TEXT("OpenMotion"), STATGROUP_OpenMotion, STATCAT_Advanced);
 
 class FOpenMotionModule : public IModuleInterface
 {
@@ -4,210 +4,28 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
-
-//
+#include "OpenMotionUpperBodySolver.h"
+#include "OpenMotionEffectorPredictor.h"
+#include "OpenMotionEffectorFilter.h"
+#include "OpenMotionEffectorReplication.h"
 
 #include "OpenMotionComponent.generated.h"
 
-
-USTRUCT(BlueprintType)
-struct FWorldTransforms
-{
-	GENERATED_USTRUCT_BODY()
-
-		// any non-UPROPERTY() struct vars are not replicated
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform HeadEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftHandEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightHandEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform Component;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform Shoulder;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftUpperArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftLowerArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightUpperArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightLowerArm;
-};
-
-
-USTRUCT(BlueprintType)
-struct FShoulderTransforms
-{
-	GENERATED_USTRUCT_BODY()
-
-		UPROPERTY(BlueprintReadWrite)
-		FTransform HeadEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftHandEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightHandEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform Shoulder;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftUpperArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftLowerArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightUpperArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightLowerArm;
-};
-
-USTRUCT(BlueprintType)
-struct FComponentTransforms
-{
-	GENERATED_USTRUCT_BODY()
-
-		UPROPERTY(BlueprintReadWrite)
-		FTransform HeadEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftHandEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightHandEffector;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform Shoulder;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftClavicle;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightClavicle;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftUpperArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LeftLowerArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightUpperArm;
-
-	UPROPERTY(BlueprintReadWrite)
-		FTransform RightLowerArm;
-};
-
-
-USTRUCT(BlueprintType)
-struct FTransformSettings
-{
-	GENERATED_USTRUCT_BODY()
-
-		UPROPERTY(BlueprintReadWrite)
-		bool DrawDebug = true;
-
-	UPROPERTY(BlueprintReadWrite)
-		float UpperArmsDistance = 30.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float DistinctShoulderRotationMultiplier = 60.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float DistinctShoulderRotationLimit = 45.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float ClavicleOffset = 90.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float ElbowBaseOffsetAngle = 30.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float ElbowYDistanceStart = 0.2f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float ElbowYWeight = 130.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float ElbowHandRotSpeed = 15.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float HeadHandAngleLimit = 50.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float HeadHandAngleOkSpan = 80.f;
-};
-
-
-USTRUCT(BlueprintType)
-struct FCharacterSettings
-{
-	GENERATED_USTRUCT_BODY()
-
-		UPROPERTY(BlueprintReadWrite)
-		FTransform CharacterBaseTransform;
-
-	UPROPERTY(BlueprintReadWrite)
-		float ArmLength = 0.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float LowerArmLength = 0.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float UpperArmLength = 0.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float LeftElbowHandAngle = 0.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float RightElbowHandAngle = 0.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float LeftHeadHandAngle = 0.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float RightHeadHandAngle = 0.f;
-
-	UPROPERTY(BlueprintReadWrite)
-		float HeadHandAngleLimitDot = 0.f;
-};
+class USkeletalMesh;
+class USkeletalMeshComponent;
 
 
+// Sockets, or bones, of the owner mesh the component reads
 USTRUCT(BlueprintType)
-struct FArmTransforms
+struct FOpenMotionBoneNames
 {
 	GENERATED_USTRUCT_BODY()
 
-		UPROPERTY(BlueprintReadWrite)
-		FTransform UpperArmTransform;
-	UPROPERTY(BlueprintReadWrite)
-		FTransform LowerArmTransform;
-
-	FArmTransforms()
-	{
-		UpperArmTransform = FTransform();
-		LowerArmTransform = FTransform();
-	}
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FName LeftUpperArm = TEXT("UpperArm_l");
 
-	FArmTransforms(FTransform UpperArm, FTransform LowerArm)
-	{
-		UpperArmTransform = UpperArm;
-		LowerArmTransform = LowerArm;
-	}
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FName RightUpperArm = TEXT("UpperArm_r");
 };
 
 
@@ -230,6 +48,19 @@ public:
 	FTransformSettings TransformSettings;
 	UPROPERTY(BlueprintReadWrite)
 	FCharacterSettings CharacterSettings;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FOpenMotionBoneNames BoneNames;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FOpenMotionEffectorFilterSettings FilterSettings;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FOpenMotionPredictionSettings PredictionSettings;
+
+	// Send the effectors given to SetCharacterTransforms on the owner to everyone else, and drive remote avatars with them.
+	// Read at BeginPlay, which is when the component starts replicating.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool ReplicateEffectors = false;
+	UPROPERTY(Replicated, BlueprintReadOnly)
+	FOpenMotionReplicatedEffectors ReplicatedEffectors;
 
 protected:
 	// Called when the game starts
@@ -238,9 +69,23 @@ protected:
 public:	
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
+	// The owning client's effectors, each one in full, for the server to replicate on as deltas
+	UFUNCTION(Server, Unreliable, WithValidation)
+		void ServerSetEffectors(const FOpenMotionReplicatedEffectors& Effectors);
+
+	// Look up the BoneNames bones of OwnerMesh now rather than on its first tick. CustomTick does this itself whenever
+	// the mesh, its skeletal mesh or BoneNames change.
+	UFUNCTION(BlueprintCallable, Category = "")
+		void SetOwnerMesh(USkeletalMeshComponent* OwnerMesh);
 	UFUNCTION(BlueprintCallable, Category = "")
 		void CustomTick(USkeletalMeshComponent* OwnerMesh);
+	// CustomTick for many avatars at once, solving them across threads. OwnerMeshes is matched to Components by index.
+	// Only the solve is batched - each avatar's effectors were already filtered and predicted one at a time by
+	// SetCharacterTransforms, as the filter has to run on every tracker sample ahead of the prediction.
+	UFUNCTION(BlueprintCallable, Category = "")
+		static void CustomTickBatch(const TArray<UOpenMotionComponent*>& Components, const TArray<USkeletalMeshComponent*>& OwnerMeshes);
 	UFUNCTION(BlueprintCallable, Category = "")
 		void ConvertTransforms();
 	UFUNCTION(BlueprintCallable, Category = "")
@@ -288,4 +133,55 @@ public:
 		FRotator GetShoulderRotationFromHands();
 	UFUNCTION(BlueprintCallable, Category = "")
 		FRotator FindBetweenNormals(FVector A, FVector B);
+
+	// Solve NumAvatars avatars with this component's settings for NumFrames frames of a swaying head and hands, through
+	// FOpenMotionUpperBodySolver and through the component's own functions, and log the time per avatar each way
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunUpperBodySolverBenchmark(int NumAvatars = 100, int NumFrames = 100);
+
+	// Solve 1, 2, 4 ... 256 avatars for NumFrames frames through FOpenMotionUpperBodySolver::SolveBatch on one thread and
+	// on every worker, and log the time per frame and per avatar each way
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		void RunUpperBodyBatchBenchmark(int NumFrames = 100);
+
+private:
+
+	// Where one of BoneNames is on the owner mesh: the bone it is on, and its offset from that bone if it is a socket
+	struct FCachedBone
+	{
+		int32 BoneIndex = INDEX_NONE;
+		FTransform SocketLocal;
+	};
+
+	FOpenMotionEffectorFilterState FilterState;
+	double LastSampleTime = 0.0;
+
+	// Recent samples of the effectors given to SetCharacterTransforms
+	FOpenMotionEffectorPredictor HeadPredictor;
+	FOpenMotionEffectorPredictor LeftHandPredictor;
+	FOpenMotionEffectorPredictor RightHandPredictor;
+
+	TWeakObjectPtr<USkeletalMeshComponent> CachedOwnerMesh;
+	TWeakObjectPtr<USkeletalMesh> CachedSkeletalMesh;
+	FOpenMotionBoneNames CachedBoneNames;
+	FCachedBone LeftUpperArmBone;
+	FCachedBone RightUpperArmBone;
+
+	void ResolveBone(USkeletalMeshComponent* InOwnerMesh, FName InName, FCachedBone& OutBone) const;
+	FVector GetBoneLocation(USkeletalMeshComponent* InOwnerMesh, const FCachedBone& InBone, FName InName) const;
+	// Read the world locations of both upper arms from the owner mesh's pose, resolving the bones first if need be
+	void GetUpperArmLocations(USkeletalMeshComponent* InOwnerMesh, FVector& OutLeft, FVector& OutRight);
+
+	// The component's transform structs gathered into the pose the solver works on, and written back out of it
+	FOpenMotionUpperBodyPose GetPose() const;
+	void SetPose(const FOpenMotionUpperBodyPose& InPose);
+
+	float GetSolveDeltaSeconds() const;
+	// Whether the trackers for this avatar are on this machine
+	bool IsDrivenLocally() const;
+	FOpenMotionUpperBodyInput MakeInput(USkeletalMeshComponent* InOwnerMesh);
+
+	// A deterministic head and hands sway, offset per avatar so no two solve the same frame
+	static FOpenMotionUpperBodyInput MakeBenchmarkInput(int InAvatar, int InFrame);
+	FOpenMotionUpperBodyPose MakeBenchmarkPose() const;
 };
@@ -0,0 +1,103 @@
+// Copyright (c) Name 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "OpenMotionEffectorFilter.generated.h"
+
+struct FOpenMotionUpperBodyInput;
+
+
+// One Euro filter settings for one channel. The cutoff rises from MinCutoff by Beta for every unit per second the
+// channel moves, so a still effector is smoothed hard and a fast one follows closely.
+USTRUCT(BlueprintType)
+struct FOpenMotionOneEuroSettings
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Cutoff frequency in Hz at rest. Lower removes more jitter.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MinCutoff = 1.f;
+
+	// Cutoff gained per unit per second of speed. Higher removes more lag.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Beta = 0.05f;
+
+	// Cutoff frequency in Hz of the speed estimate itself
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float DerivativeCutoff = 1.f;
+
+	FOpenMotionOneEuroSettings()
+	{
+	}
+
+	FOpenMotionOneEuroSettings(float InMinCutoff, float InBeta, float InDerivativeCutoff)
+		: MinCutoff(InMinCutoff)
+		, Beta(InBeta)
+		, DerivativeCutoff(InDerivativeCutoff)
+	{
+	}
+};
+
+
+USTRUCT(BlueprintType)
+struct FOpenMotionEffectorFilterSettings
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Filter the head and hands given to SetCharacterTransforms
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		bool Enabled = false;
+
+	// Speeds in cm per second
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FOpenMotionOneEuroSettings HeadLocation = FOpenMotionOneEuroSettings(1.f, 0.05f, 1.f);
+
+	// Speeds in quaternion units per second - about half the turn rate in radians
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FOpenMotionOneEuroSettings HeadRotation = FOpenMotionOneEuroSettings(1.f, 1.f, 1.f);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FOpenMotionOneEuroSettings HandLocation = FOpenMotionOneEuroSettings(1.f, 0.05f, 1.f);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FOpenMotionOneEuroSettings HandRotation = FOpenMotionOneEuroSettings(1.f, 1.f, 1.f);
+};
+
+
+/**
+ * Filtered value and speed of each channel of one avatar - the head, left hand and right hand, location then rotation.
+ */
+struct OPENMOTION_API FOpenMotionEffectorFilterState
+{
+	static const int32 NumChannels = 6;
+
+	FVector4 Values[NumChannels];
+	FVector4 Derivatives[NumChannels];
+	bool Initialized;
+
+	FOpenMotionEffectorFilterState()
+		: Initialized(false)
+	{
+	}
+
+	void Reset() { Initialized = false; }
+};
+
+
+/**
+ * One Euro filtering of head and hand effectors. Every channel is a four lane vector, and the cutoffs of all six
+ * channels are worked out two vector registers at a time, so filtering an avatar is a fixed amount of straight line
+ * vector work with no allocation.
+ */
+struct OPENMOTION_API FOpenMotionEffectorFilter
+{
+	// Filter one avatar's effectors in place. The first call just starts the filter off, and one with no time passed holds
+	// the effectors where they were last filtered to.
+	static void Filter(const FOpenMotionEffectorFilterSettings& InSettings, float InDeltaSeconds, FTransform& InOutHead, FTransform& InOutLeftHand, FTransform& InOutRightHand, FOpenMotionEffectorFilterState& InOutState);
+
+	// Filter the effectors of InNum avatars in place, each over its own DeltaSeconds. For callers that hold the raw inputs
+	// of many avatars - UOpenMotionComponent filters its own per sample in SetCharacterTransforms, not per batch.
+	static void FilterBatch(const FOpenMotionEffectorFilterSettings& InSettings, int32 InNum, FOpenMotionUpperBodyInput* InOutInputs, FOpenMotionEffectorFilterState* InOutStates);
+};
@@ -0,0 +1,74 @@
+// Copyright (c) Name 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "OpenMotionEffectorPredictor.generated.h"
+
+
+USTRUCT(BlueprintType)
+struct FOpenMotionPredictionSettings
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Extrapolate the head and hands given to SetCharacterTransforms to when the frame will be on the display
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		bool Enabled = false;
+
+	// Time from sampling the trackers to the frame being displayed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float PredictionSeconds = 0.03f;
+
+	// Samples this much older than the newest one are left out of the velocity fit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float HistorySeconds = 0.05f;
+
+	// The furthest past the newest sample a prediction is made. Beyond it the trackers are taken to have stalled.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MaxLookaheadSeconds = 0.1f;
+
+	// Furthest a prediction may move an effector from its newest sample
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MaxPredictionDistance = 15.f;
+
+	// Furthest a prediction may turn an effector from its newest sample
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MaxPredictionDegrees = 30.f;
+};
+
+
+/**
+ * A short, fixed size history of timestamped samples of one effector, extrapolated forwards in time with the linear and
+ * angular velocity fitted to the recent samples.
+ */
+struct OPENMOTION_API FOpenMotionEffectorPredictor
+{
+	static const int32 HistoryCapacity = 8;
+
+	FOpenMotionEffectorPredictor();
+
+	void Reset();
+
+	// Samples must arrive in time order - one no newer than the last replaces it
+	void AddSample(const FTransform& InTransform, double InTime);
+
+	// Where the effector will be at InTime. With fewer than two samples this is the newest sample.
+	FTransform Predict(double InTime, const FOpenMotionPredictionSettings& InSettings) const;
+
+	int32 NumSamples() const { return Count; }
+
+	// Least squares velocities over the samples within HistorySeconds of the newest. The angular velocity is an axis
+	// scaled by radians per second.
+	void GetVelocities(const FOpenMotionPredictionSettings& InSettings, FVector& OutLinearVelocity, FVector& OutAngularVelocity) const;
+
+private:
+
+	// InAge 0 is the newest sample
+	int32 GetSlot(int32 InAge) const { return (Newest - InAge + HistoryCapacity) % HistoryCapacity; }
+
+	FTransform Transforms[HistoryCapacity];
+	double Times[HistoryCapacity];
+	int32 Newest;
+	int32 Count;
+};
@@ -0,0 +1,144 @@
+// Copyright (c) Name 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+
+#include "OpenMotionEffectorReplication.generated.h"
+
+
+/**
+ * One effector relative to the component, as whole numbers. The location is in fiftieths of a centimetre and the
+ * rotation is the three smallest quaternion components, with the index of the largest, which is always positive.
+ */
+struct OPENMOTION_API FOpenMotionQuantizedEffector
+{
+	static const int32 LocationUnitsPerCm = 50;
+	static const int32 LocationBits = 18;
+	static const int32 RotationBits = 12;
+
+	int32 Location[3];
+	int32 Rotation[3];
+	int32 LargestComponent;
+
+	FOpenMotionQuantizedEffector();
+
+	static FOpenMotionQuantizedEffector Quantize(const FTransform& InLocal);
+	FTransform Dequantize() const;
+
+	bool operator==(const FOpenMotionQuantizedEffector& InOther) const;
+	bool operator!=(const FOpenMotionQuantizedEffector& InOther) const { return !(*this == InOther); }
+};
+
+/**
+ * The head and hands as sent. The sequence number lets a receiver find the state a delta was written against.
+ */
+struct OPENMOTION_API FOpenMotionQuantizedEffectors
+{
+	static const int32 NumEffectors = 3;
+
+	FOpenMotionQuantizedEffector Effectors[NumEffectors];
+	uint8 Sequence;
+
+	FOpenMotionQuantizedEffectors()
+		: Sequence(0)
+	{
+	}
+
+	bool HasSameValues(const FOpenMotionQuantizedEffectors& InOther) const;
+};
+
+/**
+ * What a connection last had sent to it, for NetDeltaSerialize to write the next update against.
+ */
+class OPENMOTION_API FOpenMotionEffectorsDeltaState : public INetDeltaBaseState
+{
+public:
+
+	FOpenMotionQuantizedEffectors State;
+
+	// Deltas written since the last full update to this connection
+	int32 DeltasSinceFull = 0;
+
+	virtual bool IsStateEqual(INetDeltaBaseState* OtherState) override;
+};
+
+
+/**
+ * Head and hand effectors relative to the avatar's component, replicated as quantized deltas against the last state each
+ * connection was sent. The engine rolls that state back to the last acknowledged one when a packet is lost, and every
+ * update names the state it was written against, so a receiver only ever applies deltas it has the base for.
+ *
+ * An acknowledgement only says a packet arrived, not that its delta could be applied, so the sender may go on writing
+ * against a state the receiver dropped. Every FullUpdateInterval deltas a connection is sent a full update instead,
+ * which bounds how long a receiver can go without applying anything, whatever was lost.
+ */
+USTRUCT(BlueprintType)
+struct OPENMOTION_API FOpenMotionReplicatedEffectors
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+		FTransform HeadEffector;
+
+	UPROPERTY(BlueprintReadOnly)
+		FTransform LeftHandEffector;
+
+	UPROPERTY(BlueprintReadOnly)
+		FTransform RightHandEffector;
+
+	// Updates received that could not be applied because their base state never arrived
+	int32 NumDeltasDropped = 0;
+
+	// Sequence number of the last update applied, or -1 before the first
+	int32 LastAppliedSequence = -1;
+
+	// Store world space effectors relative to InComponent
+	void SetEffectors(const FTransform& InComponent, const FTransform& InHead, const FTransform& InLeftHand, const FTransform& InRightHand);
+	// The stored effectors in world space relative to InComponent
+	void GetEffectors(const FTransform& InComponent, FTransform& OutHead, FTransform& OutLeftHand, FTransform& OutRightHand) const;
+
+	FOpenMotionQuantizedEffectors Quantize() const;
+
+	// Every update in full, for RPCs
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+	// Property replication, as deltas against each connection's last state
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+
+	// Write InState, as a delta against InBase if there is one
+	static void WriteEffectors(FArchive& Ar, const FOpenMotionQuantizedEffectors& InState, const FOpenMotionQuantizedEffectors* InBase);
+
+	// Deltas a connection is sent before a full update
+	static const int32 FullUpdateInterval = 30;
+
+	// Sequence numbers a base may fall behind NextSequence before it is written in full instead, well inside the 256 an
+	// eight bit sequence can tell apart
+	static const int32 MaxBaseAge = 128;
+
+private:
+
+	static const int32 NumReceivedStates = 8;
+
+	// Sequence number of the next state sent to any connection, never reused soon after however the connections roll
+	// back. Being shared, one connection sees gaps in the sequence, which only costs it slots below.
+	uint8 NextSequence = 0;
+
+	// The last few states received, in slot Sequence % NumReceivedStates. A delta is only applied when its base's slot
+	// holds that exact sequence, so a base overwritten by a later state is dropped rather than misread, and the next
+	// full update starts the receiver off again.
+	FOpenMotionQuantizedEffectors ReceivedStates[NumReceivedStates];
+	bool ReceivedStateValid[NumReceivedStates] = {};
+
+	void ApplyState(const FOpenMotionQuantizedEffectors& InState);
+};
+
+template<>
+struct TStructOpsTypeTraits<FOpenMotionReplicatedEffectors> : public TStructOpsTypeTraitsBase2<FOpenMotionReplicatedEffectors>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithNetDeltaSerializer = true,
+	};
+};
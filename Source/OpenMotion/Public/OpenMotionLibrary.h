@@ -4,8 +4,39 @@
 
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
+#include "OpenMotionEffectorPredictor.h"
+#include "OpenMotionEffectorFilter.h"
 #include "OpenMotionLibrary.generated.h"
 
+
+USTRUCT(BlueprintType)
+struct FOpenMotionPredictionReplayResult
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+		int32 NumSamples = 0;
+
+	// Mean distance and angle between the effector shown and the real one at display time, using the raw samples
+	UPROPERTY(BlueprintReadOnly)
+		float RawMeanDistance = 0.f;
+	UPROPERTY(BlueprintReadOnly)
+		float RawMeanDegrees = 0.f;
+
+	// The same, using the predicted samples
+	UPROPERTY(BlueprintReadOnly)
+		float PredictedMeanDistance = 0.f;
+	UPROPERTY(BlueprintReadOnly)
+		float PredictedMeanDegrees = 0.f;
+	UPROPERTY(BlueprintReadOnly)
+		float PredictedMaxDistance = 0.f;
+
+	// How late raw samples would have to be to lag the real effector as much as the predicted ones do
+	UPROPERTY(BlueprintReadOnly)
+		float EffectiveLatencySeconds = 0.f;
+};
+
+
 /**
  * 
  */
@@ -13,5 +44,40 @@ UCLASS()
 class OPENMOTION_API UOpenMotionLibrary : public UBlueprintFunctionLibrary
 {
 	GENERATED_BODY()
-	
+
+public:
+
+	// Play a recorded tracker trace through FOpenMotionEffectorPredictor, showing each sample Settings.PredictionSeconds
+	// after it was taken, and measure how far the raw and predicted effectors are from where the trace really was then
+	UFUNCTION(BlueprintCallable, Category = "OpenMotion|Prediction")
+		static FOpenMotionPredictionReplayResult ReplayPredictionTrace(const TArray<float>& SampleTimes, const TArray<FTransform>& Samples, const FOpenMotionPredictionSettings& Settings);
+
+	// Read a trace with one "time, x, y, z, qx, qy, qz, qw" sample per line. Lines that don't parse are skipped.
+	UFUNCTION(BlueprintCallable, Category = "OpenMotion|Prediction")
+		static bool LoadTrackerTrace(const FString& FileName, TArray<float>& OutSampleTimes, TArray<FTransform>& OutSamples);
+
+	// A 90Hz hand trace sweeping and reaching at a brisk pace, with a little tracker noise
+	UFUNCTION(BlueprintCallable, Category = "OpenMotion|Prediction")
+		static void MakeSyntheticTrackerTrace(float Seconds, TArray<float>& OutSampleTimes, TArray<FTransform>& OutSamples);
+
+	// Replay the trace in FileName, or a synthetic one when there is no such file, and log the results
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		static void RunPredictionReplay(const FString& FileName, const FOpenMotionPredictionSettings& Settings);
+
+	// Filter NumAvatars noisy copies of the synthetic trace's hand for NumFrames frames with Settings through
+	// FOpenMotionEffectorFilter::FilterBatch, and log the time per avatar along with the jitter and error of the raw and
+	// filtered hand against the clean trace
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		static void RunEffectorFilterBenchmark(const FOpenMotionEffectorFilterSettings& Settings, int NumAvatars = 256, int NumFrames = 900);
+
+	// Replicate NumAvatars copies of the synthetic trace's head and hands at SendRate updates a second for Seconds through
+	// FOpenMotionReplicatedEffectors::NetDeltaSerialize and straight back into a receiving copy, losing PacketLoss of the
+	// updates and hearing back about each one a tenth of a second later. Logs the bytes per avatar per second sent, the
+	// updates the receivers had to drop and the longest run of them, the encode and decode time, and the error of the
+	// effectors they rebuilt.
+	UFUNCTION(BlueprintCallable, Category = Benchmark)
+		static void RunEffectorReplicationBenchmark(int NumAvatars = 64, float SendRate = 30.f, float PacketLoss = 0.05f, float Seconds = 10.f);
+
+	// Where the trace was at InTime, between the samples either side of it
+	static FTransform SampleTrackerTrace(const TArray<float>& InSampleTimes, const TArray<FTransform>& InSamples, float InTime);
 };
@@ -0,0 +1,300 @@
+// Copyright (c) Name 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "OpenMotionUpperBodySolver.generated.h"
+
+
+USTRUCT(BlueprintType)
+struct FWorldTransforms
+{
+	GENERATED_USTRUCT_BODY()
+
+		// any non-UPROPERTY() struct vars are not replicated
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform HeadEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftHandEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightHandEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform Component;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform Shoulder;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftUpperArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftLowerArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightUpperArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightLowerArm;
+};
+
+
+USTRUCT(BlueprintType)
+struct FShoulderTransforms
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(BlueprintReadWrite)
+		FTransform HeadEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftHandEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightHandEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform Shoulder;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftUpperArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftLowerArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightUpperArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightLowerArm;
+};
+
+USTRUCT(BlueprintType)
+struct FComponentTransforms
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(BlueprintReadWrite)
+		FTransform HeadEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftHandEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightHandEffector;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform Shoulder;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftClavicle;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightClavicle;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftUpperArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LeftLowerArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightUpperArm;
+
+	UPROPERTY(BlueprintReadWrite)
+		FTransform RightLowerArm;
+};
+
+
+USTRUCT(BlueprintType)
+struct FTransformSettings
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(BlueprintReadWrite)
+		bool DrawDebug = true;
+
+	UPROPERTY(BlueprintReadWrite)
+		float UpperArmsDistance = 30.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float DistinctShoulderRotationMultiplier = 60.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float DistinctShoulderRotationLimit = 45.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float ClavicleOffset = 90.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float ElbowBaseOffsetAngle = 30.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float ElbowYDistanceStart = 0.2f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float ElbowYWeight = 130.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float ElbowHandRotSpeed = 15.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float HeadHandAngleLimit = 50.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float HeadHandAngleOkSpan = 80.f;
+};
+
+
+USTRUCT(BlueprintType)
+struct FCharacterSettings
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(BlueprintReadWrite)
+		FTransform CharacterBaseTransform;
+
+	UPROPERTY(BlueprintReadWrite)
+		float ArmLength = 0.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float LowerArmLength = 0.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float UpperArmLength = 0.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float LeftElbowHandAngle = 0.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float RightElbowHandAngle = 0.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float LeftHeadHandAngle = 0.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float RightHeadHandAngle = 0.f;
+
+	UPROPERTY(BlueprintReadWrite)
+		float HeadHandAngleLimitDot = 0.f;
+};
+
+
+USTRUCT(BlueprintType)
+struct FArmTransforms
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(BlueprintReadWrite)
+		FTransform UpperArmTransform;
+	UPROPERTY(BlueprintReadWrite)
+		FTransform LowerArmTransform;
+
+	FArmTransforms()
+	{
+		UpperArmTransform = FTransform();
+		LowerArmTransform = FTransform();
+	}
+
+	FArmTransforms(FTransform UpperArm, FTransform LowerArm)
+	{
+		UpperArmTransform = UpperArm;
+		LowerArmTransform = LowerArm;
+	}
+};
+
+
+/**
+ * What FOpenMotionUpperBodySolver reads from the world for one avatar and one frame.
+ */
+struct OPENMOTION_API FOpenMotionUpperBodyInput
+{
+	FTransform HeadEffector;
+	FTransform LeftHandEffector;
+	FTransform RightHandEffector;
+	FTransform Component;
+
+	// World locations of the mesh's upper arm sockets. Without them the upper arms are left where RotateUpperArm put them.
+	bool HasUpperArmLocations;
+	FVector LeftUpperArmLocation;
+	FVector RightUpperArmLocation;
+
+	float DeltaSeconds;
+
+	FOpenMotionUpperBodyInput()
+		: HasUpperArmLocations(false)
+		, LeftUpperArmLocation(FVector::ZeroVector)
+		, RightUpperArmLocation(FVector::ZeroVector)
+		, DeltaSeconds(0.f)
+	{
+	}
+};
+
+/**
+ * The solved upper body. The next frame's solve reads the shoulder, lower arms and angles back out of it, so one pose is
+ * kept per avatar and handed back in every frame.
+ */
+struct OPENMOTION_API FOpenMotionUpperBodyPose
+{
+	FWorldTransforms WorldTransforms;
+	FShoulderTransforms ShoulderTransforms;
+	FComponentTransforms ComponentTransforms;
+	FCharacterSettings CharacterSettings;
+
+	// The inverse of WorldTransforms.Component, worked out once by ConvertTransforms for every step after it
+	FTransform LocalComponentTransform;
+};
+
+/**
+ * The head and hands upper body solve UOpenMotionComponent runs, as static functions over a pose. Nothing here touches
+ * a UObject or allocates, so any thread can solve any number of avatars as long as each pose is only solved by one
+ * thread at a time.
+ *
+ * Each step matches the UOpenMotionComponent function of the same name.
+ */
+struct OPENMOTION_API FOpenMotionUpperBodySolver
+{
+	// Solve one frame, reading the last frame's state from InOutPose and leaving the new pose in it
+	static void Solve(const FOpenMotionUpperBodyInput& InInput, const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose);
+	static FOpenMotionUpperBodyPose Solve(const FOpenMotionUpperBodyInput& InInput, const FTransformSettings& InSettings, const FOpenMotionUpperBodyPose& InLastPose);
+
+	// Solve every avatar in InInputs into the pose at the same index of InOutPoses, spread over up to InMaxThreads threads
+	// (0 for every worker). Each avatar uses the settings at its index in InSettings, or the only entry if there is one.
+	static void SolveBatch(const TArray<FOpenMotionUpperBodyInput>& InInputs, const TArray<FTransformSettings>& InSettings, TArray<FOpenMotionUpperBodyPose>& InOutPoses, int32 InMaxThreads = 0);
+
+	// ---------- Pipeline steps -----------
+
+	static void ConvertTransforms(FOpenMotionUpperBodyPose& InOutPose);
+	static void SetShoulder(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose);
+	static void SetLeftUpperArm(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose);
+	static void SetRightUpperArm(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose);
+	static void ResetUpperArmsLocation(FVector InLeftUpperArmLocation, FVector InRightUpperArmLocation, FOpenMotionUpperBodyPose& InOutPose);
+	static void SolveArms(const FTransformSettings& InSettings, float InDeltaSeconds, FOpenMotionUpperBodyPose& InOutPose);
+	static void Calibrate(const FTransformSettings& InSettings, float InCharacterHeight, FCharacterSettings& InOutCharacterSettings);
+
+	// ---------- Helpers -----------
+
+	static FTransform RotateUpperArm(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, bool bInIsLeftArm, const FVector& InHandLocation);
+	static FArmTransforms SetElbowBasePosition(const FCharacterSettings& InCharacterSettings, bool bInIsLeftArm, const FVector& InUpperArmLocation, const FVector& InHandLocation);
+	static float RotateElbowByHandPosition(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, bool bInIsLeftArm, const FVector& InHandLocation);
+	static float RotateElbowByHandRotation(const FTransform& InLowerArm, const FRotator& InHandRotation);
+	static float CosineRule(float InAdjacentA, float InAdjacentB, float InOpposite);
+	static FArmTransforms RotateElbow(bool bInIsLeftArm, float InAngle, const FArmTransforms& InUpperAndLowerArms, const FVector& InHandLocation);
+	static float SafeguardAngle(float InCurrent, float InLast, float InThreshold);
+	static FTransform RotatePointAroundPivot(const FTransform& InPoint, const FTransform& InPivot, const FRotator& InDelta);
+	static float GetHeadHandAngle(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, float InLastAngle, const FVector& InHandLocation, const FVector& InHandHeadDelta);
+	static FTransform GetBaseCharTransform(const FOpenMotionUpperBodyPose& InPose);
+	static FRotator GetShoulderRotationFromHead(const FOpenMotionUpperBodyPose& InPose);
+	// Also updates the head to hand angles in the pose's character settings
+	static FRotator GetShoulderRotationFromHands(const FTransformSettings& InSettings, FOpenMotionUpperBodyPose& InOutPose);
+	static FRotator FindBetweenNormals(const FVector& InA, const FVector& InB);
+
+private:
+
+	// Place the upper and lower arm for one hand and ease its elbow hand angle towards the hand's rotation
+	static FArmTransforms SolveArm(const FTransformSettings& InSettings, const FCharacterSettings& InCharacterSettings, const FTransform& InHand, const FTransform& InLastLowerArm, float InDeltaSeconds, float& InOutElbowHandAngle);
+};
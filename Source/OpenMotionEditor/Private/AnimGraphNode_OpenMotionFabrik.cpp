@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AnimGraphNode_OpenMotionFabrik.h"
+
+#define LOCTEXT_NAMESPACE "OpenMotionEditor"
+
+FText UAnimGraphNode_OpenMotionFabrik::GetControllerDescription() const
+{
+	return LOCTEXT("OpenMotionFabrik", "OpenMotion FABRIK");
+}
+
+FText UAnimGraphNode_OpenMotionFabrik::GetTooltipText() const
+{
+	return LOCTEXT("OpenMotionFabrikTooltip", "Solves an OpenMotion FABRIK rig against skeleton bones in component space, as part of the animation evaluation.");
+}
+
+FText UAnimGraphNode_OpenMotionFabrik::GetNodeTitle(ENodeTitleType::Type TitleType) const
+{
+	if (Node.RigAsset && (TitleType == ENodeTitleType::ListView || TitleType == ENodeTitleType::MenuTitle) == false)
+	{
+		return FText::Format(LOCTEXT("OpenMotionFabrikTitle", "{0}\nRig: {1}"), GetControllerDescription(), FText::FromString(Node.RigAsset->GetName()));
+	}
+	return GetControllerDescription();
+}
+
+#undef LOCTEXT_NAMESPACE
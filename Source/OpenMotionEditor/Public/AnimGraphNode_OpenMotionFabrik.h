@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimGraphNode_SkeletalControlBase.h"
+#include "AnimNode_OpenMotionFabrik.h"
+#include "AnimGraphNode_OpenMotionFabrik.generated.h"
+
+/**
+ * Editor node for FAnimNode_OpenMotionFabrik.
+ */
+UCLASS()
+class OPENMOTIONEDITOR_API UAnimGraphNode_OpenMotionFabrik : public UAnimGraphNode_SkeletalControlBase
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = Settings)
+		FAnimNode_OpenMotionFabrik Node;
+
+public:
+
+	// UEdGraphNode interface
+	virtual FText GetNodeTitle(ENodeTitleType::Type TitleType) const override;
+	virtual FText GetTooltipText() const override;
+	// End of UEdGraphNode interface
+
+protected:
+
+	// UAnimGraphNode_SkeletalControlBase interface
+	virtual FText GetControllerDescription() const override;
+	virtual const FAnimNode_SkeletalControlBase* GetNode() const override { return &Node; }
+	// End of UAnimGraphNode_SkeletalControlBase interface
+};